@@ -37,7 +37,11 @@ for further details.  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
 
 #include <vtkFiltersCoreModule.h> // For export macro
 #include <vtkPolyDataAlgorithm.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
 #include <armadillo>
+#include <array>
+#include <vector>
 
 class VTKFILTERSCORE_EXPORT SBGATMassProperties : public vtkPolyDataAlgorithm{
 public:
@@ -51,6 +55,17 @@ public:
   void PrintHeader(std::ostream& os, vtkIndent indent) override;
   void PrintTrailer(std::ostream& os, vtkIndent indent) override;
 
+  /**
+  Brings the mass properties up to date with the input shape. Filters returned by GetSharedMassProperties are frozen 
+  and never re-execute, so that concurrent callers only ever read them
+  */
+  using Superclass::Update;
+  void Update() override{
+    if (!this -> shared){
+      this -> Superclass::Update();
+    }
+  }
+
   /**
    * Compute and return the volume (m^3)
    */
@@ -126,6 +141,14 @@ public:
   void SetScaleKiloMeters() { this -> scaleFactor = 1000; this -> scaleFactorSet = true;}
 
 
+  /**
+  Sets whether the projected-volume diagnostics (GetVolumeProjected, GetVolumeX/Y/Z and GetKx/y/z) are computed,
+  which is the default. Skipping them is faster when only the volume, surface area, center of mass and inertia are needed. In that case, 
+  the volume is obtained by summing the signed volumes of the tetrahedra formed by the origin and each facet, and the diagnostics are set to NaN
+  @param compute true if the projected-volume diagnostics must be computed
+  */
+  void SetComputeProjectedVolumes(bool compute){ this -> computeProjectedVolumes = compute; this -> Modified();}
+
   /**
   * Compute and return the coordinates of the center of mass (m)
   * evaluated in the frame of origin assuming a constant density distribution
@@ -226,6 +249,53 @@ public:
   static void ComputeAndSaveMassProperties(vtkSmartPointer<vtkPolyData> shape,std::string path);
 
 
+  /**
+  Returns the mass properties of the provided shape, computed once and shared by all the callers querying the same shape.
+  The computed mass properties are cached and keyed by the shape, its modification time, its unit and whether the projected-volume diagnostics
+  are computed, so modifying the shape invalidates them. The cache only holds a weak reference to the shape: an entry is discarded 
+  once its shape is deleted. The returned filter is fully computed before being shared (cleaned shape, links, facet normals and edges)
+  and is frozen: it never re-executes, so it can be read from several threads but must not be modified
+  @param shape pointer to considered shape
+  @param is_in_meters true if the shape coordinates are expressed in meters, false if they are in kilometers
+  @param compute_projected_volumes true if the projected-volume diagnostics must be computed (see SetComputeProjectedVolumes)
+  @return updated mass properties filter
+  */
+  static vtkSmartPointer<SBGATMassProperties> GetSharedMassProperties(vtkPolyData * shape,
+    bool is_in_meters,
+    bool compute_projected_volumes = false);
+
+  /**
+  Empties the cache of shared mass properties
+  */
+  static void ClearSharedMassProperties();
+
+  /**
+  Returns the cleaned shape (merged duplicate points, double precision coordinates, unscaled) on which the mass properties 
+  were computed. Filters sharing the mass properties of a shape can use it instead of cleaning the shape again. 
+  The cleaned shape of a shared filter is read-only: it must be shallow-copied before being set as the input of another filter
+  @return cleaned shape
+  */
+  vtkPolyData * GetCleanedShape(){
+    this -> Update(); return this -> cleanedShape;
+  }
+
+  /**
+  Returns the unit outward normals of the cleaned shape facets
+  @return facet normals, one column per facet of the cleaned shape
+  */
+  const arma::mat & GetCleanedShapeFacetNormals(){
+    this -> Update(); this -> ComputeCleanedShapeTopology(); return this -> cleanedShapeFacetNormals;
+  }
+
+  /**
+  Returns the edges of the cleaned shape along with the two facets they border
+  @return edges, stored as (first point id, second point id, first facet id, second facet id). Both facet ids 
+  are -1 if the edge does not border exactly two facets
+  */
+  const std::vector<std::array<vtkIdType,4> > & GetCleanedShapeEdges(){
+    this -> Update(); this -> ComputeCleanedShapeTopology(); return this -> cleanedShapeEdges;
+  }
+
   /**
   Save the computed mass properties to a JSON file
   @param path savepath (ex: "mass_properties.json")
@@ -242,6 +312,18 @@ protected:
     vtkInformationVector** inputVector,
     vtkInformationVector* outputVector) override;
 
+  /**
+  Computes the facet normals and the edges of the cleaned shape and builds its links, 
+  unless this was already done since the last execution
+  */
+  void ComputeCleanedShapeTopology();
+
+  vtkSmartPointer<vtkPolyData> cleanedShape;
+  arma::mat cleanedShapeFacetNormals;
+  std::vector<std::array<vtkIdType,4> > cleanedShapeEdges;
+  bool cleanedShapeTopologySet = false;
+  bool shared = false;
+
   arma::vec::fixed<3> center_of_mass;
   arma::mat::fixed<3,3> inertia_tensor;
   arma::mat::fixed<3,3> principal_axes;
@@ -272,6 +354,7 @@ protected:
   double scaleFactor = 1;
 
   bool scaleFactorSet;
+  bool computeProjectedVolumes = true;
 
 
 private:
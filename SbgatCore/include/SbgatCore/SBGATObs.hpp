@@ -16,7 +16,7 @@ This class is responsible for shape model pre-processing used.
 #define SBGATOBS_HEADER
 
 
-#include <vtkModifiedBSPTree.h>
+#include <SBGATTriangleBVH.hpp>
 #include <vtkPolyData.h>
 #include <vtkPolyDataAlgorithm.h>
 #include <vtkFiltersCoreModule.h> // For export macro
@@ -24,6 +24,7 @@ This class is responsible for shape model pre-processing used.
 #include <vtkInformationVector.h>
 
 #include <armadillo>
+#include <array>
 
 
 
@@ -56,8 +57,149 @@ public:
 	*/
 	int get_number_of_bodies() const {return this -> number_of_bodies;}
 
+	/**
+	Returns the unit outbound normals of the facets of one of the considered bodies, cached when the filter is updated
+	@param body_index index of the body
+	@return facet normals, one column per facet
+	*/
+	const arma::mat & get_facet_normals(const int body_index) const {return this -> facet_normals_vec[body_index];}
+
+	/**
+	Returns the surface areas of the facets of one of the considered bodies, cached when the filter is updated
+	@param body_index index of the body
+	@return facet areas
+	*/
+	const arma::vec & get_facet_areas(const int body_index) const {return this -> facet_areas_vec[body_index];}
+
+	/**
+	Returns the center of mass of one of the considered bodies, cached when the filter is updated
+	@param body_index index of the body
+	@return center of mass, in the body-fixed frame and in the units of the shape coordinates
+	*/
+	const arma::vec & get_center_of_mass(const int body_index) const {return this -> center_of_mass_vec[body_index];}
+
+	/**
+	Sets the seed of the random number generator used to sample the facets, and restarts the sequence of 
+	collected observations. For a given seed and sequence of calls to CollectMeasurements, the collected measurements 
+	do not depend on the number of threads
+	@param seed seed of the random number generator
+	*/
+	void SetSeed(unsigned long long seed) { this -> seed = seed; this -> collection_index = 0;}
+
+	/**
+	Methods used to place the sample points over each facet
+	*/
+	enum SamplingMethod {
+		RandomSampling = 0, ///< independent uniform points (default)
+		StratifiedSampling, ///< one jittered point per cell of a regular grid over the facet's parametrization
+		SobolSampling, ///< two-dimensional Sobol sequence, shifted at random for each facet and collection
+		CentroidQuadrature ///< a single ray from the facet's centroid, weighed by the number of samples
+	};
+
+	/**
+	Sets the method used to place the sample points over each facet. The quasi-random methods reach 
+	a given noise level with fewer samples than independent random points
+	@param method sampling method
+	*/
+	void SetSamplingMethod(SamplingMethod method) { this -> sampling_method = method; }
+
+	/**
+	Returns the method used to place the sample points over each facet
+	@return sampling method
+	*/
+	SamplingMethod GetSamplingMethod() const { return this -> sampling_method; }
+
+	/**
+	Sets the resolution of the depth buffers used to find the visible and lit surfaces. If strictly positive, 
+	the bodies are rasterized from the sun/observer/radar directions into square buffers of resolution x resolution pixels
+	and each visible pixel contributes a noise-free return. If zero (default), the surfaces are instead sampled 
+	at random and ray-traced, which is kept for cross-validation
+	@param resolution number of pixels along each side of the depth buffers
+	*/
+	void SetRasterResolution(int resolution) { this -> raster_resolution = resolution; }
+
+	/**
+	Returns the resolution of the depth buffers used to find the visible and lit surfaces
+	@return number of pixels along each side of the depth buffers. 0 if the surfaces are ray-traced
+	*/
+	int GetRasterResolution() const { return this -> raster_resolution; }
+
+	/**
+	Computes the horizon map of each facet of the considered bodies. The horizon map of a facet holds, for each 
+	azimuth bin about the facet's normal, the elevation under which the facet's centroid is shadowed by its own body. 
+	Once computed, the self-shadowing of each facet is found by a lookup in its horizon map, and only the 
+	shadowing between distinct bodies is ray-traced. Must be called after Update()
+	@param N_azimuth number of azimuth bins
+	*/
+	void ComputeHorizonMaps(const int N_azimuth = 64);
+
+	/**
+	Saves the horizon maps to a binary file
+	@param path path to the file
+	*/
+	void SaveHorizonMaps(std::string path) const;
+
+	/**
+	Loads horizon maps from a binary file written by SaveHorizonMaps. Throws an std::runtime_error if
+	the maps do not match the considered bodies. Must be called after Update()
+	@param path path to the file
+	*/
+	void LoadHorizonMaps(std::string path);
+
+	/**
+	Discards the horizon maps, if any. The self-shadowing is then ray-traced
+	*/
+	void ClearHorizonMaps() { this -> horizon_maps.clear(); }
+
+	/**
+	Returns true if horizon maps are used for the self-shadowing queries
+	@return true if horizon maps are available
+	*/
+	bool HasHorizonMaps() const { return !this -> horizon_maps.empty(); }
+
 protected:
 
+	/**
+	Depth buffer holding the surface of the considered bodies closest to a distant viewer, 
+	rasterized with an orthographic projection. Pixel (i,j) is stored at i + j * resolution
+	*/
+	struct DepthBuffer {
+		arma::vec::fixed<3> dir;
+		arma::vec::fixed<3> e1;
+		arma::vec::fixed<3> e2;
+		double u_min;
+		double v_min;
+		double pixel_size;
+		int resolution;
+		std::vector<double> depth;
+		std::vector<int> facet;
+	};
+
+	/**
+	Facets in view at one observation epoch, listed as work items (owning body and index in that body), 
+	along with the cosines between the checked directions and the normals of each body's facets. 
+	Reused from one epoch to the next: the cosines are only reallocated when the number of facets changes
+	*/
+	struct FacetsInView {
+		std::vector<int> bodies;
+		std::vector<int> facets;
+		std::vector<arma::mat> cosines;
+	};
+
+	/**
+	Relative placement of the considered bodies at one observation epoch, from which the lines 
+	to be tested for intersect are expressed in the frame of each body's hierarchy. Entry 
+	(origin,considered) is stored at origin * number_of_bodies + considered
+	*/
+	struct OcclusionScene {
+		int number_of_bodies;
+		std::vector<arma::mat::fixed<3,3> > BN_dcms;
+		std::vector<arma::vec::fixed<3> > positions;
+		std::vector<arma::mat::fixed<3,3> > dcms;
+		std::vector<arma::vec::fixed<3> > offsets;
+		std::vector<arma::vec::fixed<3> > sphere_centers;
+	};
+
 	SBGATObs();
 	~SBGATObs() override;
 
@@ -71,23 +213,42 @@ protected:
 
 
 	/*
-	Determines what facets of a given shape satisfy a set of visibility conditions, formulated in terms of a 
+	Determines what facets of the considered shapes satisfy a set of visibility conditions, formulated in terms of a 
 	direction that must point above the facet's horizon. Does not check for intersects and shadowing, 
-	only compares the outbound normal orientation to the unit vector direction of each condition. If 
-	a facet is found to be visible (i.e all conditions are satisfied), 
-	its index is added to facets_in_view.
-	@param facets_in_view reference to vector holding indices of (maybe) illuminated facets
-	@param body_index index of considered body
+	only compares the cached outbound normal of each facet to the unit vector direction of each condition. 
+	The facets found to be visible (i.e all conditions are satisfied) are listed as work items in facets_in_view, 
+	whose storage is reused from one epoch to the next
 	@param dir_to_check_vec vector of directions (unit vectors) that must point above a facet's horizon for a facet to be considered as visible
 	@param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
-	@param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+	@param facets_in_view (maybe) illuminated facets
 	*/
-	void prefind_facets_inview(
-		std::vector<int> & facets_in_view,
-		const unsigned int & body_index,
-		const std::vector<arma::vec> & dir_to_check_vec,
+	void prefind_facets_inview(const std::vector<arma::vec> & dir_to_check_vec,
 		const std::vector<arma::mat> & BN_dcms_vec,
-		const std::vector<arma::vec> & positions_vec);
+		FacetsInView & facets_in_view) const;
+
+	/**
+	Checks that the states provided for a sequence of observation epochs are consistent with 
+	the number of epochs and the number of considered bodies. Throws an std::runtime_error otherwise
+	@param method name of the calling method, used in the error message
+	@param N_epochs number of epochs
+	@param positions_vecs positions of each body at each epoch
+	@param velocities_vecs velocities of each body at each epoch
+	@param mrps_vecs MRPs of each body at each epoch
+	@param omegas_vecs angular velocities of each body at each epoch
+	*/
+	void check_epochs_dimensions(const std::string & method,
+		const unsigned int N_epochs,
+		const std::vector<std::vector<arma::vec> > & positions_vecs,
+		const std::vector<std::vector<arma::vec> > & velocities_vecs,
+		const std::vector<std::vector<arma::vec> > & mrps_vecs,
+		const std::vector<std::vector<arma::vec> > & omegas_vecs) const;
+
+	/**
+	Fetches the vertices of the facets of all the considered shapes and computes their unit normals and 
+	surface areas, stored in contiguous arrays, along with the bounding sphere of each shape. 
+	Throws an std::runtime_error if a facet is not a triangle
+	*/
+	void cache_facets();
 
 	/**
 	Computes the largest facet surface area of all of the considered shapes
@@ -95,29 +256,203 @@ protected:
 	*/
 	void find_min_facet_surface_area();
 
+	/**
+	Computes the relative placement of the considered bodies at one observation epoch. 
+	The frame transformations and the bounding sphere of each body are thus evaluated 
+	once per epoch rather than once per traced line
+	@param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
+	@param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+	@param scene relative placement of the bodies
+	*/
+	void build_occlusion_scene(const std::vector<arma::mat> & BN_dcms_vec,
+		const std::vector<arma::vec> & positions_vec,
+		OcclusionScene & scene) const;
+
 	/**
 	Checks if the line spanned between provided points intersects
-	with any of the considered bodies. 
+	with any of the considered bodies. The search stops at the first intersect found. 
+	Does not allocate memory and can be called concurrently
 	@param origin_body_index index of the body from which originates the line to be tested for intersect
 	@param start_point_origin_body coordinates of the origin of the line, expressed in the original body frame
 	@param end_point_inertial coordinates of the end of the line, expressed in the inertial frame
-	@param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
-	@param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+	@param scene relative placement of the bodies at the considered epoch
+	@param tol ray-tracing tolerance
 	@return true if the line intersects with any of the considered bodies, false otherwise
 	*/
 	bool check_line_for_intersect(const int & origin_body_index,
-		const arma::vec & start_point_origin_body,
-		const arma::vec & end_point_inertial,
-		const std::vector<arma::mat> & BN_dcms_vec,
-		const std::vector<arma::vec> & positions_vec,
+		const arma::vec::fixed<3> & start_point_origin_body,
+		const arma::vec::fixed<3> & end_point_inertial,
+		const OcclusionScene & scene,
 		const double & tol) const;
 
+	/**
+	Checks if the lines spanned between a packet of origins and a common end point intersect 
+	with any of the considered bodies. The lines are traced together through each body's hierarchy, 
+	which pays off for coherent rays such as those toward the sun or the observer. Bodies other than the 
+	origin body are only traversed by the lines crossing their bounding sphere. 
+	Does not allocate memory and can be called concurrently
+	@param origin_body_index index of the body from which originate the lines to be tested for intersect
+	@param start_points_origin_body coordinates of the origins of the lines, expressed in the original body frame (3 x n_lines)
+	@param n_lines number of lines, at most SBGATTriangleBVH::PacketSize
+	@param end_point_inertial coordinates of the end of the lines, expressed in the inertial frame
+	@param scene relative placement of the bodies at the considered epoch
+	@param tol ray-tracing tolerance
+	@param intersected on input, lines flagged as true are not tested. On output, true for the lines intersecting any of the considered bodies
+	@param skip_origin_body if true, only the bodies other than the origin body are tested (e.g when the self-shadowing is given by horizon maps)
+	*/
+	void check_lines_for_intersect(const int & origin_body_index,
+		const double * start_points_origin_body,
+		const int n_lines,
+		const arma::vec::fixed<3> & end_point_inertial,
+		const OcclusionScene & scene,
+		const double & tol,
+		bool * intersected,
+		const bool skip_origin_body = false) const;
 
-	std::vector<vtkSmartPointer<vtkModifiedBSPTree>> bspTree_vec;
+	/**
+	Checks if a segment crosses a sphere
+	@param start start of the segment
+	@param end end of the segment
+	@param center center of the sphere
+	@param radius radius of the sphere
+	@return true if a point of the segment lies within the sphere
+	*/
+	static bool segment_crosses_sphere(const double * start,
+		const double * end,
+		const double * center,
+		const double radius);
+
+	/**
+	Checks if a direction is above the horizon of a facet, as given by its horizon map. 
+	Horizon maps must be available
+	@param body_index index of the body owning the facet
+	@param facet_index index of the facet in its body
+	@param n unit normal of the facet, expressed in the body frame
+	@param dir unit direction to check, expressed in the body frame
+	@return true if dir points above the facet's horizon
+	*/
+	bool is_above_horizon(const int body_index,
+		const int facet_index,
+		const arma::vec::fixed<3> & n,
+		const arma::vec::fixed<3> & dir) const;
+
+	/**
+	Computes the azimuth of a direction about a facet normal, measured in the tangent plane 
+	from a reference axis that only depends on the normal
+	@param n unit normal of the facet
+	@param dir unit direction
+	@return azimuth in [0,2 pi)
+	*/
+	static double facet_azimuth(const arma::vec::fixed<3> & n, const arma::vec::fixed<3> & dir);
+
+	/**
+	Draws two independent uniform numbers in [0,1) from a counter-based generator. The numbers only depend 
+	on the seed, the stream and the counter, so samples can be drawn in any order and by any thread
+	@param seed seed of the generator
+	@param stream index of the stream (e.g identifying a facet)
+	@param counter index of the draw in the stream
+	@param u first uniform number
+	@param v second uniform number
+	*/
+	static void draw_uniforms(const unsigned long long seed,
+		const unsigned long long stream,
+		const unsigned long long counter,
+		double & u,
+		double & v);
+
+	/**
+	Places a sample point over a facet according to the sampling method. The point is 
+	(1 - sqrt(u)) * P0 + sqrt(u) * (1 - v) * P1 + sqrt(u) * v * P2, a mapping which preserves areas
+	@param stream index of the stream used to sample the facet
+	@param sample index of the sample in the facet
+	@param N_samples number of samples drawn from the facet
+	@param u first parametric coordinate of the sample, in [0,1)
+	@param v second parametric coordinate of the sample, in [0,1)
+	*/
+	void sample_facet(const unsigned long long stream,
+		const int sample,
+		const int N_samples,
+		double & u,
+		double & v) const;
+
+	/**
+	Returns the number of rays traced from a facet and the weight of each of them, 
+	such that the rays account for N_samples samples
+	@param N_samples number of samples drawn from the facet
+	@param ray_weight weight of each ray
+	@return number of rays traced from the facet
+	*/
+	int get_number_of_rays(const int N_samples, double & ray_weight) const;
+
+	/**
+	Returns the index of the stream used to sample a facet during the current collection
+	@param collection_index index of the collection in the sequence
+	@param body_index index of the body owning the facet
+	@param facet_index index of the facet in its body
+	@return stream index
+	*/
+	unsigned long long sampling_stream(const unsigned long long collection_index,
+		const int body_index,
+		const int facet_index) const;
+
+
+	/**
+	Gathers the vertices of all the facets of the considered bodies, expressed in the inertial frame
+	@param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
+	@param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+	@param vertices coordinates of the three vertices of each facet, expressed in the inertial frame
+	@param bodies index of the body owning each facet
+	*/
+	void gather_inertial_facets(const std::vector<arma::mat> & BN_dcms_vec,
+		const std::vector<arma::vec> & positions_vec,
+		std::vector<std::array<double,9> > & vertices,
+		std::vector<int> & bodies) const;
+
+	/**
+	Rasterizes the facets facing a distant viewer into a depth buffer of resolution raster_resolution
+	@param vertices coordinates of the three vertices of each facet, expressed in the inertial frame
+	@param dir unit direction towards the viewer, expressed in the inertial frame
+	@param buffer depth buffer, holding on output the index of the facet seen at each pixel (-1 if none)
+	*/
+	void rasterize(const std::vector<std::array<double,9> > & vertices,
+		const arma::vec & dir,
+		DepthBuffer & buffer) const;
+
+	/**
+	Returns the inertial coordinates of the surface point seen at the center of a pixel
+	@param buffer depth buffer
+	@param pixel index of the pixel
+	@return coordinates of the surface point, expressed in the inertial frame
+	*/
+	static arma::vec::fixed<3> get_pixel_point(const DepthBuffer & buffer, const int pixel);
+
+	/**
+	Checks if a surface point is seen by the viewer of a depth buffer
+	@param buffer depth buffer
+	@param point coordinates of the surface point, expressed in the inertial frame
+	@param cos_incidence cosine of the angle between the surface normal at point and the viewing direction, 
+	used to scale the depth bias with the surface slope
+	@return true if no surface lies between the point and the viewer
+	*/
+	static bool is_seen(const DepthBuffer & buffer, const arma::vec::fixed<3> & point, const double cos_incidence);
+
+	std::vector<SBGATTriangleBVH> bvh_vec;
+	std::vector<arma::mat> horizon_maps;
+	std::vector<std::vector<std::array<double,9> > > facet_vertices_vec;
+	std::vector<arma::mat> facet_normals_vec;
+	std::vector<arma::vec> facet_areas_vec;
+	std::vector<arma::vec::fixed<3> > bounding_sphere_centers_vec;
+	std::vector<double> bounding_sphere_radii_vec;
 	std::vector<vtkPolyData *> polydata_vec;
 	std::vector<arma::vec> center_of_mass_vec;
+	FacetsInView facets_in_view;
 	
 	double scaleFactor = 1;
+	double reference_length;
+	unsigned long long seed = 0;
+	unsigned long long collection_index = 0;
+	int raster_resolution = 0;
+	SamplingMethod sampling_method = RandomSampling;
 	double min_area;
 	int number_of_bodies;
 
@@ -33,7 +33,6 @@
 
 #include <vtkFiltersCoreModule.h> // For export macro
 
-#include <vtkModifiedBSPTree.h>
 #include <vtkImageData.h>
 
 #include <armadillo>
@@ -85,6 +84,34 @@ public:
     const std::vector<arma::vec> & omegas_vec,
     const bool & penalize_indicence);
 
+  /**
+  Computes collected luminosity over the surface of the considered small bodies at a sequence of times after epoch. 
+  The epochs are distributed across threads. The luminosities are the same as those obtained by calling CollectMeasurements 
+  for each epoch in turn, and are appended to measurements in the order of the provided times
+  @param measurements reference to a vector of std::arrays holding (times,luminosity)
+  @param times measurement times
+  @param N minimum number of measurements to produce over the smallest facet in the shape. The number of samples for any other facet will be equal to N * facet_surface_area / smallest_facet_surface_area
+  @param sun_dir unit direction towards sun from target in inertial frame
+  @param observer_dir unit direction towards observer from target in inertial frame
+  @param positions_vecs positions of each target's center-of-mass expressed in the primary's body frame, at each time
+  @param velocities_vecs inertial velocities of each target's center-of-mass expressed in the primary's body frame, at each time
+  @param mrps_vecs MRPs defining the inertial-to-body DCM [BN] of each target, at each time
+  @param omegas_vecs angular velocities of each body expressed in the inertial frame, at each time
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angles 
+  between the sampled point and the sun and observer
+  */
+  void CollectMeasurementsSequence(
+    std::vector<std::array<double, 2> > & measurements,
+    const std::vector<double> & times,
+    const int & N,
+    const arma::vec & sun_dir,
+    const arma::vec & observer_dir,
+    const std::vector<std::vector<arma::vec> > & positions_vecs,
+    const std::vector<std::vector<arma::vec> > & velocities_vecs,
+    const std::vector<std::vector<arma::vec> > & mrps_vecs,
+    const std::vector<std::vector<arma::vec> > & omegas_vecs,
+    const bool & penalize_indicence);
+
 
   /**
   Save the raw data points from the unnormalized (times,luminosity) time series to file
@@ -99,24 +126,72 @@ protected:
   ~SBGATObsLightcurve() override;
 
 
+  /**
+  Computes the luminosity at one observation epoch
+  @param measurement reference to an std::array holding (time,luminosity). Only the luminosity is set
+  @param N minimum number of measurements to produce over the smallest facet in the shape
+  @param sun_dir unit direction towards sun from target in inertial frame
+  @param observer_dir unit direction towards observer from target in inertial frame
+  @param positions_vec vector of positions of each target's center-of-mass expressed in the primary's body frame
+  @param mrps_vec vector of MRPs defining the inertial-to-body DCM [BN]
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angles 
+  between the sampled point and the sun and observer
+  @param collection_index index of the collection in the observation sequence, used to sample the facets
+  @param facets_in_view workspace listing the facets in view, reused across epochs
+  */
+  void collect_epoch(std::array<double, 2> & measurement,
+    const int N,
+    const arma::vec & sun_dir,
+    const arma::vec & observer_dir,
+    const std::vector<arma::vec> & positions_vec,
+    const std::vector<arma::vec> & mrps_vec,
+    const bool penalize_indicence,
+    const unsigned long long collection_index,
+    FacetsInView & facets_in_view) const;
+
+  /**
+  Computes the luminosity at one observation epoch by rasterizing the considered bodies 
+  from the observer and sun directions. Each pixel of the observer's depth buffer that is seen 
+  in the sun's depth buffer contributes the luminosity that the sampler would on average collect over 
+  the surface covered by the pixel
+  @param N minimum number of measurements to produce over the smallest facet in the shape
+  @param sun_dir unit direction towards sun from target in inertial frame
+  @param observer_dir unit direction towards observer from target in inertial frame
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angles 
+  between the sampled point and the sun and observer
+  @param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
+  @param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+  @return luminosity
+  */
+  double rasterized_luminosity(const int N,
+    const arma::vec & sun_dir,
+    const arma::vec & observer_dir,
+    const bool penalize_indicence,
+    const std::vector<arma::mat> & BN_dcms_vec,
+    const std::vector<arma::vec> & positions_vec) const;
+
   /**
   Ray traces all of the facets in view to the sun/observer and increment measurement
   counter if in view
   @param measurements_temp reference to an std::array holding (times,luminosity)
-  @param facets_in_view reference to a vector of vector holding indices of (maybe) illuminated facets for all considered bodies
+  @param bodies index of the body owning each (maybe) illuminated facet
+  @param facets index of each (maybe) illuminated facet in its body
   @param sun_dir sun direction expressed in inertial frame
   @param observer_dir observer direction expressed in inertial frame
   @param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
   @param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+  @param collection_index index of the collection in the observation sequence, used to sample the facets
   */
   void reverse_ray_trace(std::array<double, 2>  & measurements_temp,
-    const std::vector<std::vector<int> > & facets_in_view,
+    const std::vector<int> & bodies,
+    const std::vector<int> & facets,
     const arma::vec & sun_dir,
     const arma::vec & observer_dir,
     const int N,
     const bool penalize_indicence,
     const std::vector<arma::mat> & BN_dcms_vec,
-    const std::vector<arma::vec> & positions_vec);
+    const std::vector<arma::vec> & positions_vec,
+    const unsigned long long collection_index) const;
 
   
 
@@ -36,7 +36,6 @@ provided small body
 #include <vtkFiltersCoreModule.h> // For export macro
 #include <vtkPolyDataAlgorithm.h>
 
-#include <vtkModifiedBSPTree.h>
 #include <vtkImageData.h>
 
 #include <armadillo>
@@ -107,6 +106,42 @@ public:
     const double & r_bin,
     const double & rr_bin);
 
+  /**
+  Collects range/range-rate images at a sequence of times after the epoch, binning the samples directly 
+  into the images as they are ray-traced. Unlike CollectMeasurementsSequence followed by BinObservations, 
+  the samples are never stored, so the memory footprint scales with the image size rather than with the number of samples. 
+  The bin sizes and counts are therefore fixed up front: each image is centered on the range and range-rate 
+  of the primary's center of mass, and samples falling outside of it are discarded. The previous images, if any, are cleared.
+  Will throw an std::runtime_error exception if 
+  - either of the provided bin sizes or bin counts are invalid (i.e <= 0)
+  - the states are not provided for each epoch and each considered body
+  @param times observation timestamps
+  @param N minimum number of measurements to produce over the smallest facet in the shape
+  @param radar_dir unit direction towards radar from target in inertial frame
+  @param positions_vecs positions of each target's center-of-mass at each epoch
+  @param velocities_vecs inertial velocities of each target's center-of-mass at each epoch
+  @param mrps_vecs MRPs defining the inertial-to-body DCM [BN] of each target at each epoch
+  @param omegas_vecs angular velocities of each body expressed in the inertial frame at each epoch
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angle between
+  the sampled point and the radar squared
+  @param r_bin range bin size (m)
+  @param rr_bin range-rate bin size (m/s)
+  @param n_bin_r number of range bins
+  @param n_bin_rr number of range-rate bins
+  */
+  void CollectImages(const std::vector<double> & times,
+    const int & N,
+    const arma::vec & radar_dir,
+    const std::vector<std::vector<arma::vec> > & positions_vecs,
+    const std::vector<std::vector<arma::vec> > & velocities_vecs,
+    const std::vector<std::vector<arma::vec> > & mrps_vecs,
+    const std::vector<std::vector<arma::vec> > & omegas_vecs,
+    const bool & penalize_indicence,
+    const double & r_bin,
+    const double & rr_bin,
+    const int & n_bin_r,
+    const int & n_bin_rr);
+
   /**
   Save the binned radar images to PNGs in the prescribed folder.
   The images will be normalized by the largest value in the observation sequence
@@ -132,29 +167,136 @@ protected:
   SBGATObsRadar();
   ~SBGATObsRadar() override;
 
+  /**
+  Range/range-rate extent of an image into which measurements are directly binned. 
+  The image is flipped: its first row and column hold the largest range and range-rate
+  */
+  struct RadarImageWindow {
+    double max_range;
+    double max_range_rate;
+    double r_bin;
+    double rr_bin;
+    int n_bin_r;
+    int n_bin_rr;
+  };
+
+  /**
+  Finds the bin of an image window holding a measurement
+  @param window image window
+  @param range range of the measurement (m)
+  @param range_rate range-rate of the measurement (m/s)
+  @param bin index of the bin in the n_bin_r x n_bin_rr row-major image
+  @return false if the measurement falls outside of the window
+  */
+  static bool locate_bin(const RadarImageWindow & window,
+    const double range,
+    const double range_rate,
+    int & bin);
+
+
 
+  /**
+  Collects the range/range-rate samples at one observation epoch
+  @param measurements measurements collected at this epoch
+  @param N minimum number of measurements to produce over the smallest facet in the shape
+  @param radar_dir unit direction towards radar from target in inertial frame
+  @param positions_vec vector of positions of each target's center-of-mass expressed in the primary's body frame
+  @param velocities_vec vector of inertial velocities of each target's center-of-mass expressed in the primary's body frame
+  @param mrps_vec vector of MRPs defining the inertial-to-body DCM [BN]
+  @param omegas_vec vector of angular velocities of each body expressed in the inertial frame
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angle between
+  the sampled point and the radar squared
+  @param collection_index index of the collection in the observation sequence, used to sample the facets
+  @param facets_in_view workspace listing the facets in view, reused across epochs
+  @param window if not null, the measurements are binned into image instead of being stored in measurements
+  @param image n_bin_r x n_bin_rr row-major image into which the measurements are added if window is not null
+  */
+  void collect_epoch(std::vector<std::array<double, 3> > & measurements,
+    const int N,
+    const arma::vec & radar_dir,
+    const std::vector<arma::vec> & positions_vec,
+    const std::vector<arma::vec> & velocities_vec,
+    const std::vector<arma::vec> & mrps_vec,
+    const std::vector<arma::vec> & omegas_vec,
+    const bool penalize_indicence,
+    const unsigned long long collection_index,
+    FacetsInView & facets_in_view,
+    const RadarImageWindow * window = nullptr,
+    double * image = nullptr) const;
 
   /**
-  Ray traces the facets in view to the radar and measurements sequence with range/range-rate data
+  Ray traces the facets in view to the radar and fills measurements with range/range-rate data
   if sampled point was in view of the radar
-  @param measurements_sequence Sequence of measurements to add new image data to
-  @param facets_in_view reference to a vector of vector holding indices of (maybe) illuminated facets for all considered bodies
+  @param measurements measurements collected at this epoch
+  @param bodies index of the body owning each (maybe) illuminated facet
+  @param facets index of each (maybe) illuminated facet in its body
   @param radar_dir radar direction expressed in inertial frame
   @param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
   @param positions_vec vector holding the position vector of the CM of each body w/r to the primary
   @param velocities_vec vector holding the velocities vector of the CM of each body
   @param omega_vec vector holding the angular velocities vector of each body
+  @param collection_index index of the collection in the observation sequence, used to sample the facets
+  @param window if not null, the measurements are binned into image instead of being stored in measurements
+  @param image n_bin_r x n_bin_rr row-major image into which the measurements are added if window is not null
   */
-  void reverse_ray_trace(SBGATRadarObsSequence & measurements_sequence,
-    const std::vector<std::vector<int> > & facets_in_view,
+  void reverse_ray_trace(std::vector<std::array<double, 3> > & measurements,
+    const std::vector<int> & bodies,
+    const std::vector<int> & facets,
     const arma::vec & radar_dir,
     const int N,
     const bool penalize_indicence,
     const std::vector<arma::mat> & BN_dcms_vec,
     const std::vector<arma::vec> & positions_vec,
     const std::vector<arma::vec> & velocities_vec,
-    const std::vector<arma::vec> & omega_vec);
+    const std::vector<arma::vec> & omega_vec,
+    const unsigned long long collection_index,
+    const RadarImageWindow * window = nullptr,
+    double * image = nullptr) const;
+
+  /**
+  Collects the range/range-rate returns at one observation epoch by rasterizing the considered bodies 
+  from the radar direction. Each visible pixel yields one return, weighed by the incidence that the sampler
+  would on average collect over the surface covered by the pixel
+  @param measurements measurements collected at this epoch
+  @param N minimum number of measurements to produce over the smallest facet in the shape
+  @param radar_dir radar direction expressed in inertial frame
+  @param penalize_incidence if true, each measurement will be weighed by the cos(incidence) angle between
+  the sampled point and the radar squared
+  @param BN_dcms_vec vector holding the DCMs orienting the body frame of each body w/r to inertial
+  @param positions_vec vector holding the position vector of the CM of each body w/r to the primary
+  @param velocities_vec vector holding the velocities vector of the CM of each body
+  @param omegas_vec vector holding the angular velocities vector of each body
+  */
+  void rasterized_measurements(std::vector<std::array<double, 3> > & measurements,
+    const int N,
+    const arma::vec & radar_dir,
+    const bool penalize_indicence,
+    const std::vector<arma::mat> & BN_dcms_vec,
+    const std::vector<arma::vec> & positions_vec,
+    const std::vector<arma::vec> & velocities_vec,
+    const std::vector<arma::vec> & omegas_vec) const;
 
+  /**
+  Bins a set of measurements into a range/range-rate histogram. The measurements are split in a 
+  fixed number of chunks binned in private histograms, which are then summed in order so that 
+  the histogram does not depend on the number of threads
+  @param measurements range/range-rate measurements collected at one observation time
+  @param max_range largest range in the measurements (m)
+  @param max_range_rate largest range-rate in the measurements (m/s)
+  @param r_bin range bin size (m)
+  @param rr_bin range-rate bin size (m/s)
+  @param n_bin_r number of range bins
+  @param n_bin_rr number of range-rate bins
+  @param histogram pointer to the n_bin_r x n_bin_rr row-major histogram to fill
+  */
+  void bin_measurements(const std::vector<std::array<double, 3> > & measurements,
+    const double max_range,
+    const double max_range_rate,
+    const double r_bin,
+    const double rr_bin,
+    const int n_bin_r,
+    const int n_bin_rr,
+    double * histogram) const;
 
   std::vector<vtkSmartPointer<vtkImageData>> images;
   
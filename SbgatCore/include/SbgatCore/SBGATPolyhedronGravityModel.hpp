@@ -206,7 +206,7 @@ the polydata used to construct the PGM
   @return mass (kg)
   */
   double GetMass() const{
-    return this -> density * this -> mass_properties -> GetVolume() * std::pow(this -> scaleFactor,3);
+    return this -> density * this -> mass_properties -> GetVolume();
   }
 
   /**
@@ -241,6 +241,74 @@ the polydata used to construct the PGM
   */
   double GetLe( const double * pos, const int & e) const;
 
+  /**
+  Returns the performance factor of the facet formed by the three prescribed vertices at the specified position
+  @param pos position of field point
+  @param r0 coordinates of the first vertex in the facet
+  @param r1 coordinates of the second vertex in the facet
+  @param r2 coordinates of the third vertex in the facet
+  @return omega_f
+  */
+  static double GetOmegaf(const double * pos,const double * r0,const double * r1,const double * r2);
+
+  /**
+  Returns the wire potential of the edge joining the two prescribed vertices at the specified position
+  @param pos position of field point
+  @param r0 coordinates of the first vertex on the edge
+  @param r1 coordinates of the second vertex on the edge
+  @return L_e
+  */
+  static double GetLe(const double * pos,const double * r0,const double * r1);
+
+  /**
+  Evaluates the non-dimensional polyhedron potential and acceleration sums at the specified point from flat, row-major
+  vertex/topology/dyad containers. This is the same evaluation as GetPotentialAcceleration, but it lets a perturbed copy
+  of the shape be evaluated without modifying the filter. The returned potential must be scaled by
+  0.5 * G * density * scaleFactor^2 and the acceleration by G * density * scaleFactor
+  @param point coordinates of queried point, expressed in the same unit as the vertices
+  @param vertices vertex coordinates (3 * N_C)
+  @param facets vertex indices of each facet (3 * N_f)
+  @param edges vertex indices of each edge (2 * N_e)
+  @param facet_dyads facet dyads (9 * N_f)
+  @param edge_dyads edge dyads (9 * N_e)
+  @param[out] potential non-dimensional potential sum
+  @param[out] acc non-dimensional acceleration sum
+  */
+  static void GetPotentialAccelerationFromDyads(const double * point,
+    const std::vector<double> & vertices,
+    const std::vector<int> & facets,
+    const std::vector<int> & edges,
+    const std::vector<double> & facet_dyads,
+    const std::vector<double> & edge_dyads,
+    double & potential,
+    arma::vec::fixed<3> & acc);
+
+  /**
+  Evaluates the contribution of a subset of the facets and edges to the non-dimensional polyhedron potential 
+  and acceleration sums at the specified point (see the overload above). Since the sums are additive, the contribution
+  of the facets and edges that do not change can be evaluated once and reused
+  @param point coordinates of queried point, expressed in the same unit as the vertices
+  @param vertices vertex coordinates (3 * N_C)
+  @param facets vertex indices of each facet (3 * N_f)
+  @param edges vertex indices of each edge (2 * N_e)
+  @param facet_dyads facet dyads (9 * N_f)
+  @param edge_dyads edge dyads (9 * N_e)
+  @param facet_ids indices of the facets to sum over
+  @param edge_ids indices of the edges to sum over
+  @param[out] potential non-dimensional potential sum over the selected facets and edges
+  @param[out] acc non-dimensional acceleration sum over the selected facets and edges
+  */
+  static void GetPotentialAccelerationFromDyads(const double * point,
+    const std::vector<double> & vertices,
+    const std::vector<int> & facets,
+    const std::vector<int> & edges,
+    const std::vector<double> & facet_dyads,
+    const std::vector<double> & edge_dyads,
+    const std::vector<int> & facet_ids,
+    const std::vector<int> & edge_ids,
+    double & potential,
+    arma::vec::fixed<3> & acc);
+
 
   /**
   Returns coordinates of the three vertices forming a facet
@@ -514,6 +582,31 @@ protected:
     vtkInformationVector** inputVector,
     vtkInformationVector* outputVector) override;
 
+  /**
+  Returns the contribution of a facet to the non-dimensional potential and acceleration sums
+  @param[in] pos position of field point
+  @param[in] r0 coordinates of the first vertex in the facet
+  @param[in] r1 coordinates of the second vertex in the facet
+  @param[in] r2 coordinates of the third vertex in the facet
+  @param[in] F facet dyad (row-major)
+  @param[out] pot contribution to the potential sum
+  @param[out] acc contribution to the acceleration sum
+  */
+  static void GetFacetPotentialAcceleration(const double * pos,const double * r0,const double * r1,const double * r2,
+    const double * F,double & pot,double * acc);
+
+  /**
+  Returns the contribution of an edge to the non-dimensional potential and acceleration sums
+  @param[in] pos position of field point
+  @param[in] r0 coordinates of the first vertex on the edge
+  @param[in] r1 coordinates of the second vertex on the edge
+  @param[in] E edge dyad (row-major)
+  @param[out] pot contribution to the potential sum
+  @param[out] acc contribution to the acceleration sum
+  */
+  static void GetEdgePotentialAcceleration(const double * pos,const double * r0,const double * r1,
+    const double * E,double & pot,double * acc);
+
   double ** facet_dyads;
   double ** edge_dyads;
   double ** facet_normals;
@@ -82,13 +82,96 @@ public:
     arma::mat::fixed<3,3> & acc_cov) const;
 
   /**
-  Returns a square root of the covariance matrix using a cholesky decomposition.
-  The covariance square root is expressed in the original shape's unit squared (that is, 
+  Returns a square root of the covariance matrix. If ComputeCovarianceSquareRoot() was called since the last
+  change to the covariance, the cached factor is returned. Otherwise, a cholesky decomposition of the covariance
+  is computed (and not cached). Note that the full-rank square root of a sparse covariance is returned as a 
+  dense (3 * N_C x 3 * N_C) matrix: use GetSparseCovarianceSquareRoot() to avoid this.
+  The covariance square root is expressed in the original shape's unit (that is,
   meters or kilometers)
   @return covariance square root
   */
   arma::mat GetCovarianceSquareRoot() const;
 
+  /**
+  Same as GetCovarianceSquareRoot(), but returns the square root in sparse storage. The full-rank 
+  square root of a sparse covariance is obtained from ComputeSparseCholesky() and is never densified
+  @return covariance square root
+  */
+  arma::sp_mat GetSparseCovarianceSquareRoot() const;
+
+  /**
+  Computes and caches a square root L of the shape covariance such that P_CC ~= L * L^T.
+  By default, a full-rank factor is computed: the lower cholesky factor of a dense covariance, or the 
+  sparse cholesky factor of ComputeSparseCholesky() for a sparse covariance (see SetCovarianceKernel).
+  If a dense covariance is only semi-definite or if a truncation is requested, L is formed from the dominant eigenmodes 
+  of the covariance instead and only has as many columns as retained modes. The dominant eigenmodes of a sparse covariance are
+  obtained iteratively (arma::eigs_sym), without forming a dense copy of the covariance.
+  The cached factor is discarded by any subsequent call to SetCovarianceComponent
+  @param rank maximum number of retained eigenmodes. 0 means no limit
+  @param energy minimum fraction of the covariance trace that the retained eigenmodes must capture (in ]0,1])
+  */
+  void ComputeCovarianceSquareRoot(const unsigned int rank = 0,const double energy = 1);
+
+  /**
+  Runs a Monte Carlo analysis of the potential and acceleration at the prescribed field points.
+  Shape outcomes are drawn from the cached covariance square root (see ComputeCovarianceSquareRoot) and
+  applied to a copy of the vertex coordinates. Only the facets and edges touched by vertices with a non-zero row in the 
+  square root are affected: their dyads are updated and their contribution to the potential and acceleration is re-evaluated
+  at each outcome, while the contribution of the other facets and edges is evaluated once. 
+  Neither the input polydata nor the PGM filter are modified.
+  The saving is only effective if the uncertainty is confined to part of the shape: if every vertex is uncertain, 
+  or if the square root is formed from (generally dense) eigenmodes, every outcome re-evaluates all of the facets and edges.
+  The outcomes are split in a fixed number of batches, each drawn from its own random stream and
+  accumulated in its own running statistics. The batches are merged in order, so the results only depend on
+  the seed and not on the number of threads
+  @param[in] points field points (3 x N_points), expressed in the same frame/unit as the polydata
+  @param[in] N_samples number of shape outcomes
+  @param[in] seed seed of the random streams
+  @param[out] potential_mean sample mean of the potential at each field point (N_points) (m ^ 2/ s ^2)
+  @param[out] potential_var sample variance of the potential at each field point (N_points) (m ^ 4/ s ^4)
+  @param[out] acc_mean sample mean of the acceleration at each field point (3 x N_points) (m / s ^2)
+  @param[out] acc_cov sample covariance of the acceleration at each field point (3 x 3 x N_points) (m^2 / s ^4)
+  */
+  void RunMonteCarlo(const arma::mat & points,
+    const unsigned int N_samples,
+    const unsigned int seed,
+    arma::vec & potential_mean,
+    arma::vec & potential_var,
+    arma::mat & acc_mean,
+    arma::cube & acc_cov) const;
+
+  /**
+  Linearly propagates the shape covariance to the acceleration along a trajectory, returning the 
+  covariance of the acceleration at each point along with the cross-covariances between points
+  up to a prescribed lag. The partials of the acceleration with respect to the shape are computed once per
+  point (in parallel) and reused by every covariance block they contribute to. Only a sliding window of partials is kept 
+  in memory, so arcs of arbitrary length can be processed.
+  If ComputeCovarianceSquareRoot() was called since the last change to the covariance, 
+  the cached (possibly truncated) square root is used to reduce the partials before forming the blocks.
+  @param[in] positions trajectory points (3 x T), expressed in meters in the shape's body-fixed frame
+  @param[in] max_lag maximum lag (in number of points) for which the cross-covariances are computed
+  @param[out] acc_cov covariance of the acceleration at each point (3 x 3 x T) (m^2 / s ^4)
+  @param[out] acc_cross_cov acc_cross_cov[k - 1].slice(t) is the cross-covariance E[dA(t) * dA(t + k)^T] for 
+  t in [0,T - k) (3 x 3 x (T - k)) (m^2 / s ^4)
+  */
+  void GetCovarianceAccelerationTrajectory(const arma::mat & positions,
+    const unsigned int max_lag,
+    arma::cube & acc_cov,
+    std::vector<arma::cube> & acc_cross_cov) const;
+
+  /**
+  Linearly propagates the shape covariance to the acceleration along a trajectory. 
+  See GetCovarianceAccelerationTrajectory(const arma::mat & positions,...) for details
+  @param[in] positions trajectory points, such as returned by SBGATTrajectory, expressed in meters in the shape's body-fixed frame
+  @param[in] max_lag maximum lag (in number of points) for which the cross-covariances are computed
+  @param[out] acc_cov covariance of the acceleration at each point (3 x 3 x T) (m^2 / s ^4)
+  @param[out] acc_cross_cov acc_cross_cov[k - 1].slice(t) is the cross-covariance E[dA(t) * dA(t + k)^T] (m^2 / s ^4)
+  */
+  void GetCovarianceAccelerationTrajectory(const std::vector<arma::vec> & positions,
+    const unsigned int max_lag,
+    arma::cube & acc_cov,
+    std::vector<arma::cube> & acc_cross_cov) const;
+
   /**
   Runs a finite-differencing based test of the implemented PGM partials
   @param input path to obj file used to test the partials
@@ -118,13 +201,47 @@ public:
   Sets the block P_Cv0_Cv1 in the total shape covariance to the prescribed value P. 
   When v0 != v1, this function must be called twice to set the two symmetric blocks
   on both sides of the diagonal. The covariance is expressed in the original shape's unit squared (that is, 
-  meters squared or kilometers squared)
+  meters squared or kilometers squared). Unless the covariance was built by SetCovarianceKernel,
+  the first call allocates the dense (3 * N_C x 3 * N_C) covariance
   @param P covariance/correlation of Cv0 and Cv1
   @param v0 index of first vertex
   @param v1 index of second vertex
   */
   void SetCovarianceComponent(const arma::mat::fixed<3,3> & P,const int & v0, const int & v1);
 
+  /**
+  Builds the total shape covariance from a correlation-length kernel, in place of filling it
+  block by block with SetCovarianceComponent. The covariance between vertices i and j distant by d is
+  sigma^2 * k(d) * n_i * n_j^T where n_i is the area-weighted normal at vertex i
+  (or sigma^2 * k(d) * I if isotropic is true), with k(d) = exp(- d^2 / l^2) as in SBGATShapeUncertainty.
+  Only the vertex pairs within the cutoff distance are visited, through a uniform grid of cells queried in parallel, and the covariance
+  is stored in a sparse matrix so that both the build and the storage are O(N_C * k) with k the average number
+  of neighbors within the cutoff. All distances are expressed in the original shape's unit
+  @param sigma standard deviation of the vertex deviations (L)
+  @param l correlation distance (L). Governs correlation decay
+  @param cutoff distance (L) beyond which vertices are uncorrelated. If 0, 3 * l is used
+  @param compact_support if true, the kernel is tapered by a Wendland function of radius cutoff, which
+  keeps the covariance positive semi-definite. Otherwise, the kernel is simply truncated at cutoff: the resulting 
+  covariance may be indefinite, in which case ComputeCovarianceSquareRoot throws instead of producing wrong samples
+  @param isotropic if true, vertices deviate isotropically. Otherwise, they deviate along their normal
+  */
+  void SetCovarianceKernel(const double sigma,const double l,double cutoff = 0,
+    const bool compact_support = true,const bool isotropic = false);
+
+  /**
+  Returns the total shape covariance, expressed in the original shape's unit squared (that is,
+  meters squared or kilometers squared). A sparse covariance (see SetCovarianceKernel) is returned
+  as a dense copy: use GetSparseCovariance() to avoid it
+  @return shape covariance (3 * N_C x 3 * N_C)
+  */
+  arma::mat GetCovariance() const;
+
+  /**
+  Same as GetCovariance(), but returns the covariance in sparse storage
+  @return shape covariance (3 * N_C x 3 * N_C)
+  */
+  arma::sp_mat GetSparseCovariance() const;
+
   /**
   Applies prescribed deviation to all the N_C control points and updates pgm
   @param delta_C deviation (3 * N_C x 1)
@@ -148,6 +265,108 @@ public:
 
   vtkSmartPointer<SBGATPolyhedronGravityModel> GetPGMModel() const {return this -> pgm_model;}
 
+  /**
+  Evaluates the variances of the surface Polyhedron Gravity Model quantities (see SBGATPolyhedronGravityModel::ComputeSurfacePGM) at the center
+  of the queried facets, using the current shape covariance. The field points move with the facets they lie on, and the center of mass
+  is held fixed. The partials of the inertial potential and acceleration are computed once per facet and reused by all the omega-dependent
+  (body-fixed) quantities. The queried facets are processed in parallel.
+  If ComputeCovarianceSquareRoot() was called since the last change to the covariance, the variances are formed from the cached
+  (possibly truncated) square root, so that a dense covariance is never multiplied.
+  Non-queried facets are assigned a NaN variance, and facets queried more than once are only evaluated once.
+  The slope is not differentiable where it vanishes (e.g. at the center of a face of a non-rotating cube): 
+  its variance is then reported as zero.
+  @param[in] queried_elements vector of facet indices where the variances should be evaluated
+  @param[in] omega fixed angular velocity of shape expressed in rad/s
+  @param[in] com center of mass of the shape (m)
+  @param[out] slopes_variances variances of the gravitational slopes (deg^2), one per facet
+  @param[out] inertial_potentials_variances variances of the inertial potentials (m^4/s^4), one per facet
+  @param[out] body_fixed_potentials_variances variances of the body-fixed potentials (m^4/s^4), one per facet
+  @param[out] inertial_acc_magnitudes_variances variances of the inertial acceleration magnitudes (m^2/s^4), one per facet
+  @param[out] body_fixed_acc_magnitudes_variances variances of the body-fixed acceleration magnitudes (m^2/s^4), one per facet
+  */
+  void GetSurfacePGMVariances(const std::vector<unsigned int> & queried_elements,
+    const arma::vec::fixed<3> & omega,
+    const arma::vec::fixed<3> & com,
+    std::vector<double> & slopes_variances,
+    std::vector<double> & inertial_potentials_variances,
+    std::vector<double> & body_fixed_potentials_variances,
+    std::vector<double> & inertial_acc_magnitudes_variances,
+    std::vector<double> & body_fixed_acc_magnitudes_variances) const;
+
+  /**
+  Evaluates the variances of the surface Polyhedron Gravity Model quantities at the center of the queried facets of the provided shape,
+  whose vertices are assumed to deviate with the correlation-length covariance of SetCovarianceKernel
+  @param[in] selected_shape shape for which the surface polyhedron gravity model uncertainty must be computed
+  @param[in] queried_elements vector of elements indices where the variances should be evaluated
+  @param[in] is_in_meters true if the shape coordinates were expressed in meters, false if they were expressed in kilometers
+  @param[in] density shape bulk density in kg/m^3
+  @param[in] omega fixed angular velocity of shape expressed in rad/s
+  @param[in] sigma standard deviation of the vertex deviations, in the shape's unit
+  @param[in] l correlation distance, in the shape's unit
+  @param[out] slopes_variances variances of the gravitational slopes (deg^2), one per facet
+  @param[out] inertial_potentials_variances variances of the inertial potentials (m^4/s^4), one per facet
+  @param[out] body_fixed_potentials_variances variances of the body-fixed potentials (m^4/s^4), one per facet
+  @param[out] inertial_acc_magnitudes_variances variances of the inertial acceleration magnitudes (m^2/s^4), one per facet
+  @param[out] body_fixed_acc_magnitudes_variances variances of the body-fixed acceleration magnitudes (m^2/s^4), one per facet
+  @param[in] cutoff distance beyond which vertices are uncorrelated, in the shape's unit. If 0, 3 * l is used (see SetCovarianceKernel)
+  @param[in] compact_support if true, the kernel is tapered by a Wendland function of radius cutoff (see SetCovarianceKernel)
+  @param[in] isotropic if true, vertices deviate isotropically. Otherwise, they deviate along their normal (see SetCovarianceKernel)
+  */
+  static void ComputeSurfacePGMUQ(vtkSmartPointer<vtkPolyData> selected_shape,
+    const std::vector<unsigned int> & queried_elements,
+    bool is_in_meters,
+    double density,
+    const arma::vec::fixed<3> & omega,
+    double sigma,
+    double l,
+    std::vector<double> & slopes_variances,
+    std::vector<double> & inertial_potentials_variances,
+    std::vector<double> & body_fixed_potentials_variances,
+    std::vector<double> & inertial_acc_magnitudes_variances,
+    std::vector<double> & body_fixed_acc_magnitudes_variances,
+    double cutoff = 0,
+    bool compact_support = true,
+    bool isotropic = false);
+
+  /**
+  Saves the provided surface Polyhedron Gravity Model variances to a file.
+  In JSON format, the fields are the same as in SBGATPolyhedronGravityModel::SaveSurfacePGM, with the
+  additional `sigma` and `correlation_length` fields and with the values replaced by their variances
+  (`slopes_variances`, `inertial_potentials_variances`, `body_fixed_potentials_variances`,
+  `inertial_acc_magnitudes_variances`, `body_fixed_acc_magnitudes_variances`).
+  In binary format, an armadillo binary matrix is saved with one row per queried element and
+  the columns {index, slope variance, inertial potential variance, body-fixed potential variance,
+  inertial acceleration magnitude variance, body-fixed acceleration magnitude variance}
+  @param[in] selected_shape shape for which the surface polyhedron gravity model variances were computed
+  @param[in] queried_elements shape indices of elements where the variances were evaluated
+  @param[in] is_in_meters true if the shape coordinates were expressed in meters, false if they were expressed in kilometers
+  @param[in] mass mass of shape model (kg)
+  @param[in] omega fixed angular velocity of shape (rad/s)
+  @param[in] sigma standard deviation of the vertex deviations, in the shape's unit
+  @param[in] l correlation distance, in the shape's unit
+  @param[in] slopes_variances variances of the gravitational slopes (deg^2), one per facet
+  @param[in] inertial_potentials_variances variances of the inertial potentials (m^4/s^4), one per facet
+  @param[in] body_fixed_potentials_variances variances of the body-fixed potentials (m^4/s^4), one per facet
+  @param[in] inertial_acc_magnitudes_variances variances of the inertial acceleration magnitudes (m^2/s^4), one per facet
+  @param[in] body_fixed_acc_magnitudes_variances variances of the body-fixed acceleration magnitudes (m^2/s^4), one per facet
+  @param[in] path save path (ex: "pgm_surface_uq.json")
+  @param[in] binary if true, saves in armadillo binary format instead of JSON
+  */
+  static void SaveSurfacePGMUQ(vtkSmartPointer<vtkPolyData> selected_shape,
+    const std::vector<unsigned int> & queried_elements,
+    bool is_in_meters,
+    const double & mass,
+    const arma::vec::fixed<3> & omega,
+    double sigma,
+    double l,
+    const std::vector<double> & slopes_variances,
+    const std::vector<double> & inertial_potentials_variances,
+    const std::vector<double> & body_fixed_potentials_variances,
+    const std::vector<double> & inertial_acc_magnitudes_variances,
+    const std::vector<double> & body_fixed_acc_magnitudes_variances,
+    std::string path,
+    bool binary = false);
+
 protected:
 
   arma::vec GetBe() const;
@@ -455,10 +674,53 @@ protected:
 
 
 
+  /**
+  Updates the facet normals, facet dyads and edge dyads of the facets/edges flagged as affected
+  from the prescribed vertex coordinates. All containers are flat, row-major arrays
+  @param vertices vertex coordinates (3 * N_C)
+  @param facets vertex indices of each facet (3 * N_f)
+  @param edges vertex indices of each edge (2 * N_e)
+  @param edge_facets indices of the two facets adjacent to each edge (2 * N_e)
+  @param nominal_normals facet normals of the nominal shape, used to enforce the orientation (3 * N_f)
+  @param affected_facets indices of the facets to update
+  @param affected_edges indices of the edges to update
+  @param[out] facet_normals facet normals (3 * N_f)
+  @param[out] facet_dyads facet dyads (9 * N_f)
+  @param[out] edge_dyads edge dyads (9 * N_e)
+  */
+  static void UpdateDyads(const std::vector<double> & vertices,
+    const std::vector<int> & facets,
+    const std::vector<int> & edges,
+    const std::vector<int> & edge_facets,
+    const std::vector<double> & nominal_normals,
+    const std::vector<int> & affected_facets,
+    const std::vector<int> & affected_edges,
+    std::vector<double> & facet_normals,
+    std::vector<double> & facet_dyads,
+    std::vector<double> & edge_dyads);
+
+  /**
+  Computes a sparse square root S of the sparse covariance such that P_CC_sparse = S * S^T.
+  S is the lower cholesky factor of the covariance symmetrically permuted by a nested dissection 
+  ordering of the vertices (recursive bisection of the vertices along the longest side of their bounding box,
+  the vertices of one half adjacent to the other half being ordered last), which limits the fill-in of the factor. 
+  Columns whose pivot falls below the numerical rank tolerance are zeroed, so that semi-definite covariances 
+  (e.g. vertices deviating along their normal only) are supported. Throws an std::runtime_error if a pivot is negative 
+  beyond roundoff (relative to the largest variance), which reveals an indefinite covariance
+  @return sparse square root (3 * N_C x 3 * N_C), expressed in the unit of P_CC_sparse
+  */
+  arma::sp_mat ComputeSparseCholesky() const;
+
   vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_model;
 
   arma::mat P_CC;
   arma::sp_mat P_CC_sparse;
+  bool sparseCovariance = false;
+
+  arma::mat C_CC;
+  arma::sp_mat C_CC_sparse;
+  bool sparseSquareRoot = false;
+  bool covarianceSquareRootSet = false;
 
 
 
@@ -54,18 +54,43 @@ public:
    */
   static SBGATSphericalHarmo *New();
 
+  /**
+  Scratch space used by the const evaluators (EvaluateAcceleration, EvaluateGravityGradientMatrix, EvaluateBatch). 
+  The normalized exterior harmonics of a tile of points are stored with one column per (n,m) pair (see BnmIndex) 
+  and one row per point, so that the recursion runs over contiguous point arrays. 
+  A workspace only reallocates when used with a different degree or tile size and must not be shared between threads
+  */
+  struct EvaluationWorkspace{
+    arma::mat b_bar_real;
+    arma::mat b_bar_imag;
+    arma::mat geometry;
+    arma::mat sums;
+  };
+
+  /**
+  Number of points evaluated together by EvaluateBatch
+  */
+  static const int tileSize = 32;
+
+  /**
+  Highest degree for which single-point evaluations use a kernel specialized at compile time
+  */
+  static const unsigned int maxFixedDegree = 8;
+
   vtkTypeMacro(SBGATSphericalHarmo,vtkPolyDataAlgorithm);
   void PrintSelf(std::ostream& os, vtkIndent indent) override;
   void PrintHeader(std::ostream& os, vtkIndent indent) override;
   void PrintTrailer(std::ostream& os, vtkIndent indent) override;
 
   /**
-  Sets degree of spherical harmonics expansion
+  Sets degree of spherical harmonics expansion. If the coefficients were loaded from a file,
+  the expansion can be truncated to a lower degree but evaluating it above the loaded degree throws
   @param deg degree of spherical harmonics expansion
   */
   void SetDegree(const unsigned int deg){
     this -> degree = deg;
     this -> degreeSet = true;
+    this -> ComputeEvaluationTables();
   }
 
   /**
@@ -172,6 +197,114 @@ public:
   arma::vec::fixed<3> GetAcceleration(const arma::vec::fixed<3> & pos);
 
 
+  /**
+  Returns the gravity potential at the specified point
+  @param pos position at which the potential must be evaluated (meters)
+  @return potential (m ^ 2 / s ^ 2)
+  */
+  double GetPotential(const arma::vec::fixed<3> & pos);
+
+  /**
+  Returns the gravity potential at the specified point. Like EvaluateAcceleration, 
+  this method does not update the pipeline and can be called concurrently from several threads
+  @param pos position at which the potential must be evaluated (meters)
+  @return potential (m ^ 2 / s ^ 2)
+  */
+  double EvaluatePotential(const arma::vec::fixed<3> & pos) const;
+
+  /**
+  Returns the gravity potential at the specified point, using a caller-supplied workspace
+  @param pos position at which the potential must be evaluated (meters)
+  @param workspace scratch space, owned by the calling thread
+  @return potential (m ^ 2 / s ^ 2)
+  */
+  double EvaluatePotential(const arma::vec::fixed<3> & pos,
+    EvaluationWorkspace & workspace) const;
+
+  /**
+  Evaluates the potential, acceleration and gravity gradient matrix at the specified point
+  from a single evaluation of the harmonics
+  @param[in] pos position at which the field must be evaluated (meters)
+  @param[out] potential potential (m ^ 2 / s ^ 2)
+  @param[out] acc acceleration (m / s ^ 2)
+  @param[out] dAccdPos gravity gradient matrix (1 / s ^ 2)
+  */
+  void GetPotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+    double & potential,
+    arma::vec::fixed<3> & acc,
+    arma::mat::fixed<3,3> & dAccdPos);
+
+  /**
+  Evaluates the potential, acceleration and gravity gradient matrix at the specified point
+  from a single evaluation of the harmonics. Like EvaluateAcceleration, this method does not update 
+  the pipeline and can be called concurrently from several threads
+  @param[in] pos position at which the field must be evaluated (meters)
+  @param[out] potential potential (m ^ 2 / s ^ 2)
+  @param[out] acc acceleration (m / s ^ 2)
+  @param[out] dAccdPos gravity gradient matrix (1 / s ^ 2)
+  */
+  void EvaluatePotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+    double & potential,
+    arma::vec::fixed<3> & acc,
+    arma::mat::fixed<3,3> & dAccdPos) const;
+
+  /**
+  Evaluates the potential, acceleration and gravity gradient matrix at the specified point
+  from a single evaluation of the harmonics, using a caller-supplied workspace
+  @param[in] pos position at which the field must be evaluated (meters)
+  @param[out] potential potential (m ^ 2 / s ^ 2)
+  @param[out] acc acceleration (m / s ^ 2)
+  @param[out] dAccdPos gravity gradient matrix (1 / s ^ 2)
+  @param[in] workspace scratch space, owned by the calling thread
+  */
+  void EvaluatePotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+    double & potential,
+    arma::vec::fixed<3> & acc,
+    arma::mat::fixed<3,3> & dAccdPos,
+    EvaluationWorkspace & workspace) const;
+
+  /**
+  Returns the acceleration due to gravity at the specified point. Unlike GetAcceleration, 
+  this method does not update the pipeline (Update() or LoadFromJson() must have been called beforehand) and 
+  does not modify the object, so it can be called concurrently from several threads. 
+  The harmonics are evaluated in a thread-local workspace
+  @param pos position at which the acceleration must be evaluated (meters)
+  @return acceleration (m / s ^ 2)
+  */
+  arma::vec::fixed<3> EvaluateAcceleration(const arma::vec::fixed<3> & pos) const;
+
+  /**
+  Returns the acceleration due to gravity at the specified point, using a caller-supplied workspace.
+  See EvaluateAcceleration(const arma::vec::fixed<3> & pos) for details
+  @param pos position at which the acceleration must be evaluated (meters)
+  @param workspace scratch space, owned by the calling thread
+  @return acceleration (m / s ^ 2)
+  */
+  arma::vec::fixed<3> EvaluateAcceleration(const arma::vec::fixed<3> & pos,
+    EvaluationWorkspace & workspace) const;
+
+  /**
+  Evaluates the potential, acceleration and gravity gradient matrix at an array of positions.
+  The positions are split in tiles of tileSize points whose harmonics are evaluated together, and the tiles are processed in parallel.
+  Update() or LoadFromJson() must have been called beforehand
+  @param[in] positions positions at which the field must be evaluated (3 x N) (meters)
+  @param[out] potentials potentials (N) (m^2 / s^2)
+  @param[out] accelerations accelerations (3 x N) (m / s^2)
+  @param[out] gravity_gradients gravity gradient matrices (3 x 3 x N) (1 / s^2)
+  */
+  void EvaluateBatch(const arma::mat & positions,
+    arma::vec & potentials,
+    arma::mat & accelerations,
+    arma::cube & gravity_gradients) const;
+
+  /**
+  Evaluates the acceleration at an array of positions. See EvaluateBatch for details
+  @param[in] positions positions at which the acceleration must be evaluated (3 x N) (meters)
+  @param[out] accelerations accelerations (3 x N) (m / s^2)
+  */
+  void EvaluateAccelerationBatch(const arma::mat & positions,
+    arma::mat & accelerations) const;
+
   /** 
   Evaluates the gravity gradient matrix (the partial derivative of the spherical 
   harmonics acceleration with respect to the position vector) at the prescribed
@@ -183,6 +316,27 @@ public:
   void GetGravityGradientMatrix(const arma::vec::fixed<3> & pos,
     arma::mat::fixed<3,3> & dAccdPos);
 
+  /** 
+  Evaluates the gravity gradient matrix at the prescribed location. Unlike GetGravityGradientMatrix, 
+  this method does not update the pipeline and can be called concurrently from several threads.
+  The harmonics are evaluated in a thread-local workspace
+  @param[in] pos position at which the gravity gradient matrix must be evaluated (meters)
+  @param[out] dAccdPos container holding the gravity gradient matrix (1 / s ^ 2)
+  */
+  void EvaluateGravityGradientMatrix(const arma::vec::fixed<3> & pos,
+    arma::mat::fixed<3,3> & dAccdPos) const;
+
+  /** 
+  Evaluates the gravity gradient matrix at the prescribed location, using a caller-supplied workspace.
+  See EvaluateGravityGradientMatrix(const arma::vec::fixed<3> & pos,arma::mat::fixed<3,3> & dAccdPos) for details
+  @param[in] pos position at which the gravity gradient matrix must be evaluated (meters)
+  @param[out] dAccdPos container holding the gravity gradient matrix (1 / s ^ 2)
+  @param[in] workspace scratch space, owned by the calling thread
+  */
+  void EvaluateGravityGradientMatrix(const arma::vec::fixed<3> & pos,
+    arma::mat::fixed<3,3> & dAccdPos,
+    EvaluationWorkspace & workspace) const;
+
 
   /** 
   Evaluates the partial derivative of the spherical harmonics acceleration
@@ -222,6 +376,23 @@ public:
   void GetPartialHarmonics(const arma::vec::fixed<3> & pos,
     arma::mat & partial_C, 
     arma::mat & partial_S);
+
+  /**
+  Evaluates the partial derivatives of the acceleration with respect to the spherical harmonics coefficients 
+  at an array of positions (e.g measurement epochs) and writes them in a preallocated, row-major design matrix block.
+  The acceleration components at the k-th position occupy rows 3k, 3k + 1 and 3k + 2 of the block. Each row holds the partials 
+  with respect to the Cnm coefficients followed by those with respect to the Snm coefficients, ordered as in GetPartialHarmonics,
+  so that the partial of the i-th acceleration component at the k-th position with respect to the j-th coefficient is
+  design_matrix[(3 * k + i) * row_stride + j]. Entries of a row past the last partial are not modified.
+  The positions are processed by tiles in parallel. Update() or LoadFromJson() must have been called beforehand
+  @param[in] positions positions at which the partials must be evaluated (3 x N) (meters)
+  @param[out] design_matrix pointer to the first element of the block, which must hold at least 3 N rows
+  @param[in] row_stride distance between two consecutive rows of the block, in number of elements. Must be at least 
+  (n + 1)^2, the number of partials per row, where n is the degree of the expansion
+  */
+  void EvaluatePartialHarmonicsBatch(const arma::mat & positions,
+    double * design_matrix,
+    const size_t row_stride) const;
   /**
   Sets the scale factor to 1, indicative that the polydata has its coordinates expressed in meters
   */
@@ -268,6 +439,34 @@ public:
   */
   void LoadFromJson(std::string path);
 
+  /**
+  Exports the computed spherical harmonics expansion to a binary file, faster to load than JSON 
+  for high-degree expansions. The file is made of a 64-byte header
+  - magic == "SBGATSH" (8 bytes, null-terminated)
+  - version == 1 (uint32)
+  - normalized == 1 if the coefficients are normalized (uint32)
+  - degree == degree of the spherical expansion (uint64)
+  - facets == number of facets (uint64)
+  - vertices == number of vertices (uint64)
+  - referenceRadius (m) (double)
+  - totalMass (kg) (double)
+  - density (kg/m^3) (double)
+  followed by the Cnm and Snm coefficients, each stored as a contiguous (degree + 1) x (degree + 1) column-major array of doubles.
+  The file is written in the native byte order of the machine
+  @param path binary file where the spherical harmonics model will be saved
+  */
+  void SaveToBinary(std::string path) const;
+
+  /**
+  Loads a spherical harmonics expansion saved with SaveToBinary. When memory mapped, the coefficients 
+  are not copied but read directly from the file's pages, which are shared by all the processes 
+  loading the same file. The mapping is private: modifying the coefficients does not modify the file
+  @param path binary file storing the spherical harmonics model
+  @param memory_map if true, the file is memory mapped. Otherwise, or on systems other than Unix and macOS, 
+  the coefficients are read into memory
+  */
+  void LoadFromBinary(std::string path,bool memory_map = true);
+
   /**
   Sets the Cnm coefficients. There is normally no need to use this method outside of Sbgat's tests
   @param[in] Cnm coefficients
@@ -280,6 +479,64 @@ public:
   */
   void SetSnm(arma::mat Snm){this ->Snm =Snm;}
 
+  /**
+  Raises the degree of the expansion, keeping the current coefficients and only computing
+  the rows of degree greater than the current degree. The existing coefficients, including ones loaded with LoadFromJson 
+  or LoadFromBinary, are not modified. For spherical harmonics loaded from a file, the shape they were computed from must first be 
+  connected with SetInputData or SetInputConnection and its unit set with SetScaleMeters or SetScaleKiloMeters
+  @param new_degree new degree of the expansion (must be greater than the current degree)
+  */
+  void ExtendDegree(const unsigned int new_degree);
+
+  /**
+  Sets the covariance of the shape vertices and turns on the uncertainty mode. In this mode, 
+  the next update also propagates the vertex covariance to the covariance of the spherical harmonics coefficients.
+  The covariance is indexed on the vertices of the cleaned input shape (which are the vertices of the input 
+  if it is already clean) and expressed in the same squared unit as the input coordinates
+  @param[in] P_CC vertex covariance (3 N_vertices x 3 N_vertices)
+  */
+  void SetVertexCovariance(const arma::sp_mat & P_CC){
+    this -> P_CC = P_CC;
+    this -> vertexCovarianceSet = true;
+    this -> Modified();
+  }
+
+  /**
+  Sets the covariance of the shape vertices and turns on the uncertainty mode. 
+  See SetVertexCovariance(const arma::sp_mat & P_CC) for details
+  @param[in] P_CC vertex covariance (3 N_vertices x 3 N_vertices)
+  */
+  void SetVertexCovariance(const arma::mat & P_CC){
+    this -> SetVertexCovariance(arma::sp_mat(P_CC));
+  }
+
+  /**
+  Turns off the uncertainty mode
+  */
+  void ClearVertexCovariance(){
+    this -> P_CC.reset();
+    this -> coefficientsCovariance.reset();
+    this -> partialCoefficientsPartialC.reset();
+    this -> vertexCovarianceSet = false;
+    this -> Modified();
+  }
+
+  /**
+  Returns the covariance of the spherical harmonics coefficients arising from the 
+  vertex covariance (see SetVertexCovariance). The coefficients are stacked as
+  [C_00,C_10,C_11,C_20,C_21,C_22,...,S_11,S_21,S_22,S_31,...], that is 
+  (n+1) * (n+2)/2 Cnm coefficients followed by n * (n+1)/2 Snm coefficients for a degree n expansion
+  @return coefficients covariance
+  */
+  arma::mat GetCoefficientsCovariance() {this -> Update(); return this -> coefficientsCovariance;}
+
+  /**
+  Returns the partial derivatives of the spherical harmonics coefficients (stacked as in GetCoefficientsCovariance())
+  with respect to the coordinates of the shape vertices, expressed in meters. Only available in uncertainty mode
+  @return partial derivatives of the coefficients with respect to the vertices coordinates (1/m)
+  */
+  arma::mat GetPartialCoefficientsPartialC() {this -> Update(); return this -> partialCoefficientsPartialC;}
+
 
 
 protected:
@@ -290,9 +547,215 @@ protected:
     vtkInformationVector** inputVector,
     vtkInformationVector* outputVector) override;
 
+  /**
+  Computes the partials of the coefficients with respect to the vertices coordinates
+  and propagates the vertex covariance to the coefficients covariance.
+  SHARMLib does not provide the partials of ComputePolyhedralCS, so the partials of each facet
+  contribution are computed by fourth-order central differences while the partials of 
+  the volume are exact. Facets are processed in parallel
+  @param input cleaned shape
+  @param volume shape volume (m^3)
+  */
+  void ComputeCoefficientsCovariance(vtkPolyData * input,double volume);
+
+  /**
+  Sums the contributions of all the facets of the shape to the unnormalized spherical harmonics coefficients.
+  The facets are split in a fixed number of chunks accumulated in parallel and reduced in a fixed order, so that the 
+  result does not depend on the number of threads
+  @param[in] input cleaned shape
+  @param[in] degree degree of the expansion
+  @param[out] C sum of the facets' Cnm contributions
+  @param[out] S sum of the facets' Snm contributions
+  */
+  void AccumulateFacetsCoefficients(vtkPolyData * input,
+    const unsigned int degree,
+    arma::mat & C,
+    arma::mat & S) const;
+
+  /**
+  Sums the contributions of all the facets of the shape to the rows min_degree to max_degree of the unnormalized 
+  spherical harmonics coefficients, the other rows being set to zero. The interior solid harmonics of degree n are homogeneous polynomials 
+  of degree n, so their integral over the tetrahedron formed by the origin and a facet reduces to an integral over the facet,
+  evaluated exactly with a collapsed Gauss-Legendre rule. The lower degrees only enter the recursion of the harmonics at the quadrature points. 
+  The facets are accumulated and reduced as in AccumulateFacetsCoefficients
+  @param[in] input cleaned shape
+  @param[in] min_degree lowest degree of the computed rows
+  @param[in] max_degree highest degree of the computed rows
+  @param[out] C sum of the facets' Cnm contributions (max_degree + 1 x max_degree + 1)
+  @param[out] S sum of the facets' Snm contributions (max_degree + 1 x max_degree + 1)
+  */
+  void AccumulateFacetsCoefficientsRows(vtkPolyData * input,
+    const unsigned int min_degree,
+    const unsigned int max_degree,
+    arma::mat & C,
+    arma::mat & S) const;
+
+  /**
+  Gathers the coordinates of the vertices of the triangular facets of the shape, 
+  scaled to meters. Facets that are not triangles are skipped
+  @param[in] input cleaned shape
+  @param[out] facets_coords coordinates of the three vertices of each facet (9 N_facets)
+  */
+  void GatherFacetsCoordinates(vtkPolyData * input,std::vector<double> & facets_coords) const;
+
+  /**
+  Precomputes the recursion factors of the normalized exterior harmonics and the normalization
+  factors of the acceleration and gravity gradient expressions for the current degree
+  */
+  void ComputeEvaluationTables();
+
+  /**
+  Writes the partials of the acceleration at one point of the workspace with respect to the Cnm and Snm coefficients.
+  The partial of the i-th acceleration component with respect to the k-th coefficient is stored at 
+  partial_C[i * component_stride + k * coef_stride] (and likewise for partial_S)
+  @param[in] workspace workspace holding the harmonics computed by ComputeBnm
+  @param[in] point index of the point in the workspace
+  @param[out] partial_C partials with respect to the Cnm coefficients
+  @param[out] partial_S partials with respect to the Snm coefficients
+  @param[in] component_stride distance between the partials of two consecutive acceleration components
+  @param[in] coef_stride distance between the partials with respect to two consecutive coefficients
+  */
+  void FillPartialHarmonics(const EvaluationWorkspace & workspace,
+    const int point,
+    double * partial_C,
+    double * partial_S,
+    const size_t component_stride,
+    const size_t coef_stride) const;
+
+  /**
+  Unmaps the file mapped by LoadFromBinary, if any. The coefficients are emptied beforehand
+  since they may point to the mapped pages
+  */
+  void ReleaseCoefficientsMapping();
+
+  /**
+  Returns the column of the (n,m) harmonic in the workspace arrays
+  @param n degree
+  @param m order (m <= n)
+  @return column index
+  */
+  static constexpr int BnmIndex(const int n,const int m){return n * (n + 1) / 2 + m;}
+
+  /**
+  Evaluates the normalized exterior harmonics up to degree + 2 at a tile of points
+  @param[in] positions pointer to the coordinates of the points (3 x n_points, column-major) (meters)
+  @param[in] n_points number of points
+  @param[out] workspace container holding the real and imaginary parts of the harmonics
+  */
+  void ComputeBnm(const double * positions,const int n_points,EvaluationWorkspace & workspace) const;
+
+  /**
+  Evaluates the potential, acceleration and/or gravity gradient matrix at a tile of points.
+  Outputs set to nullptr are not computed
+  @param[in] positions pointer to the coordinates of the points (3 x n_points, column-major) (meters)
+  @param[in] n_points number of points
+  @param[out] potentials potentials (n_points) (m^2 / s^2)
+  @param[out] accelerations accelerations (3 x n_points, column-major) (m / s^2)
+  @param[out] gravity_gradients gravity gradient matrices (3 x 3 x n_points, column-major) (1 / s^2)
+  @param[in] workspace scratch space, owned by the calling thread
+  */
+  void EvaluateTile(const double * positions,
+    const int n_points,
+    double * potentials,
+    double * accelerations,
+    double * gravity_gradients,
+    EvaluationWorkspace & workspace) const;
+
+  /**
+  Evaluates the normalized exterior harmonics at a group of points into caller-provided arrays.
+  The degree D and number of points P are compile-time constants when non-negative, in which case the 
+  recursion has constant trip counts and can be fully unrolled by the compiler. D = P = -1 uses the runtime values
+  @param[in] positions pointer to the coordinates of the points (3 x n_points, column-major) (meters)
+  @param[in] n_points number of points (ignored if P > 0)
+  @param[out] b_real real part of the harmonics (n_points x BnmIndex(degree + 3,0), column-major)
+  @param[out] b_imag imaginary part of the harmonics (n_points x BnmIndex(degree + 3,0), column-major)
+  @param[out] geometry scratch array (n_points x 4)
+  */
+  template <int D,int P>
+  void ComputeBnmKernel(const double * positions,
+    const int n_points,
+    double * b_real,
+    double * b_imag,
+    double * geometry) const;
+
+  /**
+  Evaluates the potential, acceleration and/or gravity gradient matrix at a group of points into caller-provided arrays.
+  See ComputeBnmKernel for the meaning of D and P. Outputs set to nullptr are not computed
+  @param[in] positions pointer to the coordinates of the points (3 x n_points, column-major) (meters)
+  @param[in] n_points number of points (ignored if P > 0)
+  @param[out] potentials potentials (n_points) (m^2 / s^2)
+  @param[out] accelerations accelerations (3 x n_points, column-major) (m / s^2)
+  @param[out] gravity_gradients gravity gradient matrices (3 x 3 x n_points, column-major) (1 / s^2)
+  @param b_real scratch array (n_points x BnmIndex(degree + 3,0))
+  @param b_imag scratch array (n_points x BnmIndex(degree + 3,0))
+  @param geometry scratch array (n_points x 4)
+  @param sums scratch array (n_points x 10)
+  */
+  template <int D,int P>
+  void EvaluateKernel(const double * positions,
+    const int n_points,
+    double * potentials,
+    double * accelerations,
+    double * gravity_gradients,
+    double * b_real,
+    double * b_imag,
+    double * geometry,
+    double * sums) const;
+
+  /**
+  Evaluates the field at a single point with the kernel specialized for degree D, 
+  using stack storage only
+  @param[in] pos coordinates of the point (meters)
+  @param[out] potential potential (m^2 / s^2), or nullptr
+  @param[out] acceleration acceleration (3) (m / s^2), or nullptr
+  @param[out] gravity_gradient gravity gradient matrix (3 x 3, column-major) (1 / s^2), or nullptr
+  */
+  template <int D>
+  void EvaluatePointDegree(const double * pos,
+    double * potential,
+    double * acceleration,
+    double * gravity_gradient) const;
+
+  /**
+  Evaluates the field at a single point with the specialized kernel matching the current degree,
+  if the degree does not exceed maxFixedDegree
+  @param[in] pos coordinates of the point (meters)
+  @param[out] potential potential (m^2 / s^2), or nullptr
+  @param[out] acceleration acceleration (3) (m / s^2), or nullptr
+  @param[out] gravity_gradient gravity gradient matrix (3 x 3, column-major) (1 / s^2), or nullptr
+  @return true if a specialized kernel was used, false if the generic path must be used instead
+  */
+  bool EvaluatePointFixedDegree(const double * pos,
+    double * potential,
+    double * acceleration,
+    double * gravity_gradient) const;
+
+  /**
+  Evaluates the potential, acceleration and/or gravity gradient matrix at an array of positions, in parallel over tiles.
+  Outputs set to nullptr are not computed
+  @param[in] positions positions at which the field must be evaluated (3 x N) (meters)
+  @param[out] potentials potentials (N) (m^2 / s^2)
+  @param[out] accelerations accelerations (3 x N, column-major) (m / s^2)
+  @param[out] gravity_gradients gravity gradient matrices (3 x 3 x N, column-major) (1 / s^2)
+  */
+  void EvaluateBatch(const arma::mat & positions,
+    double * potentials,
+    double * accelerations,
+    double * gravity_gradients) const;
+
   arma::mat Cnm;
   arma::mat Snm;
 
+  arma::sp_mat P_CC;
+  arma::mat coefficientsCovariance;
+  arma::mat partialCoefficientsPartialC;
+
+  arma::vec bnmDiagonalFactors;
+  arma::mat bnmFactorsA;
+  arma::mat bnmFactorsB;
+  arma::cube accelerationFactors;
+  arma::cube gravityGradientFactors;
+
   double referenceRadius;
   double density;
   double totalMass;
@@ -309,6 +772,10 @@ protected:
   bool referenceRadiusSet;
   bool scaleFactorSet;
   bool setFromJSON;
+  bool vertexCovarianceSet = false;
+
+  void * coefficientsMapping = nullptr;
+  size_t coefficientsMappingSize = 0;
 
 private:
   SBGATSphericalHarmo(const SBGATSphericalHarmo&) = delete;
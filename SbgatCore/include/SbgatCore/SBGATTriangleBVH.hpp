@@ -0,0 +1,150 @@
+/**
+@file SBGATTriangleBVH.hpp
+@class  SBGATTriangleBVH
+@author Benjamin Bercovici
+@author Jay McMahon
+@date October 2018
+
+@brief  Defines the SBGATTriangleBVH class
+@details Defines the SBGATTriangleBVH class, a bounding volume hierarchy over the triangles of a shape model
+dedicated to shadow-ray (any-hit) queries. Triangles are stored by blocks of SBGATTriangleBVH::LeafWidth in
+structure-of-arrays layout so that a leaf is tested against a ray in a single vectorized loop. Coherent rays
+(e.g all pointing toward the sun or the observer) can be traced together as a packet sharing a single traversal of the tree.
+Queries do not allocate memory and can be called concurrently once the hierarchy is built.
+@copyright MIT License, Benjamin Bercovici and Jay McMahon
+*/
+
+#ifndef HEADER_SBGATTRIANGLEBVH
+#define HEADER_SBGATTRIANGLEBVH
+
+#include <vtkPolyData.h>
+#include <vector>
+
+
+class SBGATTriangleBVH {
+
+public:
+
+	/**
+	Number of triangles tested at once in a leaf
+	*/
+	static const int LeafWidth = 4;
+
+	/**
+	Maximum number of rays traced together by AnyHitPacket
+	*/
+	static const int PacketSize = 8;
+
+	/**
+	Constructor. The hierarchy is empty until Build is called
+	*/
+	SBGATTriangleBVH();
+
+	/**
+	Builds the hierarchy over the triangles of the provided shape. Throws if
+	the shape has non-triangular cells
+	@param polydata shape model, whose coordinates are used as is
+	*/
+	void Build(vtkPolyData * polydata);
+
+	/**
+	Checks if the segment spanned between the provided points intersects any triangle. The
+	search stops at the first intersect found
+	@param start start of the segment
+	@param end end of the segment
+	@param tol intersects closer than tol to start are ignored
+	@return true if the segment intersects the shape, false otherwise
+	*/
+	bool AnyHit(const double * start, const double * end, const double tol) const;
+
+	/**
+	Checks if the segments spanned between the provided points intersect any triangle, traversing the hierarchy
+	once for the whole packet. Best suited to coherent segments, e.g sharing the same end point
+	@param starts start of the segments, stored contiguously (3 x n_rays)
+	@param ends end of the segments, stored contiguously (3 x n_rays)
+	@param n_rays number of segments, in [0,PacketSize]
+	@param tol intersects closer than tol to the start of a segment are ignored
+	@param hits on input, segments flagged as true are skipped. On output, true for the segments intersecting the shape
+	*/
+	void AnyHitPacket(const double * starts, const double * ends, const int n_rays, const double tol, bool * hits) const;
+
+	/**
+	Returns the number of triangles in the hierarchy
+	@return number of triangles
+	*/
+	int GetNumberOfTriangles() const { return this -> number_of_triangles; }
+
+	/**
+	Returns the number of nodes in the hierarchy
+	@return number of nodes
+	*/
+	int GetNumberOfNodes() const { return static_cast<int>(this -> nodes.size()); }
+
+protected:
+
+	/**
+	Node of the hierarchy. Inner nodes store their left child right after them
+	and the index of their right child in offset. Leaves store the index of their triangle block in offset
+	*/
+	struct Node {
+		double lower[3];
+		double upper[3];
+		int offset;
+		int is_leaf;
+	};
+
+	/**
+	Block of LeafWidth triangles in structure-of-arrays layout, as a vertex and two edges.
+	Unused lanes hold degenerate triangles that cannot be hit
+	*/
+	struct TriangleBlock {
+		double v0[3][LeafWidth];
+		double e1[3][LeafWidth];
+		double e2[3][LeafWidth];
+	};
+
+	/**
+	Recursively builds the node spanning the triangles indexed by indices[begin:end]
+	@param indices triangle indices, reordered in place
+	@param begin first triangle in the node
+	@param end one past the last triangle in the node
+	@param vertices vertex coordinates of all triangles (9 per triangle)
+	@param centroids centroid coordinates of all triangles (3 per triangle)
+	@param depth depth of the node
+	*/
+	void build_node(std::vector<int> & indices,
+		int begin,
+		int end,
+		const std::vector<double> & vertices,
+		const std::vector<double> & centroids,
+		int depth);
+
+	/**
+	Tests a ray against a triangle block
+	@param origin ray origin
+	@param dir ray direction, spanning the whole segment
+	@param t_min smallest accepted intersect parameter
+	@param block triangle block
+	@return true if any triangle of the block is hit for a parameter in [t_min,1]
+	*/
+	static bool intersect_block(const double * origin, const double * dir, const double t_min, const TriangleBlock & block);
+
+	/**
+	Tests a segment against a node's box
+	@param origin ray origin
+	@param inv_dir componentwise inverse of the ray direction
+	@param node node
+	@return true if the segment crosses the box
+	*/
+	static bool intersect_box(const double * origin, const double * inv_dir, const Node & node);
+
+	static const int MaxDepth = 64;
+
+	std::vector<Node> nodes;
+	std::vector<TriangleBlock> blocks;
+	int number_of_triangles = 0;
+	double padding = 0;
+
+};
+
+#endif
@@ -45,10 +45,242 @@ SOFTWARE.
 #include <vtkCleanPolyData.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkFloatArray.h>
+#include <vtkCellData.h>
+#include <vtkExtractEdges.h>
+#include <vtkLine.h>
+#include <vtkWeakPointer.h>
 #include <RigidBodyKinematics.hpp>
 #include <json.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <future>
+#include <list>
+#include <mutex>
 vtkStandardNewMacro(SBGATMassProperties);
 
+// Neumaier's compensated sum. Keeps the facet sums accurate, and nearly 
+// independent of the order in which the facets are added
+struct CompensatedSum{
+
+  double sum = 0;
+  double compensation = 0;
+
+  void Add(const double value){
+    double t = this -> sum + value;
+    if (std::abs(this -> sum) >= std::abs(value)){
+      this -> compensation += (this -> sum - t) + value;
+    }
+    else{
+      this -> compensation += (value - t) + this -> sum;
+    }
+    this -> sum = t;
+  }
+
+  void Add(const CompensatedSum & other){
+    this -> Add(other.sum);
+    this -> Add(other.compensation);
+  }
+
+  double Value() const {return this -> sum + this -> compensation;}
+
+};
+
+// Sums over a set of facets
+struct MassPropertiesSums{
+
+  CompensatedSum area;
+  CompensatedSum oriented_surface[3];
+  CompensatedSum volume;
+  CompensatedSum c[3];
+
+  // P_xx, P_yy, P_zz, P_xy, P_xz, P_yz
+  CompensatedSum P[6];
+
+  // Projected-volume diagnostics
+  CompensatedSum vol[3];
+  CompensatedSum volume_projected;
+  long munc[3] = {0,0,0};
+  long wxyz = 0;
+  long wxy = 0;
+  long wxz = 0;
+  long wyz = 0;
+  long unpredicted = 0;
+
+  double min_area = VTK_DOUBLE_MAX;
+  double max_area = 0;
+
+  void Add(const MassPropertiesSums & other){
+
+    this -> area.Add(other.area);
+    this -> volume.Add(other.volume);
+    this -> volume_projected.Add(other.volume_projected);
+
+    for (int idx = 0; idx < 3; ++idx){
+      this -> oriented_surface[idx].Add(other.oriented_surface[idx]);
+      this -> c[idx].Add(other.c[idx]);
+      this -> vol[idx].Add(other.vol[idx]);
+      this -> munc[idx] += other.munc[idx];
+    }
+
+    for (int idx = 0; idx < 6; ++idx){
+      this -> P[idx].Add(other.P[idx]);
+    }
+
+    this -> wxyz += other.wxyz;
+    this -> wxy += other.wxy;
+    this -> wxz += other.wxz;
+    this -> wyz += other.wyz;
+    this -> unpredicted += other.unpredicted;
+
+    this -> min_area = std::min(this -> min_area,other.min_area);
+    this -> max_area = std::max(this -> max_area,other.max_area);
+
+  }
+
+};
+
+// Adds the contribution of one triangle to the sums
+static void AccumulateFacet(const double * coords,
+  const vtkIdType * facet,
+  const bool projected_volumes,
+  MassPropertiesSums & sums){
+
+  double x[3],y[3],z[3];
+  double i[3],j[3],k[3],u[3],absu[3],length;
+
+  for (int idx = 0; idx < 3; idx++){
+    x[idx] = coords[3 * facet[idx]];
+    y[idx] = coords[3 * facet[idx] + 1];
+    z[idx] = coords[3 * facet[idx] + 2];
+  }
+
+  // get i j k vectors ...
+  //
+  i[0] = ( x[1] - x[0]); j[0] = (y[1] - y[0]); k[0] = (z[1] - z[0]);
+  i[1] = ( x[2] - x[0]); j[1] = (y[2] - y[0]); k[1] = (z[2] - z[0]);
+
+  // cross product between two vectors, to determine normal vector
+  //
+  u[0] = ( j[0] * k[1] - k[0] * j[1]);
+  u[1] = ( k[0] * i[1] - i[0] * k[1]);
+  u[2] = ( i[0] * j[1] - j[0] * i[1]);
+
+  // area of a triangle, and oriented surface
+  //
+  length = sqrt( u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+  double area = 0.5 * length;
+
+  sums.area.Add(area);
+  sums.min_area = std::min(sums.min_area,area);
+  sums.max_area = std::max(sums.max_area,area);
+
+  sums.oriented_surface[0].Add(0.5 * u[0]);
+  sums.oriented_surface[1].Add(0.5 * u[1]);
+  sums.oriented_surface[2].Add(0.5 * u[2]);
+
+  double xavg = (x[0] + x[1] + x[2]) / 3.0;
+  double yavg = (y[0] + y[1] + y[2]) / 3.0;
+  double zavg = (z[0] + z[1] + z[2]) / 3.0;
+
+  if (projected_volumes){
+
+    // determine max unit normal component...
+    //
+    absu[0] = fabs(u[0]); absu[1] = fabs(u[1]); absu[2] = fabs(u[2]);
+
+    if (( absu[0] > absu[1]) && ( absu[0] > absu[2]) ){
+      sums.munc[0]++;
+    }
+    else if (( absu[1] > absu[0]) && ( absu[1] > absu[2]) ){
+      sums.munc[1]++;
+    }
+    else if (( absu[2] > absu[0]) && ( absu[2] > absu[1]) ){
+      sums.munc[2]++;
+    }
+    else if (( absu[0] == absu[1])&& ( absu[0] == absu[2])){
+      sums.wxyz++;
+    }
+    else if (( absu[0] == absu[1])&& ( absu[0] > absu[2]) ){
+      sums.wxy++;
+    }
+    else if (( absu[0] == absu[2])&& ( absu[0] > absu[1]) ){
+      sums.wxz++;
+    }
+    else if (( absu[1] == absu[2])&& ( absu[0] < absu[2]) ){
+      sums.wyz++;
+    }
+    else{
+      sums.unpredicted++;
+    }
+
+    // volume elements ...
+    //
+    sums.vol[2].Add(0.5 * u[2] * zavg);
+    sums.vol[1].Add(0.5 * u[1] * yavg);
+    sums.vol[0].Add(0.5 * u[0] * xavg);
+
+    // V  =  (z1+z2+z3)(x1y2-x2y1+x2y3-x3y2+x3y1-x1y3)/6
+    // Volume under triangle is projected area of the triangle times
+    // the average of the three z values
+    double xp[3];
+    vtkMath::Cross(x,y,xp);
+    sums.volume_projected.Add(zavg * (xp[0]+xp[1]+xp[2]) / 2);
+
+  }
+
+  // Center of mass
+  // See "Inertia of Any Polyhedron" by Anthony R. Dobrovolskis, Icarus 124, 698–704 (1996) Article No. 0243
+  double dv = 1. / 6. * (x[1] * ( (  y[1] - y[0] ) * (  z[2] - z[0]   ) - (  z[1] - z[0]   ) * (  y[2] - y[0])) + 
+    y[1] * ( (  z[1] - z[0] ) * (  x[2] - x[0]   ) -  (  x[1] - x[0]   ) * (  z[2] - z[0]   ) ) + 
+    z[1] * ( (  x[1] - x[0] ) * (  y[2] - y[0]   ) -  (  y[1] - y[0]   ) * (  x[2] - x[0]   )));
+
+  sums.volume.Add(dv);
+  sums.c[0].Add(dv * 0.75 * xavg);
+  sums.c[1].Add(dv * 0.75 * yavg);
+  sums.c[2].Add(dv * 0.75 * zavg);
+
+  // Inertia tensor
+  // See "Inertia of Any Polyhedron" by Anthony R. Dobrovolskis, Icarus 124, 698–704 (1996) Article No. 0243
+  sums.P[0].Add(dv / 20 * (2 * x[0] * x[0] + 2 * x[1] * x[1] + 2 * x[2] * x[2]
+    + 2 * x[0] * x[1] + 2 * x[0] * x[2] + 2 * x[1] * x[2]));
+
+  sums.P[1].Add(dv / 20 * (2 * y[0] * y[0] + 2 * y[1] * y[1] + 2 * y[2] * y[2]
+    + 2 * y[0] * y[1] + 2 * y[0] * y[2] + 2 * y[1] * y[2]));
+
+  sums.P[2].Add(dv / 20 * (2 * z[0] * z[0] + 2 * z[1] * z[1] + 2 * z[2] * z[2]
+    + 2 * z[0] * z[1] + 2 * z[0] * z[2] + 2 * z[1] * z[2]));
+
+  sums.P[3].Add(dv / 20 * (2 * x[0] * y[0] + 2 * x[1] * y[1] + 2 * x[2] * y[2]
+    + x[0] * y[1] + y[0] * x[1] + x[0] * y[2] + y[0] * x[2] + x[1] * y[2] + y[1] * x[2]));
+
+  sums.P[4].Add(dv / 20 * (2 * x[0] * z[0] + 2 * x[1] * z[1] + 2 * x[2] * z[2]
+    + x[0] * z[1] + z[0] * x[1] + x[0] * z[2] + z[0] * x[2] + x[1] * z[2] + z[1] * x[2]));
+
+  sums.P[5].Add(dv / 20 * (2 * y[0] * z[0] + 2 * y[1] * z[1] + 2 * y[2] * z[2]
+    + y[0] * z[1] + z[0] * y[1] + y[0] * z[2] + z[0] * y[2] + y[1] * z[2] + z[1] * y[2]));
+
+}
+
+// Entry of the shared mass properties cache. The mass properties are made available
+// through a future so that the entry can be inserted before they are computed
+struct SharedMassPropertiesEntry{
+  vtkWeakPointer<vtkPolyData> shape;
+  vtkMTimeType mtime;
+  bool is_in_meters;
+  bool compute_projected_volumes;
+  std::shared_future<vtkSmartPointer<SBGATMassProperties> > mass_properties;
+};
+
+// Only guards the cache itself: the mass properties are computed outside of it
+static std::mutex shared_mass_properties_mutex;
+
+// Most recently queried entries first
+static std::list<SharedMassPropertiesEntry> shared_mass_properties_cache;
+static const unsigned int shared_mass_properties_cache_size = 8;
+
 //----------------------------------------------------------------------------
 // Constructs with initial 0 values.
 SBGATMassProperties::SBGATMassProperties(){
@@ -95,12 +327,16 @@ int SBGATMassProperties::RequestData(
   cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
   cleaner -> Update();
 
-  vtkPolyData * input = cleaner -> GetOutput();
+  // The cleaned shape is detached from the cleaner so that it does not 
+  // keep the pipeline, and thus the input shape, alive
+  this -> cleanedShape = vtkSmartPointer<vtkPolyData>::New();
+  this -> cleanedShape -> ShallowCopy(cleaner -> GetOutput());
+  this -> cleanedShapeTopologySet = false;
+  vtkPolyData * input = this -> cleanedShape;
 
 
 
   vtkIdType cellId, numCells, numPts, numIds;
-  double p[3];
 
   numCells = input->GetNumberOfCells();
   numPts = input->GetNumberOfPoints();
@@ -110,62 +346,24 @@ int SBGATMassProperties::RequestData(
     return 1;
   }
 
-  vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
-  ptIds -> Allocate(VTK_CELL_SIZE);
-
-  // Traverse all cells, obtaining node coordinates.
-  //
-  double    vol[3],kxyz[3];
-  double    xp[3]; // to compute volumeproj
-  double    munc[3],wxyz,wxy,wxz,wyz;
-  double    area,surfacearea;
-  double sum_surface[3];
-  double    volumeproj;
-  double    mincellarea, maxcellarea;
-  double    a,b,c,s;
-  double    x[3],y[3],z[3];
-  double    i[3],j[3],k[3],u[3],absu[3],length;
-  double    ii[3],jj[3],kk[3];
-  double    xavg,yavg,zavg;
-  double cx,cy,cz;
-  double dv;
-  double P_xx;
-  double P_yy;
-  double P_zz;
-  double P_xy;
-  double P_xz;
-  double P_yz;
-  double average_surface;
-
-  vtkIdType idx;
-
-  // Initialize variables ...
-  //
-  surfacearea = 0.0;
-  volumeproj = 0.0;
-  mincellarea = VTK_DOUBLE_MAX; maxcellarea = 0.0;
-  wxyz = 0; wxy = 0.0; wxz = 0.0; wyz = 0.0;
-  cx = 0; cy = 0; cz = 0;
-  P_xx = 0;   P_yy = 0;   P_zz = 0;
-  P_xy = 0;   P_yz = 0;   P_xz = 0;
-
-  sum_surface[0] = 0;
-  sum_surface[1] = 0;
-  sum_surface[2] = 0;
-  average_surface = 0;
-
-
   input -> GetBounds(this -> bounds);
 
-  arma::vec::fixed<3> bbox_min = {this -> scaleFactor * this -> bounds[0],this -> scaleFactor * this -> bounds[2],this -> scaleFactor * this -> bounds[4]};
-  arma::vec::fixed<3> bbox_max = {this -> scaleFactor * this -> bounds[1],this -> scaleFactor * this -> bounds[3],this -> scaleFactor * this -> bounds[5]};
-
-  for ( idx = 0; idx < 3 ; idx++ ){
-    munc[idx] = 0.0;
-    vol[idx]  = 0.0;
-    kxyz[idx] = 0.0;
+  // The vertex coordinates (scaled to meters if need be!) and the facets' vertex indices 
+  // are gathered in contiguous arrays
+  std::vector<double> coords(3 * numPts);
+  for (vtkIdType ptId = 0; ptId < numPts; ++ptId){
+    input -> GetPoint(ptId,coords.data() + 3 * ptId);
+    coords[3 * ptId] *= this -> scaleFactor;
+    coords[3 * ptId + 1] *= this -> scaleFactor;
+    coords[3 * ptId + 2] *= this -> scaleFactor;
   }
 
+  vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+  ptIds -> Allocate(VTK_CELL_SIZE);
+
+  std::vector<vtkIdType> facets;
+  facets.reserve(3 * numCells);
+
   for (cellId=0; cellId < numCells; cellId++){
     if ( input->GetCellType(cellId) != VTK_TRIANGLE){
       vtkWarningMacro(<< "Input data type must be VTK_TRIANGLE not "<< input->GetCellType(cellId));
@@ -175,223 +373,84 @@ int SBGATMassProperties::RequestData(
     numIds = ptIds->GetNumberOfIds();
     assert(numIds == 3);
 
-    // store current vertex (x,y,z) coordinates ...
-    // Note that the coordinates are scaled to meters if need be!
-    for (idx=0; idx < numIds; idx++){
-      input->GetPoint(ptIds->GetId(idx), p);
-      x[idx] = this -> scaleFactor * p[0] ; y[idx] = this -> scaleFactor * p[1] ; z[idx] = this -> scaleFactor * p[2] ;
+    for (vtkIdType idx = 0; idx < numIds; idx++){
+      facets.push_back(ptIds -> GetId(idx));
     }
+  }
 
-    // get i j k vectors ...
-    //
-    i[0] = ( x[1] - x[0]); j[0] = (y[1] - y[0]); k[0] = (z[1] - z[0]);
-    i[1] = ( x[2] - x[0]); j[1] = (y[2] - y[0]); k[1] = (z[2] - z[0]);
-    i[2] = ( x[2] - x[1]); j[2] = (y[2] - y[1]); k[2] = (z[2] - z[1]);
+  // The facets are split in a fixed number of chunks, independent of the number of threads,
+  // whose sums are accumulated in parallel and reduced in a fixed order
+  int N_triangles = static_cast<int>(facets.size() / 3);
+  int N_chunks = std::min(N_triangles,64);
+  std::vector<MassPropertiesSums> chunk_sums(N_chunks);
 
-    // cross product between two vectors, to determine normal vector
-    //
-    u[0] = ( j[0] * k[1] - k[0] * j[1]);
-    u[1] = ( k[0] * i[1] - i[0] * k[1]);
-    u[2] = ( i[0] * j[1] - j[0] * i[1]);
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
 
-    // normalize normal vector to 1
-    //
-    length = sqrt( u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
-    if ( length != 0.0)
-    {
-      u[0] /= length;
-      u[1] /= length;
-      u[2] /= length;
-    }
-    else
-    {
-      u[0] = u[1] = u[2] = 0.0;
-    }
-
-    // determine max unit normal component...
-    //
-    absu[0] = fabs(u[0]); absu[1] = fabs(u[1]); absu[2] = fabs(u[2]);
+    int first = static_cast<int>(static_cast<long>(chunk) * N_triangles / N_chunks);
+    int last = static_cast<int>(static_cast<long>(chunk + 1) * N_triangles / N_chunks);
 
-    if (( absu[0] > absu[1]) && ( absu[0] > absu[2]) )
-    {
-      munc[0]++;
-    }
-    else if (( absu[1] > absu[0]) && ( absu[1] > absu[2]) )
-    {
-      munc[1]++;
-    }
-    else if (( absu[2] > absu[0]) && ( absu[2] > absu[1]) )
-    {
-      munc[2]++;
-    }
-    else if (( absu[0] == absu[1])&& ( absu[0] == absu[2]))
-    {
-      wxyz++;
-    }
-    else if (( absu[0] == absu[1])&& ( absu[0] > absu[2]) )
-    {
-      wxy++;
-    }
-    else if (( absu[0] == absu[2])&& ( absu[0] > absu[1]) )
-    {
-      wxz++;
-    }
-    else if (( absu[1] == absu[2])&& ( absu[0] < absu[2]) )
-    {
-      wyz++;
-    }
-    else
-    {
-      vtkErrorMacro( << "Unpredicted situation...!" );
-      return 1;
+    for (int f = first; f < last; ++f){
+      AccumulateFacet(coords.data(),facets.data() + 3 * f,this -> computeProjectedVolumes,chunk_sums[chunk]);
     }
 
-    // This is reduced to ...
-    //
-    ii[0] = i[0] * i[0]; ii[1] = i[1] * i[1]; ii[2] = i[2] * i[2];
-    jj[0] = j[0] * j[0]; jj[1] = j[1] * j[1]; jj[2] = j[2] * j[2];
-    kk[0] = k[0] * k[0]; kk[1] = k[1] * k[1]; kk[2] = k[2] * k[2];
+  }
 
-    // area of a triangle...
-    //
-    a = sqrt(ii[1] + jj[1] + kk[1]);
-    b = sqrt(ii[0] + jj[0] + kk[0]);
-    c = sqrt(ii[2] + jj[2] + kk[2]);
-    s = 0.5 * (a + b + c);
-    area = sqrt( fabs(s*(s-a)*(s-b)*(s-c)));
-    surfacearea += area;
-
-    average_surface += area / numCells;
-
-    if( area < mincellarea )
-    {
-      mincellarea = area;
-    }
-    if( area > maxcellarea )
-    {
-      maxcellarea = area;
-    }
+  MassPropertiesSums sums;
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
+    sums.Add(chunk_sums[chunk]);
+  }
 
-    // volume elements ...
-    //
-    zavg = (z[0] + z[1] + z[2]) / 3.0;
-    yavg = (y[0] + y[1] + y[2]) / 3.0;
-    xavg = (x[0] + x[1] + x[2]) / 3.0;
+  if (sums.unpredicted > 0){
+    vtkErrorMacro( << "Unpredicted situation...!" );
+    return 1;
+  }
 
-    vol[2] += (area * u[2] * zavg);
-    vol[1] += (area * u[1] * yavg);
-    vol[0] += (area * u[0] * xavg);
+  double surfacearea = sums.area.Value();
+  double average_surface = surfacearea / numCells;
+  double sum_surface[3] = {sums.oriented_surface[0].Value(),sums.oriented_surface[1].Value(),sums.oriented_surface[2].Value()};
 
-    // V  =  (z1+z2+z3)(x1y2-x2y1+x2y3-x3y2+x3y1-x1y3)/6
-    // Volume under triangle is projected area of the triangle times
-    // the average of the three z values
-    vtkMath::Cross(x,y,xp);
-    volumeproj += zavg * (xp[0]+xp[1]+xp[2]) / 2;
-
-    // Center of mass
-    // See "Inertia of Any Polyhedron" by Anthony R. Dobrovolskis, Icarus 124, 698–704 (1996) Article No. 0243
-    dv = 1. / 6. * (x[1] * ( (  y[1] - y[0] ) * (  z[2] - z[0]   ) - (  z[1] - z[0]   ) * (  y[2] - y[0])) + 
-      y[1] * ( (  z[1] - z[0] ) * (  x[2] - x[0]   ) -  (  x[1] - x[0]   ) * (  z[2] - z[0]   ) ) + 
-      z[1] * ( (  x[1] - x[0] ) * (  y[2] - y[0]   ) -  (  y[1] - y[0]   ) * (  x[2] - x[0]   )));
-
-    cx += dv * (x[0] + x[1] + x[2])/4;
-    cy += dv * (y[0] + y[1] + y[2])/4;
-    cz += dv * (z[0] + z[1] + z[2])/4;
-
-
-    // Inertia tensor
-    // See "Inertia of Any Polyhedron" by Anthony R. Dobrovolskis, Icarus 124, 698–704 (1996) Article No. 0243
-
-    P_xx += dv / 20 * (2 * x[0] * x[0]
-      + 2 * x[1] * x[1]
-      + 2 * x[2] * x[2]
-      + x[0] * x[1]
-      + x[0] * x[1]
-      + x[0] * x[2]
-      + x[0] * x[2]
-      + x[1] * x[2]
-      + x[1] * x[2]);
-
-
-    P_yy += dv / 20 * (2 * y[0] * y[0]
-      + 2 * y[1] * y[1]
-      + 2 * y[2] * y[2]
-      + y[0] * y[1]
-      + y[0] * y[1]
-      + y[0] * y[2]
-      + y[0] * y[2]
-      + y[1] * y[2]
-      + y[1] * y[2]);
-
-    P_zz += dv / 20 * (2 * z[0] * z[0]
-      + 2 * z[1] * z[1]
-      + 2 * z[2] * z[2]
-      + z[0] * z[1]
-      + z[0] * z[1]
-      + z[0] * z[2]
-      + z[0] * z[2]
-      + z[1] * z[2]
-      + z[1] * z[2]);
-
-    P_xy += dv / 20 * (2 * x[0] * y[0]
-      + 2 * x[1] * y[1]
-      + 2 * x[2] * y[2]
-      + x[0] * y[1]
-      + y[0] * x[1]
-      + x[0] * y[2]
-      + y[0] * x[2]
-      + x[1] * y[2]
-      + y[1] * x[2]);
-
-    P_xz += dv / 20 * (2 * x[0] * z[0]
-      + 2 * x[1] * z[1]
-      + 2 * x[2] * z[2]
-      + x[0] * z[1]
-      + z[0] * x[1]
-      + x[0] * z[2]
-      + z[0] * x[2]
-      + x[1] * z[2]
-      + z[1] * x[2]);
-
-    P_yz += dv / 20 * (2 * y[0] * z[0]
-      + 2 * y[1] * z[1]
-      + 2 * y[2] * z[2]
-      + y[0] * z[1]
-      + z[0] * y[1]
-      + y[0] * z[2]
-      + z[0] * y[2]
-      + y[1] * z[2]
-      + z[1] * y[2]);
-
-    // Sum of oriented surface
-    vtkMath::MultiplyScalar(u,area);
-    vtkMath::Add(u,sum_surface,sum_surface);
-
-  }
+  double P_xx = sums.P[0].Value();
+  double P_yy = sums.P[1].Value();
+  double P_zz = sums.P[2].Value();
+  double P_xy = sums.P[3].Value();
+  double P_xz = sums.P[4].Value();
+  double P_yz = sums.P[5].Value();
 
   // Surface Area ...
   this->SurfaceArea = surfacearea;
-  this->MinCellArea = mincellarea;
-  this->MaxCellArea = maxcellarea;
+  this->MinCellArea = sums.min_area;
+  this->MaxCellArea = sums.max_area;
+
+  if (this -> computeProjectedVolumes){
+
+    // Weighting factors in Discrete Divergence theorem for volume calculation.
+    //
+    double kxyz[3];
+    kxyz[0] = (sums.munc[0] + (sums.wxyz/3.0) + ((sums.wxy+sums.wxz)/2.0)) /numCells;
+    kxyz[1] = (sums.munc[1] + (sums.wxyz/3.0) + ((sums.wxy+sums.wyz)/2.0)) /numCells;
+    kxyz[2] = (sums.munc[2] + (sums.wxyz/3.0) + ((sums.wxz+sums.wyz)/2.0)) /numCells;
+    this->VolumeX = sums.vol[0].Value();
+    this->VolumeY = sums.vol[1].Value();
+    this->VolumeZ = sums.vol[2].Value();
+    this->Kx = kxyz[0];
+    this->Ky = kxyz[1];
+    this->Kz = kxyz[2];
+    this->Volume =  (kxyz[0] * this->VolumeX + kxyz[1] * this->VolumeY + kxyz[2]  * this->VolumeZ);
+    this->Volume =  fabs(this->Volume);
+    this->VolumeProjected = sums.volume_projected.Value();
+  }
+  else{
+    this->VolumeX = this->VolumeY = this->VolumeZ = std::numeric_limits<double>::quiet_NaN();
+    this->Kx = this->Ky = this->Kz = std::numeric_limits<double>::quiet_NaN();
+    this->VolumeProjected = std::numeric_limits<double>::quiet_NaN();
+    this->Volume = fabs(sums.volume.Value());
+  }
 
-  // Weighting factors in Discrete Divergence theorem for volume calculation.
-  //
-  kxyz[0] = (munc[0] + (wxyz/3.0) + ((wxy+wxz)/2.0)) /numCells;
-  kxyz[1] = (munc[1] + (wxyz/3.0) + ((wxy+wyz)/2.0)) /numCells;
-  kxyz[2] = (munc[2] + (wxyz/3.0) + ((wxz+wyz)/2.0)) /numCells;
-  this->VolumeX = vol[0] ;
-  this->VolumeY = vol[1] ;
-  this->VolumeZ = vol[2] ;
-  this->Kx = kxyz[0];
-  this->Ky = kxyz[1];
-  this->Kz = kxyz[2];
-  this->Volume =  (kxyz[0] * vol[0] + kxyz[1] * vol[1] + kxyz[2]  * vol[2]);
-  this->Volume =  fabs(this->Volume);
-  this->VolumeProjected = volumeproj ;
   this->NormalizedShapeIndex =(sqrt(surfacearea)/std::cbrt(this->Volume))/2.199085233;
 
   // Center of mass
-  arma::vec::fixed<3> com_ = {cx,cy,cz};
+  arma::vec::fixed<3> com_ = {sums.c[0].Value(),sums.c[1].Value(),sums.c[2].Value()};
 
   this -> center_of_mass = com_ / this->Volume ;
 
@@ -523,13 +582,179 @@ void SBGATMassProperties::PrintSelf(std::ostream& os, vtkIndent indent){
 
 void SBGATMassProperties::ComputeAndSaveMassProperties(vtkSmartPointer<vtkPolyData> shape,std::string path){
 
-  vtkSmartPointer<SBGATMassProperties> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
-  mass_properties -> SetInputData(shape);
-  mass_properties -> SetScaleMeters();
+  SBGATMassProperties::GetSharedMassProperties(shape,true,true) -> SaveMassProperties(path);
 
-  mass_properties -> Update();
+}
+
+vtkSmartPointer<SBGATMassProperties> SBGATMassProperties::GetSharedMassProperties(vtkPolyData * shape,
+  bool is_in_meters,
+  bool compute_projected_volumes){
+
+  vtkMTimeType mtime = shape -> GetMTime();
+
+  auto matches = [&](const SharedMassPropertiesEntry & entry){
+    return entry.shape.GetPointer() == shape && entry.mtime == mtime && entry.is_in_meters == is_in_meters 
+    && entry.compute_projected_volumes == compute_projected_volumes;
+  };
+
+  std::promise<vtkSmartPointer<SBGATMassProperties> > promise;
+  std::shared_future<vtkSmartPointer<SBGATMassProperties> > cached_mass_properties;
+  bool found = false;
 
-  mass_properties -> SaveMassProperties(path);
+  {
+    std::lock_guard<std::mutex> lock(shared_mass_properties_mutex);
+
+    // Entries whose shape was deleted are discarded
+    shared_mass_properties_cache.remove_if([](const SharedMassPropertiesEntry & entry){
+      return entry.shape.GetPointer() == nullptr;
+    });
+
+    for (auto it = shared_mass_properties_cache.begin(); it != shared_mass_properties_cache.end(); ++it){
+      if (matches(*it)){
+        shared_mass_properties_cache.splice(shared_mass_properties_cache.begin(),shared_mass_properties_cache,it);
+        cached_mass_properties = shared_mass_properties_cache.front().mass_properties;
+        found = true;
+        break;
+      }
+    }
+
+    // Otherwise, the entry is inserted before being computed so that concurrent queries 
+    // of the same shape wait for it instead of computing it again
+    if (!found){
+      SharedMassPropertiesEntry entry;
+      entry.shape = shape;
+      entry.mtime = mtime;
+      entry.is_in_meters = is_in_meters;
+      entry.compute_projected_volumes = compute_projected_volumes;
+      entry.mass_properties = promise.get_future().share();
+      shared_mass_properties_cache.push_front(entry);
+
+      if (shared_mass_properties_cache.size() > shared_mass_properties_cache_size){
+        shared_mass_properties_cache.pop_back();
+      }
+    }
+  }
+
+  // Only waits if another thread is still computing the same entry
+  if (found){
+    return cached_mass_properties.get();
+  }
+
+  try{
+
+    vtkSmartPointer<SBGATMassProperties> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
+    mass_properties -> SetInputData(shape);
+    if (is_in_meters){
+      mass_properties -> SetScaleMeters();
+    }
+    else{
+      mass_properties -> SetScaleKiloMeters();
+    }
+    mass_properties -> SetComputeProjectedVolumes(compute_projected_volumes);
+    mass_properties -> Update();
+
+    // Everything the consumers may need is computed before the entry is shared, 
+    // after which the entry is frozen and only read
+    mass_properties -> ComputeCleanedShapeTopology();
+    mass_properties -> shared = true;
+    mass_properties -> SetInputData(nullptr);
+
+    promise.set_value(mass_properties);
+    return mass_properties;
+
+  }
+  catch(...){
+
+    // A failed computation is not cached, but is reported to the threads waiting for it
+    promise.set_exception(std::current_exception());
+
+    std::lock_guard<std::mutex> lock(shared_mass_properties_mutex);
+    shared_mass_properties_cache.remove_if(matches);
+    throw;
+
+  }
+
+}
+
+void SBGATMassProperties::ClearSharedMassProperties(){
+
+  std::lock_guard<std::mutex> lock(shared_mass_properties_mutex);
+  shared_mass_properties_cache.clear();
+
+}
+
+void SBGATMassProperties::ComputeCleanedShapeTopology(){
+
+  if (this -> cleanedShapeTopologySet){
+    return;
+  }
+
+  vtkPolyData * input = this -> cleanedShape;
+  this -> cleanedShapeFacetNormals.reset();
+  this -> cleanedShapeEdges.clear();
+  this -> cleanedShapeTopologySet = true;
+
+  if (input == nullptr || input -> GetNumberOfCells() < 1){
+    return;
+  }
+
+  // Required by vtkPolyData::GetPointCells 
+  input -> BuildLinks();
+
+  // Generate normals
+  vtkSmartPointer<vtkPolyDataNormals> normalGenerator = vtkSmartPointer<vtkPolyDataNormals>::New();
+  normalGenerator -> SetInputData(input);
+  normalGenerator -> ComputePointNormalsOff();
+  normalGenerator -> ComputeCellNormalsOn();
+  normalGenerator -> Update();
+
+  vtkFloatArray * normals = vtkFloatArray::SafeDownCast(normalGenerator -> GetOutput() -> GetCellData() -> GetArray("Normals"));
+
+  vtkIdType numCells = input -> GetNumberOfCells();
+  this -> cleanedShapeFacetNormals.set_size(3,numCells);
+
+  for (vtkIdType i = 0; i < numCells; ++i){
+    normals -> GetTuple(i,this -> cleanedShapeFacetNormals.colptr(i));
+  }
+
+  // The edges are extracted
+  vtkSmartPointer<vtkExtractEdges> extractEdges = vtkSmartPointer<vtkExtractEdges>::New();
+  extractEdges -> SetInputData(input);
+  extractEdges -> Update();
+
+  vtkIdType edge_count = extractEdges -> GetOutput() -> GetNumberOfCells();
+  this -> cleanedShapeEdges.resize(edge_count);
+
+  vtkSmartPointer<vtkIdList> facet_ids_point_1 = vtkSmartPointer<vtkIdList>::New();
+  vtkSmartPointer<vtkIdList> facet_ids_point_2 = vtkSmartPointer<vtkIdList>::New();
+
+  // This loop cannot be parallelized since GetCell is 
+  // not thread-safe
+  for(vtkIdType i = 0; i < edge_count; i++){
+
+    vtkLine * line = vtkLine::SafeDownCast(extractEdges -> GetOutput() -> GetCell(i));
+    this -> cleanedShapeEdges[i][0] = line -> GetPointIds() -> GetId(0);
+    this -> cleanedShapeEdges[i][1] = line -> GetPointIds() -> GetId(1);
+
+    // We need to find the facets forming this edge
+    input -> GetPointCells(this -> cleanedShapeEdges[i][0],facet_ids_point_1);
+    input -> GetPointCells(this -> cleanedShapeEdges[i][1],facet_ids_point_2);
+
+    // Now, we find the two facet indices showing up in both facet_ids_point_1 and facet_ids_point_2
+    facet_ids_point_1 -> IntersectWith(facet_ids_point_2);
+
+    // Edges of non-manifold shapes are flagged rather than rejected, since only 
+    // some of the consumers require a closed shape
+    if (facet_ids_point_1 -> GetNumberOfIds() != 2){
+      this -> cleanedShapeEdges[i][2] = -1;
+      this -> cleanedShapeEdges[i][3] = -1;
+    }
+    else{
+      this -> cleanedShapeEdges[i][2] = facet_ids_point_1 -> GetId(0);
+      this -> cleanedShapeEdges[i][3] = facet_ids_point_1 -> GetId(1);
+    }
+
+  }
 
 }
 
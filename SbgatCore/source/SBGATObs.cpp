@@ -1,6 +1,14 @@
 
 #include <SBGATObs.hpp>
 #include <SBGATMassProperties.hpp>
+#include <vtkIdList.h>
+#include <vtkSmartPointer.h>
+#include <vtkMath.h>
+#include <algorithm>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
 
 
 vtkStandardNewMacro(SBGATObs);
@@ -27,47 +35,46 @@ int SBGATObs::RequestData(
 	vtkInformationVector** inputVector,
 	vtkInformationVector* vtkNotUsed( outputVector )){
 
-	this -> bspTree_vec.clear();
+	this -> bvh_vec.clear();
+	this -> horizon_maps.clear();
 	this -> polydata_vec.clear();
-
-	vtkSmartPointer<SBGATMassProperties> mass_filter = vtkSmartPointer<SBGATMassProperties>::New();
+	this -> center_of_mass_vec.clear();
 
   // Processing the primary
 	vtkInformation *inInfo0 = inputVector[0]->GetInformationObject(0);
 	vtkPolyData * primary = vtkPolyData::SafeDownCast(inInfo0->Get(vtkDataObject::DATA_OBJECT()));
 
 
-	vtkSmartPointer<vtkModifiedBSPTree> tree = vtkSmartPointer<vtkModifiedBSPTree>::New();
-	tree -> SetDataSet(primary);
-	tree -> BuildLocator();
+	this -> bvh_vec.push_back(SBGATTriangleBVH());
+	this -> bvh_vec.back().Build(primary);
 
-	this -> bspTree_vec.push_back(tree);
 	this -> polydata_vec.push_back(primary);
 
-	mass_filter -> SetInputData(primary);
-	mass_filter -> Update();
-	this -> center_of_mass_vec.push_back(mass_filter -> GetCenterOfMass());
+	this -> center_of_mass_vec.push_back(SBGATMassProperties::GetSharedMassProperties(primary,true) -> GetCenterOfMass());
 	
   	// Processing the secondary, if any
 	if(inputVector[0] -> GetNumberOfInformationObjects() == 2){
 
 		vtkInformation *inInfo1 = inputVector[0]->GetInformationObject(1);
 		vtkPolyData * secondary =  vtkPolyData::SafeDownCast(inInfo1->Get(vtkDataObject::DATA_OBJECT()));
-		vtkSmartPointer<vtkModifiedBSPTree> tree = vtkSmartPointer<vtkModifiedBSPTree>::New();
-		tree -> SetDataSet(secondary);
-		tree -> BuildLocator();
-		this -> bspTree_vec.push_back(tree);
+		this -> bvh_vec.push_back(SBGATTriangleBVH());
+		this -> bvh_vec.back().Build(secondary);
 		this -> polydata_vec.push_back(secondary);
 
-		mass_filter -> SetInputData(secondary);
-		mass_filter -> Update();
-		this -> center_of_mass_vec.push_back(mass_filter -> GetCenterOfMass());
+		this -> center_of_mass_vec.push_back(SBGATMassProperties::GetSharedMassProperties(secondary,true) -> GetCenterOfMass());
 
 	}
 
 
 	this -> number_of_bodies = polydata_vec.size();
 
+	// Length of the primary's diagonal, from which the position of the observers and the ray-tracing tolerance derive. 
+	// Stored so that concurrent observations do not query the polydata's bounds
+	this -> reference_length = primary -> GetLength();
+
+	// The vertices, unit normals and areas of the facets are fetched once and for all
+	this -> cache_facets();
+
  // The surface area of the largest facet amongst all considered shapes is found
 	this -> find_min_facet_surface_area();
 
@@ -75,31 +82,37 @@ int SBGATObs::RequestData(
 }
 
 
-void SBGATObs::find_min_facet_surface_area(){
+void SBGATObs::cache_facets(){
 
-	double min_area = std::numeric_limits<double>::infinity();
-	vtkIdType numCells, numIds;
+	this -> facet_vertices_vec.clear();
+	this -> facet_normals_vec.clear();
+	this -> facet_areas_vec.clear();
+	this -> bounding_sphere_centers_vec.clear();
+	this -> bounding_sphere_radii_vec.clear();
 
 	vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
 	ptIds -> Allocate(VTK_CELL_SIZE);
 
 	for (auto input : this -> polydata_vec){
 
-		numCells = input -> GetNumberOfCells();
+		vtkIdType numCells = input -> GetNumberOfCells();
 
-		for (vtkIdType cellId=0; cellId < numCells; cellId++){
+		std::vector<std::array<double,9> > vertices(numCells);
+		arma::mat normals(3,numCells);
+		arma::vec areas(numCells);
+
+		for (vtkIdType cellId = 0; cellId < numCells; cellId++){
 
 			if ( input->GetCellType(cellId) != VTK_TRIANGLE){
 				throw(std::runtime_error("Input data type must be VTK_TRIANGLE not " + std::to_string(input->GetCellType(cellId))));
 			}
 
 			input -> GetCellPoints(cellId,ptIds);
-			numIds = ptIds -> GetNumberOfIds();
-			assert(numIds == 3);
+			assert(ptIds -> GetNumberOfIds() == 3);
 
-			double p0[3];
-			double p1[3];
-			double p2[3];
+			double * p0 = vertices[cellId].data();
+			double * p1 = vertices[cellId].data() + 3;
+			double * p2 = vertices[cellId].data() + 6;
 
 			input->GetPoint(ptIds->GetId(0), p0);
 			input->GetPoint(ptIds->GetId(1), p1);
@@ -114,8 +127,47 @@ void SBGATObs::find_min_facet_surface_area(){
 			double n[3];
 
 			vtkMath::Cross(e0,e1,n);
-			min_area = std::min(min_area,vtkMath::Norm(n)/2);
+			areas(cellId) = vtkMath::Normalize(n) / 2;
+
+			normals(0,cellId) = n[0];
+			normals(1,cellId) = n[1];
+			normals(2,cellId) = n[2];
+
+		}
+
+		// The bounding sphere is centered on the bounding box of the shape
+		double bounds[6];
+		input -> GetBounds(bounds);
+		arma::vec::fixed<3> center = {(bounds[0] + bounds[1]) / 2,(bounds[2] + bounds[3]) / 2,(bounds[4] + bounds[5]) / 2};
+
+		double radius = 0;
+		for (const auto & facet_vertices : vertices){
+			for (int k = 0; k < 3; ++k){
+				double d0 = facet_vertices[3 * k] - center(0);
+				double d1 = facet_vertices[3 * k + 1] - center(1);
+				double d2 = facet_vertices[3 * k + 2] - center(2);
+				radius = std::max(radius,d0 * d0 + d1 * d1 + d2 * d2);
+			}
+		}
+
+		this -> facet_vertices_vec.push_back(vertices);
+		this -> facet_normals_vec.push_back(normals);
+		this -> facet_areas_vec.push_back(areas);
+		this -> bounding_sphere_centers_vec.push_back(center);
+		this -> bounding_sphere_radii_vec.push_back(std::sqrt(radius));
+
+	}
+
+}
 
+
+void SBGATObs::find_min_facet_surface_area(){
+
+	double min_area = std::numeric_limits<double>::infinity();
+
+	for (const auto & areas : this -> facet_areas_vec){
+		if (areas.n_elem > 0){
+			min_area = std::min(min_area,areas.min());
 		}
 	}
 
@@ -136,106 +188,732 @@ int SBGATObs::FillInputPortInformation( int port, vtkInformation* info ){
 	return 0;
 }
 
-void SBGATObs::prefind_facets_inview (
-	
-	std::vector<int> & facets_in_view,
-	const unsigned int & body_index,
-	const std::vector<arma::vec> & dir_to_check_vec,
+void SBGATObs::prefind_facets_inview(const std::vector<arma::vec> & dir_to_check_vec,
 	const std::vector<arma::mat> & BN_dcms_vec,
-	const std::vector<arma::vec> & positions_vec){
+	FacetsInView & facets_in_view) const{
+
+	facets_in_view.bodies.clear();
+	facets_in_view.facets.clear();
+	facets_in_view.cosines.resize(this -> number_of_bodies);
 
-	vtkIdType numCells, numIds;
+	for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
 
-	vtkPolyData * input = this -> polydata_vec[body_index];
+		const arma::mat & normals = this -> facet_normals_vec[body_index];
+		arma::mat & cosines = facets_in_view.cosines[body_index];
+
+		// The directions to check are expressed in the body frame
+		arma::mat dirs_body_frame(3,dir_to_check_vec.size());
+		for (unsigned int i = 0; i < dir_to_check_vec.size(); ++i){
+			dirs_body_frame.col(i) = BN_dcms_vec[body_index] * dir_to_check_vec[i];
+		}
+
+		// A single pass over the contiguous normals gives the cosine of each direction 
+		// with respect to each facet. A facet is kept if all the directions point above its horizon. 
+		// The cosines are written in place, the storage being only reallocated when the number of facets changes
+		if (cosines.n_rows != dirs_body_frame.n_cols || cosines.n_cols != normals.n_cols){
+			cosines.set_size(dirs_body_frame.n_cols,normals.n_cols);
+		}
+		cosines = dirs_body_frame.t() * normals;
+
+		for (unsigned int facet = 0; facet < cosines.n_cols; ++facet){
+
+			bool in_view = true;
+			for (unsigned int i = 0; i < cosines.n_rows; ++i){
+				if (cosines(i,facet) < 0){
+					in_view = false;
+					break;
+				}
+			}
+
+			if (in_view){
+				facets_in_view.bodies.push_back(body_index);
+				facets_in_view.facets.push_back(facet);
+			}
+		}
+
+	}
+}
+
+
+void SBGATObs::check_epochs_dimensions(const std::string & method,
+	const unsigned int N_epochs,
+	const std::vector<std::vector<arma::vec> > & positions_vecs,
+	const std::vector<std::vector<arma::vec> > & velocities_vecs,
+	const std::vector<std::vector<arma::vec> > & mrps_vecs,
+	const std::vector<std::vector<arma::vec> > & omegas_vecs) const{
+
+	if (positions_vecs.size() != N_epochs || velocities_vecs.size() != N_epochs || mrps_vecs.size() != N_epochs || omegas_vecs.size() != N_epochs){
+		throw(std::runtime_error("In " + method + ": states must be provided for each of the " + std::to_string(N_epochs) + " epochs"));
+	}
+
+	for (unsigned int t = 0; t < N_epochs; ++t){
+		if (static_cast<int>(positions_vecs[t].size()) != this -> number_of_bodies || static_cast<int>(velocities_vecs[t].size()) != this -> number_of_bodies 
+			|| static_cast<int>(mrps_vecs[t].size()) != this -> number_of_bodies || static_cast<int>(omegas_vecs[t].size()) != this -> number_of_bodies){
+			throw(std::runtime_error("In " + method + ": incompatible input dimensions at epoch " + std::to_string(t)));
+		}
+	}
+
+}
+
+
+void SBGATObs::build_occlusion_scene(const std::vector<arma::mat> & BN_dcms_vec,
+	const std::vector<arma::vec> & positions_vec,
+	OcclusionScene & scene) const{
+
+	int n = this -> number_of_bodies;
+
+	scene.number_of_bodies = n;
+	scene.BN_dcms.resize(n);
+	scene.positions.resize(n);
+	scene.dcms.resize(n * n);
+	scene.offsets.resize(n * n);
+	scene.sphere_centers.resize(n * n);
+
+	for (int body_index = 0; body_index < n; ++body_index){
+		scene.BN_dcms[body_index] = BN_dcms_vec[body_index];
+		scene.positions[body_index] = positions_vec[body_index];
+	}
+
+	for (int origin_body_index = 0; origin_body_index < n; ++origin_body_index){
+
+		const arma::mat::fixed<3,3> & BN_origin = scene.BN_dcms[origin_body_index];
+
+		for (int considered_body_index = 0; considered_body_index < n; ++considered_body_index){
+
+			const arma::mat::fixed<3,3> & BN_considered = scene.BN_dcms[considered_body_index];
+			int pair = origin_body_index * n + considered_body_index;
+
+			// Maps coordinates in the origin body's hierarchy to coordinates in the considered body's hierarchy
+			// the center of mass of each body is not necessarily at (0,0,0) so this offset must be accounted for
+			scene.dcms[pair] = BN_considered * BN_origin.t();
+			scene.offsets[pair] = BN_considered * (scene.positions[origin_body_index] - scene.positions[considered_body_index]
+				- BN_origin.t() * this -> center_of_mass_vec[origin_body_index]) + this -> center_of_mass_vec[considered_body_index];
+
+			// Center of the considered body's bounding sphere, expressed in the origin body's hierarchy
+			scene.sphere_centers[pair] = BN_origin * (BN_considered.t() * (this -> bounding_sphere_centers_vec[considered_body_index] 
+				- this -> center_of_mass_vec[considered_body_index]) + scene.positions[considered_body_index] - scene.positions[origin_body_index])
+				+ this -> center_of_mass_vec[origin_body_index];
+
+		}
+	}
+
+}
+
+
+bool SBGATObs::check_line_for_intersect(const int & origin_body_index,
+	const arma::vec::fixed<3> & start_point_origin_body,
+	const arma::vec::fixed<3> & end_point_inertial,
+	const OcclusionScene & scene,
+	const double & tol) const{
+
+	bool intersected = false;
+	this -> check_lines_for_intersect(origin_body_index,start_point_origin_body.memptr(),1,end_point_inertial,scene,tol,&intersected);
+	return intersected;
+
+}
+
+
+void SBGATObs::check_lines_for_intersect(const int & origin_body_index,
+	const double * start_points_origin_body,
+	const int n_lines,
+	const arma::vec::fixed<3> & end_point_inertial,
+	const OcclusionScene & scene,
+	const double & tol,
+	bool * intersected,
+	const bool skip_origin_body) const{
+
+	double start_points_considered[3 * SBGATTriangleBVH::PacketSize];
+	double end_points_considered[3 * SBGATTriangleBVH::PacketSize];
+	bool candidate[SBGATTriangleBVH::PacketSize];
+	bool hits[SBGATTriangleBVH::PacketSize];
+
+	// The common end point is first expressed in the origin body's hierarchy
+	arma::vec::fixed<3> end_point_origin_body = scene.BN_dcms[origin_body_index] * (end_point_inertial - scene.positions[origin_body_index]) 
+	+ this -> center_of_mass_vec[origin_body_index];
+
+	for (int considered_body_index = 0; considered_body_index < this -> number_of_bodies; ++considered_body_index){
+
+		if (skip_origin_body && considered_body_index == origin_body_index){
+			continue;
+		}
+
+		int pair = origin_body_index * scene.number_of_bodies + considered_body_index;
+
+		// Broad phase: the lines that do not cross the bounding sphere of another body 
+		// cannot intersect it and are not traced through its hierarchy
+		int n_candidates = 0;
+
+		for (int l = 0; l < n_lines; ++l){
+
+			candidate[l] = !intersected[l];
+
+			if (candidate[l] && considered_body_index != origin_body_index){
+				candidate[l] = SBGATObs::segment_crosses_sphere(start_points_origin_body + 3 * l,end_point_origin_body.memptr(),
+					scene.sphere_centers[pair].memptr(),this -> bounding_sphere_radii_vec[considered_body_index] + tol);
+			}
+
+			// Lines that are not candidates are flagged as hit so as to be skipped by the traversal
+			hits[l] = !candidate[l];
+			n_candidates += candidate[l];
+		}
+
+		if (n_candidates == 0){
+			continue;
+		}
+
+		// The origins and the end point are expressed in the frame of the considered body's hierarchy
+		const arma::mat::fixed<3,3> & dcm = scene.dcms[pair];
+		const arma::vec::fixed<3> & offset = scene.offsets[pair];
+		arma::vec::fixed<3> end_point_considered = dcm * end_point_origin_body + offset;
+
+		for (int l = 0; l < n_lines; ++l){
+			for (int i = 0; i < 3; ++i){
+				start_points_considered[3 * l + i] = offset(i) + dcm(i,0) * start_points_origin_body[3 * l] 
+				+ dcm(i,1) * start_points_origin_body[3 * l + 1] + dcm(i,2) * start_points_origin_body[3 * l + 2];
+				end_points_considered[3 * l + i] = end_point_considered(i);
+			}
+		}
+
+		this -> bvh_vec[considered_body_index].AnyHitPacket(start_points_considered,end_points_considered,n_lines,tol,hits);
+
+		for (int l = 0; l < n_lines; ++l){
+			if (candidate[l] && hits[l]){
+				intersected[l] = true;
+			}
+		}
+
+	}
+
+}
+
+
+bool SBGATObs::segment_crosses_sphere(const double * start,
+	const double * end,
+	const double * center,
+	const double radius){
+
+	double d[3] = {end[0] - start[0],end[1] - start[1],end[2] - start[2]};
+	double c[3] = {center[0] - start[0],center[1] - start[1],center[2] - start[2]};
+
+	// Parameter of the point of the segment closest to the center
+	double dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+	double t = dd > 0 ? (c[0] * d[0] + c[1] * d[1] + c[2] * d[2]) / dd : 0;
+	t = std::max(0.,std::min(1.,t));
+
+	double dx = c[0] - t * d[0];
+	double dy = c[1] - t * d[1];
+	double dz = c[2] - t * d[2];
+
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+
+}
+
+
+void SBGATObs::gather_inertial_facets(const std::vector<arma::mat> & BN_dcms_vec,
+	const std::vector<arma::vec> & positions_vec,
+	std::vector<std::array<double,9> > & vertices,
+	std::vector<int> & bodies) const{
+
+	vertices.clear();
+	bodies.clear();
 
 	vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
 	ptIds -> Allocate(VTK_CELL_SIZE);
-	numCells = input -> GetNumberOfCells();
 
-	for (vtkIdType cellId=0; cellId < numCells; cellId++){
+	for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+
+		vtkPolyData * input = this -> polydata_vec[body_index];
+		arma::mat::fixed<3,3> NB = BN_dcms_vec[body_index].t();
+
+		for (vtkIdType cellId = 0; cellId < input -> GetNumberOfCells(); ++cellId){
+
+			std::array<double,9> facet_vertices;
+			input -> GetCellPoints(cellId,ptIds);
 
-		if ( input->GetCellType(cellId) != VTK_TRIANGLE){
-			throw(std::runtime_error("Input data type must be VTK_TRIANGLE not " + std::to_string(input->GetCellType(cellId))));
+			for (int v = 0; v < 3; ++v){
+				arma::vec::fixed<3> point;
+				input -> GetPoint(ptIds -> GetId(v),point.memptr());
+				point = NB * (point - this -> center_of_mass_vec[body_index]) + positions_vec[body_index];
+				std::copy(point.begin(),point.end(),facet_vertices.begin() + 3 * v);
+			}
+
+			vertices.push_back(facet_vertices);
+			bodies.push_back(body_index);
+
+		}
+	}
+
+}
+
+
+void SBGATObs::rasterize(const std::vector<std::array<double,9> > & vertices,
+	const arma::vec & dir,
+	DepthBuffer & buffer) const{
+
+	int resolution = this -> raster_resolution;
+
+	// The projection plane is spanned by e1 and e2, such that (e1,e2,dir) is right-handed
+	buffer.dir = arma::normalise(dir);
+	arma::vec::fixed<3> axis = {0,0,0};
+	axis(arma::abs(buffer.dir).index_min()) = 1;
+	buffer.e1 = arma::normalise(arma::cross(buffer.dir,axis));
+	buffer.e2 = arma::cross(buffer.dir,buffer.e1);
+	buffer.resolution = resolution;
+
+	int N_facets = static_cast<int>(vertices.size());
+
+	// Projected coordinates (u,v) and depth (w) of each vertex. The closer to the viewer, the larger the depth
+	std::vector<double> projected(9 * N_facets);
+	double u_min = std::numeric_limits<double>::infinity();
+	double u_max = -std::numeric_limits<double>::infinity();
+	double v_min = std::numeric_limits<double>::infinity();
+	double v_max = -std::numeric_limits<double>::infinity();
+
+	for (int f = 0; f < N_facets; ++f){
+		for (int v = 0; v < 3; ++v){
+			const double * x = vertices[f].data() + 3 * v;
+			double * p = projected.data() + 9 * f + 3 * v;
+			p[0] = buffer.e1(0) * x[0] + buffer.e1(1) * x[1] + buffer.e1(2) * x[2];
+			p[1] = buffer.e2(0) * x[0] + buffer.e2(1) * x[1] + buffer.e2(2) * x[2];
+			p[2] = buffer.dir(0) * x[0] + buffer.dir(1) * x[1] + buffer.dir(2) * x[2];
+			u_min = std::min(u_min,p[0]);
+			u_max = std::max(u_max,p[0]);
+			v_min = std::min(v_min,p[1]);
+			v_max = std::max(v_max,p[1]);
+		}
+	}
+
+	buffer.u_min = u_min;
+	buffer.v_min = v_min;
+	buffer.pixel_size = std::max(u_max - u_min,v_max - v_min) / resolution * (1 + 1e-9);
+	buffer.depth.assign(resolution * resolution,-std::numeric_limits<double>::infinity());
+	buffer.facet.assign(resolution * resolution,-1);
+
+	for (int f = 0; f < N_facets; ++f){
+
+		const double * p0 = projected.data() + 9 * f;
+		const double * p1 = p0 + 3;
+		const double * p2 = p0 + 6;
+
+		// Facets whose outbound normal points away from the viewer cannot be seen
+		double area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+		if (area <= 0){
+			continue;
 		}
 
-		input -> GetCellPoints(cellId,ptIds);
-		numIds = ptIds -> GetNumberOfIds();
-		assert(numIds == 3);
+		int i_min = std::max(0,int((std::min(p0[0],std::min(p1[0],p2[0])) - u_min) / buffer.pixel_size));
+		int i_max = std::min(resolution - 1,int((std::max(p0[0],std::max(p1[0],p2[0])) - u_min) / buffer.pixel_size));
+		int j_min = std::max(0,int((std::min(p0[1],std::min(p1[1],p2[1])) - v_min) / buffer.pixel_size));
+		int j_max = std::min(resolution - 1,int((std::max(p0[1],std::max(p1[1],p2[1])) - v_min) / buffer.pixel_size));
 
-		double p0[3];
-		double p1[3];
-		double p2[3];
+		for (int j = j_min; j <= j_max; ++j){
 
-		input->GetPoint(ptIds->GetId(0), p0);
-		input->GetPoint(ptIds->GetId(1), p1);
-		input->GetPoint(ptIds->GetId(2), p2);
+			double v_c = v_min + (j + 0.5) * buffer.pixel_size;
 
-		double e0[3];
-		double e1[3];
+			for (int i = i_min; i <= i_max; ++i){
 
-		vtkMath::Subtract(p1,p0,e0);
-		vtkMath::Subtract(p2,p0,e1);
+				double u_c = u_min + (i + 0.5) * buffer.pixel_size;
 
-		double n[3];
+				// Barycentric coordinates of the pixel center
+				double l0 = ((p1[0] - u_c) * (p2[1] - v_c) - (p2[0] - u_c) * (p1[1] - v_c)) / area;
+				double l1 = ((p2[0] - u_c) * (p0[1] - v_c) - (p0[0] - u_c) * (p2[1] - v_c)) / area;
+				double l2 = 1 - l0 - l1;
 
-		vtkMath::Cross(e0,e1,n);
-		vtkMath::Normalize(n);
+				if (l0 < 0 || l1 < 0 || l2 < 0){
+					continue;
+				}
 
-    // The normal vector is oriented using the body's dcm
-		arma::vec n_body_frame = {n[0],n[1],n[2]};
+				int k = i + j * resolution;
+				double depth = l0 * p0[2] + l1 * p1[2] + l2 * p2[2];
 
-    // Check if all the provided directions point above this facet's horizon
-		bool in_view = true;
+				if (depth > buffer.depth[k]){
+					buffer.depth[k] = depth;
+					buffer.facet[k] = f;
+				}
 
-		for(auto dir : dir_to_check_vec){
-			if (arma::dot(n_body_frame,BN_dcms_vec[body_index] * dir) < 0){
-				in_view = false;
-				break;
 			}
 		}
+	}
 
-		if (in_view){
-			facets_in_view.push_back(cellId);
+}
+
+
+arma::vec::fixed<3> SBGATObs::get_pixel_point(const DepthBuffer & buffer, const int pixel){
+
+	int i = pixel % buffer.resolution;
+	int j = pixel / buffer.resolution;
+
+	return (buffer.u_min + (i + 0.5) * buffer.pixel_size) * buffer.e1 
+	+ (buffer.v_min + (j + 0.5) * buffer.pixel_size) * buffer.e2 
+	+ buffer.depth[pixel] * buffer.dir;
+
+}
+
+
+bool SBGATObs::is_seen(const DepthBuffer & buffer, const arma::vec::fixed<3> & point, const double cos_incidence){
+
+	int i = int(std::floor((arma::dot(point,buffer.e1) - buffer.u_min) / buffer.pixel_size));
+	int j = int(std::floor((arma::dot(point,buffer.e2) - buffer.v_min) / buffer.pixel_size));
+
+	if (i < 0 || j < 0 || i >= buffer.resolution || j >= buffer.resolution){
+		return true;
+	}
+
+	// The depth stored at the pixel center differs from that of the point by up to 
+	// a pixel times the surface slope, which the bias accounts for
+	double slope = std::sqrt(std::max(0.,1 - cos_incidence * cos_incidence)) / std::max(cos_incidence,1e-2);
+	double bias = buffer.pixel_size * (1 + slope);
+
+	return arma::dot(point,buffer.dir) >= buffer.depth[i + j * buffer.resolution] - bias;
+
+}
+
+
+// SplitMix64 finalizer
+static unsigned long long mix_bits(unsigned long long x){
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+void SBGATObs::draw_uniforms(const unsigned long long seed,
+	const unsigned long long stream,
+	const unsigned long long counter,
+	double & u,
+	double & v){
+
+	unsigned long long key = mix_bits(seed ^ mix_bits(stream));
+
+	// The 53 most significant bits of each draw are mapped to [0,1)
+	u = (mix_bits(key + 2 * counter) >> 11) * (1.0 / 9007199254740992.0);
+	v = (mix_bits(key + 2 * counter + 1) >> 11) * (1.0 / 9007199254740992.0);
+
+}
+
+void SBGATObs::ComputeHorizonMaps(const int N_azimuth){
+
+	if (N_azimuth < 1){
+		throw(std::runtime_error("In SBGATObs::ComputeHorizonMaps: the number of azimuth bins must be positive, not " + std::to_string(N_azimuth)));
+	}
+
+	if (static_cast<int>(this -> bvh_vec.size()) != this -> number_of_bodies || this -> number_of_bodies == 0){
+		throw(std::runtime_error("In SBGATObs::ComputeHorizonMaps: Update() must be called first"));
+	}
+
+	// The horizon elevation is found by bisection to within 2^-12 * pi/2 (about 0.02 deg)
+	const int N_bisections = 12;
+	double tol = this -> reference_length / 1E6;
+
+	std::vector<arma::mat> horizon_maps(this -> number_of_bodies);
+
+	for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+
+		const std::vector<std::array<double,9> > & vertices = this -> facet_vertices_vec[body_index];
+		const arma::mat & normals = this -> facet_normals_vec[body_index];
+		int N_facets = static_cast<int>(vertices.size());
+		double ray_length = 2 * this -> polydata_vec[body_index] -> GetLength();
+
+		horizon_maps[body_index].set_size(N_azimuth,N_facets);
+		const SBGATTriangleBVH & bvh = this -> bvh_vec[body_index];
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int f = 0; f < N_facets; ++f){
+
+			arma::vec::fixed<3> P0 = {vertices[f][0],vertices[f][1],vertices[f][2]};
+			arma::vec::fixed<3> P1 = {vertices[f][3],vertices[f][4],vertices[f][5]};
+			arma::vec::fixed<3> P2 = {vertices[f][6],vertices[f][7],vertices[f][8]};
+
+			arma::vec::fixed<3> n = normals.col(f);
+			arma::vec::fixed<3> origin = (P0 + P1 + P2) / 3 + 3 * tol * n;
+
+			// Tangent axes from which the azimuth is measured, consistent with facet_azimuth
+			arma::vec::fixed<3> axis = {0,0,0};
+			axis(arma::abs(n).index_min()) = 1;
+			arma::vec::fixed<3> t1 = arma::normalise(arma::cross(n,axis));
+			arma::vec::fixed<3> t2 = arma::cross(n,t1);
+
+			for (int bin = 0; bin < N_azimuth; ++bin){
+
+				double azimuth = 2 * arma::datum::pi * (bin + 0.5) / N_azimuth;
+				arma::vec::fixed<3> tangent = std::cos(azimuth) * t1 + std::sin(azimuth) * t2;
+
+				// The facet is supposed to be shadowed below its horizon and lit above it
+				double lower = 0;
+				double upper = arma::datum::pi / 2;
+
+				for (int iter = 0; iter < N_bisections; ++iter){
+
+					double elevation = 0.5 * (lower + upper);
+					arma::vec::fixed<3> end = origin + ray_length * (std::cos(elevation) * tangent + std::sin(elevation) * n);
+
+					if (bvh.AnyHit(origin.memptr(),end.memptr(),tol)){
+						lower = elevation;
+					}
+					else{
+						upper = elevation;
+					}
+				}
+
+				horizon_maps[body_index](bin,f) = (lower == 0) ? 0 : upper;
+
+			}
 		}
+	}
 
+	this -> horizon_maps = horizon_maps;
+
+}
+
+
+// Header of the files written by SBGATObs::SaveHorizonMaps
+struct HorizonMapsBinaryHeader{
+	char magic[8];
+	uint32_t version;
+	uint32_t n_azimuth;
+	uint64_t n_bodies;
+};
+
+static_assert(sizeof(HorizonMapsBinaryHeader) == 24,"Unexpected padding in HorizonMapsBinaryHeader");
+
+static const char horizon_maps_binary_magic[8] = "SBGATHM";
+static const uint32_t horizon_maps_binary_version = 1;
+
+void SBGATObs::SaveHorizonMaps(std::string path) const{
+
+	if (this -> horizon_maps.empty()){
+		throw(std::runtime_error("In SBGATObs::SaveHorizonMaps: no horizon maps to save"));
+	}
+
+	HorizonMapsBinaryHeader header;
+	std::memset(&header,0,sizeof(header));
+	std::memcpy(header.magic,horizon_maps_binary_magic,sizeof(header.magic));
+	header.version = horizon_maps_binary_version;
+	header.n_azimuth = this -> horizon_maps[0].n_rows;
+	header.n_bodies = this -> horizon_maps.size();
+
+	std::ofstream o(path,std::ios::binary);
+	o.write(reinterpret_cast<const char *>(&header),sizeof(header));
+
+	for (const auto & horizon_map : this -> horizon_maps){
+		uint64_t n_facets = horizon_map.n_cols;
+		o.write(reinterpret_cast<const char *>(&n_facets),sizeof(n_facets));
+	}
+
+	for (const auto & horizon_map : this -> horizon_maps){
+		o.write(reinterpret_cast<const char *>(horizon_map.memptr()),horizon_map.n_elem * sizeof(double));
 	}
+
+	if (!o){
+		throw(std::runtime_error("In SBGATObs::SaveHorizonMaps: could not write to " + path));
+	}
+
 }
 
+void SBGATObs::LoadHorizonMaps(std::string path){
 
-bool SBGATObs::check_line_for_intersect(const int & origin_body_index,
-	const arma::vec & start_point_origin_body,
-	const arma::vec & end_point_inertial,
-	const std::vector<arma::mat> & BN_dcms_vec,
-	const std::vector<arma::vec> & positions_vec,
-	const double & tol) const{
+	std::ifstream i(path,std::ios::binary);
+	if (!i){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: could not open " + path));
+	}
 
+	HorizonMapsBinaryHeader header;
+	if (!i.read(reinterpret_cast<char *>(&header),sizeof(header))){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: " + path + " is too short to hold a header"));
+	}
 
-	for (int considered_body_index = 0; considered_body_index < this -> number_of_bodies; ++considered_body_index){
+	if (std::memcmp(header.magic,horizon_maps_binary_magic,sizeof(header.magic)) != 0){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: " + path + " is not a horizon maps binary file"));
+	}
+
+	if (header.version != horizon_maps_binary_version){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: unsupported format version " + std::to_string(header.version) + " in " + path));
+	}
+
+	if (header.n_azimuth == 0){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: the horizon maps in " + path + " have no azimuth bins"));
+	}
+
+	if (header.n_bodies != static_cast<uint64_t>(this -> number_of_bodies)){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: " + path + " holds the horizon maps of " + std::to_string(header.n_bodies) 
+			+ " bodies, not " + std::to_string(this -> number_of_bodies)));
+	}
+
+	std::vector<arma::mat> horizon_maps(this -> number_of_bodies);
+	uint64_t n_facets_total = 0;
+
+	for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+
+		uint64_t n_facets;
+		i.read(reinterpret_cast<char *>(&n_facets),sizeof(n_facets));
+
+		if (!i || n_facets != static_cast<uint64_t>(this -> polydata_vec[body_index] -> GetNumberOfCells())){
+			throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: the horizon maps in " + path + " do not match the facets of body " + std::to_string(body_index)));
+		}
+
+		n_facets_total += n_facets;
+	}
+
+	// The elevation tables must exactly fill the rest of the file, which is checked
+	// before anything is allocated
+	std::streamoff tables_begin = i.tellg();
+	i.seekg(0,std::ios::end);
+	std::streamoff tables_end = i.tellg();
+	i.seekg(tables_begin);
+
+	if (tables_begin < 0 || tables_end < tables_begin 
+		|| static_cast<uint64_t>(tables_end - tables_begin) / sizeof(double) != header.n_azimuth * n_facets_total
+		|| static_cast<uint64_t>(tables_end - tables_begin) % sizeof(double) != 0){
+		throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: the size of the elevation tables in " + path 
+			+ " is inconsistent with " + std::to_string(header.n_azimuth) + " azimuth bins"));
+	}
+
+	for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+
+		arma::mat & horizon_map = horizon_maps[body_index];
+		horizon_map.set_size(header.n_azimuth,this -> polydata_vec[body_index] -> GetNumberOfCells());
+
+		if (!i.read(reinterpret_cast<char *>(horizon_map.memptr()),horizon_map.n_elem * sizeof(double))){
+			throw(std::runtime_error("In SBGATObs::LoadHorizonMaps: " + path + " is truncated"));
+		}
+	}
+
+	this -> horizon_maps = horizon_maps;
+
+}
+
+
+double SBGATObs::facet_azimuth(const arma::vec::fixed<3> & n, const arma::vec::fixed<3> & dir){
+
+	arma::vec::fixed<3> axis = {0,0,0};
+	axis(arma::abs(n).index_min()) = 1;
+	arma::vec::fixed<3> t1 = arma::normalise(arma::cross(n,axis));
+	arma::vec::fixed<3> t2 = arma::cross(n,t1);
 
-		// The KD tree of the considered body is aligned with the axes of the B frame 
-		// the center of mass of the considered body is not necessarily at (0,0,0) so this offset must be accounted for
+	double azimuth = std::atan2(arma::dot(dir,t2),arma::dot(dir,t1));
+	return azimuth < 0 ? azimuth + 2 * arma::datum::pi : azimuth;
 
-		arma::vec start_point_inertial = BN_dcms_vec[origin_body_index].t() * (start_point_origin_body - this -> center_of_mass_vec[origin_body_index]) + positions_vec[origin_body_index];
-		arma::vec start_point_considered = BN_dcms_vec[considered_body_index] *  (start_point_inertial - positions_vec[considered_body_index]) + this -> center_of_mass_vec[considered_body_index];
-		arma::vec end_point_considered = BN_dcms_vec[considered_body_index] *  (end_point_inertial - positions_vec[considered_body_index]) + this -> center_of_mass_vec[considered_body_index];
+}
+
+
+bool SBGATObs::is_above_horizon(const int body_index,
+	const int facet_index,
+	const arma::vec::fixed<3> & n,
+	const arma::vec::fixed<3> & dir) const{
 
+	double elevation = std::asin(std::max(-1.,std::min(1.,arma::dot(n,dir))));
+
+	if (elevation <= 0){
+		return false;
+	}
 
+	// The horizon elevation is interpolated between the centers of the two nearest azimuth bins
+	const arma::mat & horizon_map = this -> horizon_maps[body_index];
+	int N_azimuth = horizon_map.n_rows;
 
-		vtkSmartPointer<vtkIdList> cellIds = vtkSmartPointer<vtkIdList>::New();
-		vtkSmartPointer<vtkPoints> verts = vtkSmartPointer<vtkPoints>::New();
+	double x = SBGATObs::facet_azimuth(n,dir) / (2 * arma::datum::pi) * N_azimuth - 0.5;
+	double x_floor = std::floor(x);
+	double weight = x - x_floor;
+	int bin_before = (static_cast<int>(x_floor) + N_azimuth) % N_azimuth;
+	int bin_after = (bin_before + 1) % N_azimuth;
+
+	double horizon = (1 - weight) * horizon_map(bin_before,facet_index) + weight * horizon_map(bin_after,facet_index);
+
+	return elevation > horizon;
+
+}
+
+
+// Reverses the order of the bits of a 32-bit integer
+static unsigned int reverse_bits(unsigned int x){
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+void SBGATObs::sample_facet(const unsigned long long stream,
+	const int sample,
+	const int N_samples,
+	double & u,
+	double & v) const{
+
+	switch (this -> sampling_method){
+
+		case StratifiedSampling:{
+
+			// The unit square is divided in a m x m grid, each cell receiving one jittered sample. 
+			// The samples in excess of m^2 are drawn at random
+			int m = static_cast<int>(std::sqrt(static_cast<double>(N_samples)));
+			while ((m + 1) * (m + 1) <= N_samples){
+				++m;
+			}
 
-		 // Checking if the considered line is intercepted by any of the considered bodies
-		this -> bspTree_vec[considered_body_index] -> IntersectWithLine(start_point_considered.colptr(0), 
-			end_point_considered.colptr(0), tol, verts, cellIds);
+			SBGATObs::draw_uniforms(this -> seed,stream,sample,u,v);
 
-		if (verts -> GetNumberOfPoints() > 0){
-			return true;
+			if (sample < m * m){
+				u = ((sample % m) + u) / m;
+				v = ((sample / m) + v) / m;
+			}
+			break;
+		}
+
+		case SobolSampling:{
+
+			// The first two dimensions of the Sobol sequence are the van der Corput sequence
+			// and the sequence generated by the Pascal matrix. Each facet's sequence is randomized 
+			// by a digital shift, which preserves its stratification
+			double shift_u,shift_v;
+			SBGATObs::draw_uniforms(this -> seed,stream,0,shift_u,shift_v);
+
+			unsigned int index = static_cast<unsigned int>(sample);
+			unsigned int x = reverse_bits(index);
+			unsigned int y = 0;
+			for (unsigned int direction = 1u << 31; index != 0; index >>= 1, direction ^= direction >> 1){
+				if (index & 1u){
+					y ^= direction;
+				}
+			}
+
+			x ^= static_cast<unsigned int>(shift_u * 4294967296.0);
+			y ^= static_cast<unsigned int>(shift_v * 4294967296.0);
+
+			u = x * (1.0 / 4294967296.0);
+			v = y * (1.0 / 4294967296.0);
+			break;
+		}
+
+		case CentroidQuadrature:{
+			u = 4. / 9;
+			v = 0.5;
+			break;
 		}
 
+		default:{
+			SBGATObs::draw_uniforms(this -> seed,stream,sample,u,v);
+			break;
+		}
+	}
+
+}
+
+int SBGATObs::get_number_of_rays(const int N_samples, double & ray_weight) const{
+
+	int N_rays = N_samples;
+	if (this -> sampling_method == CentroidQuadrature){
+		N_rays = std::min(N_samples,1);
 	}
 
-	return false;
+	ray_weight = N_rays > 0 ? static_cast<double>(N_samples) / N_rays : 0;
+	return N_rays;
+
+}
 
+unsigned long long SBGATObs::sampling_stream(const unsigned long long collection_index,
+	const int body_index,
+	const int facet_index) const{
+	return ((collection_index * this -> number_of_bodies + body_index) << 32) + static_cast<unsigned long long>(facet_index);
 }
 
 
@@ -30,6 +30,7 @@
 #include <vtkPNGWriter.h>
 #include <vtkImageCast.h>
 #include <vtkPointData.h>
+#include <algorithm>
 
 #include <boost/progress.hpp>
 
@@ -65,19 +66,81 @@ void SBGATObsLightcurve::CollectMeasurements(
     throw(std::runtime_error("Incompatible input dimensions"));
 
 
-// Containers
-  std::vector<std::vector<int> > facets_in_view;
-  std::vector<arma::mat> BN_dcms_vec ;
+  std::array<double, 2>  measurements_temp;
+  measurements_temp[0] = time;
+
+  this -> collect_epoch(measurements_temp,N,sun_dir,observer_dir,
+    positions_vec,mrps_vec,penalize_indicence,this -> collection_index++,this -> facets_in_view);
+
+  measurements.push_back(measurements_temp);
+
+}
+
+
+void SBGATObsLightcurve::CollectMeasurementsSequence(
+  std::vector<std::array<double, 2> > & measurements,
+  const std::vector<double> & times,
+  const int & N,
+  const arma::vec & sun_dir,
+  const arma::vec & observer_dir,
+  const std::vector<std::vector<arma::vec> > & positions_vecs,
+  const std::vector<std::vector<arma::vec> > & velocities_vecs,
+  const std::vector<std::vector<arma::vec> > & mrps_vecs,
+  const std::vector<std::vector<arma::vec> > & omegas_vecs,
+  const bool & penalize_indicence){
+
+  int N_epochs = static_cast<int>(times.size());
+
+  this -> check_epochs_dimensions("SBGATObsLightcurve::CollectMeasurementsSequence",N_epochs,
+    positions_vecs,velocities_vecs,mrps_vecs,omegas_vecs);
 
+  // Each epoch is assigned the collection index it would have had if collected serially
+  int first = static_cast<int>(measurements.size());
+  unsigned long long first_collection_index = this -> collection_index;
+  this -> collection_index += N_epochs;
 
+  measurements.resize(first + N_epochs);
+
+  // The epochs are distributed across threads, sharing the bodies' hierarchies. 
+  // A single epoch is parallelized over its facets instead. 
+  // Each thread reuses its list of facets in view from one epoch to the next
+  #pragma omp parallel if (N_epochs > 1)
+  {
+    FacetsInView facets_in_view;
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < N_epochs; ++t){
+      measurements[first + t][0] = times[t];
+      this -> collect_epoch(measurements[first + t],N,sun_dir,observer_dir,
+        positions_vecs[t],mrps_vecs[t],penalize_indicence,first_collection_index + t,facets_in_view);
+    }
+  }
+
+}
+
+
+void SBGATObsLightcurve::collect_epoch(std::array<double, 2> & measurement,
+  const int N,
+  const arma::vec & sun_dir,
+  const arma::vec & observer_dir,
+  const std::vector<arma::vec> & positions_vec,
+  const std::vector<arma::vec> & mrps_vec,
+  const bool penalize_indicence,
+  const unsigned long long collection_index,
+  FacetsInView & facets_in_view) const{
+
+  // Containers
+  std::vector<arma::mat> BN_dcms_vec ;
 
   // Pre-allocating for all inputs  
   for (int i = 0; i < this -> number_of_bodies; ++i){
-    facets_in_view.push_back(std::vector<int>());
     BN_dcms_vec.push_back(RBK::mrp_to_dcm(mrps_vec[i]));
   }
 
-
+  if (this -> raster_resolution > 0){
+    measurement[1] = this -> rasterized_luminosity(N,sun_dir,observer_dir,penalize_indicence,BN_dcms_vec,positions_vec);
+    return;
+  }
 
   // First, only facets that are in view of the sun
   // and the observer (based on their normal orientation) are kept
@@ -86,39 +149,83 @@ void SBGATObsLightcurve::CollectMeasurements(
 
   std::vector<arma::vec> dir_to_check_vec = {observer_dir,sun_dir};
 
+  this -> prefind_facets_inview(dir_to_check_vec,BN_dcms_vec,facets_in_view);
 
-  for (int i = 0; i < this -> number_of_bodies; ++i){
-
-    this -> prefind_facets_inview(facets_in_view[i],
-      i,
-      dir_to_check_vec,
-      BN_dcms_vec,
-      positions_vec);
-  }
-
-
-  std::array<double, 2>  measurements_temp;
-  measurements_temp[0] = time;
-  measurements_temp[1] = 0;
+  measurement[1] = 0;
 
-  this -> reverse_ray_trace(measurements_temp,
-    facets_in_view,
+  this -> reverse_ray_trace(measurement,
+    facets_in_view.bodies,
+    facets_in_view.facets,
     sun_dir,
     observer_dir,
     N,
     penalize_indicence,
     BN_dcms_vec,
-    positions_vec);
+    positions_vec,
+    collection_index);
 
+}
 
-  measurements.push_back(measurements_temp);
 
+double SBGATObsLightcurve::rasterized_luminosity(const int N,
+  const arma::vec & sun_dir,
+  const arma::vec & observer_dir,
+  const bool penalize_indicence,
+  const std::vector<arma::mat> & BN_dcms_vec,
+  const std::vector<arma::vec> & positions_vec) const{
+
+  std::vector<std::array<double,9> > vertices;
+  std::vector<int> bodies;
+  this -> gather_inertial_facets(BN_dcms_vec,positions_vec,vertices,bodies);
 
-}
+  DepthBuffer observer_buffer,sun_buffer;
+  this -> rasterize(vertices,observer_dir,observer_buffer);
+  this -> rasterize(vertices,sun_dir,sun_buffer);
+
+  // Each pixel stands for the surface it sees, which the sampler would have covered with 
+  // N / min_area samples per unit area. The returns are weighed accordingly so that both 
+  // visibility engines yield the same luminosity
+  double pixel_area = observer_buffer.pixel_size * observer_buffer.pixel_size;
+  double samples_density = N / this -> min_area;
+  double luminosity = 0;
 
+  for (int pixel = 0; pixel < static_cast<int>(observer_buffer.facet.size()); ++pixel){
 
+    int f = observer_buffer.facet[pixel];
+    if (f < 0){
+      continue;
+    }
+
+    const std::array<double,9> & facet_vertices = vertices[f];
+    arma::vec::fixed<3> P0 = {facet_vertices[0],facet_vertices[1],facet_vertices[2]};
+    arma::vec::fixed<3> P1 = {facet_vertices[3],facet_vertices[4],facet_vertices[5]};
+    arma::vec::fixed<3> P2 = {facet_vertices[6],facet_vertices[7],facet_vertices[8]};
+    arma::vec::fixed<3> n = arma::normalise(arma::cross(P1 - P0, P2 - P0));
+
+    double cosi_sun = arma::dot(n,sun_buffer.dir);
+    double cosi_obs = arma::dot(n,observer_buffer.dir);
+
+    if (cosi_sun < 0 || cosi_obs <= 0){
+      continue;
+    }
 
+    if (!SBGATObs::is_seen(sun_buffer,SBGATObs::get_pixel_point(observer_buffer,pixel),cosi_sun)){
+      continue;
+    }
 
+    // The pixel covers a surface of pixel_area / cosi_obs
+    if (penalize_indicence){
+      luminosity += samples_density * pixel_area * cosi_sun;
+    }
+    else{
+      luminosity += samples_density * pixel_area / cosi_obs;
+    }
+
+  }
+
+  return luminosity;
+
+}
 
 
 void SBGATObsLightcurve::SaveLightCurveData(const std::vector<std::array<double, 2> > & measurements,
@@ -159,106 +266,127 @@ void SBGATObsLightcurve::PrintSelf(std::ostream& os, vtkIndent indent){
 }
 
 void SBGATObsLightcurve::reverse_ray_trace(std::array<double, 2>  & measurements_temp,
-  const std::vector<std::vector<int> > & facets_in_view,
+  const std::vector<int> & bodies,
+  const std::vector<int> & facets,
   const arma::vec & sun_dir,
   const arma::vec & observer_dir,
   const int N,
   const bool penalize_indicence,
   const std::vector<arma::mat> & BN_dcms_vec,
-  const std::vector<arma::vec> & positions_vec){
+  const std::vector<arma::vec> & positions_vec,
+  const unsigned long long collection_index) const{
 
 
-  
-
   // The sun is positionned with respect to the primary 
-  arma::vec observer_pos = this -> center_of_mass_vec[0] + this -> polydata_vec[0] -> GetLength() * 1E6 * observer_dir;
-  arma::vec sun_pos = this -> center_of_mass_vec[0] + this -> polydata_vec[0] -> GetLength() * 1E6 * sun_dir;
+  arma::vec::fixed<3> observer_pos = this -> center_of_mass_vec[0] + this -> reference_length * 1E6 * observer_dir;
+  arma::vec::fixed<3> sun_pos = this -> center_of_mass_vec[0] + this -> reference_length * 1E6 * sun_dir;
 
   // Ray-tracing tolerance
-  double tol = this -> polydata_vec[0] -> GetLength()/1E6;
-
+  double tol = this -> reference_length/1E6;
 
+  // The relative placement of the bodies is evaluated once for all the traced lines
+  OcclusionScene scene;
+  this -> build_occlusion_scene(BN_dcms_vec,positions_vec,scene);
 
+  // The facets are split in a fixed number of chunks, independent of the number of threads, 
+  // each summing its own returns. The chunks are then summed in order
+  int N_facets = static_cast<int>(facets.size());
+  int N_chunks = std::min(N_facets,256);
+  std::vector<double> chunk_luminosities(N_chunks,0);
+  const int packet_size = SBGATTriangleBVH::PacketSize;
 
+  // With horizon maps, only the shadowing between distinct bodies is ray-traced
+  const bool self_shadowing_from_maps = this -> HasHorizonMaps();
 
-  for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+  #pragma omp parallel for schedule(dynamic)
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
 
-    vtkPolyData * input = this -> polydata_vec[body_index];
+    int first = static_cast<int>(static_cast<long>(chunk) * N_facets / N_chunks);
+    int last = static_cast<int>(static_cast<long>(chunk + 1) * N_facets / N_chunks);
 
-    vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
-    ptIds -> Allocate(VTK_CELL_SIZE);
+    // The kept facets are then sampled and reverse ray-traced
+    for (int facet_index = first; facet_index < last; ++facet_index){
 
-    arma::vec::fixed<3> target_to_sun_dir_body_frame = BN_dcms_vec[body_index] * sun_dir;
-    arma::vec::fixed<3> target_to_observer_dir_body_frame = BN_dcms_vec[body_index] * observer_dir;
+      int body_index = bodies[facet_index];
+      const std::array<double,9> & facet_vertices = this -> facet_vertices_vec[body_index][facets[facet_index]];
 
+      arma::vec::fixed<3> P0 = {facet_vertices[0],facet_vertices[1],facet_vertices[2]};
+      arma::vec::fixed<3> P1 = {facet_vertices[3],facet_vertices[4],facet_vertices[5]};
+      arma::vec::fixed<3> P2 = {facet_vertices[6],facet_vertices[7],facet_vertices[8]};
 
-  // The kept facets are then sampled and reverse ray-traced
-    for (unsigned int facet_index = 0; facet_index != facets_in_view[body_index].size(); ++facet_index){
+      arma::vec::fixed<3> target_to_sun_dir_body_frame = BN_dcms_vec[body_index] * sun_dir;
+      arma::vec::fixed<3> target_to_observer_dir_body_frame = BN_dcms_vec[body_index] * observer_dir;
 
-      double p0[3];
-      double p1[3];
-      double p2[3];
+      arma::vec::fixed<3> n = this -> facet_normals_vec[body_index].col(facets[facet_index]);
 
-      input -> GetCellPoints(facets_in_view[body_index][facet_index],ptIds);
-      input -> GetPoint(ptIds->GetId(0), p0);
-      input -> GetPoint(ptIds->GetId(1), p1);
-      input -> GetPoint(ptIds->GetId(2), p2);
+      // The number of points sampled from this facet is determined based on 
+      // the relative size of this facet compared to the largest one in all the considered shapes
+      int N_samples = int( N * this -> facet_areas_vec[body_index](facets[facet_index]) / this -> min_area);
 
-      arma::vec::fixed<3> P0 = {p0[0],p0[1],p0[2]};
-      arma::vec::fixed<3> P1 = {p1[0],p1[1],p1[2]};
-      arma::vec::fixed<3> P2 = {p2[0],p2[1],p2[2]};
-
-      arma::vec::fixed<3> n = arma::cross(P1 - P0, P2 - P0);
-
-    // The number of points sampled from this facet is determined based on 
-    // the relative size of this facet compared to the largest one in all the considered shapes
-      int N_samples = int( N * arma::norm(n /2) / this -> min_area);
-
-    // only need unit normal vector from here
-      n = arma::normalise(arma::cross(P1 - P0, P2 - P0));
+      // If available, the horizon map of this facet tells whether it is shadowed by its own body
+      if (self_shadowing_from_maps && !(this -> is_above_horizon(body_index,facets[facet_index],n,target_to_sun_dir_body_frame)
+        && this -> is_above_horizon(body_index,facets[facet_index],n,target_to_observer_dir_body_frame))){
+        continue;
+      }
 
       double cosi_sun,cosi_obs ;
 
-    // Computing the ray incidence at impact if needed
+      // Computing the ray incidence at impact if needed
       if (penalize_indicence){
-        cosi_sun = vtkMath::Dot(n.colptr(0),target_to_sun_dir_body_frame.colptr(0));
-        cosi_obs = vtkMath::Dot(n.colptr(0),target_to_observer_dir_body_frame.colptr(0));
+        cosi_sun = arma::dot(n,target_to_sun_dir_body_frame);
+        cosi_obs = arma::dot(n,target_to_observer_dir_body_frame);
       }
       else{
         cosi_sun = 1;
         cosi_obs = 1;
       }
 
-    // A maximum of N points are sampled from this facet
-    // #pragma omp parallel for
-      for (int i = 0; i < N_samples; ++i){
+      unsigned long long stream = this -> sampling_stream(collection_index,body_index,facets[facet_index]);
 
+      double ray_weight;
+      int N_rays = this -> get_number_of_rays(N_samples,ray_weight);
 
-      // A random origin point is uniformly drawn from this facet
-        arma::vec random = arma::randu<arma::vec>(2);
-        double u = random(0);
-        double v = random(1);
-        arma::vec::fixed<3> origin = (1 - std::sqrt(u)) * P0 + std::sqrt(u) * ( 1 - v ) * P1 + std::sqrt(u) * v * P2 ;
+      // The samples are ray-traced to the sun and to the observer by packets of coherent rays
+      for (int first_sample = 0; first_sample < N_rays; first_sample += packet_size){
 
-    // Derived points are expressed in the body reference frame
-      arma::vec point_above_surface = origin + 3 * tol * n; // the origin of the ray is moved 3*tol above the surface
-      
-      bool has_intersected = (this -> check_line_for_intersect(body_index,point_above_surface,sun_pos,BN_dcms_vec,positions_vec,tol)
-        + this -> check_line_for_intersect(body_index,point_above_surface,observer_pos,BN_dcms_vec,positions_vec,tol));
+        int n_lines = std::min(N_rays - first_sample,packet_size);
 
-      // If this point was not obscured, the return is weighed by the incidence on the inbound and outbout rays
-      if (!has_intersected){
-        measurements_temp[1] += cosi_sun * cosi_obs;
-      }
+        double points_above_surface[3 * SBGATTriangleBVH::PacketSize];
+        bool has_intersected[SBGATTriangleBVH::PacketSize];
 
+        for (int l = 0; l < n_lines; ++l){
 
-    }
-  }
+          // An origin point is drawn from this facet
+          double u,v;
+          this -> sample_facet(stream,first_sample + l,N_samples,u,v);
 
-}
+          // Derived points are expressed in the body reference frame
+          for (int j = 0; j < 3; ++j){
+            double origin = (1 - std::sqrt(u)) * P0(j) + std::sqrt(u) * ( 1 - v ) * P1(j) + std::sqrt(u) * v * P2(j);
+            points_above_surface[3 * l + j] = origin + 3 * tol * n(j); // the origin of the ray is moved 3*tol above the surface
+          }
 
+          has_intersected[l] = false;
+        }
 
+        // Rays shadowed from the sun are not traced to the observer
+        this -> check_lines_for_intersect(body_index,points_above_surface,n_lines,sun_pos,scene,tol,has_intersected,self_shadowing_from_maps);
+        this -> check_lines_for_intersect(body_index,points_above_surface,n_lines,observer_pos,scene,tol,has_intersected,self_shadowing_from_maps);
 
+        // If this point was not obscured, the return is weighed by the incidence on the inbound and outbout rays
+        for (int l = 0; l < n_lines; ++l){
+          if (!has_intersected[l]){
+            chunk_luminosities[chunk] += ray_weight * cosi_sun * cosi_obs;
+          }
+        }
+
+      }
+    }
+  }
+
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
+    measurements_temp[1] += chunk_luminosities[chunk];
+  }
 
 }
 
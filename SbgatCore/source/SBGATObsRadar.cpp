@@ -48,6 +48,8 @@ SOFTWARE.
 #include <vtkPNGWriter.h>
 #include <vtkImageCast.h>
 #include <vtkPointData.h>
+#include <algorithm>
+#include <limits>
 
 #include <boost/progress.hpp>
 
@@ -80,17 +82,196 @@ void SBGATObsRadar::CollectMeasurements(SBGATRadarObsSequence & measurements_seq
   if(positions_vec.size() != omegas_vec.size() || positions_vec.size() != velocities_vec.size()|| positions_vec.size() != mrps_vec.size())
     throw(std::runtime_error("Incompatible input dimensions"));
 
+  measurements_sequence.push_back(std::vector<std::array<double, 3> >());
+
+  this -> collect_epoch(measurements_sequence.back(),N,radar_dir,
+    positions_vec,velocities_vec,mrps_vec,omegas_vec,penalize_indicence,this -> collection_index++,this -> facets_in_view);
+
+}
+
+
+void SBGATObsRadar::CollectMeasurementsSequence(SBGATRadarObsSequence & measurements_sequence,  
+  const std::vector<double> & times,
+  const int & N,
+  const arma::vec & radar_dir,
+  const std::vector<std::vector<arma::vec> > & positions_vecs,
+  const std::vector<std::vector<arma::vec> > & velocities_vecs,
+  const std::vector<std::vector<arma::vec> > & mrps_vecs,
+  const std::vector<std::vector<arma::vec> > & omegas_vecs,
+  const bool & penalize_indicence){
+
+  int N_epochs = static_cast<int>(times.size());
+
+  this -> check_epochs_dimensions("SBGATObsRadar::CollectMeasurementsSequence",N_epochs,
+    positions_vecs,velocities_vecs,mrps_vecs,omegas_vecs);
+
+  // Each epoch is assigned the collection index it would have had if collected serially
+  int first = static_cast<int>(measurements_sequence.size());
+  unsigned long long first_collection_index = this -> collection_index;
+  this -> collection_index += N_epochs;
+
+  measurements_sequence.resize(first + N_epochs);
+
+  // The epochs are distributed across threads, sharing the bodies' hierarchies. 
+  // A single epoch is parallelized over its facets instead. 
+  // Each thread reuses its list of facets in view from one epoch to the next
+  #pragma omp parallel if (N_epochs > 1)
+  {
+    FacetsInView facets_in_view;
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < N_epochs; ++t){
+      this -> collect_epoch(measurements_sequence[first + t],N,radar_dir,
+        positions_vecs[t],velocities_vecs[t],mrps_vecs[t],omegas_vecs[t],penalize_indicence,first_collection_index + t,facets_in_view);
+    }
+  }
+
+}
+
+
+void SBGATObsRadar::CollectImages(const std::vector<double> & times,
+  const int & N,
+  const arma::vec & radar_dir,
+  const std::vector<std::vector<arma::vec> > & positions_vecs,
+  const std::vector<std::vector<arma::vec> > & velocities_vecs,
+  const std::vector<std::vector<arma::vec> > & mrps_vecs,
+  const std::vector<std::vector<arma::vec> > & omegas_vecs,
+  const bool & penalize_indicence,
+  const double & r_bin,
+  const double & rr_bin,
+  const int & n_bin_r,
+  const int & n_bin_rr){
+
+  if (r_bin <= 0 || rr_bin <= 0){
+    throw(std::runtime_error("In SBGATObsRadar::CollectImages: bin sizes must be positive, not " + std::to_string(r_bin) + " and " + std::to_string(rr_bin)));
+  }
+
+  if (n_bin_r <= 0 || n_bin_rr <= 0){
+    throw(std::runtime_error("In SBGATObsRadar::CollectImages: bin counts must be positive, not " + std::to_string(n_bin_r) + " and " + std::to_string(n_bin_rr)));
+  }
+
+  int N_epochs = static_cast<int>(times.size());
+
+  this -> check_epochs_dimensions("SBGATObsRadar::CollectImages",N_epochs,
+    positions_vecs,velocities_vecs,mrps_vecs,omegas_vecs);
+
+  // Each epoch is assigned the collection index it would have had if collected serially
+  unsigned long long first_collection_index = this -> collection_index;
+  this -> collection_index += N_epochs;
+
+  // The container holding the images is pre-allocated
+  this -> images.clear();
+  for (int i = 0; i < N_epochs; ++i){
+    this -> images.push_back(vtkSmartPointer<vtkImageData>::New());
+    this -> images[i] -> SetExtent(0, n_bin_rr - 1, 0, n_bin_r - 1, 0, 0);
+    this -> images[i] -> AllocateScalars(VTK_DOUBLE, 1);
+  }
+
+  // The radar is positionned with respect to the primary 
+  arma::vec::fixed<3> radar_pos = this -> center_of_mass_vec[0] + this -> reference_length * 1E6 * radar_dir;
+
+  std::vector<double> max_values(N_epochs);
+
+  // The epochs are distributed across threads, sharing the bodies' hierarchies. 
+  // A single epoch is parallelized over its facets instead
+  #pragma omp parallel if (N_epochs > 1)
+  {
+    FacetsInView facets_in_view;
+    std::vector<std::array<double, 3> > measurements;
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < N_epochs; ++t){
+
+      double * dPtr = static_cast<double *>(this -> images[t] -> GetScalarPointer(0, 0, 0));
+      std::fill(dPtr,dPtr + n_bin_r * n_bin_rr,0.);
+
+      // The image is centered on the range and range-rate of the primary's center of mass
+      arma::vec::fixed<3> relative_position = positions_vecs[t][0] - radar_pos;
+      double range = arma::norm(relative_position);
+      double range_rate = arma::dot(relative_position,velocities_vecs[t][0]) / range;
+
+      RadarImageWindow window;
+      window.r_bin = r_bin;
+      window.rr_bin = rr_bin;
+      window.n_bin_r = n_bin_r;
+      window.n_bin_rr = n_bin_rr;
+      window.max_range = range * this -> scaleFactor + n_bin_r * r_bin / 2;
+      window.max_range_rate = range_rate * this -> scaleFactor + n_bin_rr * rr_bin / 2;
+
+      this -> collect_epoch(measurements,N,radar_dir,
+        positions_vecs[t],velocities_vecs[t],mrps_vecs[t],omegas_vecs[t],penalize_indicence,first_collection_index + t,
+        facets_in_view,&window,dPtr);
+
+      // The maximum image value is extracted
+      max_values[t] = *std::max_element(dPtr,dPtr + n_bin_r * n_bin_rr);
+    }
+  }
+
+  this -> max_value = -1;
+  for (int i = 0; i < N_epochs; ++i){
+    this -> max_value = std::max(this -> max_value,max_values[i]);
+  }
+
+}
+
+
+bool SBGATObsRadar::locate_bin(const RadarImageWindow & window,
+  const double range,
+  const double range_rate,
+  int & bin){
+
+  // Flipping the image, consistently with BinObservations
+  double row = std::floor((window.max_range - range) / window.r_bin);
+  double col = std::floor((window.max_range_rate - range_rate) / window.rr_bin);
+
+  if (row < 0 || row >= window.n_bin_r || col < 0 || col >= window.n_bin_rr){
+    return false;
+  }
+
+  bin = static_cast<int>(col) + static_cast<int>(row) * window.n_bin_rr;
+  return true;
+
+}
+
+
+void SBGATObsRadar::collect_epoch(std::vector<std::array<double, 3> > & measurements,
+  const int N,
+  const arma::vec & radar_dir,
+  const std::vector<arma::vec> & positions_vec,
+  const std::vector<arma::vec> & velocities_vec,
+  const std::vector<arma::vec> & mrps_vec,
+  const std::vector<arma::vec> & omegas_vec,
+  const bool penalize_indicence,
+  const unsigned long long collection_index,
+  FacetsInView & facets_in_view,
+  const RadarImageWindow * window,
+  double * image) const{
 
   // Containers
-  std::vector<std::vector<int> > facets_in_view;
   std::vector<arma::mat> BN_dcms_vec ;
 
   // Pre-allocating for all inputs  
   for (int i = 0; i < this -> number_of_bodies; ++i){
-    facets_in_view.push_back(std::vector<int>());
     BN_dcms_vec.push_back(RBK::mrp_to_dcm(mrps_vec[i]));
   }
 
+  if (this -> raster_resolution > 0){
+    this -> rasterized_measurements(measurements,N,radar_dir,penalize_indicence,
+      BN_dcms_vec,positions_vec,velocities_vec,omegas_vec);
+
+    // The rasterized returns, at most one per pixel, are binned in the image
+    if (window != nullptr){
+      for (const auto & measurement : measurements){
+        int bin;
+        if (SBGATObsRadar::locate_bin(*window,measurement[0] * this -> scaleFactor,measurement[1] * this -> scaleFactor,bin)){
+          image[bin] += measurement[2];
+        }
+      }
+      measurements.clear();
+    }
+    return;
+  }
+
 
   // First, only facets that are in view of the radar (based on their normal orientation) are kept
   // Then, the facets that are potentially in view are ray-traced to the observer,
@@ -98,225 +279,392 @@ void SBGATObsRadar::CollectMeasurements(SBGATRadarObsSequence & measurements_seq
 
   std::vector<arma::vec> dir_to_check_vec = {radar_dir};
 
-  for (int i = 0; i < this -> number_of_bodies; ++i){
-    this -> prefind_facets_inview(facets_in_view[i],i,dir_to_check_vec,BN_dcms_vec,positions_vec);
-  }
-
-
-  // The vector holding the kept-facets is initialized
-  std::vector<std::array<double, 3> > measurements_temp;
-  
-  this -> reverse_ray_trace(measurements_sequence,facets_in_view,radar_dir,N,penalize_indicence,
-    BN_dcms_vec,positions_vec,velocities_vec,omegas_vec);
-
+  this -> prefind_facets_inview(dir_to_check_vec,BN_dcms_vec,facets_in_view);
 
+  this -> reverse_ray_trace(measurements,facets_in_view.bodies,facets_in_view.facets,radar_dir,N,penalize_indicence,
+    BN_dcms_vec,positions_vec,velocities_vec,omegas_vec,collection_index,window,image);
 
 }
 
 
-void SBGATObsRadar::reverse_ray_trace(SBGATRadarObsSequence & measurements_sequence,
-  const std::vector<std::vector<int> > & facets_in_view,
+void SBGATObsRadar::reverse_ray_trace(std::vector<std::array<double, 3> > & measurements,
+  const std::vector<int> & bodies,
+  const std::vector<int> & facets,
   const arma::vec & radar_dir,
   const int N,
   const bool penalize_indicence,
   const std::vector<arma::mat> & BN_dcms_vec,
   const std::vector<arma::vec> & positions_vec,
   const std::vector<arma::vec> & velocities_vec,
-  const std::vector<arma::vec> & omegas_vec){
-
-  std::vector<std::array<double, 3> > measurements;
+  const std::vector<arma::vec> & omegas_vec,
+  const unsigned long long collection_index,
+  const RadarImageWindow * window,
+  double * image) const{
 
   // Ray-tracing tolerance
-  double tol = this -> polydata_vec[0] -> GetLength()/1E6;
+  double tol = this -> reference_length/1E6;
+
+  // The relative placement of the bodies is evaluated once for all the traced lines
+  OcclusionScene scene;
+  this -> build_occlusion_scene(BN_dcms_vec,positions_vec,scene);
 
   // The radar is positionned with respect to the primary 
-  arma::vec radar_pos = this -> center_of_mass_vec[0] + this -> polydata_vec[0] -> GetLength() * 1E6 * radar_dir;
+  arma::vec::fixed<3> radar_pos = this -> center_of_mass_vec[0] + this -> reference_length * 1E6 * radar_dir;
+
+  // The facets are split in a fixed number of chunks, independent of the number of threads, 
+  // each collecting its own measurements. The chunks are then merged in order. 
+  // When an image window is provided, the measurements are directly binned in at most 16 image tiles 
+  // instead, each accumulating a fixed subset of the chunks. The tiles are then summed in order
+  int N_facets = static_cast<int>(facets.size());
+  int N_chunks = std::min(N_facets,256);
+  int N_tiles = window == nullptr ? N_chunks : std::min(N_chunks,16);
+  int N_bins = window == nullptr ? 0 : window -> n_bin_r * window -> n_bin_rr;
+  std::vector<std::vector<std::array<double, 3> > > chunk_measurements(window == nullptr ? N_chunks : 0);
+  std::vector<std::vector<double> > tiles(window == nullptr ? 0 : N_tiles);
+  const int packet_size = SBGATTriangleBVH::PacketSize;
+
+  // With horizon maps, only the shadowing between distinct bodies is ray-traced
+  const bool self_shadowing_from_maps = this -> HasHorizonMaps();
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < N_tiles; ++tile){
+
+    if (window != nullptr){
+      tiles[tile].assign(N_bins,0);
+    }
 
-  for (int body_index = 0; body_index < this -> number_of_bodies; ++body_index){
+    for (int chunk = tile; chunk < N_chunks; chunk += N_tiles){
 
-    vtkPolyData * input = this -> polydata_vec[body_index];
+      int first = static_cast<int>(static_cast<long>(chunk) * N_facets / N_chunks);
+      int last = static_cast<int>(static_cast<long>(chunk + 1) * N_facets / N_chunks);
 
-    vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
-    ptIds -> Allocate(VTK_CELL_SIZE);
+      // The kept facets are then sampled and reverse ray-traced
+      for (int facet_index = first; facet_index < last; ++facet_index){
 
-    arma::vec target_to_radar_dir_body_frame = BN_dcms_vec[body_index] * radar_dir;
+        int body_index = bodies[facet_index];
+        const std::array<double,9> & facet_vertices = this -> facet_vertices_vec[body_index][facets[facet_index]];
 
+        arma::vec::fixed<3> P0 = {facet_vertices[0],facet_vertices[1],facet_vertices[2]};
+        arma::vec::fixed<3> P1 = {facet_vertices[3],facet_vertices[4],facet_vertices[5]};
+        arma::vec::fixed<3> P2 = {facet_vertices[6],facet_vertices[7],facet_vertices[8]};
 
-  // The kept facets are then sampled and reverse ray-traced
-    for (unsigned int facet_index = 0; facet_index != facets_in_view[body_index].size(); ++facet_index){
+        arma::vec::fixed<3> target_to_radar_dir_body_frame = BN_dcms_vec[body_index] * radar_dir;
 
-      double p0[3];
-      double p1[3];
-      double p2[3];
+        arma::vec::fixed<3> n = this -> facet_normals_vec[body_index].col(facets[facet_index]);
 
-      input -> GetCellPoints(facets_in_view[body_index][facet_index],ptIds);
-      input -> GetPoint(ptIds->GetId(0), p0);
-      input -> GetPoint(ptIds->GetId(1), p1);
-      input -> GetPoint(ptIds->GetId(2), p2);
+        // The number of points sampled from this facet is determined based on 
+        // the relative size of this facet compared to the largest one in all the considered shapes
+        int N_samples = int( N * this -> facet_areas_vec[body_index](facets[facet_index]) / this -> min_area);
 
-      arma::vec P0 = {p0[0],p0[1],p0[2]};
-      arma::vec P1 = {p1[0],p1[1],p1[2]};
-      arma::vec P2 = {p2[0],p2[1],p2[2]};
+        // If available, the horizon map of this facet tells whether it is shadowed by its own body
+        if (self_shadowing_from_maps && !this -> is_above_horizon(body_index,facets[facet_index],n,target_to_radar_dir_body_frame)){
+          continue;
+        }
 
-      arma::vec n = arma::cross(P1 - P0, P2 - P0);
+        double cosi_radar ;
 
-    // The number of points sampled from this facet is determined based on 
-    // the relative size of this facet compared to the largest one in all the considered shapes
-      int N_samples = int( N * arma::norm(n /2) / this -> min_area);
+        // Computing the ray incidence at impact if needed
+        if (penalize_indicence){
+          cosi_radar = arma::dot(n,target_to_radar_dir_body_frame);
+        }
+        else{
+          cosi_radar = 1;
+        }
 
-    // only need unit normal vector from here
-      n = arma::normalise(arma::cross(P1 - P0, P2 - P0));
+        unsigned long long stream = this -> sampling_stream(collection_index,body_index,facets[facet_index]);
 
-      double cosi_radar ;
+        double ray_weight;
+        int N_rays = this -> get_number_of_rays(N_samples,ray_weight);
 
-    // Computing the ray incidence at impact if needed
-      if (penalize_indicence){
-        cosi_radar = vtkMath::Dot(n.colptr(0),target_to_radar_dir_body_frame.colptr(0));
-      }
-      else{
-        cosi_radar = 1;
-      }
+        // The samples are ray-traced to the radar by packets of coherent rays
+        for (int first_sample = 0; first_sample < N_rays; first_sample += packet_size){
 
-    // A maximum of N points are sampled from this facet
-    // #pragma omp parallel for
-      for (int i = 0; i < N_samples; ++i){
+          int n_lines = std::min(N_rays - first_sample,packet_size);
 
-      // A random origin point is uniformly drawn from this facet
-        arma::vec random = arma::randu<arma::vec>(2);
-        double u = random(0);
-        double v = random(1);
-        arma::vec origin = (1 - std::sqrt(u)) * P0 + std::sqrt(u) * ( 1 - v ) * P1 + std::sqrt(u) * v * P2 ;
+          double origins[3 * SBGATTriangleBVH::PacketSize];
+          double points_above_surface[3 * SBGATTriangleBVH::PacketSize];
+          bool has_intersected[SBGATTriangleBVH::PacketSize];
 
-      arma::vec point_above_surface = origin + 3 * tol * n; // the origin of the ray is moved 3*tol above the surface
+          for (int l = 0; l < n_lines; ++l){
 
-      bool has_intersected = this -> check_line_for_intersect(body_index,point_above_surface,radar_pos,BN_dcms_vec,positions_vec,tol);
+            // An origin point is drawn from this facet
+            double u,v;
+            this -> sample_facet(stream,first_sample + l,N_samples,u,v);
 
-      // If this point was not obscured, the return is weighed by the incidence on the inbound and outbout rays
+            for (int j = 0; j < 3; ++j){
+              origins[3 * l + j] = (1 - std::sqrt(u)) * P0(j) + std::sqrt(u) * ( 1 - v ) * P1(j) + std::sqrt(u) * v * P2(j);
+              points_above_surface[3 * l + j] = origins[3 * l + j] + 3 * tol * n(j); // the origin of the ray is moved 3*tol above the surface
+            }
 
-      if (!has_intersected){
+            has_intersected[l] = false;
+          }
 
-        // origin is the sampled point, expressed in the body reference frame
-        // Its actual position should be in the inertial frame, accounting for the assigned position of the body
+          this -> check_lines_for_intersect(body_index,points_above_surface,n_lines,radar_pos,scene,tol,has_intersected,self_shadowing_from_maps);
 
-        arma::vec origin_cm = BN_dcms_vec[body_index].t() * (origin - this -> center_of_mass_vec[body_index]);
-        arma::vec origin_inertial = origin_cm + positions_vec[body_index];
+          for (int l = 0; l < n_lines; ++l){
 
-        // Range
-        double range = arma::norm(origin_inertial - radar_pos);
+            // If this point was not obscured, the return is weighed by the incidence on the inbound and outbout rays
+            if (!has_intersected[l]){
 
-        // The velocity at the impact point is a combination of the orbital and rotational velocities
-        arma::vec velocity = velocities_vec[body_index] + arma::cross(omegas_vec[body_index],origin_cm);
-        
-        double range_rate = arma::dot(origin_inertial - radar_pos,velocity) / range;
+              arma::vec::fixed<3> origin = {origins[3 * l],origins[3 * l + 1],origins[3 * l + 2]};
 
-        std::array<double, 3> measurement = {{range,range_rate,std::pow(cosi_radar,2)}};
-        measurements.push_back(measurement);
+              // origin is the sampled point, expressed in the body reference frame
+              // Its actual position should be in the inertial frame, accounting for the assigned position of the body
+              arma::vec::fixed<3> origin_cm = BN_dcms_vec[body_index].t() * (origin - this -> center_of_mass_vec[body_index]);
+              arma::vec::fixed<3> origin_inertial = origin_cm + positions_vec[body_index];
+
+              // Range
+              double range = arma::norm(origin_inertial - radar_pos);
+
+              // The velocity at the impact point is a combination of the orbital and rotational velocities
+              arma::vec::fixed<3> velocity = velocities_vec[body_index] + arma::cross(omegas_vec[body_index],origin_cm);
+
+              double range_rate = arma::dot(origin_inertial - radar_pos,velocity) / range;
+
+              if (window == nullptr){
+                std::array<double, 3> measurement = {{range,range_rate,ray_weight * std::pow(cosi_radar,2)}};
+                chunk_measurements[chunk].push_back(measurement);
+              }
+              else{
+                int bin;
+                if (SBGATObsRadar::locate_bin(*window,range * this -> scaleFactor,range_rate * this -> scaleFactor,bin)){
+                  tiles[tile][bin] += ray_weight * std::pow(cosi_radar,2);
+                }
+              }
+            }
+          }
+
+        }
       }
+    }
+  }
 
+  measurements.clear();
 
+  if (window == nullptr){
+    for (int chunk = 0; chunk < N_chunks; ++chunk){
+      measurements.insert(measurements.end(),chunk_measurements[chunk].begin(),chunk_measurements[chunk].end());
+    }
+  }
+  else{
+    #pragma omp parallel for
+    for (int k = 0; k < N_bins; ++k){
+      double value = 0;
+      for (int tile = 0; tile < N_tiles; ++tile){
+        value += tiles[tile][k];
+      }
+      image[k] += value;
     }
   }
+
 }
 
-measurements_sequence.push_back(measurements);
+void SBGATObsRadar::rasterized_measurements(std::vector<std::array<double, 3> > & measurements,
+  const int N,
+  const arma::vec & radar_dir,
+  const bool penalize_indicence,
+  const std::vector<arma::mat> & BN_dcms_vec,
+  const std::vector<arma::vec> & positions_vec,
+  const std::vector<arma::vec> & velocities_vec,
+  const std::vector<arma::vec> & omegas_vec) const{
+
+  std::vector<std::array<double,9> > vertices;
+  std::vector<int> bodies;
+  this -> gather_inertial_facets(BN_dcms_vec,positions_vec,vertices,bodies);
+
+  DepthBuffer radar_buffer;
+  this -> rasterize(vertices,radar_dir,radar_buffer);
+
+  // The radar is positionned with respect to the primary 
+  arma::vec::fixed<3> radar_pos = this -> center_of_mass_vec[0] + this -> reference_length * 1E6 * radar_dir;
+
+  // Each pixel stands for the surface it sees, which the sampler would have covered with 
+  // N / min_area samples per unit area. The returns are weighed accordingly so that both 
+  // visibility engines yield the same images
+  double pixel_area = radar_buffer.pixel_size * radar_buffer.pixel_size;
+  double samples_density = N / this -> min_area;
+
+  measurements.clear();
+
+  for (int pixel = 0; pixel < static_cast<int>(radar_buffer.facet.size()); ++pixel){
+
+    int f = radar_buffer.facet[pixel];
+    if (f < 0){
+      continue;
+    }
+
+    int body_index = bodies[f];
+    const std::array<double,9> & facet_vertices = vertices[f];
+    arma::vec::fixed<3> P0 = {facet_vertices[0],facet_vertices[1],facet_vertices[2]};
+    arma::vec::fixed<3> P1 = {facet_vertices[3],facet_vertices[4],facet_vertices[5]};
+    arma::vec::fixed<3> P2 = {facet_vertices[6],facet_vertices[7],facet_vertices[8]};
+
+    double cosi_radar = arma::dot(arma::normalise(arma::cross(P1 - P0, P2 - P0)),radar_buffer.dir);
+
+    if (cosi_radar <= 0){
+      continue;
+    }
+
+    arma::vec::fixed<3> origin_inertial = SBGATObs::get_pixel_point(radar_buffer,pixel);
+    arma::vec::fixed<3> origin_cm = origin_inertial - positions_vec[body_index];
+
+    // Range
+    double range = arma::norm(origin_inertial - radar_pos);
+
+    // The velocity at the impact point is a combination of the orbital and rotational velocities
+    arma::vec::fixed<3> velocity = velocities_vec[body_index] + arma::cross(omegas_vec[body_index],origin_cm);
+
+    double range_rate = arma::dot(origin_inertial - radar_pos,velocity) / range;
+
+    // The pixel covers a surface of pixel_area / cosi_radar
+    double weight;
+    if (penalize_indicence){
+      weight = samples_density * pixel_area * cosi_radar;
+    }
+    else{
+      weight = samples_density * pixel_area / cosi_radar;
+    }
+
+    std::array<double, 3> measurement = {{range,range_rate,weight}};
+    measurements.push_back(measurement);
+
+  }
 
 }
 
+
 void SBGATObsRadar::BinObservations(
   const SBGATRadarObsSequence & measurements_sequence,
   const double & r_bin,
   const double & rr_bin){
 
-  // The container holding the images is pre-allocated
-  this -> images.clear();
-  this -> max_value = -1;
+  if (r_bin <= 0 || rr_bin <= 0){
+    throw(std::runtime_error("In SBGATObsRadar::BinObservations: bin sizes must be positive, not " + std::to_string(r_bin) + " and " + std::to_string(rr_bin)));
+  }
 
-  for (unsigned int i = 0; i < measurements_sequence.size(); ++i){
+  int N_images = static_cast<int>(measurements_sequence.size());
+
+  // The extent of each image is found in a single pass over its measurements, 
+  // converted to meters so as to be consistent with the bin sizes
+  std::vector<double> max_ranges(N_images,-std::numeric_limits<double>::infinity());
+  std::vector<double> min_ranges(N_images,std::numeric_limits<double>::infinity());
+  std::vector<double> max_range_rates(N_images,-std::numeric_limits<double>::infinity());
+  std::vector<double> min_range_rates(N_images,std::numeric_limits<double>::infinity());
+
+  #pragma omp parallel for if (N_images > 1)
+  for (int i = 0; i < N_images; ++i){
+    for (const auto & measurement : measurements_sequence[i]){
+      max_ranges[i] = std::max(max_ranges[i],measurement[0] * this -> scaleFactor);
+      min_ranges[i] = std::min(min_ranges[i],measurement[0] * this -> scaleFactor);
+      max_range_rates[i] = std::max(max_range_rates[i],measurement[1] * this -> scaleFactor);
+      min_range_rates[i] = std::min(min_range_rates[i],measurement[1] * this -> scaleFactor);
+    }
+  }
 
-    auto measurements = measurements_sequence[i];
+  // The bin counts are determined from the specified bin sizes and data extent
+  std::vector<int> n_bins_r(N_images);
+  std::vector<int> n_bins_rr(N_images);
 
-    this -> images.push_back(vtkSmartPointer<vtkImageData>::New());
+  for (int i = 0; i < N_images; ++i){
 
-  // Using arma::vec to get statistics
-    arma::vec ranges(measurements.size());
-    arma::vec range_rates(measurements.size());
+    n_bins_r[i] = measurements_sequence[i].empty() ? 0 : (int)((max_ranges[i] - min_ranges[i]) / r_bin);
+    n_bins_rr[i] = measurements_sequence[i].empty() ? 0 : (int)((max_range_rates[i] - min_range_rates[i]) / rr_bin);
 
-    for (unsigned int i = 0; i < measurements.size(); ++i){
-      ranges(i) = measurements[i][0];
-      range_rates(i) = measurements[i][1];
+    // Checking if one dimension is "empty" (i.e has zero bins)
+    if (n_bins_r[i] == 0 || n_bins_rr[i] == 0){
+      throw(std::runtime_error("The prescribed bin sizes yielded " + std::to_string(n_bins_r[i]) + " range bins and " + std::to_string(n_bins_rr[i]) + " range-rate bins. "));
     }
 
-  // Subtracting the mean range
-    ranges -= arma::mean(ranges);
+  }
 
-  // The extent of the data is extracted
-    double r_extent = std::abs(ranges.max() - ranges.min()) * this -> scaleFactor;
-    double rr_extent = std::abs(range_rates.max() - range_rates.min()) * this -> scaleFactor;
+  // The container holding the images is pre-allocated
+  this -> images.clear();
+  for (int i = 0; i < N_images; ++i){
+    this -> images.push_back(vtkSmartPointer<vtkImageData>::New());
+    this -> images[i] -> SetExtent(0, n_bins_rr[i] - 1, 0, n_bins_r[i] - 1, 0, 0);
+    this -> images[i] -> AllocateScalars(VTK_DOUBLE, 1);
+  }
 
+  // The images are formed by "binning in" the measurements. When there is a single image, 
+  // the binning is parallelized over its measurements instead
+  std::vector<double> max_values(N_images);
 
-  // The bin counts are determined from the specified bin sizes and data extent
-    int n_bin_r = (int)(r_extent / r_bin);
-    int n_bin_rr = (int)(rr_extent / rr_bin);
+  #pragma omp parallel for schedule(dynamic) if (N_images > 1)
+  for (int i = 0; i < N_images; ++i){
 
-    // Checking if one dimension is "empty" (i.e has zero bins)
-    if (n_bin_r == 0 || n_bin_rr == 0){
-      throw(std::runtime_error("The prescribed bin sizes yielded " + std::to_string(n_bin_r) + " range bins and " + std::to_string(n_bin_rr) + " range-rate bins. "));
-    }
+    double * dPtr = static_cast<double *>(this -> images[i] -> GetScalarPointer(0, 0, 0));
 
-    // The image is formed by "binning in" the measurements
+    this -> bin_measurements(measurements_sequence[i],
+      max_ranges[i],
+      max_range_rates[i],
+      r_bin,
+      rr_bin,
+      n_bins_r[i],
+      n_bins_rr[i],
+      dPtr);
 
-    this -> images[i] -> SetExtent(0, n_bin_rr - 1, 0, n_bin_r - 1, 0, 0);
-    this -> images[i] -> AllocateScalars(VTK_DOUBLE, 1);
+    // The maximum image value is extracted
+    max_values[i] = *std::max_element(dPtr,dPtr + n_bins_r[i] * n_bins_rr[i]);
 
-    double *dPtr = static_cast<double *>(this -> images[i]->GetScalarPointer(0, 0, 0));
+  }
 
-    // The image is initialized 
-    #pragma omp parallel for
-    for (int row = 0; row < n_bin_r; ++row){
-      for (int col = 0; col < n_bin_rr; ++col){
-        int k = col + row * n_bin_rr;
-        dPtr[k] = 0;
-      }
-    }
+  this -> max_value = -1;
+  for (int i = 0; i < N_images; ++i){
+    this -> max_value = std::max(this -> max_value,max_values[i]);
+  }
 
+}
 
-    double max_range = ranges.max();
-    double max_range_rate = range_rates.max();
 
-    // The histogram is built
-    #pragma omp parallel for
-    for (unsigned int mes = 0; mes < measurements.size(); ++mes){
+void SBGATObsRadar::bin_measurements(const std::vector<std::array<double, 3> > & measurements,
+  const double max_range,
+  const double max_range_rate,
+  const double r_bin,
+  const double rr_bin,
+  const int n_bin_r,
+  const int n_bin_rr,
+  double * histogram) const{
 
-      // Flipping the image
-      int row = int( ( - ranges(mes) +  max_range)/ r_bin );
-      int col = int( ( - range_rates(mes) + max_range_rate )/ rr_bin );
+  int N_mes = static_cast<int>(measurements.size());
+  int N_bins = n_bin_r * n_bin_rr;
 
-      // The last bin is inclusive
-      if (row == n_bin_r){
-        --row;
-      }
-      if (col == n_bin_rr){
-        --col;
-      }
+  // Each chunk holds at least 4096 measurements, and at most 16 private histograms are allocated
+  int N_chunks = std::max(1,std::min(16,N_mes / 4096));
+  std::vector<std::vector<double> > chunk_histograms(N_chunks);
 
-      int k = col + row * n_bin_rr;
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
+
+    std::vector<double> & chunk_histogram = chunk_histograms[chunk];
+    chunk_histogram.assign(N_bins,0);
+
+    int first = static_cast<int>(static_cast<long>(chunk) * N_mes / N_chunks);
+    int last = static_cast<int>(static_cast<long>(chunk + 1) * N_mes / N_chunks);
+
+    for (int mes = first; mes < last; ++mes){
+
+      // Flipping the image. The last bin is inclusive
+      int row = std::min(int( ( max_range - measurements[mes][0] * this -> scaleFactor ) / r_bin ),n_bin_r - 1);
+      int col = std::min(int( ( max_range_rate - measurements[mes][1] * this -> scaleFactor ) / rr_bin ),n_bin_rr - 1);
 
       // Adding the cosine of the incidence 
       // If the incidence is 0 then measurements[mes][2] == 1. 
       // if the incidence is 90 deg then measurements[mes][2] == 0
       // if the incidence is not used then measurements[mes][2] == 1 always
-      dPtr[k] += measurements[mes][2];
+      chunk_histogram[col + row * n_bin_rr] += measurements[mes][2];
 
     }
+  }
 
-    // The maximum image value is extracted
-    vtkDataArray * scalars = this -> images[i] -> GetPointData() -> GetScalars();
-
-    for (vtkIdType tupleIdx = 0; tupleIdx < scalars -> GetNumberOfTuples(); ++tupleIdx){
-     this -> max_value = std::max(max_value,scalars -> GetTuple1(tupleIdx));
-   }
-
- }
+  // The private histograms are summed in order
+  #pragma omp parallel for
+  for (int k = 0; k < N_bins; ++k){
+    double value = 0;
+    for (int chunk = 0; chunk < N_chunks; ++chunk){
+      value += chunk_histograms[chunk][k];
+    }
+    histogram[k] = value;
+  }
 
 }
 
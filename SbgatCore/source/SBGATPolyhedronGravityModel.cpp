@@ -44,18 +44,14 @@ SOFTWARE.
 #include <vtkSmartPointer.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
-#include <vtkPolyDataNormals.h>
 #include <RigidBodyKinematics.hpp>
 #include <vtkDoubleArray.h>
-#include <vtkFloatArray.h>
 #include <vtkCellData.h>
-#include <vtkExtractEdges.h>
 #include <vtkCellArray.h>
 #include <vtkPoints.h>
 #include <vtkCleanPolyData.h>
 #include <json.hpp>
 
-#include <vtkLine.h>
 #include <set>
 #include <vtkMath.h>
 #include <array>
@@ -104,13 +100,10 @@ int SBGATPolyhedronGravityModel::RequestData(
   	// call ExecuteData
 	vtkPolyData * input_unclean = vtkPolyData::SafeDownCast(inInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-	vtkSmartPointer<vtkCleanPolyData> cleaner =
-	vtkSmartPointer<vtkCleanPolyData>::New();
-	cleaner -> SetInputData (input_unclean);
-	cleaner -> SetOutputPointsPrecision	( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
-	cleaner -> Update();
-
-	vtkPolyData * input = cleaner -> GetOutput();
+	// The cleaned shape and its mass properties are shared with the other filters 
+	// processing the same shape
+	this -> mass_properties = SBGATMassProperties::GetSharedMassProperties(input_unclean,this -> scaleFactor == 1);
+	vtkPolyData * input = this -> mass_properties -> GetCleanedShape();
 
 	vtkIdType cellId, numCells, numPts, numIds;
 
@@ -138,20 +131,16 @@ int SBGATPolyhedronGravityModel::RequestData(
 
 	} 
 
-    // Generate normals
-	vtkSmartPointer<vtkPolyDataNormals> normalGenerator = vtkSmartPointer<vtkPolyDataNormals>::New();
-
-	normalGenerator->SetInputData(input);
-	normalGenerator->ComputePointNormalsOff();
-	normalGenerator->ComputeCellNormalsOn();
-	normalGenerator->Update();
+	// The facet normals and edges are computed along with the shared mass properties
+	const arma::mat & normals = this -> mass_properties -> GetCleanedShapeFacetNormals();
+	const std::vector<std::array<vtkIdType,4> > & edge_points_ids_facet_ids = this -> mass_properties -> GetCleanedShapeEdges();
+	unsigned int edge_count = edge_points_ids_facet_ids.size();
 
-	vtkPolyData * input_with_normals = normalGenerator -> GetOutput();
-	
-	// Required by vtkPolyData::GetPointCells	
-	input -> BuildLinks();
-
-	vtkFloatArray * normals =  vtkFloatArray::SafeDownCast(input_with_normals->GetCellData()->GetArray("Normals"));
+	for (unsigned int i = 0; i < edge_count; ++i){
+		if (edge_points_ids_facet_ids[i][2] < 0){
+			throw(std::runtime_error("In SBGATPolyhedronGravityModel.cpp: every edge should border exactly 2 facets"));
+		}
+	}
 	
 	// Any data previously owned is erased
 	this -> Clear();
@@ -185,8 +174,7 @@ int SBGATPolyhedronGravityModel::RequestData(
 		input -> GetCellPoints(i,ptIds);
 
 
-		double normal[3];
-		normals -> GetTuple(i,normal);
+		const double * normal = normals.colptr(i);
 		this -> facet_dyads[i][0] = normal[0] * normal[0];
 		this -> facet_dyads[i][1] = normal[0] * normal[1];
 		this -> facet_dyads[i][2] = normal[0] * normal[2];
@@ -205,45 +193,6 @@ int SBGATPolyhedronGravityModel::RequestData(
 
 	}
 
-	// The edges are extracted
-	vtkSmartPointer<vtkExtractEdges> extractEdges = vtkSmartPointer<vtkExtractEdges>::New();
-	extractEdges -> SetInputData(input);
-	extractEdges -> Update();
-
-	unsigned int edge_count = extractEdges -> GetOutput() -> GetNumberOfCells();
-	std::vector<std::array<vtkIdType,4>> edge_points_ids_facet_ids(edge_count);
-
-	// Should get rid of this map and use a vector instead
-	// This loop cannot be parallelized since GetPointCells is 
-	// not thread-safe
-	for(vtkIdType i = 0; i < edge_count; i++){
-
-		vtkSmartPointer<vtkLine> line = vtkLine::SafeDownCast(extractEdges->GetOutput()->GetCell(i));
-		edge_points_ids_facet_ids[i][0] = line->GetPointIds()->GetId(0);
-		edge_points_ids_facet_ids[i][1] = line->GetPointIds()->GetId(1);
-
-		// We need to find the facets forming this edge
-		vtkSmartPointer<vtkIdList> facet_ids_point_1 = vtkSmartPointer<vtkIdList>::New();
-		vtkSmartPointer<vtkIdList> facet_ids_point_2 = vtkSmartPointer<vtkIdList>::New();
-
-		input -> GetPointCells	(	edge_points_ids_facet_ids[i][0],facet_ids_point_1 );
-		input -> GetPointCells	(	edge_points_ids_facet_ids[i][1],facet_ids_point_2 );
-
-
-
-		// Now, we find the two facet indices showing up in both facet_ids_point_1 and facet_ids_point_2
-		facet_ids_point_1 -> IntersectWith	(	facet_ids_point_2	)	;
-
-		if (facet_ids_point_1 -> GetNumberOfIds() != 2){
-			throw(std::runtime_error("In SBGATPolyhedronGravityModel.cpp: the intersection of the facet id lists should have exactly 2 items, not " + std::to_string(facet_ids_point_1 -> GetNumberOfIds())));
-		}
-
-		edge_points_ids_facet_ids[i][2] = facet_ids_point_1->GetId(0);
-		edge_points_ids_facet_ids[i][3] = facet_ids_point_1->GetId(1);
-		
-	}
-
-
 	// The edges dyads are created
 	this -> edge_dyads = new double * [edge_points_ids_facet_ids.size()];
 	this -> edges = new int * [edge_points_ids_facet_ids.size()];
@@ -328,10 +277,6 @@ int SBGATPolyhedronGravityModel::RequestData(
 	this -> N_edges = edge_count;
 	this -> N_facets = numCells;
 
-	this -> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
-	this -> mass_properties -> SetInputData(input);
-	this -> mass_properties -> Update();
-
 	// Check that the Euler characteristic == 2
 	assert (input -> GetNumberOfPoints() - edge_count + numCells == 2);
 
@@ -486,73 +431,222 @@ void SBGATPolyhedronGravityModel::GetPotentialAcceleration(double const  * point
 	#pragma omp parallel for reduction(+:acc_x,acc_y,acc_z,pot)
 	for (vtkIdType facet_index = 0; facet_index < this -> N_facets; ++ facet_index) {
 
-		double * r0 = this -> vertices[this -> facets[facet_index][0]];
-		
-		double r0m[3];
+		double pot_f;
+		double acc_f[3];
 
-		vtkMath::Subtract(r0,point_scaled,r0m);
-		
-		double wf = this -> GetOmegaf( point_scaled, facet_index);
+		SBGATPolyhedronGravityModel::GetFacetPotentialAcceleration(point_scaled,
+			this -> vertices[this -> facets[facet_index][0]],
+			this -> vertices[this -> facets[facet_index][1]],
+			this -> vertices[this -> facets[facet_index][2]],
+			this -> facet_dyads[facet_index],pot_f,acc_f);
 
-		double * F = this -> facet_dyads[facet_index];
+		acc_x += acc_f[0];
+		acc_y += acc_f[1];
+		acc_z += acc_f[2];
 
+		pot += pot_f;
 
-		double a[3] = {
-			F[0] * r0m[0] + F[1] * r0m[1] +  F[2] * r0m[2],
-			F[3] * r0m[0] + F[4] * r0m[1] +  F[5] * r0m[2],
-			F[6] * r0m[0] + F[7] * r0m[1] +  F[8] * r0m[2]
-		};
+	}
 
-		acc_x += wf * a[0];
-		acc_y += wf * a[1];
-		acc_z += wf * a[2];
+	// Edge loop
+	#pragma omp parallel for reduction(+:acc_x,acc_y,acc_z,pot)
+	for (int edge_index = 0; edge_index < this -> N_edges; ++ edge_index) {
+
+		double pot_e;
+		double acc_e[3];
 
-		pot += - wf * vtkMath::Dot(r0m,a);
+		SBGATPolyhedronGravityModel::GetEdgePotentialAcceleration(point_scaled,
+			this -> vertices[this -> edges[edge_index][0]],
+			this -> vertices[this -> edges[edge_index][1]],
+			this -> edge_dyads[edge_index],pot_e,acc_e);
 
+		acc_x += acc_e[0];
+		acc_y += acc_e[1];
+		acc_z += acc_e[2];
+
+		pot += pot_e;
 
 	}
 
-	// Edge loop
-	#pragma omp parallel for reduction(-:acc_x,acc_y,acc_z,pot)
-	for (int edge_index = 0; edge_index < this -> N_edges; ++ edge_index) {
+	acc(0) = acc_x;
+	acc(1) = acc_y;
+	acc(2) = acc_z;
 
-		double * r0 = this -> vertices[this -> edges[edge_index][0]];
+	acc *= arma::datum::G  * this -> density* this -> scaleFactor ;
+	pot *= 0.5 * arma::datum::G * this -> density* this -> scaleFactor* this -> scaleFactor ;
 
-		
-		double r0m[3];
-		
-		vtkMath::Subtract(r0,point_scaled,r0m);
-		
-		
-		double Le = this -> GetLe( point_scaled, edge_index);
+	potential = pot;
 
-		double * E = this -> edge_dyads[edge_index];
+}
 
-		double a[3] = {
-			E[0] * r0m[0] + E[1] * r0m[1] +  E[2] * r0m[2],
-			E[3] * r0m[0] + E[4] * r0m[1] +  E[5] * r0m[2],
-			E[6] * r0m[0] + E[7] * r0m[1] +  E[8] * r0m[2]
-		};
+void SBGATPolyhedronGravityModel::GetPotentialAccelerationFromDyads(const double * point,
+	const std::vector<double> & vertices,
+	const std::vector<int> & facets,
+	const std::vector<int> & edges,
+	const std::vector<double> & facet_dyads,
+	const std::vector<double> & edge_dyads,
+	double & potential,
+	arma::vec::fixed<3> & acc){
 
+	int N_f = facets.size() / 3;
+	int N_e = edges.size() / 2;
 
-		pot += Le * vtkMath::Dot(r0m,a);
+	double pot = 0;
+	double acc_x = 0;
+	double acc_y = 0;
+	double acc_z = 0;
 
+	// Facet loop
+	for (int f = 0; f < N_f; ++f){
 
+		double pot_f;
+		double acc_f[3];
 
-		acc_x -= Le * a[0];
-		acc_y -= Le * a[1];
-		acc_z -= Le * a[2];
+		SBGATPolyhedronGravityModel::GetFacetPotentialAcceleration(point,
+			vertices.data() + 3 * facets[3 * f],
+			vertices.data() + 3 * facets[3 * f + 1],
+			vertices.data() + 3 * facets[3 * f + 2],
+			facet_dyads.data() + 9 * f,pot_f,acc_f);
+
+		acc_x += acc_f[0];
+		acc_y += acc_f[1];
+		acc_z += acc_f[2];
+
+		pot += pot_f;
+
+	}
+
+	// Edge loop
+	for (int e = 0; e < N_e; ++e){
+
+		double pot_e;
+		double acc_e[3];
+
+		SBGATPolyhedronGravityModel::GetEdgePotentialAcceleration(point,
+			vertices.data() + 3 * edges[2 * e],
+			vertices.data() + 3 * edges[2 * e + 1],
+			edge_dyads.data() + 9 * e,pot_e,acc_e);
+
+		acc_x += acc_e[0];
+		acc_y += acc_e[1];
+		acc_z += acc_e[2];
+
+		pot += pot_e;
 
 	}
 
+	potential = pot;
 	acc(0) = acc_x;
 	acc(1) = acc_y;
 	acc(2) = acc_z;
 
-	acc *= arma::datum::G  * this -> density* this -> scaleFactor ;
-	pot *= 0.5 * arma::datum::G * this -> density* this -> scaleFactor* this -> scaleFactor ;
+}
+
+void SBGATPolyhedronGravityModel::GetPotentialAccelerationFromDyads(const double * point,
+	const std::vector<double> & vertices,
+	const std::vector<int> & facets,
+	const std::vector<int> & edges,
+	const std::vector<double> & facet_dyads,
+	const std::vector<double> & edge_dyads,
+	const std::vector<int> & facet_ids,
+	const std::vector<int> & edge_ids,
+	double & potential,
+	arma::vec::fixed<3> & acc){
+
+	double pot = 0;
+	double acc_x = 0;
+	double acc_y = 0;
+	double acc_z = 0;
+
+	// Facet loop
+	for (auto f : facet_ids){
+
+		double pot_f;
+		double acc_f[3];
+
+		SBGATPolyhedronGravityModel::GetFacetPotentialAcceleration(point,
+			vertices.data() + 3 * facets[3 * f],
+			vertices.data() + 3 * facets[3 * f + 1],
+			vertices.data() + 3 * facets[3 * f + 2],
+			facet_dyads.data() + 9 * f,pot_f,acc_f);
+
+		acc_x += acc_f[0];
+		acc_y += acc_f[1];
+		acc_z += acc_f[2];
+
+		pot += pot_f;
+
+	}
+
+	// Edge loop
+	for (auto e : edge_ids){
+
+		double pot_e;
+		double acc_e[3];
+
+		SBGATPolyhedronGravityModel::GetEdgePotentialAcceleration(point,
+			vertices.data() + 3 * edges[2 * e],
+			vertices.data() + 3 * edges[2 * e + 1],
+			edge_dyads.data() + 9 * e,pot_e,acc_e);
+
+		acc_x += acc_e[0];
+		acc_y += acc_e[1];
+		acc_z += acc_e[2];
+
+		pot += pot_e;
+
+	}
 
 	potential = pot;
+	acc(0) = acc_x;
+	acc(1) = acc_y;
+	acc(2) = acc_z;
+
+}
+
+void SBGATPolyhedronGravityModel::GetFacetPotentialAcceleration(const double * pos,const double * r0,const double * r1,const double * r2,
+	const double * F,double & pot,double * acc){
+
+	double r0m[3];
+
+	vtkMath::Subtract(r0,pos,r0m);
+
+	double wf = SBGATPolyhedronGravityModel::GetOmegaf(pos,r0,r1,r2);
+
+	double a[3] = {
+		F[0] * r0m[0] + F[1] * r0m[1] +  F[2] * r0m[2],
+		F[3] * r0m[0] + F[4] * r0m[1] +  F[5] * r0m[2],
+		F[6] * r0m[0] + F[7] * r0m[1] +  F[8] * r0m[2]
+	};
+
+	acc[0] = wf * a[0];
+	acc[1] = wf * a[1];
+	acc[2] = wf * a[2];
+
+	pot = - wf * vtkMath::Dot(r0m,a);
+
+}
+
+void SBGATPolyhedronGravityModel::GetEdgePotentialAcceleration(const double * pos,const double * r0,const double * r1,
+	const double * E,double & pot,double * acc){
+
+	double r0m[3];
+
+	vtkMath::Subtract(r0,pos,r0m);
+
+	double Le = SBGATPolyhedronGravityModel::GetLe(pos,r0,r1);
+
+	double a[3] = {
+		E[0] * r0m[0] + E[1] * r0m[1] +  E[2] * r0m[2],
+		E[3] * r0m[0] + E[4] * r0m[1] +  E[5] * r0m[2],
+		E[6] * r0m[0] + E[7] * r0m[1] +  E[8] * r0m[2]
+	};
+
+	acc[0] = - Le * a[0];
+	acc[1] = - Le * a[1];
+	acc[2] = - Le * a[2];
+
+	pot = Le * vtkMath::Dot(r0m,a);
 
 }
 
@@ -799,20 +893,17 @@ void SBGATPolyhedronGravityModel::ComputeSurfacePGM(
 	pgm_filter -> SetInputData(selected_shape);
 	pgm_filter -> SetDensity(density);
 
-	vtkSmartPointer<SBGATMassProperties> mass_prop = vtkSmartPointer<SBGATMassProperties>::New();
-	mass_prop -> SetInputData(selected_shape);
-
 	if (is_in_meters){
 		pgm_filter -> SetScaleMeters();
-		mass_prop -> SetScaleMeters();
 	}
 	else{
 		pgm_filter -> SetScaleKiloMeters();
-		mass_prop -> SetScaleKiloMeters();
 	}
 
 	pgm_filter -> Update();
-	mass_prop -> Update();
+
+	// Shared with pgm_filter
+	vtkSmartPointer<SBGATMassProperties> mass_prop = SBGATMassProperties::GetSharedMassProperties(selected_shape,is_in_meters);
 
 	slopes.clear();
 	inertial_potentials.clear();
@@ -1119,9 +1210,14 @@ double SBGATPolyhedronGravityModel::GetOmegaf(const arma::vec::fixed<3> & pos, c
 
 double SBGATPolyhedronGravityModel::GetOmegaf( const double * pos, const int & f) const{
 
-	const double * r0 = this -> vertices[this -> facets[f][0]];
-	const double * r1 = this -> vertices[this -> facets[f][1]];
-	const double * r2 = this -> vertices[this -> facets[f][2]];
+	return SBGATPolyhedronGravityModel::GetOmegaf(pos,
+		this -> vertices[this -> facets[f][0]],
+		this -> vertices[this -> facets[f][1]],
+		this -> vertices[this -> facets[f][2]]);
+
+}
+
+double SBGATPolyhedronGravityModel::GetOmegaf(const double * pos,const double * r0,const double * r1,const double * r2){
 
 	double r0m[3];
 	double r1m[3];
@@ -1152,9 +1248,13 @@ double SBGATPolyhedronGravityModel::GetLe(const arma::vec::fixed<3> & pos, const
 
 double SBGATPolyhedronGravityModel::GetLe( const double * pos, const int & e) const{
 
-	double * r0 = this -> vertices[this -> edges[e][0]];
-	double * r1 = this -> vertices[this -> edges[e][1]];
+	return SBGATPolyhedronGravityModel::GetLe(pos,
+		this -> vertices[this -> edges[e][0]],
+		this -> vertices[this -> edges[e][1]]);
+
+}
 
+double SBGATPolyhedronGravityModel::GetLe(const double * pos,const double * r0,const double * r1){
 
 	double r0m[3];
 	double r1m[3];
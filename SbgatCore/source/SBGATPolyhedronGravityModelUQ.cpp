@@ -2,6 +2,14 @@
 #include <RigidBodyKinematics.hpp>
 #include <vtkOBJReader.h>
 #include <vtkCleanPolyData.h>
+#include <json.hpp>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <numeric>
+#include <functional>
+#include <algorithm>
+
 #pragma omp declare reduction( + : arma::rowvec : omp_out += omp_in ) \
 initializer( omp_priv = arma::zeros<arma::rowvec>(omp_orig.n_cols))
 
@@ -14,9 +22,13 @@ initializer( omp_priv = arma::zeros<arma::mat>(omp_orig.n_rows,omp_orig.n_cols))
 void SBGATPolyhedronGravityModelUQ::SetPGM(vtkSmartPointer<SBGATPolyhedronGravityModel> pgm){
 	this -> pgm_model = pgm;
 	int N_C = vtkPolyData::SafeDownCast(this -> pgm_model -> GetInput()) -> GetNumberOfPoints();
-	this -> P_CC = arma::zeros<arma::mat>(3 * N_C,3 * N_C);
 
+	// The covariance starts as an empty sparse matrix. The dense covariance 
+	// is only allocated by the first call to SetCovarianceComponent
+	this -> P_CC.reset();
 	this -> P_CC_sparse = arma::sp_mat(3 * N_C,3 * N_C);
+	this -> sparseCovariance = true;
+	this -> covarianceSquareRootSet = false;
 }
 
 
@@ -27,6 +39,10 @@ double SBGATPolyhedronGravityModelUQ::GetVariancePotential(double const * point)
 
 	arma::rowvec partial = this -> pgm_model -> GetScaleFactor() * this -> GetPartialUPartialC(point_scaled);
 
+	if (this -> sparseCovariance){
+		return arma::dot(partial, this -> P_CC_sparse * partial.t());
+	}
+
 	return arma::dot(partial, this -> P_CC * partial.t()); 
 
 }
@@ -45,6 +61,11 @@ arma::mat::fixed<3,3> SBGATPolyhedronGravityModelUQ::GetCovarianceAcceleration(d
 	vtkMath::MultiplyScalar(point_scaled,1./this -> pgm_model -> GetScaleFactor());
 
 	arma::mat partial = this -> GetPartialAPartialC(point_scaled);
+
+	if (this -> sparseCovariance){
+		return partial * this -> P_CC_sparse * partial.t();
+	}
+
 	return partial *  this -> P_CC * partial.t();
 
 }
@@ -1933,19 +1954,1238 @@ arma::mat::fixed<3,10> SBGATPolyhedronGravityModelUQ::PartialAccfPartialXf(const
 
 arma::mat SBGATPolyhedronGravityModelUQ::GetCovarianceSquareRoot() const{
 
+	if (this -> covarianceSquareRootSet){
+		if (this -> sparseSquareRoot){
+			return arma::mat(this -> C_CC_sparse);
+		}
+		return this -> C_CC;
+	}
+
+	if (this -> sparseCovariance){
+		return arma::mat(this -> ComputeSparseCholesky()) / this -> pgm_model ->  GetScaleFactor() ;
+	}
+
 	return arma::chol(this -> P_CC,"lower") / this -> pgm_model ->  GetScaleFactor() ;
 
 }
 
+arma::sp_mat SBGATPolyhedronGravityModelUQ::GetSparseCovarianceSquareRoot() const{
+
+	if (this -> covarianceSquareRootSet){
+		if (this -> sparseSquareRoot){
+			return this -> C_CC_sparse;
+		}
+		return arma::sp_mat(this -> C_CC);
+	}
+
+	if (this -> sparseCovariance){
+		return this -> ComputeSparseCholesky() / this -> pgm_model ->  GetScaleFactor() ;
+	}
+
+	return arma::sp_mat(arma::chol(this -> P_CC,"lower")) / this -> pgm_model ->  GetScaleFactor() ;
+
+}
+
+void SBGATPolyhedronGravityModelUQ::ComputeCovarianceSquareRoot(const unsigned int rank,const double energy){
+
+	if (energy <= 0 || energy > 1){
+		throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::ComputeCovarianceSquareRoot: energy must lie in ]0,1], got " + std::to_string(energy)));
+	}
+
+	double scaleFactor = this -> pgm_model -> GetScaleFactor();
+
+	this -> C_CC.reset();
+	this -> C_CC_sparse = arma::sp_mat();
+	this -> sparseSquareRoot = false;
+
+	arma::vec eigval;
+	arma::mat eigvec;
+	double trace;
+
+	if (this -> sparseCovariance){
+
+		// The full-rank factor of a sparse covariance is a sparse cholesky factor
+		if (rank == 0 && energy == 1){
+			this -> C_CC_sparse = this -> ComputeSparseCholesky() / scaleFactor;
+			this -> sparseSquareRoot = true;
+			this -> covarianceSquareRootSet = true;
+			return;
+		}
+
+		// Otherwise, the dominant eigenmodes are found iteratively. If no rank is prescribed,
+		// the number of computed modes is doubled until the requested energy is captured
+		arma::uword n = this -> P_CC_sparse.n_rows;
+		trace = arma::trace(this -> P_CC_sparse);
+		arma::uword k = std::min<arma::uword>((rank == 0) ? 64 : rank,n - 1);
+
+		while (true){
+
+			if (!arma::eigs_sym(eigval,eigvec,this -> P_CC_sparse,k)){
+				throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::ComputeCovarianceSquareRoot: iterative eigendecomposition of the shape covariance failed"));
+			}
+
+			if (rank != 0 || k == n - 1 || arma::sum(arma::clamp(eigval,0,arma::datum::inf)) >= energy * trace){
+				break;
+			}
+
+			k = std::min<arma::uword>(2 * k,n - 1);
+		}
+
+	}
+	else{
+
+		// The full-rank cholesky factor is used whenever possible
+		if (rank == 0 && energy == 1 && arma::chol(this -> C_CC,this -> P_CC,"lower")){
+			this -> C_CC /= scaleFactor;
+			this -> covarianceSquareRootSet = true;
+			return;
+		}
+
+		// Otherwise, the covariance is factored from its dominant eigenmodes
+		if (!arma::eig_sym(eigval,eigvec,this -> P_CC)){
+			throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::ComputeCovarianceSquareRoot: eigendecomposition of the shape covariance failed"));
+		}
+
+		trace = arma::sum(arma::clamp(eigval,0,arma::datum::inf));
+
+	}
+
+	arma::uvec order = arma::sort_index(eigval,"descend");
+	unsigned int max_rank = (rank == 0) ? eigval.n_rows : std::min<unsigned int>(rank,eigval.n_rows);
+
+	unsigned int n_modes = 0;
+	double captured = 0;
+
+	while (n_modes < max_rank){
+		double lambda = eigval(order(n_modes));
+		if (lambda <= 0 || captured >= energy * trace){
+			break;
+		}
+		captured += lambda;
+		++n_modes;
+	}
+
+	this -> C_CC = arma::zeros<arma::mat>(eigvec.n_rows,n_modes);
+
+	for (unsigned int k = 0; k < n_modes; ++k){
+		this -> C_CC.col(k) = std::sqrt(eigval(order(k))) * eigvec.col(order(k));
+	}
+
+	this -> C_CC /= scaleFactor;
+	this -> covarianceSquareRootSet = true;
+
+}
+
+arma::sp_mat SBGATPolyhedronGravityModelUQ::ComputeSparseCholesky() const{
+
+	vtkPolyData * polydata = vtkPolyData::SafeDownCast(this -> pgm_model -> GetInput());
+
+	const arma::sp_mat & P = this -> P_CC_sparse;
+	arma::uword n = P.n_rows;
+	int N_C = n / 3;
+
+	// Vertex adjacency graph of the covariance
+	std::vector<std::vector<int> > adjacency(N_C);
+	double max_variance = 0;
+
+	for (arma::sp_mat::const_iterator it = P.begin(); it != P.end(); ++it){
+		int u = it.row() / 3;
+		int v = it.col() / 3;
+		if (u != v){
+			adjacency[u].push_back(v);
+		}
+		else if (it.row() == it.col()){
+			max_variance = std::max(max_variance,double(*it));
+		}
+	}
+
+	for (auto & neighbors : adjacency){
+		std::sort(neighbors.begin(),neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(),neighbors.end()),neighbors.end());
+	}
+
+	// Nested dissection ordering of the vertices. Each region is split at the median 
+	// of its longest side; the vertices of the first half adjacent to the second half
+	// form the separator, which is ordered after both halves
+	std::vector<int> order;
+	order.reserve(N_C);
+	std::vector<int> side(N_C,-1);
+
+	std::function<void(const std::vector<int> &)> dissect = [&](const std::vector<int> & region){
+
+		if (region.size() <= 64){
+			order.insert(order.end(),region.begin(),region.end());
+			return;
+		}
+
+		arma::vec::fixed<3> lower = {arma::datum::inf,arma::datum::inf,arma::datum::inf};
+		arma::vec::fixed<3> upper = - lower;
+
+		for (auto v : region){
+			double r[3];
+			polydata -> GetPoint(v,r);
+			for (int k = 0; k < 3; ++k){
+				lower(k) = std::min(lower(k),r[k]);
+				upper(k) = std::max(upper(k),r[k]);
+			}
+		}
+
+		int axis = arma::index_max(upper - lower);
+
+		std::vector<std::pair<double,int> > sorted(region.size());
+		for (unsigned int i = 0; i < region.size(); ++i){
+			double r[3];
+			polydata -> GetPoint(region[i],r);
+			sorted[i] = std::make_pair(r[axis],region[i]);
+		}
+
+		unsigned int half = region.size() / 2;
+		std::nth_element(sorted.begin(),sorted.begin() + half,sorted.end());
+
+		for (unsigned int i = 0; i < sorted.size(); ++i){
+			side[sorted[i].second] = (i < half) ? 0 : 1;
+		}
+
+		std::vector<int> first,second,separator;
+
+		for (unsigned int i = 0; i < sorted.size(); ++i){
+			int v = sorted[i].second;
+			if (i >= half){
+				second.push_back(v);
+			}
+			else if (std::any_of(adjacency[v].begin(),adjacency[v].end(),[&](int u){return side[u] == 1;})){
+				separator.push_back(v);
+			}
+			else{
+				first.push_back(v);
+			}
+		}
+
+		for (auto v : region){
+			side[v] = -1;
+		}
+
+		dissect(first);
+		dissect(second);
+		order.insert(order.end(),separator.begin(),separator.end());
+
+	};
+
+	std::vector<int> all_vertices(N_C);
+	std::iota(all_vertices.begin(),all_vertices.end(),0);
+	dissect(all_vertices);
+
+	// perm[i] is the original index of the i-th permuted unknown
+	std::vector<arma::uword> perm(n);
+	std::vector<arma::uword> iperm(n);
+	for (int k = 0; k < N_C; ++k){
+		for (int q = 0; q < 3; ++q){
+			perm[3 * k + q] = 3 * order[k] + q;
+			iperm[3 * order[k] + q] = 3 * k + q;
+		}
+	}
+
+	// Lower triangle of the permuted covariance, stored by columns
+	std::vector<std::vector<std::pair<arma::uword,double> > > A(n);
+	for (arma::sp_mat::const_iterator it = P.begin(); it != P.end(); ++it){
+		arma::uword i = iperm[it.row()];
+		arma::uword j = iperm[it.col()];
+		if (i >= j){
+			A[j].push_back(std::make_pair(i,double(*it)));
+		}
+	}
+
+	// Left-looking cholesky factorization. The columns of L are stored with sorted row indices,
+	// the diagonal coming first. next[k] points to the first entry of column k below the current row and
+	// row_lists[j] holds the columns k < j such that L(j,k) != 0, which are moved down to their next
+	// non-zero row once used
+	std::vector<std::vector<arma::uword> > L_rows(n);
+	std::vector<std::vector<double> > L_values(n);
+	std::vector<std::vector<arma::uword> > row_lists(n);
+	std::vector<arma::uword> next(n,0);
+
+	std::vector<double> x(n,0);
+	std::vector<bool> marked(n,false);
+	std::vector<arma::uword> pattern;
+
+	double tol = n * arma::datum::eps * max_variance;
+
+	// Pivots more negative than roundoff can explain reveal an indefinite covariance
+	double indefinite_tol = std::sqrt(arma::datum::eps) * max_variance;
+
+	for (arma::uword j = 0; j < n; ++j){
+
+		pattern.clear();
+
+		for (auto & entry : A[j]){
+			x[entry.first] = entry.second;
+			marked[entry.first] = true;
+			pattern.push_back(entry.first);
+		}
+
+		for (auto k : row_lists[j]){
+
+			arma::uword p = next[k];
+			double L_jk = L_values[k][p];
+
+			for (arma::uword q = p; q < L_rows[k].size(); ++q){
+				arma::uword i = L_rows[k][q];
+				if (!marked[i]){
+					marked[i] = true;
+					pattern.push_back(i);
+				}
+				x[i] -= L_values[k][q] * L_jk;
+			}
+
+			++next[k];
+			if (next[k] < L_rows[k].size()){
+				row_lists[L_rows[k][next[k]]].push_back(k);
+			}
+		}
+
+		std::sort(pattern.begin(),pattern.end());
+
+		if (x[j] < - indefinite_tol){
+			throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::ComputeSparseCholesky: the covariance is not positive semi-definite (pivot " 
+				+ std::to_string(x[j]) + " for a maximum variance of " + std::to_string(max_variance) 
+				+ "). A kernel truncated at the cutoff distance is not guaranteed to be positive semi-definite: use compact_support"));
+		}
+
+		// Columns with a vanishing pivot are left empty
+		if (x[j] > tol){
+
+			double pivot = std::sqrt(x[j]);
+
+			for (auto i : pattern){
+				if (i == j || (i > j && x[i] != 0)){
+					L_rows[j].push_back(i);
+					L_values[j].push_back(x[i] / pivot);
+				}
+			}
+
+			next[j] = 1;
+			if (L_rows[j].size() > 1){
+				row_lists[L_rows[j][1]].push_back(j);
+			}
+		}
+
+		for (auto i : pattern){
+			x[i] = 0;
+			marked[i] = false;
+		}
+
+		std::vector<arma::uword>().swap(row_lists[j]);
+
+	}
+
+	// S = P^T * L, so that S * S^T = P^T * L * L^T * P = P_CC_sparse
+	arma::uword nnz = 0;
+	for (arma::uword j = 0; j < n; ++j){
+		nnz += L_rows[j].size();
+	}
+
+	arma::umat locations(2,nnz);
+	arma::vec values(nnz);
+
+	arma::uword index = 0;
+	for (arma::uword j = 0; j < n; ++j){
+		for (unsigned int q = 0; q < L_rows[j].size(); ++q){
+			locations(0,index) = perm[L_rows[j][q]];
+			locations(1,index) = j;
+			values(index) = L_values[j][q];
+			++index;
+		}
+	}
+
+	return arma::sp_mat(locations,values,n,n);
+
+}
+
 void SBGATPolyhedronGravityModelUQ::SetCovarianceComponent(const arma::mat::fixed<3,3> & P,const int & v0, const int & v1){
 
-	this -> P_CC.submat(3 * v0,3 * v1,3 * v0 + 2,3 * v1 + 2) = P * std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+	// A covariance filled block by block is stored densely, unless it was built by SetCovarianceKernel
+	if (this -> sparseCovariance && this -> P_CC_sparse.n_nonzero == 0){
+		this -> P_CC = arma::zeros<arma::mat>(this -> P_CC_sparse.n_rows,this -> P_CC_sparse.n_cols);
+		this -> sparseCovariance = false;
+	}
+
+	if (this -> sparseCovariance){
+		this -> P_CC_sparse.submat(3 * v0,3 * v1,3 * v0 + 2,3 * v1 + 2) = P * std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+	}
+	else{
+		this -> P_CC.submat(3 * v0,3 * v1,3 * v0 + 2,3 * v1 + 2) = P * std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+	}
+	this -> covarianceSquareRootSet = false;
+
+}
+
+arma::mat SBGATPolyhedronGravityModelUQ::GetCovariance() const{
+
+	if (this -> sparseCovariance){
+		return arma::mat(this -> P_CC_sparse) / std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+	}
+
+	return this -> P_CC / std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+
+}
+
+arma::sp_mat SBGATPolyhedronGravityModelUQ::GetSparseCovariance() const{
+
+	if (this -> sparseCovariance){
+		return this -> P_CC_sparse / std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+	}
+
+	return arma::sp_mat(this -> P_CC) / std::pow(this -> pgm_model ->  GetScaleFactor(),2);
+
+}
+
+void SBGATPolyhedronGravityModelUQ::SetCovarianceKernel(const double sigma,const double l,double cutoff,
+	const bool compact_support,const bool isotropic){
+
+	if (l <= 0){
+		throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::SetCovarianceKernel: the correlation distance must be positive, got " + std::to_string(l)));
+	}
+
+	if (cutoff <= 0){
+		cutoff = 3 * l;
+	}
+
+	vtkPolyData * polydata = vtkPolyData::SafeDownCast(this -> pgm_model -> GetInput());
+
+	int N_C = polydata -> GetNumberOfPoints();
+	int N_f = polydata -> GetNumberOfCells();
+
+	// Area-weighted vertex normals
+	arma::mat vertex_normals = arma::zeros<arma::mat>(3,N_C);
+
+	for (int f = 0; f < N_f; ++f){
+		int v0,v1,v2;
+		this -> pgm_model -> GetIndicesVerticesInFacet(f,v0,v1,v2);
+		arma::vec::fixed<3> n = this -> pgm_model -> GetNonNormalizedFacetNormal(f);
+		vertex_normals.col(v0) += n;
+		vertex_normals.col(v1) += n;
+		vertex_normals.col(v2) += n;
+	}
+
+	vertex_normals = arma::normalise(vertex_normals);
+
+	// Neighbors within the cutoff distance. The vertices are binned in a uniform grid whose cells 
+	// are at least as large as the cutoff, so the neighbors of a vertex lie in the 27 cells around it.
+	// The grid is only read once built, so the vertices are queried concurrently
+	arma::mat points(3,N_C);
+	for (int i = 0; i < N_C; ++i){
+		polydata -> GetPoint(i,points.colptr(i));
+	}
+
+	arma::vec::fixed<3> lower = arma::min(points,1);
+	arma::vec::fixed<3> extent = arma::max(points,1) - lower;
+
+	// The number of cells along each axis is capped so that cell keys cannot overflow
+	double cell_size = std::max(cutoff,arma::max(extent) / 1024);
+
+	unsigned long long dims[3];
+	for (int k = 0; k < 3; ++k){
+		dims[k] = static_cast<unsigned long long>(extent(k) / cell_size) + 1;
+	}
+
+	auto get_cell = [&](int i,long long * c){
+		for (int k = 0; k < 3; ++k){
+			c[k] = std::min<long long>(static_cast<long long>((points(k,i) - lower(k)) / cell_size),dims[k] - 1);
+		}
+	};
+
+	// Vertices sorted by cell key
+	std::vector<std::pair<unsigned long long,int> > cells(N_C);
+	for (int i = 0; i < N_C; ++i){
+		long long c[3];
+		get_cell(i,c);
+		cells[i] = std::make_pair((c[0] * dims[1] + c[1]) * dims[2] + c[2],i);
+	}
+	std::sort(cells.begin(),cells.end());
+
+	std::vector<std::vector<int> > neighbors(N_C);
+	double cutoff_sq = cutoff * cutoff;
+
+	#pragma omp parallel for
+	for (int i = 0; i < N_C; ++i){
+
+		long long c[3];
+		get_cell(i,c);
+
+		for (long long dx = -1; dx <= 1; ++dx){
+			for (long long dy = -1; dy <= 1; ++dy){
+				for (long long dz = -1; dz <= 1; ++dz){
+
+					long long n[3] = {c[0] + dx,c[1] + dy,c[2] + dz};
+
+					if (n[0] < 0 || n[1] < 0 || n[2] < 0 
+						|| n[0] >= static_cast<long long>(dims[0]) 
+						|| n[1] >= static_cast<long long>(dims[1]) 
+						|| n[2] >= static_cast<long long>(dims[2])){
+						continue;
+					}
+
+					unsigned long long key = (n[0] * dims[1] + n[1]) * dims[2] + n[2];
+
+					for (auto it = std::lower_bound(cells.begin(),cells.end(),std::make_pair(key,-1)); 
+						it != cells.end() && it -> first == key; ++it){
+						int j = it -> second;
+						if (arma::accu(arma::square(points.col(i) - points.col(j))) <= cutoff_sq){
+							neighbors[i].push_back(j);
+						}
+					}
+
+				}
+			}
+		}
+
+	}
+
+	// Offsets of each vertex's blocks in the batch-insertion containers. 
+	// Only the diagonal of the isotropic blocks is stored
+	int block_entries = isotropic ? 3 : 9;
+	std::vector<arma::uword> offsets(N_C + 1,0);
+	for (int i = 0; i < N_C; ++i){
+		offsets[i + 1] = offsets[i] + block_entries * neighbors[i].size();
+	}
+
+	arma::umat locations(2,offsets[N_C]);
+	arma::vec values(offsets[N_C]);
 
-	// this -> P_CC_sparse.submat(3 * v0,3 * v1,3 * v0 + 2,3 * v1 + 2) = this -> P_CC.submat(3 * v0,3 * v1,3 * v0 + 2,3 * v1 + 2);
+	double variance = std::pow(sigma * this -> pgm_model -> GetScaleFactor(),2);
 
+	#pragma omp parallel for
+	for (int i = 0; i < N_C; ++i){
+
+		double ri[3];
+		polydata -> GetPoint(i,ri);
+		arma::uword index = offsets[i];
+
+		for (auto j : neighbors[i]){
+
+			double rj[3];
+			polydata -> GetPoint(j,rj);
+			double d = std::sqrt(vtkMath::Distance2BetweenPoints(ri,rj));
+
+			double k = std::exp(- std::pow(d / l,2));
+
+			if (compact_support){
+				// Wendland C2 taper
+				double t = std::max(0.,1 - d / cutoff);
+				k *= std::pow(t,4) * (4 * d / cutoff + 1);
+			}
+
+			if (isotropic){
+				for (int q = 0; q < 3; ++q){
+					locations(0,index) = 3 * i + q;
+					locations(1,index) = 3 * j + q;
+					values(index) = variance * k;
+					++index;
+				}
+				continue;
+			}
+
+			arma::mat::fixed<3,3> block = variance * k * vertex_normals.col(i) * vertex_normals.col(j).t();
+
+			for (int q = 0; q < 3; ++q){
+				for (int r = 0; r < 3; ++r){
+					locations(0,index) = 3 * i + q;
+					locations(1,index) = 3 * j + r;
+					values(index) = block(q,r);
+					++index;
+				}
+			}
+		}
+	}
+
+	this -> P_CC_sparse = arma::sp_mat(locations,values,3 * N_C,3 * N_C);
+	this -> P_CC.reset();
+	this -> sparseCovariance = true;
+	this -> covarianceSquareRootSet = false;
 
 }
 
+void SBGATPolyhedronGravityModelUQ::GetSurfacePGMVariances(const std::vector<unsigned int> & queried_elements,
+	const arma::vec::fixed<3> & omega,
+	const arma::vec::fixed<3> & com,
+	std::vector<double> & slopes_variances,
+	std::vector<double> & inertial_potentials_variances,
+	std::vector<double> & body_fixed_potentials_variances,
+	std::vector<double> & inertial_acc_magnitudes_variances,
+	std::vector<double> & body_fixed_acc_magnitudes_variances) const{
+
+	vtkPolyData * polydata = vtkPolyData::SafeDownCast(this -> pgm_model -> GetInput());
+	int N_f = polydata -> GetNumberOfCells();
+	double scaleFactor = this -> pgm_model -> GetScaleFactor();
+
+	slopes_variances.assign(N_f,std::numeric_limits<double>::quiet_NaN());
+	inertial_potentials_variances.assign(N_f,std::numeric_limits<double>::quiet_NaN());
+	body_fixed_potentials_variances.assign(N_f,std::numeric_limits<double>::quiet_NaN());
+	inertial_acc_magnitudes_variances.assign(N_f,std::numeric_limits<double>::quiet_NaN());
+	body_fixed_acc_magnitudes_variances.assign(N_f,std::numeric_limits<double>::quiet_NaN());
+
+	arma::mat::fixed<3,3> omega_tilde = RBK::tilde(omega);
+	arma::mat::fixed<3,3> omega_tilde_sq = omega_tilde * omega_tilde;
+
+	// The outputs are indexed by facet, so a facet queried more than once is only processed once
+	std::vector<unsigned int> facets(queried_elements);
+	std::sort(facets.begin(),facets.end());
+	facets.erase(std::unique(facets.begin(),facets.end()),facets.end());
+
+	// The partials evaluated within this loop have their own parallel reductions, 
+	// which are serialized when nested
+	#pragma omp parallel for
+	for (int e = 0; e < static_cast<int>(facets.size()); ++e){
+
+		int f = facets[e];
+
+		arma::vec::fixed<3> N = this -> pgm_model -> GetNonNormalizedFacetNormal(f);
+		arma::vec::fixed<3> n = arma::normalise(N);
+
+		// The acceleration partials are discontinuous across the facet, so 
+		// they are evaluated just above it. The offset is the geometric mean of the facet size 
+		// and of the round-off error on the center coordinates, so that the field point
+		// is unambiguously outside the shape while the field is still that of the surface
+		arma::vec::fixed<3> center = this -> pgm_model -> GetFacetCenter(f);
+		double facet_size = std::sqrt(0.5 * arma::norm(N));
+		double roundoff = arma::datum::eps * std::max(arma::norm(center,"inf"),facet_size);
+		center += std::sqrt(facet_size * roundoff) * n;
+		arma::vec::fixed<3> arm = scaleFactor * center - com;
+
+		double potential;
+		arma::vec::fixed<3> acc;
+		arma::mat::fixed<3,3> gravity_gradient;
+		this -> pgm_model -> GetPotentialAccelerationGravityGradient(arma::vec::fixed<3>(scaleFactor * center),
+			potential,acc,gravity_gradient);
+
+		// Partials of the facet center (m) with respect to the control points (m)
+		arma::mat PartialCenterPartialC = 1./3 * arma::join_rows(arma::join_rows(arma::eye<arma::mat>(3,3),
+			arma::eye<arma::mat>(3,3)),arma::eye<arma::mat>(3,3)) * this -> PartialTfPartialC(f);
+
+		// Inertial partials, with the field point attached to the facet
+		arma::rowvec PartialUPartialC = scaleFactor * this -> GetPartialUPartialC(center) + acc.t() * PartialCenterPartialC;
+		arma::mat PartialAPartialC = this -> GetPartialAPartialC(center) + gravity_gradient * PartialCenterPartialC;
+
+		// Body-fixed partials, derived from the inertial ones
+		arma::vec::fixed<3> acc_body_fixed = acc - omega_tilde_sq * arm;
+		arma::rowvec PartialUbPartialC = PartialUPartialC + (omega_tilde * arm).t() * omega_tilde * PartialCenterPartialC;
+		arma::mat PartialAbPartialC = PartialAPartialC - omega_tilde_sq * PartialCenterPartialC;
+
+		arma::vec::fixed<3> acc_dir = arma::normalise(acc);
+		arma::vec::fixed<3> acc_body_fixed_dir = arma::normalise(acc_body_fixed);
+
+		// Slope partials
+		arma::mat PartialnPartialC = PartialNormalizedVPartialNonNormalizedV(N) * this -> PartialNfPartialTf(f) * this -> PartialTfPartialC(f) / scaleFactor;
+		arma::mat PartialAbDirPartialC = (arma::eye<arma::mat>(3,3) - acc_body_fixed_dir * acc_body_fixed_dir.t()) / arma::norm(acc_body_fixed) * PartialAbPartialC;
+		double cos_slope = - arma::dot(acc_body_fixed_dir,n);
+		arma::rowvec PartialCosSlopePartialC = - n.t() * PartialAbDirPartialC - acc_body_fixed_dir.t() * PartialnPartialC;
+
+		// The slope is not differentiable where it vanishes, in which case its variance is set to zero. 
+		// Its sine is obtained from a cross product, which remains accurate at small slopes
+		arma::mat J(5,PartialUPartialC.n_cols);
+		double sin_slope = arma::norm(arma::cross(acc_body_fixed_dir,n));
+		if (sin_slope > std::sqrt(arma::datum::eps)){
+			J.row(0) = - 180. / arma::datum::pi / sin_slope * PartialCosSlopePartialC;
+		}
+		else{
+			J.row(0).zeros();
+		}
+		J.row(1) = PartialUPartialC;
+		J.row(2) = PartialUbPartialC;
+		J.row(3) = acc_dir.t() * PartialAPartialC;
+		J.row(4) = acc_body_fixed_dir.t() * PartialAbPartialC;
+
+		// With a cached square root L, the variances are the squared norms of the rows of J * L.
+		// Otherwise, only the non-zeros of a sparse covariance are visited
+		arma::vec variances;
+		if (this -> covarianceSquareRootSet && this -> sparseSquareRoot){
+			variances = arma::sum(arma::square(scaleFactor * (J * this -> C_CC_sparse)),1);
+		}
+		else if (this -> covarianceSquareRootSet){
+			variances = arma::sum(arma::square(scaleFactor * (J * this -> C_CC)),1);
+		}
+		else if (this -> sparseCovariance){
+			variances = arma::sum(arma::mat(J * this -> P_CC_sparse) % J,1);
+		}
+		else{
+			variances = arma::sum((J * this -> P_CC) % J,1);
+		}
+
+		slopes_variances[f] = variances(0);
+		inertial_potentials_variances[f] = variances(1);
+		body_fixed_potentials_variances[f] = variances(2);
+		inertial_acc_magnitudes_variances[f] = variances(3);
+		body_fixed_acc_magnitudes_variances[f] = variances(4);
+
+	}
+
+}
+
+void SBGATPolyhedronGravityModelUQ::ComputeSurfacePGMUQ(vtkSmartPointer<vtkPolyData> selected_shape,
+	const std::vector<unsigned int> & queried_elements,
+	bool is_in_meters,
+	double density,
+	const arma::vec::fixed<3> & omega,
+	double sigma,
+	double l,
+	std::vector<double> & slopes_variances,
+	std::vector<double> & inertial_potentials_variances,
+	std::vector<double> & body_fixed_potentials_variances,
+	std::vector<double> & inertial_acc_magnitudes_variances,
+	std::vector<double> & body_fixed_acc_magnitudes_variances,
+	double cutoff,
+	bool compact_support,
+	bool isotropic){
+
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputData(selected_shape);
+	pgm_filter -> SetDensity(density);
+
+	if (is_in_meters){
+		pgm_filter -> SetScaleMeters();
+	}
+	else{
+		pgm_filter -> SetScaleKiloMeters();
+	}
+
+	pgm_filter -> Update();
+
+	// Shared with pgm_filter
+	vtkSmartPointer<SBGATMassProperties> mass_prop = SBGATMassProperties::GetSharedMassProperties(selected_shape,is_in_meters);
+
+	SBGATPolyhedronGravityModelUQ pgm_uq;
+	pgm_uq.SetPGM(pgm_filter);
+	pgm_uq.SetCovarianceKernel(sigma,l,cutoff,compact_support,isotropic);
+
+	pgm_uq.GetSurfacePGMVariances(queried_elements,
+		omega,
+		mass_prop -> GetCenterOfMass(),
+		slopes_variances,
+		inertial_potentials_variances,
+		body_fixed_potentials_variances,
+		inertial_acc_magnitudes_variances,
+		body_fixed_acc_magnitudes_variances);
+
+}
+
+void SBGATPolyhedronGravityModelUQ::SaveSurfacePGMUQ(vtkSmartPointer<vtkPolyData> selected_shape,
+	const std::vector<unsigned int> & queried_elements,
+	bool is_in_meters,
+	const double & mass,
+	const arma::vec::fixed<3> & omega,
+	double sigma,
+	double l,
+	const std::vector<double> & slopes_variances,
+	const std::vector<double> & inertial_potentials_variances,
+	const std::vector<double> & body_fixed_potentials_variances,
+	const std::vector<double> & inertial_acc_magnitudes_variances,
+	const std::vector<double> & body_fixed_acc_magnitudes_variances,
+	std::string path,
+	bool binary){
+
+	if (binary){
+
+		arma::mat surface_pgm_uq(queried_elements.size(),6);
+
+		for (unsigned int i = 0; i < queried_elements.size(); ++i){
+			int index = queried_elements[i];
+			surface_pgm_uq(i,0) = index;
+			surface_pgm_uq(i,1) = slopes_variances[index];
+			surface_pgm_uq(i,2) = inertial_potentials_variances[index];
+			surface_pgm_uq(i,3) = body_fixed_potentials_variances[index];
+			surface_pgm_uq(i,4) = inertial_acc_magnitudes_variances[index];
+			surface_pgm_uq(i,5) = body_fixed_acc_magnitudes_variances[index];
+		}
+
+		if (!surface_pgm_uq.save(path,arma::arma_binary)){
+			throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::SaveSurfacePGMUQ: could not save to " + path));
+		}
+
+		return;
+	}
+
+	nlohmann::json surface_pgm_uq_json;
+	nlohmann::json omega_json = {
+		{"value",{omega(0),omega(1),omega(2)}},
+		{"unit","rad/s"}
+	};
+
+	std::string distance_unit = is_in_meters ? "m" : "km";
+
+	surface_pgm_uq_json["facets"] = selected_shape -> GetNumberOfCells();
+	surface_pgm_uq_json["vertices"] = selected_shape -> GetNumberOfPoints();
+	surface_pgm_uq_json["mass"] = mass;
+	surface_pgm_uq_json["omega"] = omega_json;
+	surface_pgm_uq_json["sigma"] = {
+		{"value",sigma},
+		{"unit",distance_unit}
+	};
+	surface_pgm_uq_json["correlation_length"] = {
+		{"value",l},
+		{"unit",distance_unit}
+	};
+
+	nlohmann::json slopes_variances_json,
+	inertial_potentials_variances_json,
+	body_fixed_potentials_variances_json,
+	inertial_acc_magnitudes_variances_json,
+	body_fixed_acc_magnitudes_variances_json;
+
+	for (unsigned int i = 0; i < queried_elements.size(); ++i){
+		int index = queried_elements[i];
+
+
+		nlohmann::json slope_variance = { 
+			{"index", index}, 
+			{"value", slopes_variances[index]},
+			{"unit","deg^2"} 
+		};
+
+		nlohmann::json inertial_potential_variance = { 
+			{"index", index}, 
+			{"value", inertial_potentials_variances[index]},
+			{"unit","m^4/s^4"} 
+		};
+
+		nlohmann::json body_fixed_potential_variance = { 
+			{"index", index}, 
+			{"value", body_fixed_potentials_variances[index]},
+			{"unit","m^4/s^4"} 
+		};
+
+		nlohmann::json inertial_acc_magnitude_variance = { 
+			{"index", index}, 
+			{"value", inertial_acc_magnitudes_variances[index]},
+			{"unit","m^2/s^4"} 
+		};
+
+		nlohmann::json body_fixed_acc_magnitude_variance = { 
+			{"index", index}, 
+			{"value", body_fixed_acc_magnitudes_variances[index]},
+			{"unit","m^2/s^4"} 
+		};
+
+		slopes_variances_json.push_back(slope_variance);
+		inertial_potentials_variances_json.push_back(inertial_potential_variance);
+		body_fixed_potentials_variances_json.push_back(body_fixed_potential_variance);
+		inertial_acc_magnitudes_variances_json.push_back(inertial_acc_magnitude_variance);
+		body_fixed_acc_magnitudes_variances_json.push_back(body_fixed_acc_magnitude_variance);
+
+	}
+
+	surface_pgm_uq_json["slopes_variances"] = slopes_variances_json;
+	surface_pgm_uq_json["inertial_potentials_variances"] = inertial_potentials_variances_json;
+	surface_pgm_uq_json["body_fixed_potentials_variances"] = body_fixed_potentials_variances_json;
+	surface_pgm_uq_json["inertial_acc_magnitudes_variances"] = inertial_acc_magnitudes_variances_json;
+	surface_pgm_uq_json["body_fixed_acc_magnitudes_variances"] = body_fixed_acc_magnitudes_variances_json;
+
+	std::ofstream o(path);
+	o << std::setw(4) << surface_pgm_uq_json << std::endl;
+
+}
+
+void SBGATPolyhedronGravityModelUQ::RunMonteCarlo(const arma::mat & points,
+	const unsigned int N_samples,
+	const unsigned int seed,
+	arma::vec & potential_mean,
+	arma::vec & potential_var,
+	arma::mat & acc_mean,
+	arma::cube & acc_cov) const{
+
+	if (points.n_rows != 3){
+		throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::RunMonteCarlo: the field points must be stacked in a 3 x N_points matrix"));
+	}
+
+	if (N_samples < 2){
+		throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::RunMonteCarlo: at least two samples are needed, got " + std::to_string(N_samples)));
+	}
+
+	vtkPolyData * polydata = vtkPolyData::SafeDownCast(this -> pgm_model -> GetInput());
+
+	int N_C = polydata -> GetNumberOfPoints();
+	int N_f = polydata -> GetNumberOfCells();
+	int N_e = N_C + N_f - 2;
+	int N_points = points.n_cols;
+
+	double scaleFactor = this -> pgm_model -> GetScaleFactor();
+	double potential_scale = 0.5 * arma::datum::G * this -> pgm_model -> GetDensity() * scaleFactor * scaleFactor;
+	double acc_scale = arma::datum::G * this -> pgm_model -> GetDensity() * scaleFactor;
+
+	// Snapshot of the nominal geometry and topology
+	std::vector<double> nominal_vertices(3 * N_C);
+	std::vector<int> facets(3 * N_f);
+	std::vector<int> edges(2 * N_e);
+	std::vector<int> edge_facets(2 * N_e);
+	std::vector<double> nominal_normals(3 * N_f);
+
+	for (int i = 0; i < N_C; ++i){
+		polydata -> GetPoint(i,nominal_vertices.data() + 3 * i);
+	}
+
+	for (int f = 0; f < N_f; ++f){
+		this -> pgm_model -> GetIndicesVerticesInFacet(f,facets[3 * f],facets[3 * f + 1],facets[3 * f + 2]);
+		this -> pgm_model -> GetFacetNormal(f,nominal_normals.data() + 3 * f);
+	}
+
+	for (int e = 0; e < N_e; ++e){
+		this -> pgm_model -> GetIndicesVerticesOnEdge(e,edges[2 * e],edges[2 * e + 1]);
+		this -> pgm_model -> GetIndicesOfAdjacentFacets(e,edge_facets[2 * e],edge_facets[2 * e + 1]);
+	}
+
+	// The nominal dyads are recomputed in double precision so that
+	// updated and non-updated dyads are consistent
+	std::vector<int> all_facets(N_f);
+	std::vector<int> all_edges(N_e);
+	std::iota(all_facets.begin(),all_facets.end(),0);
+	std::iota(all_edges.begin(),all_edges.end(),0);
+
+	std::vector<double> nominal_facet_normals(3 * N_f);
+	std::vector<double> nominal_facet_dyads(9 * N_f);
+	std::vector<double> nominal_edge_dyads(9 * N_e);
+
+	SBGATPolyhedronGravityModelUQ::UpdateDyads(nominal_vertices,facets,edges,edge_facets,nominal_normals,
+		all_facets,all_edges,nominal_facet_normals,nominal_facet_dyads,nominal_edge_dyads);
+
+	// Only the vertices with a non-zero row in the covariance square root
+	// can move, and only the facets/edges touching them need to be updated.
+	// A square root formed from eigenmodes is generally dense, in which case
+	// all of the vertices are active
+	arma::sp_mat L = this -> GetSparseCovarianceSquareRoot();
+
+	std::vector<bool> is_active(N_C,false);
+	for (arma::sp_mat::const_iterator it = L.begin(); it != L.end(); ++it){
+		is_active[it.row() / 3] = true;
+	}
+
+	std::vector<int> active_vertices;
+	for (int i = 0; i < N_C; ++i){
+		if (is_active[i]){
+			active_vertices.push_back(i);
+		}
+	}
+
+	std::vector<int> affected_facets;
+	std::vector<bool> is_affected(N_f,false);
+	for (int f = 0; f < N_f; ++f){
+		if (is_active[facets[3 * f]] || is_active[facets[3 * f + 1]] || is_active[facets[3 * f + 2]]){
+			affected_facets.push_back(f);
+			is_affected[f] = true;
+		}
+	}
+
+	std::vector<int> affected_edges;
+	std::vector<int> unaffected_facets;
+	std::vector<int> unaffected_edges;
+	for (int e = 0; e < N_e; ++e){
+		if (is_affected[edge_facets[2 * e]] || is_affected[edge_facets[2 * e + 1]]){
+			affected_edges.push_back(e);
+		}
+		else{
+			unaffected_edges.push_back(e);
+		}
+	}
+	for (int f = 0; f < N_f; ++f){
+		if (!is_affected[f]){
+			unaffected_facets.push_back(f);
+		}
+	}
+
+	// The contribution of the facets and edges that never move is evaluated once. 
+	// Each outcome then only sums over the affected facets and edges
+	arma::mat unaffected_sums(4,N_points);
+
+	#pragma omp parallel for
+	for (int p = 0; p < N_points; ++p){
+		arma::vec::fixed<3> point_scaled = points.col(p) / scaleFactor;
+		double pot;
+		arma::vec::fixed<3> acc;
+
+		SBGATPolyhedronGravityModel::GetPotentialAccelerationFromDyads(point_scaled.colptr(0),
+			nominal_vertices,facets,edges,nominal_facet_dyads,nominal_edge_dyads,
+			unaffected_facets,unaffected_edges,pot,acc);
+
+		unaffected_sums(0,p) = pot;
+		unaffected_sums(1,p) = acc(0);
+		unaffected_sums(2,p) = acc(1);
+		unaffected_sums(3,p) = acc(2);
+	}
+
+	// The samples are split in a fixed number of batches, each with its own random stream,
+	// so that the results do not depend on the number of threads
+	int N_batches = std::min<int>(N_samples,64);
+
+	std::vector<arma::mat> batch_means(N_batches);
+	std::vector<arma::cube> batch_M2(N_batches);
+	std::vector<double> batch_counts(N_batches);
+
+	#pragma omp parallel for
+	for (int b = 0; b < N_batches; ++b){
+
+		unsigned int first = (unsigned long long)(b) * N_samples / N_batches;
+		unsigned int last = (unsigned long long)(b + 1) * N_samples / N_batches;
+
+		std::seed_seq seq = {seed,(unsigned int)(b)};
+		std::mt19937_64 generator(seq);
+		std::normal_distribution<double> distribution(0,1);
+
+		std::vector<double> vertices(nominal_vertices);
+		std::vector<double> facet_normals(nominal_facet_normals);
+		std::vector<double> facet_dyads(nominal_facet_dyads);
+		std::vector<double> edge_dyads(nominal_edge_dyads);
+
+		arma::mat mean = arma::zeros<arma::mat>(4,N_points);
+		arma::cube M2 = arma::zeros<arma::cube>(4,4,N_points);
+
+		arma::vec z(L.n_cols);
+		arma::vec deviation(3 * N_C);
+
+		for (unsigned int s = first; s < last; ++s){
+
+			for (unsigned int k = 0; k < z.n_rows; ++k){
+				z(k) = distribution(generator);
+			}
+
+			deviation = L * z;
+
+			for (auto i : active_vertices){
+				vertices[3 * i] = nominal_vertices[3 * i] + deviation(3 * i);
+				vertices[3 * i + 1] = nominal_vertices[3 * i + 1] + deviation(3 * i + 1);
+				vertices[3 * i + 2] = nominal_vertices[3 * i + 2] + deviation(3 * i + 2);
+			}
+
+			SBGATPolyhedronGravityModelUQ::UpdateDyads(vertices,facets,edges,edge_facets,nominal_normals,
+				affected_facets,affected_edges,facet_normals,facet_dyads,edge_dyads);
+
+			double n = s - first + 1;
+
+			for (int p = 0; p < N_points; ++p){
+
+				arma::vec::fixed<3> point_scaled = points.col(p) / scaleFactor;
+				double pot;
+				arma::vec::fixed<3> acc;
+
+				SBGATPolyhedronGravityModel::GetPotentialAccelerationFromDyads(point_scaled.colptr(0),
+					vertices,facets,edges,facet_dyads,edge_dyads,affected_facets,affected_edges,pot,acc);
+
+				arma::vec::fixed<4> x;
+				x(0) = potential_scale * (unaffected_sums(0,p) + pot);
+				x.subvec(1,3) = acc_scale * (unaffected_sums.submat(1,p,3,p) + acc);
+
+				// Welford update of the running mean and co-moments
+				arma::vec::fixed<4> delta = x - mean.col(p);
+				mean.col(p) += delta / n;
+				M2.slice(p) += delta * (x - mean.col(p)).t();
+
+			}
+
+		}
+
+		batch_means[b] = mean;
+		batch_M2[b] = M2;
+		batch_counts[b] = last - first;
+
+	}
+
+	// The batch statistics are merged in order
+	arma::mat mean = batch_means[0];
+	arma::cube M2 = batch_M2[0];
+	double n = batch_counts[0];
+
+	for (int b = 1; b < N_batches; ++b){
+
+		double n_b = batch_counts[b];
+		double n_tot = n + n_b;
+
+		for (int p = 0; p < N_points; ++p){
+			arma::vec::fixed<4> delta = batch_means[b].col(p) - mean.col(p);
+			M2.slice(p) += batch_M2[b].slice(p) + (n * n_b / n_tot) * delta * delta.t();
+			mean.col(p) += (n_b / n_tot) * delta;
+		}
+
+		n = n_tot;
+	}
+
+	potential_mean = mean.row(0).t();
+	acc_mean = mean.rows(1,3);
+	potential_var.set_size(N_points);
+	acc_cov.set_size(3,3,N_points);
+
+	for (int p = 0; p < N_points; ++p){
+		potential_var(p) = M2(0,0,p) / (n - 1);
+		acc_cov.slice(p) = M2.slice(p).submat(1,1,3,3) / (n - 1);
+	}
+
+}
+
+
+void SBGATPolyhedronGravityModelUQ::GetCovarianceAccelerationTrajectory(const arma::mat & positions,
+	const unsigned int max_lag,
+	arma::cube & acc_cov,
+	std::vector<arma::cube> & acc_cross_cov) const{
+
+	if (positions.n_rows != 3){
+		throw(std::runtime_error("In SBGATPolyhedronGravityModelUQ::GetCovarianceAccelerationTrajectory: positions must have 3 rows, got " + std::to_string(positions.n_rows)));
+	}
+
+	int T = positions.n_cols;
+	double scaleFactor = this -> pgm_model -> GetScaleFactor();
+
+	acc_cov.set_size(3,3,T);
+	acc_cross_cov.resize(max_lag);
+	for (unsigned int k = 1; k <= max_lag; ++k){
+		acc_cross_cov[k - 1].set_size(3,3,std::max(T - static_cast<int>(k),0));
+	}
+
+	// Each covariance block is formed as Cov(dA(t),dA(s)) = A_t * B_s^T with
+	// A_t = B_t = dA/dC(t) * L * s if the square root L is cached,
+	// A_t = dA/dC(t) * P_CC, B_t = dA/dC(t) otherwise
+	bool use_square_root = this -> covarianceSquareRootSet;
+
+	// The partials are stored in a ring buffer holding one block of points
+	// plus the max_lag points preceding it
+	const int block_size = 256;
+	const int buffer_size = block_size + static_cast<int>(max_lag);
+	std::vector<arma::mat> A_buffer(buffer_size);
+	std::vector<arma::mat> B_buffer(use_square_root ? 0 : buffer_size);
+	const std::vector<arma::mat> & B_ref = use_square_root ? A_buffer : B_buffer;
+
+	for (int b0 = 0; b0 < T; b0 += block_size){
+
+		int b1 = std::min(b0 + block_size,T);
+
+		// The partials evaluated within this loop have their own parallel reductions, 
+		// which are serialized when nested
+		#pragma omp parallel for
+		for (int t = b0; t < b1; ++t){
+
+			arma::vec::fixed<3> pos_scaled = positions.col(t) / scaleFactor;
+			arma::mat PartialAPartialC = this -> GetPartialAPartialC(pos_scaled);
+
+			if (use_square_root && this -> sparseSquareRoot){
+				A_buffer[t % buffer_size] = scaleFactor * (PartialAPartialC * this -> C_CC_sparse);
+			}
+			else if (use_square_root){
+				A_buffer[t % buffer_size] = scaleFactor * (PartialAPartialC * this -> C_CC);
+			}
+			else if (this -> sparseCovariance){
+				A_buffer[t % buffer_size] = PartialAPartialC * this -> P_CC_sparse;
+				B_buffer[t % buffer_size] = PartialAPartialC;
+			}
+			else{
+				A_buffer[t % buffer_size] = PartialAPartialC * this -> P_CC;
+				B_buffer[t % buffer_size] = PartialAPartialC;
+			}
+		}
+
+		#pragma omp parallel for
+		for (int t = b0; t < b1; ++t){
+
+			const arma::mat & B_t = B_ref[t % buffer_size];
+
+			acc_cov.slice(t) = A_buffer[t % buffer_size] * B_t.t();
+			
+			// Symmetrizing to remove round-off
+			acc_cov.slice(t) = 0.5 * (acc_cov.slice(t) + acc_cov.slice(t).t());
+
+			for (int k = 1; k <= static_cast<int>(max_lag) && t - k >= 0; ++k){
+				acc_cross_cov[k - 1].slice(t - k) = A_buffer[(t - k) % buffer_size] * B_t.t();
+			}
+
+		}
+
+	}
+
+}
+
+void SBGATPolyhedronGravityModelUQ::GetCovarianceAccelerationTrajectory(const std::vector<arma::vec> & positions,
+	const unsigned int max_lag,
+	arma::cube & acc_cov,
+	std::vector<arma::cube> & acc_cross_cov) const{
+
+	arma::mat positions_mat(3,positions.size());
+
+	for (unsigned int t = 0; t < positions.size(); ++t){
+		positions_mat.col(t) = positions[t];
+	}
+
+	this -> GetCovarianceAccelerationTrajectory(positions_mat,max_lag,acc_cov,acc_cross_cov);
+
+}
+
+void SBGATPolyhedronGravityModelUQ::UpdateDyads(const std::vector<double> & vertices,
+	const std::vector<int> & facets,
+	const std::vector<int> & edges,
+	const std::vector<int> & edge_facets,
+	const std::vector<double> & nominal_normals,
+	const std::vector<int> & affected_facets,
+	const std::vector<int> & affected_edges,
+	std::vector<double> & facet_normals,
+	std::vector<double> & facet_dyads,
+	std::vector<double> & edge_dyads){
+
+	for (auto f : affected_facets){
+
+		const double * r0 = vertices.data() + 3 * facets[3 * f];
+		const double * r1 = vertices.data() + 3 * facets[3 * f + 1];
+		const double * r2 = vertices.data() + 3 * facets[3 * f + 2];
+
+		double r1m0[3];
+		double r2m0[3];
+		double * n = facet_normals.data() + 3 * f;
+
+		vtkMath::Subtract(r1,r0,r1m0);
+		vtkMath::Subtract(r2,r0,r2m0);
+		vtkMath::Cross(r1m0,r2m0,n);
+		vtkMath::Normalize(n);
+
+		if (vtkMath::Dot(n,nominal_normals.data() + 3 * f) < 0){
+			vtkMath::MultiplyScalar(n,-1.);
+		}
+
+		double * F = facet_dyads.data() + 9 * f;
+
+		for (int i = 0; i < 3; ++i){
+			for (int j = 0; j < 3; ++j){
+				F[3 * i + j] = n[i] * n[j];
+			}
+		}
+
+	}
+
+	for (auto e : affected_edges){
+
+		const double * p0 = vertices.data() + 3 * edges[2 * e];
+		const double * p1 = vertices.data() + 3 * edges[2 * e + 1];
+
+		const double * nA = facet_normals.data() + 3 * edge_facets[2 * e];
+		const double * nB = facet_normals.data() + 3 * edge_facets[2 * e + 1];
+
+		// Same as the normalized nA x nB oriented along p1 - p0,
+		// but well defined for nearly coplanar facets
+		double edge_dir[3];
+		vtkMath::Subtract(p1,p0,edge_dir);
+		vtkMath::Normalize(edge_dir);
+
+		double edge_normal_A_to_B[3];
+		double edge_normal_B_to_A[3];
+
+		vtkMath::Cross(nA,edge_dir,edge_normal_A_to_B);
+		vtkMath::Cross(nB,edge_dir,edge_normal_B_to_A);
+		vtkMath::MultiplyScalar(edge_normal_A_to_B,-1.);
+
+		double * E = edge_dyads.data() + 9 * e;
+
+		for (int i = 0; i < 3; ++i){
+			for (int j = 0; j < 3; ++j){
+				E[3 * i + j] = nA[i] * edge_normal_A_to_B[j] + nB[i] * edge_normal_B_to_A[j];
+			}
+		}
+
+	}
+
+}
+
+
 void SBGATPolyhedronGravityModelUQ::TestAddPartialSumUePartialC(std::string filename, double tol){
 
 	std::cout << "\t In TestAddPartialSumUePartialC ...";
@@ -76,19 +76,13 @@ int SBGATShapeUncertainty::RequestData(vtkInformation* vtkNotUsed( request ),vtk
 
  vtkPolyData * input_unclean = vtkPolyData::SafeDownCast(inInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-  vtkSmartPointer<vtkCleanPolyData> cleaner =
-  vtkSmartPointer<vtkCleanPolyData>::New();
-  cleaner -> SetInputData (input_unclean);
-  cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
-  cleaner -> Update();
+  // The cleaned shape and its mass properties are shared with the other filters 
+  // processing the same shape
+  vtkSmartPointer<SBGATMassProperties> center_of_mass_filter = SBGATMassProperties::GetSharedMassProperties(input_unclean,true);
 
-  vtkPolyData * input = cleaner -> GetOutput();
-
-  vtkSmartPointer<SBGATMassProperties> center_of_mass_filter =
-  vtkSmartPointer<SBGATMassProperties>::New();
-
-  center_of_mass_filter -> SetInputData(input);
-  center_of_mass_filter -> Update();
+  // The shared cleaned shape is read-only, so a shallow copy of it is transformed
+  vtkSmartPointer<vtkPolyData> cleaned_shape = vtkSmartPointer<vtkPolyData>::New();
+  cleaned_shape -> ShallowCopy(center_of_mass_filter -> GetCleanedShape());
 
   arma::vec x = - center_of_mass_filter -> GetCenterOfMass();
 
@@ -99,11 +93,11 @@ int SBGATShapeUncertainty::RequestData(vtkInformation* vtkNotUsed( request ),vtk
   vtkSmartPointer<vtkTransformPolyDataFilter> filter =
   vtkSmartPointer<vtkTransformPolyDataFilter>::New();
 
-  filter -> SetInputData(input);
+  filter -> SetInputData(cleaned_shape);
   filter -> SetTransform(transform);
   filter -> Update();
 
-  input = filter -> GetOutput();
+  vtkPolyData * input = filter -> GetOutput();
 
 
   vtkIdType numCells, numPts, numIds;
@@ -50,210 +50,1223 @@ SOFTWARE.
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <RigidBodyKinematics.hpp>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Memory mapping of the binary files is only available on POSIX systems
+#if defined(__unix__) || defined(__APPLE__)
+#define SBGAT_SPHERICAL_HARMO_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Header of the files written by SBGATSphericalHarmo::SaveToBinary
+struct SphericalHarmoBinaryHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t normalized;
+  uint64_t degree;
+  uint64_t n_facets;
+  uint64_t n_vertices;
+  double referenceRadius;
+  double totalMass;
+  double density;
+};
+
+static_assert(sizeof(SphericalHarmoBinaryHeader) == 64,"Unexpected padding in SphericalHarmoBinaryHeader");
+
+static const char spherical_harmo_binary_magic[8] = "SBGATSH";
+static const uint32_t spherical_harmo_binary_version = 1;
+
+// Largest degree accepted by SBGATSphericalHarmo::LoadFromBinary (about 1.6 GB of coefficients)
+static const uint64_t spherical_harmo_binary_max_degree = 10000;
+
+// Sums the chunk buffers of the facets contributions pairwise in a fixed order, 
+// so that the result does not depend on the number of threads. The sums are left in the first chunk
+static void ReduceChunks(std::vector<arma::mat> & Cnm_chunks,std::vector<arma::mat> & Snm_chunks){
+
+  int N_chunks = Cnm_chunks.size();
+
+  for (int stride = 1; stride < N_chunks; stride *= 2){
+
+    #pragma omp parallel for
+    for (int chunk = 0; chunk < N_chunks - stride; chunk += 2 * stride){
+      Cnm_chunks[chunk] += Cnm_chunks[chunk + stride];
+      Snm_chunks[chunk] += Snm_chunks[chunk + stride];
+    }
+
+  }
+
+}
+
+// Nodes and weights of the N_nodes-point Gauss-Legendre rule over [0,1], 
+// exact for polynomials of degree up to 2 N_nodes - 1
+static void GaussLegendreNodes(const int N_nodes,std::vector<double> & nodes,std::vector<double> & weights){
+
+  nodes.resize(N_nodes);
+  weights.resize(N_nodes);
+
+  for (int i = 0; i < N_nodes; ++i){
+
+    // Newton iterations on the Legendre polynomial of degree N_nodes over [-1,1]
+    double t = std::cos(arma::datum::pi * (i + 0.75) / (N_nodes + 0.5));
+    double dP = 1;
+
+    for (int iter = 0; iter < 100; ++iter){
+
+      double P_prev = 1;
+      double P = t;
+      for (int k = 2; k <= N_nodes; ++k){
+        double P_next = ((2 * k - 1) * t * P - (k - 1) * P_prev) / k;
+        P_prev = P;
+        P = P_next;
+      }
+
+      dP = N_nodes * (t * P - P_prev) / (t * t - 1);
+      double dt = P / dP;
+      t -= dt;
+
+      if (std::abs(dt) < 1e-15){
+        break;
+      }
+    }
+
+    nodes[i] = 0.5 * (1 - t);
+    weights[i] = 1. / ((1 - t * t) * dP * dP);
+
+  }
+
+}
+
 vtkStandardNewMacro(SBGATSphericalHarmo);
 
-//----------------------------------------------------------------------------
-// Constructs with initial 0 values.
-SBGATSphericalHarmo::SBGATSphericalHarmo(){
+//----------------------------------------------------------------------------
+// Constructs with initial 0 values.
+SBGATSphericalHarmo::SBGATSphericalHarmo(){
+
+  this -> normalized = false;
+  this -> degreeSet = false;
+  this -> densitySet = false;
+  this -> referenceRadiusSet = false;
+  this -> scaleFactorSet = false;
+  this -> setFromJSON = false;
+
+
+  this->SetNumberOfOutputPorts(0);
+}
+
+//----------------------------------------------------------------------------
+// Destroy any allocated memory.
+SBGATSphericalHarmo::~SBGATSphericalHarmo(){
+  this -> ReleaseCoefficientsMapping();
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// This method computes the Cnm and Snm arrays of coefficients
+// used in the spherical harmonics expansion of exterior gravity 
+// about a constant-density polyhedron
+
+int SBGATSphericalHarmo::RequestData(vtkInformation* vtkNotUsed( request ),vtkInformationVector** inputVector,vtkInformationVector* vtkNotUsed( outputVector )){
+
+  if (this -> setFromJSON){
+    return 1;
+  }
+
+  vtkInformation * inInfo =
+  inputVector[0] -> GetInformationObject(0);
+
+  // call ExecuteData
+  vtkPolyData * input_unclean = vtkPolyData::SafeDownCast(inInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+  // The cleaned shape and its mass properties are shared with the other filters 
+  // processing the same shape
+  vtkSmartPointer<SBGATMassProperties> mass_properties = SBGATMassProperties::GetSharedMassProperties(input_unclean,
+    this -> scaleFactor == 1);
+
+  vtkPolyData * input = mass_properties -> GetCleanedShape();
+  vtkIdType numCells, numPts;
+
+  numCells = input->GetNumberOfCells();
+  numPts = input->GetNumberOfPoints();
+  if (numCells < 1 || numPts < 1){
+    vtkErrorMacro( << "No data to measure...!");
+    return 1;
+  }
+
+
+  if (!(this -> degreeSet && this -> densitySet && this -> referenceRadiusSet && this -> scaleFactorSet)){
+    throw(std::runtime_error("Trying to evaluate spherical harmonics although the degree, density, reference radius and scale factor may have not been properly set"));
+  }
+  
+  // Initialize variables 
+  this -> Cnm.clear();
+  this -> Snm.clear();
+  this -> n_facets = numCells;
+  this -> n_vertices = numPts;
+
+  this -> Cnm = arma::zeros<arma::mat>(this -> degree + 1  , this -> degree + 1);
+  this -> Snm = arma::zeros<arma::mat>(this -> degree + 1  , this -> degree + 1);
+
+  // Check that the shape is topologically closed
+ assert(mass_properties -> CheckClosed());
+
+ this -> totalMass = mass_properties -> GetVolume() * this -> density;
+
+ this -> AccumulateFacetsCoefficients(input,this -> degree,this -> Cnm,this -> Snm);
+
+this -> Cnm /= mass_properties -> GetVolume();
+this -> Snm /= mass_properties -> GetVolume();
+
+if (this -> vertexCovarianceSet){
+  this -> ComputeCoefficientsCovariance(input,mass_properties -> GetVolume());
+}
+
+return 1;
+}
+
+
+void SBGATSphericalHarmo::ExtendDegree(const unsigned int new_degree){
+
+  if (new_degree <= this -> degree){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ExtendDegree: the new degree (" + std::to_string(new_degree) 
+      + ") must be greater than the current degree (" + std::to_string(this -> degree) + ")"));
+  }
+
+  if (!this -> scaleFactorSet){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ExtendDegree: the scale factor must be set"));
+  }
+
+  vtkPolyData * input_unclean = nullptr;
+
+  if (this -> GetNumberOfInputConnections(0) > 0){
+    // Brings the current coefficients (and the input) up to date
+    this -> Update();
+    input_unclean = vtkPolyData::SafeDownCast(this -> GetInput());
+  }
+
+  if (input_unclean == nullptr || input_unclean -> GetNumberOfCells() < 1){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ExtendDegree: no shape is connected to the filter. Spherical harmonics loaded from a file can only be extended once the shape they were computed from is set with SetInputData or SetInputConnection"));
+  }
+
+  vtkSmartPointer<SBGATMassProperties> mass_properties = SBGATMassProperties::GetSharedMassProperties(input_unclean,
+    this -> scaleFactor == 1);
+
+  vtkPolyData * input = mass_properties -> GetCleanedShape();
+
+  double volume = mass_properties -> GetVolume();
+
+  if (this -> Cnm.n_rows == 0 || this -> Snm.n_rows != this -> Cnm.n_rows){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ExtendDegree: there are no coefficients to extend"));
+  }
+
+  // Rows above the current degree may already be held if the expansion was truncated with SetDegree
+  unsigned int available_degree = this -> Cnm.n_rows - 1;
+
+  if (new_degree > available_degree){
+
+    arma::mat C,S;
+    this -> AccumulateFacetsCoefficientsRows(input,available_degree + 1,new_degree,C,S);
+
+    // The existing rows are copied as is, possibly out of a file mapping
+    arma::mat Cnm_extended = arma::zeros<arma::mat>(new_degree + 1,new_degree + 1);
+    arma::mat Snm_extended = arma::zeros<arma::mat>(new_degree + 1,new_degree + 1);
+
+    Cnm_extended.submat(0,0,available_degree,available_degree) = this -> Cnm;
+    Snm_extended.submat(0,0,available_degree,available_degree) = this -> Snm;
+
+    Cnm_extended.rows(available_degree + 1,new_degree) = C.rows(available_degree + 1,new_degree) / volume;
+    Snm_extended.rows(available_degree + 1,new_degree) = S.rows(available_degree + 1,new_degree) / volume;
+
+    this -> ReleaseCoefficientsMapping();
+    this -> Cnm = Cnm_extended;
+    this -> Snm = Snm_extended;
+
+  }
+
+  this -> degree = new_degree;
+  this -> degreeSet = true;
+  this -> n_facets = input -> GetNumberOfCells();
+  this -> n_vertices = input -> GetNumberOfPoints();
+  this -> ComputeEvaluationTables();
+
+  if (this -> vertexCovarianceSet){
+    this -> ComputeCoefficientsCovariance(input,volume);
+  }
+
+}
+
+
+void SBGATSphericalHarmo::AccumulateFacetsCoefficients(vtkPolyData * input,
+  const unsigned int degree,
+  arma::mat & C,
+  arma::mat & S) const{
+
+  // The triangular facets are gathered beforehand so that 
+  // the input is not accessed from concurrent threads
+  std::vector<double> facets_coords;
+  this -> GatherFacetsCoordinates(input,facets_coords);
+
+  int N_triangles = facets_coords.size() / 9;
+
+  // The facets are split in a fixed number of contiguous chunks, each accumulated
+  // serially in its own buffer. The chunk buffers are then summed pairwise in a fixed order,
+  // so the coefficients do not depend on the number of threads
+  int N_chunks = std::max(std::min(N_triangles,64),1);
+  std::vector<arma::mat> Cnm_chunks(N_chunks,arma::zeros<arma::mat>(degree + 1, degree + 1));
+  std::vector<arma::mat> Snm_chunks(N_chunks,arma::zeros<arma::mat>(degree + 1, degree + 1));
+
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
+
+    int f0 = static_cast<int>((static_cast<long>(N_triangles) * chunk) / N_chunks);
+    int f1 = static_cast<int>((static_cast<long>(N_triangles) * (chunk + 1)) / N_chunks);
+
+    // Per-facet temporaries, reused across the chunk
+    arma::mat Cnm2f(degree + 1, degree + 1);
+    arma::mat Snm2f(degree + 1, degree + 1);
+
+    for (int f = f0; f < f1; ++f){
+
+      double * r0 = &facets_coords[9 * f];
+
+      // Call to SHARMLib here
+      SHARMLib::ComputePolyhedralCS(Cnm2f,Snm2f,degree,this -> referenceRadius,r0,r0 + 3,r0 + 6,this -> normalized);
+
+      Cnm_chunks[chunk] += Cnm2f ;
+      Snm_chunks[chunk] += Snm2f ;
+    }
+
+  }
+
+  ReduceChunks(Cnm_chunks,Snm_chunks);
+
+  C = Cnm_chunks[0];
+  S = Snm_chunks[0];
+
+}
+
+
+void SBGATSphericalHarmo::AccumulateFacetsCoefficientsRows(vtkPolyData * input,
+  const unsigned int min_degree,
+  const unsigned int max_degree,
+  arma::mat & C,
+  arma::mat & S) const{
+
+  std::vector<double> facets_coords;
+  this -> GatherFacetsCoordinates(input,facets_coords);
+
+  int N_triangles = facets_coords.size() / 9;
+  const int N = max_degree;
+  const int N_min = min_degree;
+
+  // Recursion factors of the interior solid harmonics r^n Pnm(sin(phi)) exp(i m lambda) / R^n, 
+  // and factors turning their integrals over the shape into the unnormalized coefficients
+  arma::vec diagonal_factors = arma::zeros<arma::vec>(N + 1);
+  arma::mat factors_A = arma::zeros<arma::mat>(N + 1,N + 1);
+  arma::mat factors_B = arma::zeros<arma::mat>(N + 1,N + 1);
+  arma::mat coefficients_factors = arma::zeros<arma::mat>(N + 1,N + 1);
+
+  for (int nn = 0; nn <= N; ++nn){
+
+    double n = (double) nn;
+
+    if (nn == 1){
+      diagonal_factors(nn) = this -> normalized ? std::sqrt(3.0) : 1.0;
+    }
+    else if (nn > 1){
+      diagonal_factors(nn) = this -> normalized ? std::sqrt((2.0*n+1.0) / (2.0*n)) : 2.0*n-1.0;
+    }
+
+    for (int mm = 0; mm <= nn; ++mm){
+
+      double m = (double) mm;
+
+      if (mm < nn){
+        if (this -> normalized){
+          factors_A(nn,mm) = std::sqrt((2.0*n+1.0) * (2.0*n-1.0) / ((n-m) * (n+m)));
+          if (mm <= nn - 2){
+            factors_B(nn,mm) = std::sqrt((2.0*n+1.0) * (n+m-1.0) * (n-m-1.0) / ((2.0*n-3.0) * (n+m) * (n-m)));
+          }
+        }
+        else{
+          factors_A(nn,mm) = (2.0*n-1.0) / (n-m);
+          if (mm <= nn - 2){
+            factors_B(nn,mm) = (n+m-1.0) / (n-m);
+          }
+        }
+      }
+
+      if (this -> normalized){
+        coefficients_factors(nn,mm) = 1.0 / (2.0*n+1.0);
+      }
+      else{
+        coefficients_factors(nn,mm) = (mm == 0) ? 1.0 : 2.0;
+        for (int k = nn - mm + 1; k <= nn + mm; ++k){
+          coefficients_factors(nn,mm) /= k;
+        }
+      }
+
+    }
+  }
+
+  // The harmonics of degree n are homogeneous polynomials of degree n. Their integral over the tetrahedron 
+  // formed by the origin and a facet is therefore det(r0,r1,r2) / (n + 3) times their integral over the unit triangle,
+  // which the collapsed Gauss-Legendre rule below evaluates exactly up to degree max_degree
+  int N_nodes = N / 2 + 1;
+  std::vector<double> nodes;
+  std::vector<double> weights;
+  GaussLegendreNodes(N_nodes,nodes,weights);
+
+  int N_chunks = std::max(std::min(N_triangles,64),1);
+  std::vector<arma::mat> Cnm_chunks(N_chunks,arma::zeros<arma::mat>(N + 1, N + 1));
+  std::vector<arma::mat> Snm_chunks(N_chunks,arma::zeros<arma::mat>(N + 1, N + 1));
+
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < N_chunks; ++chunk){
+
+    int f0 = static_cast<int>((static_cast<long>(N_triangles) * chunk) / N_chunks);
+    int f1 = static_cast<int>((static_cast<long>(N_triangles) * (chunk + 1)) / N_chunks);
+
+    // Harmonics at the current quadrature point, reused across the chunk
+    arma::mat a_real = arma::zeros<arma::mat>(N + 1, N + 1);
+    arma::mat a_imag = arma::zeros<arma::mat>(N + 1, N + 1);
+
+    for (int f = f0; f < f1; ++f){
+
+      const double * r0 = &facets_coords[9 * f];
+      const double * r1 = r0 + 3;
+      const double * r2 = r0 + 6;
+
+      double r1_cross_r2[3];
+      vtkMath::Cross(r1,r2,r1_cross_r2);
+      double det = vtkMath::Dot(r0,r1_cross_r2);
+
+      for (int i = 0; i < N_nodes; ++i){
+        for (int j = 0; j < N_nodes; ++j){
+
+          double s = nodes[i];
+          double t = (1 - nodes[i]) * nodes[j];
+          double w = det * weights[i] * weights[j] * (1 - nodes[i]);
+
+          double x = (r0[0] + s * (r1[0] - r0[0]) + t * (r2[0] - r0[0])) / this -> referenceRadius;
+          double y = (r0[1] + s * (r1[1] - r0[1]) + t * (r2[1] - r0[1])) / this -> referenceRadius;
+          double z = (r0[2] + s * (r1[2] - r0[2]) + t * (r2[2] - r0[2])) / this -> referenceRadius;
+          double r_sq = x * x + y * y + z * z;
+
+          a_real(0,0) = 1;
+          a_imag(0,0) = 0;
+
+          for (int nn = 1; nn <= N; ++nn){
+
+            a_real(nn,nn) = diagonal_factors(nn) * (x * a_real(nn - 1,nn - 1) - y * a_imag(nn - 1,nn - 1));
+            a_imag(nn,nn) = diagonal_factors(nn) * (x * a_imag(nn - 1,nn - 1) + y * a_real(nn - 1,nn - 1));
+
+            for (int mm = 0; mm < nn; ++mm){
+              a_real(nn,mm) = factors_A(nn,mm) * z * a_real(nn - 1,mm);
+              a_imag(nn,mm) = factors_A(nn,mm) * z * a_imag(nn - 1,mm);
+
+              if (mm <= nn - 2){
+                a_real(nn,mm) -= factors_B(nn,mm) * r_sq * a_real(nn - 2,mm);
+                a_imag(nn,mm) -= factors_B(nn,mm) * r_sq * a_imag(nn - 2,mm);
+              }
+            }
+          }
+
+          // Only the requested rows are accumulated
+          for (int nn = N_min; nn <= N; ++nn){
+            for (int mm = 0; mm <= nn; ++mm){
+              Cnm_chunks[chunk](nn,mm) += w / (nn + 3) * a_real(nn,mm);
+              Snm_chunks[chunk](nn,mm) += w / (nn + 3) * a_imag(nn,mm);
+            }
+          }
+
+        }
+      }
+    }
+
+  }
+
+  ReduceChunks(Cnm_chunks,Snm_chunks);
+
+  C = Cnm_chunks[0] % coefficients_factors;
+  S = Snm_chunks[0] % coefficients_factors;
+
+}
+
+
+void SBGATSphericalHarmo::GatherFacetsCoordinates(vtkPolyData * input,std::vector<double> & facets_coords) const{
+
+  vtkIdType numCells = input->GetNumberOfCells();
+
+  vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+  ptIds->Allocate(VTK_CELL_SIZE);
+
+  facets_coords.clear();
+  facets_coords.reserve(9 * numCells);
+
+  for (vtkIdType cellId=0; cellId < numCells; cellId++){
+
+    if ( input->GetCellType(cellId) != VTK_TRIANGLE){
+      vtkWarningMacro(<< "Input data type must be VTK_TRIANGLE not " << input->GetCellType(cellId));
+      continue;
+    }
+
+    input->GetCellPoints(cellId,ptIds);
+    assert(ptIds->GetNumberOfIds() == 3);
+
+    for (int i = 0; i < 3; ++i){
+      double r[3];
+      input->GetPoint(ptIds->GetId(i), r);
+      vtkMath::MultiplyScalar(r,this -> scaleFactor);
+      facets_coords.insert(facets_coords.end(),r,r + 3);
+    }
+
+  }
+
+}
+
+
+void SBGATSphericalHarmo::ComputeCoefficientsCovariance(vtkPolyData * input,double volume){
+
+  int N_C = input -> GetNumberOfPoints();
+  int N_f = input -> GetNumberOfCells();
+
+  if (this -> P_CC.n_rows != 3 * N_C || this -> P_CC.n_cols != 3 * N_C){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ComputeCoefficientsCovariance: the vertex covariance must be " 
+      + std::to_string(3 * N_C) + " x " + std::to_string(3 * N_C) + ", got " 
+      + std::to_string(this -> P_CC.n_rows) + " x " + std::to_string(this -> P_CC.n_cols)));
+  }
+
+  int degree = this -> degree;
+  int N_Cnm = (degree + 1) * (degree + 2) / 2;
+  int N_Snm = degree * (degree + 1) / 2;
+
+  // Stacks the Cnm and Snm arrays as documented in GetCoefficientsCovariance
+  auto stack_coefficients = [degree,N_Cnm,N_Snm](const arma::mat & C, const arma::mat & S){
+    arma::vec coefs(N_Cnm + N_Snm);
+    int counter = 0;
+    for (int n = 0; n <= degree; ++n){
+      for (int m = 0; m <= n; ++m){
+        coefs(counter) = C(n,m);
+        ++counter;
+      }
+    }
+    for (int n = 1; n <= degree; ++n){
+      for (int m = 1; m <= n; ++m){
+        coefs(counter) = S(n,m);
+        ++counter;
+      }
+    }
+    return coefs;
+  };
+
+  arma::vec coefs = stack_coefficients(this -> Cnm,this -> Snm);
+
+  // Vertex coordinates (m) and facet connectivity are gathered beforehand so that 
+  // the input is not accessed from concurrent threads
+  arma::mat vertices(3,N_C);
+  for (int v = 0; v < N_C; ++v){
+    input -> GetPoint(v,vertices.colptr(v));
+  }
+  vertices *= this -> scaleFactor;
+
+  arma::imat facets(3,N_f);
+  vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+  for (int f = 0; f < N_f; ++f){
+    input -> GetCellPoints(f,ptIds);
+    for (int i = 0; i < 3; ++i){
+      facets(i,f) = ptIds -> GetId(i);
+    }
+  }
+
+  this -> partialCoefficientsPartialC = arma::zeros<arma::mat>(N_Cnm + N_Snm,3 * N_C);
+
+  // Fourth-order central differences. The step is relative to the reference radius, which 
+  // normalizes the vertex coordinates in the facet contributions
+  double h = 1e-4 * this -> referenceRadius;
+  const double steps[4] = {-2 * h,-h,h,2 * h};
+  const double weights[4] = {1./(12 * h),-8./(12 * h),8./(12 * h),-1./(12 * h)};
+
+  // Facets are processed in chunks so as to bound the memory used by the 
+  // facet partials, which are then scattered serially
+  const int chunk_size = 256;
+  std::vector<arma::mat> facet_partials(chunk_size);
+
+  for (int f0 = 0; f0 < N_f; f0 += chunk_size){
+
+    int f1 = std::min(f0 + chunk_size,N_f);
+
+    #pragma omp parallel for
+    for (int f = f0; f < f1; ++f){
+
+      arma::mat & partial = facet_partials[f - f0];
+      partial = arma::zeros<arma::mat>(N_Cnm + N_Snm,9);
+
+      arma::vec::fixed<9> T_f = arma::join_cols(arma::join_cols(vertices.col(facets(0,f)),
+        vertices.col(facets(1,f))),vertices.col(facets(2,f)));
+
+      arma::mat Cnm2f(degree + 1, degree + 1);
+      arma::mat Snm2f(degree + 1, degree + 1);
+
+      for (int k = 0; k < 9; ++k){
+        for (int i = 0; i < 4; ++i){
+          arma::vec::fixed<9> T_f_pert = T_f;
+          T_f_pert(k) += steps[i];
+
+          SHARMLib::ComputePolyhedralCS(Cnm2f,Snm2f,degree,this -> referenceRadius,
+            T_f_pert.memptr(),T_f_pert.memptr() + 3,T_f_pert.memptr() + 6,this -> normalized);
+
+          partial.col(k) += weights[i] * stack_coefficients(Cnm2f,Snm2f);
+        }
+      }
+
+      // The coefficients are normalized by the volume, whose partials are exact
+      arma::vec::fixed<3> r0 = T_f.subvec(0,2);
+      arma::vec::fixed<3> r1 = T_f.subvec(3,5);
+      arma::vec::fixed<3> r2 = T_f.subvec(6,8);
+
+      arma::rowvec::fixed<9> PartialVolumePartialTf = arma::join_rows(arma::join_rows(arma::cross(r1,r2).t(),
+        arma::cross(r2,r0).t()),arma::cross(r0,r1).t()) / 6;
+
+      partial = (partial - coefs * PartialVolumePartialTf) / volume;
+
+    }
+
+    for (int f = f0; f < f1; ++f){
+      for (int i = 0; i < 3; ++i){
+        this -> partialCoefficientsPartialC.cols(3 * facets(i,f),3 * facets(i,f) + 2) += facet_partials[f - f0].cols(3 * i,3 * i + 2);
+      }
+    }
+
+  }
+
+  // The coefficients covariance is accumulated over chunks of vertex coordinates so that
+  // only the non-zero entries of the sparse vertex covariance are visited and the
+  // partials-covariance product is never formed over all the coordinates at once
+  const arma::mat & J = this -> partialCoefficientsPartialC;
+  this -> coefficientsCovariance = arma::zeros<arma::mat>(N_Cnm + N_Snm,N_Cnm + N_Snm);
+
+  const int N_coords = 3 * N_C;
+  const int coords_chunk_size = 3 * chunk_size;
+  arma::mat JP_chunk;
+
+  for (int c0 = 0; c0 < N_coords; c0 += coords_chunk_size){
+
+    int c1 = std::min(c0 + coords_chunk_size,N_coords);
+    JP_chunk = arma::zeros<arma::mat>(N_Cnm + N_Snm,c1 - c0);
+
+    #pragma omp parallel for
+    for (int c = c0; c < c1; ++c){
+      for (arma::sp_mat::const_col_iterator it = this -> P_CC.begin_col(c); it != this -> P_CC.end_col(c); ++it){
+        JP_chunk.col(c - c0) += (*it) * J.col(it.row());
+      }
+    }
+
+    this -> coefficientsCovariance += JP_chunk * J.cols(c0,c1 - 1).t();
+
+  }
+
+  // The vertex covariance is converted to meters
+  this -> coefficientsCovariance *= this -> scaleFactor * this -> scaleFactor;
+  this -> coefficientsCovariance = 0.5 * (this -> coefficientsCovariance + this -> coefficientsCovariance.t());
+
+}
+
+
+
+
+
+
+
+
+void SBGATSphericalHarmo::ComputeEvaluationTables(){
+
+  int D = this -> degree;
+
+  // Recursion factors of the normalized exterior harmonics, up to degree D + 2
+  this -> bnmDiagonalFactors = arma::zeros<arma::vec>(D + 3);
+  this -> bnmFactorsA = arma::zeros<arma::mat>(D + 3,D + 3);
+  this -> bnmFactorsB = arma::zeros<arma::mat>(D + 3,D + 3);
+
+  for (int nn = 1; nn <= D + 2; ++nn){
+
+    double n = (double) nn;
+
+    if (nn == 1){
+      this -> bnmDiagonalFactors(nn) = std::sqrt(3.0);
+    }
+    else{
+      this -> bnmDiagonalFactors(nn) = std::sqrt((2.0*n+1.0) / (2.0*n));
+    }
+
+    for (int mm = 0; mm < nn; ++mm){
+
+      double m = (double) mm;
+
+      this -> bnmFactorsA(nn,mm) = std::sqrt((2.0*n+1.0) * (2.0*n-1.0) / ((n-m) * (n+m)));
+
+      if (mm <= nn - 2){
+        this -> bnmFactorsB(nn,mm) = std::sqrt((2.0*n+1.0) * (n+m-1.0) * (n-m-1.0) / ((2.0*n-3.0) * (n+m) * (n-m)));
+      }
+    }
+  }
+
+  // Normalization factors of the acceleration and gravity gradient expressions
+  this -> accelerationFactors = arma::zeros<arma::cube>(D + 1,D + 1,4);
+  this -> gravityGradientFactors = arma::zeros<arma::cube>(D + 1,D + 1,10);
+
+  for (int nn = 0; nn <= D; ++nn){
+
+    double n = (double) nn;
+
+    for (int mm = 0; mm <= nn; ++mm){
+
+      double m = (double) mm;
+      double delta_1_m = (mm == 1) ? 1.0 : 0.0;
+      double delta_2_m = (mm == 2) ? 1.0 : 0.0;
+
+      this -> accelerationFactors(nn,mm,0) = sqrt( (n+2.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+3.0) );
+      this -> accelerationFactors(nn,mm,1) = sqrt( (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) );
+      this -> accelerationFactors(nn,mm,2) = sqrt( 2.0 * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_1_m) / (2.0*n+3.0) );
+      this -> accelerationFactors(nn,mm,3) = sqrt( (n-m+1.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) );
+
+      this -> gravityGradientFactors(nn,mm,0) = sqrt( (n+m+4.0) * (n+m+3.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,1) = sqrt( (n-m+2.0) * (n-m+1.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,2) = sqrt( 2.0 * (n-m+4.0) * (n-m+3.0) * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_2_m) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,3) = sqrt( (n+5.0) * (n+4.0) * (n+3.0) * (n+2.0) * (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,4) = sqrt( (n+3.0) * (n+2.0) * (n+1.0) * n * (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,5) = sqrt( (n+4.0) * (n+3.0) * (n+2.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,6) = sqrt( (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,7) = sqrt( (n-m+1.0) * (n+m+3.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,8) = sqrt( 2.0 * (n+m+1.0) * (n-m+3.0) * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_1_m) / (2.0*n+5.0) );
+      this -> gravityGradientFactors(nn,mm,9) = sqrt( (n+3.0) * (n+2.0) * (n+1.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+5.0) );
+
+    }
+  }
+
+}
+
+
+template <int D,int P>
+void SBGATSphericalHarmo::ComputeBnmKernel(const double * positions,
+  const int n_points_runtime,
+  double * b_real,
+  double * b_imag,
+  double * geometry) const{
+
+  // Degree and number of points are compile-time constants in the specialized kernels
+  const int n_points = (P > 0) ? P : n_points_runtime;
+  const int N = ((D >= 0) ? D : static_cast<int>(this -> degree)) + 2;
+
+  double R = this -> referenceRadius;
+
+  double * x_tilde = geometry;
+  double * y_tilde = geometry + n_points;
+  double * z_tilde = geometry + 2 * n_points;
+  double * rho = geometry + 3 * n_points;
+
+  double * b_real_00 = b_real;
+  double * b_imag_00 = b_imag;
+
+  for (int p = 0; p < n_points; ++p){
+    const double * pos = positions + 3 * p;
+    double r2 = pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2];
+    rho[p] = R * R / r2;
+    x_tilde[p] = pos[0] * R / r2;
+    y_tilde[p] = pos[1] * R / r2;
+    z_tilde[p] = pos[2] * R / r2;
+    b_real_00[p] = R / std::sqrt(r2);
+    b_imag_00[p] = 0;
+  }
+
+  for (int n = 1; n <= N; ++n){
+
+    // Sectorial terms
+    double d = this -> bnmDiagonalFactors(n);
+    const double * b_real_prev = b_real + n_points * BnmIndex(n - 1,n - 1);
+    const double * b_imag_prev = b_imag + n_points * BnmIndex(n - 1,n - 1);
+    double * b_real_nn = b_real + n_points * BnmIndex(n,n);
+    double * b_imag_nn = b_imag + n_points * BnmIndex(n,n);
+
+    for (int p = 0; p < n_points; ++p){
+      b_real_nn[p] = d * (x_tilde[p] * b_real_prev[p] - y_tilde[p] * b_imag_prev[p]);
+      b_imag_nn[p] = d * (y_tilde[p] * b_real_prev[p] + x_tilde[p] * b_imag_prev[p]);
+    }
+
+    // Zonal and tesseral terms
+    for (int m = 0; m < n; ++m){
+
+      double A = this -> bnmFactorsA(n,m);
+      const double * b_real_n1 = b_real + n_points * BnmIndex(n - 1,m);
+      const double * b_imag_n1 = b_imag + n_points * BnmIndex(n - 1,m);
+      double * b_real_nm = b_real + n_points * BnmIndex(n,m);
+      double * b_imag_nm = b_imag + n_points * BnmIndex(n,m);
+
+      if (m <= n - 2){
+
+        double B = this -> bnmFactorsB(n,m);
+        const double * b_real_n2 = b_real + n_points * BnmIndex(n - 2,m);
+        const double * b_imag_n2 = b_imag + n_points * BnmIndex(n - 2,m);
+
+        for (int p = 0; p < n_points; ++p){
+          b_real_nm[p] = A * z_tilde[p] * b_real_n1[p] - B * rho[p] * b_real_n2[p];
+          b_imag_nm[p] = A * z_tilde[p] * b_imag_n1[p] - B * rho[p] * b_imag_n2[p];
+        }
+      }
+      else{
+        for (int p = 0; p < n_points; ++p){
+          b_real_nm[p] = A * z_tilde[p] * b_real_n1[p];
+          b_imag_nm[p] = A * z_tilde[p] * b_imag_n1[p];
+        }
+      }
+
+    }
+  }
+
+}
+
+
+template <int D,int P>
+void SBGATSphericalHarmo::EvaluateKernel(const double * positions,
+  const int n_points_runtime,
+  double * potentials,
+  double * accelerations,
+  double * gravity_gradients,
+  double * b_real,
+  double * b_imag,
+  double * geometry,
+  double * sums) const{
+
+  // Degree and number of points are compile-time constants in the specialized kernels
+  const int n_points = (P > 0) ? P : n_points_runtime;
+  const unsigned int degree = (D >= 0) ? D : this -> degree;
+
+  this -> ComputeBnmKernel<D,P>(positions,n_points,b_real,b_imag,geometry);
+
+  // Running sums of the potential, acceleration and 
+  // gravity gradient (xx,yy,zz,xy,xz,yz) expressions
+  std::fill(sums,sums + 10 * n_points,0.);
+
+  double * U = sums;
+  double * x_ddot = sums + n_points;
+  double * y_ddot = sums + 2 * n_points;
+  double * z_ddot = sums + 3 * n_points;
+  double * ddU_dxdx = sums + 4 * n_points;
+  double * ddU_dydy = sums + 5 * n_points;
+  double * ddU_dzdz = sums + 6 * n_points;
+  double * ddU_dxdy = sums + 7 * n_points;
+  double * ddU_dxdz = sums + 8 * n_points;
+  double * ddU_dydz = sums + 9 * n_points;
+
+  // The coefficients may hold more degrees than evaluated
+  const double * Cnm_ptr = this -> Cnm.memptr();
+  const double * Snm_ptr = this -> Snm.memptr();
+  const unsigned int ld = this -> Cnm.n_rows;
+
+  for (unsigned int nn = 0; nn <= degree; nn++){
+
+    double n = (double) nn;
+
+    for (unsigned int mm = 0; mm<=nn; mm++){
+
+      double C = Cnm_ptr[nn + ld * mm];
+      double S = Snm_ptr[nn + ld * mm];
+
+      if (potentials != nullptr){
+
+        const double * b_real_nm = b_real + n_points * BnmIndex(nn,mm);
+        const double * b_imag_nm = b_imag + n_points * BnmIndex(nn,mm);
+
+        for (int p = 0; p < n_points; ++p){
+          U[p] += C * b_real_nm[p] + S * b_imag_nm[p];
+        }
+      }
+
+      if (accelerations != nullptr){
+
+        double K1 = this -> accelerationFactors(nn,mm,0);
+        double K2 = this -> accelerationFactors(nn,mm,1);
+        double K3 = this -> accelerationFactors(nn,mm,2);
+        double Kz = this -> accelerationFactors(nn,mm,3);
+
+        const double * re_1p1 = b_real + n_points * BnmIndex(nn + 1,mm + 1);
+        const double * im_1p1 = b_imag + n_points * BnmIndex(nn + 1,mm + 1);
+        const double * re_10 = b_real + n_points * BnmIndex(nn + 1,mm);
+        const double * im_10 = b_imag + n_points * BnmIndex(nn + 1,mm);
+
+        if (mm == 0){
+
+          for (int p = 0; p < n_points; ++p){
+            x_ddot[p] -= 2.0 * ( C * K1 * re_1p1[p] );
+            y_ddot[p] -= 2.0 * ( C * K1 * im_1p1[p] );
+            z_ddot[p] -= 2.0 * ( C * Kz * re_10[p] );
+          }
+
+        }
+        else{
+
+          const double * re_1m1 = b_real + n_points * BnmIndex(nn + 1,mm - 1);
+          const double * im_1m1 = b_imag + n_points * BnmIndex(nn + 1,mm - 1);
+
+          for (int p = 0; p < n_points; ++p){
+            x_ddot[p] += ( -C * K2 * re_1p1[p] -S * K2 * im_1p1[p] +C * K3 * re_1m1[p] +S * K3 * im_1m1[p]);
+            y_ddot[p] += ( -C * K2 * im_1p1[p] +S * K2 * re_1p1[p] -C * K3 * im_1m1[p] +S * K3 * re_1m1[p]);
+            z_ddot[p] -= 2.0 * ( C * Kz * re_10[p] +S * Kz * im_10[p] );
+          }
+
+        } 
+      }
+
+      if (gravity_gradients != nullptr){
+
+        double K1 = this -> gravityGradientFactors(nn,mm,0);
+        double K2 = this -> gravityGradientFactors(nn,mm,1);
+        double K3 = this -> gravityGradientFactors(nn,mm,2);
+        double K4 = this -> gravityGradientFactors(nn,mm,3);
+        double K5 = this -> gravityGradientFactors(nn,mm,4);
+        double K6 = this -> gravityGradientFactors(nn,mm,5);
+        double K7 = this -> gravityGradientFactors(nn,mm,6);
+        double K8 = this -> gravityGradientFactors(nn,mm,7);
+        double K9 = this -> gravityGradientFactors(nn,mm,8);
+        double K10= this -> gravityGradientFactors(nn,mm,9);
+
+        const double * re_2p2 = b_real + n_points * BnmIndex(nn + 2,mm + 2);
+        const double * im_2p2 = b_imag + n_points * BnmIndex(nn + 2,mm + 2);
+        const double * re_2p1 = b_real + n_points * BnmIndex(nn + 2,mm + 1);
+        const double * im_2p1 = b_imag + n_points * BnmIndex(nn + 2,mm + 1);
+        const double * re_20 = b_real + n_points * BnmIndex(nn + 2,mm);
+        const double * im_20 = b_imag + n_points * BnmIndex(nn + 2,mm);
+
+        /*// Partial expressions */
+        if (mm == 0){
+
+          for (int p = 0; p < n_points; ++p){
+            ddU_dxdx[p] += 2.0 * ( C * K6 * re_2p2[p] -(n+2)*(n+1) * K7 * C * re_20[p] );
+            ddU_dydy[p] -= 2.0 * ( C * K6 * re_2p2[p] +(n+2)*(n+1) * K7 * C * re_20[p] );
+            ddU_dxdy[p] += 2.0 * ( C * K6 * im_2p2[p] );
+            ddU_dxdz[p] += 4.0 * ( C * K10 * re_2p1[p] );
+            ddU_dydz[p] += 4.0 * ( C * K10 * im_2p1[p] );
+            ddU_dzdz[p] += 4.0 * ( C * K2  * re_20[p] );
+          }
+
+        }
+        else if (mm == 1){
+
+          const double * re_2m1 = b_real + n_points * BnmIndex(nn + 2,mm - 1);
+          const double * im_2m1 = b_imag + n_points * BnmIndex(nn + 2,mm - 1);
+
+          for (int p = 0; p < n_points; ++p){
+            ddU_dxdx[p] += ( C * K4 * re_2p2[p] +S * K4 * im_2p2[p] -3.0 * K5 * C * re_20[p] -  K5 * S * im_20[p]);
+            ddU_dydy[p] -= ( C * K4 * re_2p2[p] +S * K4 * im_2p2[p] +  K5 * C * re_20[p] +3.0 * K5 * S * im_20[p]);
+            ddU_dxdy[p] -= ( S * K4 * re_2p2[p] -C * K4 * im_2p2[p] +  K5 * S * re_20[p] +  K5 * C * im_20[p]);
+            ddU_dxdz[p] += 2.0 * ( C * K8 * re_2p1[p] +S * K8 * im_2p1[p] -  K9 * C * re_2m1[p] -K9 * S * im_2m1[p] );
+            ddU_dydz[p] -= 2.0 * ( S * K8 * re_2p1[p] -C * K8 * im_2p1[p] +  K9 * S * re_2m1[p] -K9 * C * im_2m1[p] );
+            ddU_dzdz[p] += 4.0 * ( C * K2 * re_20[p]   +S * K2 * im_20[p]);
+          }
+
+        }
+        else{
+
+          const double * re_2m1 = b_real + n_points * BnmIndex(nn + 2,mm - 1);
+          const double * im_2m1 = b_imag + n_points * BnmIndex(nn + 2,mm - 1);
+          const double * re_2m2 = b_real + n_points * BnmIndex(nn + 2,mm - 2);
+          const double * im_2m2 = b_imag + n_points * BnmIndex(nn + 2,mm - 2);
+
+          for (int p = 0; p < n_points; ++p){
+            ddU_dxdx[p] += (  C * K1 * re_2p2[p] +S * K1 * im_2p2[p] -2.0 * K2 * C * re_20[p] -2.0 * K2 * S * im_20[p] +K3 * C * re_2m2[p] +K3 * S * im_2m2[p]);
+            ddU_dydy[p] -= (  C * K1 * re_2p2[p] +S * K1 * im_2p2[p] +2.0 * K2 * C * re_20[p] +2.0 * K2 * S * im_20[p] +K3 * C * re_2m2[p] +K3 * S * im_2m2[p]);
+            ddU_dxdy[p] += ( -S * K1 * re_2p2[p] +C * K1 * im_2p2[p] +K3 * S * re_2m2[p] -K3 * C * im_2m2[p]);
+            ddU_dxdz[p] += 2.0 * ( C * K8 * re_2p1[p] +S * K8 * im_2p1[p] -  K9 * C * re_2m1[p] -K9 * S * im_2m1[p] );
+            ddU_dydz[p] -= 2.0 * ( S * K8 * re_2p1[p] -C * K8 * im_2p1[p] +  K9 * S * re_2m1[p] -K9 * C * im_2m1[p] );
+            ddU_dzdz[p] += 4.0 * ( C * K2 * re_20[p]   +S * K2 * im_20[p]);
+          }
+
+        }
+      }
+
+    } 
+
+  } 
 
-  this -> normalized = false;
-  this -> degreeSet = false;
-  this -> densitySet = false;
-  this -> referenceRadiusSet = false;
-  this -> scaleFactorSet = false;
-  this -> setFromJSON = false;
+  double mu = this -> totalMass * arma::datum::G;
 
+  if (potentials != nullptr){
+    double K0 = mu / this -> referenceRadius;
+    for (int p = 0; p < n_points; ++p){
+      potentials[p] = K0 * U[p];
+    }
+  }
 
-  this->SetNumberOfOutputPorts(0);
-}
+  if (accelerations != nullptr){
+    double K0 = 0.5 * mu / std::pow(this -> referenceRadius,2);
+    for (int p = 0; p < n_points; ++p){
+      accelerations[3 * p] = K0 * x_ddot[p];
+      accelerations[3 * p + 1] = K0 * y_ddot[p];
+      accelerations[3 * p + 2] = K0 * z_ddot[p];
+    }
+  }
+
+  if (gravity_gradients != nullptr){
+    double K0 = 0.25 * mu / std::pow(this -> referenceRadius,3);
+    for (int p = 0; p < n_points; ++p){
+      double * dAccdPos = gravity_gradients + 9 * p;
+      dAccdPos[0] = K0 * ddU_dxdx[p];
+      dAccdPos[4] = K0 * ddU_dydy[p];
+      dAccdPos[8] = K0 * ddU_dzdz[p];
+      dAccdPos[1] = dAccdPos[3] = K0 * ddU_dxdy[p];
+      dAccdPos[2] = dAccdPos[6] = K0 * ddU_dxdz[p];
+      dAccdPos[5] = dAccdPos[7] = K0 * ddU_dydz[p];
+    }
+  }
 
-//----------------------------------------------------------------------------
-// Destroy any allocated memory.
-SBGATSphericalHarmo::~SBGATSphericalHarmo(){
 }
 
-//----------------------------------------------------------------------------
-// Description:
-// This method computes the Cnm and Snm arrays of coefficients
-// used in the spherical harmonics expansion of exterior gravity 
-// about a constant-density polyhedron
 
-int SBGATSphericalHarmo::RequestData(vtkInformation* vtkNotUsed( request ),vtkInformationVector** inputVector,vtkInformationVector* vtkNotUsed( outputVector )){
+void SBGATSphericalHarmo::ComputeBnm(const double * positions,
+  const int n_points,
+  EvaluationWorkspace & workspace) const{
 
-  if (this -> setFromJSON){
-    return 1;
+  int N = this -> degree + 2;
+
+  if (static_cast<int>(this -> bnmDiagonalFactors.n_rows) != N + 1){
+    throw(std::runtime_error("In SBGATSphericalHarmo::ComputeBnm: the evaluation tables were not computed for degree " + std::to_string(this -> degree)));
   }
 
-  vtkInformation * inInfo =
-  inputVector[0] -> GetInformationObject(0);
+  // Only reallocates if the workspace was last used with a different degree or number of points
+  workspace.b_bar_real.set_size(n_points,BnmIndex(N + 1,0));
+  workspace.b_bar_imag.set_size(n_points,BnmIndex(N + 1,0));
+  workspace.geometry.set_size(n_points,4);
 
-  // call ExecuteData
-  vtkPolyData * input_unclean = vtkPolyData::SafeDownCast(inInfo->Get(vtkDataObject::DATA_OBJECT()));
+  this -> ComputeBnmKernel<-1,-1>(positions,n_points,
+    workspace.b_bar_real.memptr(),workspace.b_bar_imag.memptr(),workspace.geometry.memptr());
 
-  vtkSmartPointer<vtkCleanPolyData> cleaner =
-  vtkSmartPointer<vtkCleanPolyData>::New();
-  cleaner -> SetInputData (input_unclean);
-  cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
-  cleaner -> Update();
+}
 
 
-  vtkPolyData * input = cleaner -> GetOutput();
-  vtkIdType cellId, numCells, numPts, numIds;
+void SBGATSphericalHarmo::EvaluateTile(const double * positions,
+  const int n_points,
+  double * potentials,
+  double * accelerations,
+  double * gravity_gradients,
+  EvaluationWorkspace & workspace) const{
 
-  numCells = input->GetNumberOfCells();
-  numPts = input->GetNumberOfPoints();
-  if (numCells < 1 || numPts < 1){
-    vtkErrorMacro( << "No data to measure...!");
-    return 1;
+  int N = this -> degree + 2;
+
+  if (static_cast<int>(this -> bnmDiagonalFactors.n_rows) != N + 1){
+    throw(std::runtime_error("In SBGATSphericalHarmo::EvaluateTile: the evaluation tables were not computed for degree " + std::to_string(this -> degree)));
   }
 
-  vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
-  ptIds->Allocate(VTK_CELL_SIZE);
+  if (this -> degree + 1 > this -> Cnm.n_rows || this -> Snm.n_rows != this -> Cnm.n_rows){
+    throw(std::runtime_error("In SBGATSphericalHarmo::EvaluateTile: the expansion is evaluated up to degree " + std::to_string(this -> degree) 
+      + " but the coefficients only extend to degree " + std::to_string(static_cast<int>(std::min(this -> Cnm.n_rows,this -> Snm.n_rows)) - 1)));
+  }
 
+  // Low-degree single points go through the specialized kernels
+  if (n_points == 1 && this -> EvaluatePointFixedDegree(positions,potentials,accelerations,gravity_gradients)){
+    return;
+  }
 
-  if (!(this -> degreeSet && this -> densitySet && this -> referenceRadiusSet && this -> scaleFactorSet)){
-    throw(std::runtime_error("Trying to evaluate spherical harmonics although the degree, density, reference radius and scale factor may have not been properly set"));
+  // Only reallocates if the workspace was last used with a different degree or number of points
+  workspace.b_bar_real.set_size(n_points,BnmIndex(N + 1,0));
+  workspace.b_bar_imag.set_size(n_points,BnmIndex(N + 1,0));
+  workspace.geometry.set_size(n_points,4);
+  workspace.sums.set_size(n_points,10);
+
+  this -> EvaluateKernel<-1,-1>(positions,n_points,potentials,accelerations,gravity_gradients,
+    workspace.b_bar_real.memptr(),workspace.b_bar_imag.memptr(),
+    workspace.geometry.memptr(),workspace.sums.memptr());
+
+}
+
+
+template <int D>
+void SBGATSphericalHarmo::EvaluatePointDegree(const double * pos,
+  double * potential,
+  double * acceleration,
+  double * gravity_gradient) const{
+
+  // Stack storage sized at compile time
+  std::array<double,BnmIndex(D + 3,0)> b_real;
+  std::array<double,BnmIndex(D + 3,0)> b_imag;
+  std::array<double,4> geometry;
+  std::array<double,10> sums;
+
+  this -> EvaluateKernel<D,1>(pos,1,potential,acceleration,gravity_gradient,
+    b_real.data(),b_imag.data(),geometry.data(),sums.data());
+
+}
+
+
+bool SBGATSphericalHarmo::EvaluatePointFixedDegree(const double * pos,
+  double * potential,
+  double * acceleration,
+  double * gravity_gradient) const{
+
+  if (this -> degree > SBGATSphericalHarmo::maxFixedDegree){
+    return false;
   }
-  
-  // Initialize variables 
-  this -> Cnm.clear();
-  this -> Snm.clear();
-  this -> n_facets = numCells;
-  this -> n_vertices = numPts;
 
-  this -> Cnm = arma::zeros<arma::mat>(this -> degree + 1  , this -> degree + 1);
-  this -> Snm = arma::zeros<arma::mat>(this -> degree + 1  , this -> degree + 1);
-  
-  vtkSmartPointer<SBGATMassProperties> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
-  mass_properties -> SetInputData(input);
-  if (this -> scaleFactor ==1){
-    mass_properties -> SetScaleMeters();
+  switch (this -> degree){
+    case 1 : this -> EvaluatePointDegree<1>(pos,potential,acceleration,gravity_gradient); return true;
+    case 2 : this -> EvaluatePointDegree<2>(pos,potential,acceleration,gravity_gradient); return true;
+    case 3 : this -> EvaluatePointDegree<3>(pos,potential,acceleration,gravity_gradient); return true;
+    case 4 : this -> EvaluatePointDegree<4>(pos,potential,acceleration,gravity_gradient); return true;
+    case 5 : this -> EvaluatePointDegree<5>(pos,potential,acceleration,gravity_gradient); return true;
+    case 6 : this -> EvaluatePointDegree<6>(pos,potential,acceleration,gravity_gradient); return true;
+    case 7 : this -> EvaluatePointDegree<7>(pos,potential,acceleration,gravity_gradient); return true;
+    case 8 : this -> EvaluatePointDegree<8>(pos,potential,acceleration,gravity_gradient); return true;
+    default : return false;
   }
-  else{
-   mass_properties -> SetScaleKiloMeters();
- }
- mass_properties -> Update();
 
-  // Check that the shape is topologically closed
- assert(mass_properties -> CheckClosed());
+}
 
- this -> totalMass = mass_properties -> GetVolume() * this -> density;
 
-  // Looping over all facets
- for (cellId=0; cellId < numCells; cellId++){
+void SBGATSphericalHarmo::EvaluateBatch(const arma::mat & positions,
+  double * potentials,
+  double * accelerations,
+  double * gravity_gradients) const{
 
-  if ( input->GetCellType(cellId) != VTK_TRIANGLE){
-    vtkWarningMacro(<< "Input data type must be VTK_TRIANGLE not " << input->GetCellType(cellId));
-    continue;
+  if (positions.n_rows != 3){
+    throw(std::runtime_error("In SBGATSphericalHarmo::EvaluateBatch: positions must have 3 rows, got " + std::to_string(positions.n_rows)));
   }
 
-  input->GetCellPoints(cellId,ptIds);
-  numIds = ptIds->GetNumberOfIds();
-  assert(numIds == 3);
+  const int tile_size = SBGATSphericalHarmo::tileSize;
+  int N_points = positions.n_cols;
+  int N_tiles = (N_points + tile_size - 1) / tile_size;
+
+  // Tiles are independent, so any thread count yields the same result
+  #pragma omp parallel for
+  for (int tile = 0; tile < N_tiles; ++tile){
+
+    thread_local EvaluationWorkspace workspace;
+
+    int p0 = tile * tile_size;
+    int n_points = std::min(tile_size,N_points - p0);
 
+    this -> EvaluateTile(positions.colptr(p0),n_points,
+      potentials == nullptr ? nullptr : potentials + p0,
+      accelerations == nullptr ? nullptr : accelerations + 3 * p0,
+      gravity_gradients == nullptr ? nullptr : gravity_gradients + 9 * p0,
+      workspace);
 
-  double r0[3];
-  double r1[3];
-  double r2[3];
+  }
 
-  input->GetPoint(ptIds->GetId(0), r0);
-  input->GetPoint(ptIds->GetId(1), r1);
-  input->GetPoint(ptIds->GetId(2), r2);
+}
 
-  vtkMath::MultiplyScalar(r0,this -> scaleFactor);
-  vtkMath::MultiplyScalar(r1,this -> scaleFactor);
-  vtkMath::MultiplyScalar(r2,this -> scaleFactor);
 
-  arma::mat Cnm2f(this -> degree + 1, this -> degree + 1);
-  arma::mat Snm2f(this -> degree + 1, this -> degree + 1);
+void SBGATSphericalHarmo::EvaluateBatch(const arma::mat & positions,
+  arma::vec & potentials,
+  arma::mat & accelerations,
+  arma::cube & gravity_gradients) const{
 
-    // Call to SHARMLib here
-  SHARMLib::ComputePolyhedralCS(Cnm2f,Snm2f,this -> degree,this -> referenceRadius,&r0[0],&r1[0],&r2[0],this -> normalized);
+  potentials.set_size(positions.n_cols);
+  accelerations.set_size(3,positions.n_cols);
+  gravity_gradients.set_size(3,3,positions.n_cols);
 
-  this -> Cnm += Cnm2f ;
-  this -> Snm += Snm2f ;
+  this -> EvaluateBatch(positions,potentials.memptr(),accelerations.memptr(),gravity_gradients.memptr());
 
 }
 
-this -> Cnm /= mass_properties -> GetVolume();
-this -> Snm /= mass_properties -> GetVolume();
+void SBGATSphericalHarmo::EvaluateAccelerationBatch(const arma::mat & positions,
+  arma::mat & accelerations) const{
+
+  accelerations.set_size(3,positions.n_cols);
+  this -> EvaluateBatch(positions,nullptr,accelerations.memptr(),nullptr);
 
-return 1;
 }
 
 
+double SBGATSphericalHarmo::GetPotential(const arma::vec::fixed<3> & pos){
+
+  try{
 
+    this -> Update();
 
+    return this -> EvaluatePotential(pos);
 
+  }
 
+  catch(std::runtime_error & error){
 
+    std::cout << "an std::runtime_error occured inside SBGATSphericalHarmo::GetPotential. returning 0\n";
+    return 0;
 
-arma::vec::fixed<3> SBGATSphericalHarmo::GetAcceleration(const arma::vec::fixed<3> & pos){
+  }
 
-  try{
+}
 
-    this -> Update();
+double SBGATSphericalHarmo::EvaluatePotential(const arma::vec::fixed<3> & pos) const{
 
-    int n_max = 50;
+  thread_local EvaluationWorkspace workspace;
+  return this -> EvaluatePotential(pos,workspace);
 
-    arma::mat b_bar_real = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
-    arma::mat b_bar_imag = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
+}
 
-    SHARMLib::GetBnmNormalizedExterior(this -> degree,
-      b_bar_real,
-      b_bar_imag,
-      pos,
-      this -> referenceRadius);
+double SBGATSphericalHarmo::EvaluatePotential(const arma::vec::fixed<3> & pos,
+  EvaluationWorkspace & workspace) const{
 
-    double mu = this -> totalMass * arma::datum::G;
+  double potential;
+  this -> EvaluateTile(pos.memptr(),1,&potential,nullptr,nullptr,workspace);
 
-    double K0 = 0.5 * mu / std::pow(this -> referenceRadius,2);
-    double x_ddot = 0;
-    double y_ddot = 0;
-    double z_ddot = 0;
+  return potential;
 
-    for (unsigned int nn = 0; nn <= this -> degree; nn++){
+}
 
-      double n = (double) nn;
 
-      for (unsigned int mm = 0; mm<=nn; mm++){
+void SBGATSphericalHarmo::GetPotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+  double & potential,
+  arma::vec::fixed<3> & acc,
+  arma::mat::fixed<3,3> & dAccdPos){
 
-        double m = (double) mm;
-        double delta_1_m;
+  try{
 
-        if (mm == 1){
-          delta_1_m = 1.0;
-        }
-        else{
-          delta_1_m = 0.0;
-        } 
+    this -> Update();
 
-        double K1 = sqrt( (n+2.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+3.0) );
-        double K2 = sqrt( (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) );
-        double K3 = sqrt( 2.0 * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_1_m) / (2.0*n+3.0) );
+    this -> EvaluatePotentialAccelerationGravityGradient(pos,potential,acc,dAccdPos);
 
-        if (mm == 0){
+  }
 
-          x_ddot -= 2.0 * K0 * ( this -> Cnm(nn,mm) * K1 * b_bar_real(nn+1,mm+1) );
-          y_ddot -= 2.0 * K0 * ( this -> Cnm(nn,mm) * K1 * b_bar_imag(nn+1,mm+1) );
-          z_ddot -= 2.0 * K0 * ( this -> Cnm(nn,mm)*sqrt((n-m+1.0)*(n+m+1.0)*(2.0*n+1.0)/(2.0*n+3.0)) * b_bar_real(nn+1,mm) );
+  catch(std::runtime_error & error){
+    std::cout << "an std::runtime_error occured inside SBGATSphericalHarmo::GetPotentialAccelerationGravityGradient. returning zeros\n";
+    potential = 0;
+    acc = arma::zeros<arma::vec>(3);
+    dAccdPos = arma::zeros<arma::mat>(3,3);
+  }
 
-        }
-        else{
+}
 
-          x_ddot += K0 * ( -this -> Cnm(nn,mm) * K2 * b_bar_real(nn+1,mm+1) -this -> Snm(nn,mm) * K2 * b_bar_imag(nn+1,mm+1) +this -> Cnm(nn,mm) * K3 * b_bar_real(nn+1,mm-1) +this -> Snm(nn,mm) * K3 * b_bar_imag(nn+1,mm-1));
-          y_ddot += K0 * ( -this -> Cnm(nn,mm) * K2 * b_bar_imag(nn+1,mm+1) +this -> Snm(nn,mm) * K2 * b_bar_real(nn+1,mm+1) -this -> Cnm(nn,mm) * K3 * b_bar_imag(nn+1,mm-1) +this -> Snm(nn,mm) * K3 * b_bar_real(nn+1,mm-1));
-          z_ddot -= 2.0 * K0 * ( this -> Cnm(nn,mm)*sqrt((n-m+1.0)*(n+m+1.0)*(2.0*n+1.0)/(2.0*n+3.0)) * b_bar_real(nn+1,mm) +this -> Snm(nn,mm)*sqrt((n-m+1.0)*(n+m+1.0)*(2*n+1.0)/(2.0*n+3.0)) * b_bar_imag(nn+1,mm) );
+void SBGATSphericalHarmo::EvaluatePotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+  double & potential,
+  arma::vec::fixed<3> & acc,
+  arma::mat::fixed<3,3> & dAccdPos) const{
 
-        } 
+  thread_local EvaluationWorkspace workspace;
+  this -> EvaluatePotentialAccelerationGravityGradient(pos,potential,acc,dAccdPos,workspace);
 
-      } 
+}
 
-    } 
+void SBGATSphericalHarmo::EvaluatePotentialAccelerationGravityGradient(const arma::vec::fixed<3> & pos,
+  double & potential,
+  arma::vec::fixed<3> & acc,
+  arma::mat::fixed<3,3> & dAccdPos,
+  EvaluationWorkspace & workspace) const{
+
+  this -> EvaluateTile(pos.memptr(),1,&potential,acc.memptr(),dAccdPos.memptr(),workspace);
+
+}
 
-    arma::vec::fixed<3> acceleration = {x_ddot,y_ddot,z_ddot};
 
-    return acceleration;
+arma::vec::fixed<3> SBGATSphericalHarmo::GetAcceleration(const arma::vec::fixed<3> & pos){
+
+  try{
+
+    this -> Update();
+
+    return this -> EvaluateAcceleration(pos);
 
   }
 
@@ -266,6 +1279,23 @@ arma::vec::fixed<3> SBGATSphericalHarmo::GetAcceleration(const arma::vec::fixed<
 
 } 
 
+arma::vec::fixed<3> SBGATSphericalHarmo::EvaluateAcceleration(const arma::vec::fixed<3> & pos) const{
+
+  thread_local EvaluationWorkspace workspace;
+  return this -> EvaluateAcceleration(pos,workspace);
+
+}
+
+arma::vec::fixed<3> SBGATSphericalHarmo::EvaluateAcceleration(const arma::vec::fixed<3> & pos,
+  EvaluationWorkspace & workspace) const{
+
+  arma::vec::fixed<3> acceleration;
+  this -> EvaluateTile(pos.memptr(),1,nullptr,acceleration.memptr(),nullptr,workspace);
+
+  return acceleration;
+
+}
+
 
 
 void SBGATSphericalHarmo::GetGravityGradientMatrix(const arma::vec::fixed<3> & pos,
@@ -275,184 +1305,138 @@ void SBGATSphericalHarmo::GetGravityGradientMatrix(const arma::vec::fixed<3> & p
 
     this -> Update();
 
-    int n_max = 50;
+    this -> EvaluateGravityGradientMatrix(pos,dAccdPos);
 
-    arma::mat b_bar_real = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
-    arma::mat b_bar_imag = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
+  }
 
-    SHARMLib::GetBnmNormalizedExterior(this -> degree,
-      b_bar_real,
-      b_bar_imag,
-      pos,
-      this -> referenceRadius);
+  catch(std::runtime_error & error){
+    std::cout << "an std::runtime_error occured inside SBGATSphericalHarmo::GetGravityGradientMatrix. returning zero matrix\n";
+    dAccdPos = arma::zeros<arma::mat>(3,3);
+  }
 
-    double mu = this -> totalMass * arma::datum::G;
+} 
 
-    double K0 = 0.25 * mu / std::pow(this -> referenceRadius,3);
+void SBGATSphericalHarmo::EvaluateGravityGradientMatrix(const arma::vec::fixed<3> & pos,
+  arma::mat::fixed<3,3> & dAccdPos) const{
 
-    double ddU_dxdx = 0;
-    double ddU_dydy = 0;
-    double ddU_dxdy = 0;
-    double ddU_dxdz = 0;
-    double ddU_dydz = 0;
-    double ddU_dzdz = 0;
+  thread_local EvaluationWorkspace workspace;
+  this -> EvaluateGravityGradientMatrix(pos,dAccdPos,workspace);
 
-    for (unsigned int nn = 0; nn <= this -> degree; nn++){
+}
 
-      double n = (double) nn;
+void SBGATSphericalHarmo::EvaluateGravityGradientMatrix(const arma::vec::fixed<3> & pos,
+  arma::mat::fixed<3,3> & dAccdPos,
+  EvaluationWorkspace & workspace) const{
 
-      for (unsigned int mm = 0; mm<=nn; mm++){
+  this -> EvaluateTile(pos.memptr(),1,nullptr,nullptr,dAccdPos.memptr(),workspace);
 
-        double m = (double) mm;
-        double delta_1_m,delta_2_m;
+} 
 
-        if (mm == 1){
-          delta_1_m = 1.0;
-        }
-        else{
-          delta_1_m = 0.0;
-        } 
 
-        if (mm == 2){
-          delta_2_m = 1.0;
-        }
-        else{
-          delta_2_m = 0.0;
-        }
+void SBGATSphericalHarmo::GetPartialHarmonics(const arma::vec::fixed<3> & pos,
+  arma::mat & partial_C, 
+  arma::mat & partial_S){
 
-        double K1 = sqrt( (n+m+4.0) * (n+m+3.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
-        double K2 = sqrt( (n-m+2.0) * (n-m+1.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
-        double K3 = sqrt( 2.0 * (n-m+4.0) * (n-m+3.0) * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_2_m) / (2.0*n+5.0) );
-        double K4 = sqrt( (n+5.0) * (n+4.0) * (n+3.0) * (n+2.0) * (2.0*n+1.0) / (2.0*n+5.0) );
-        double K5 = sqrt( (n+3.0) * (n+2.0) * (n+1.0) * n * (2.0*n+1.0) / (2.0*n+5.0) );
-        double K6 = sqrt( (n+4.0) * (n+3.0) * (n+2.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+5.0) );
-        double K7 = sqrt( (2.0*n+1.0) / (2.0*n+5.0) );
-        double K8 = sqrt( (n-m+1.0) * (n+m+3.0) * (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+5.0) );
-        double K9 = sqrt( 2.0 * (n+m+1.0) * (n-m+3.0) * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_1_m) / (2.0*n+5.0) );
-        double K10= sqrt( (n+3.0) * (n+2.0) * (n+1.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+5.0) );
+  thread_local EvaluationWorkspace workspace;
+  this -> ComputeBnm(pos.memptr(),1,workspace);
 
+  partial_C.set_size(3,static_cast<int>((this -> degree + 1) * (this -> degree + 2)/2));
+  partial_S.set_size(3,static_cast<int>((this -> degree + 1) * (this -> degree + 2)/2 - static_cast<int>(this -> degree + 1)));
 
-        /*// Partial expressions */
-        if (mm == 0){
+  // Armadillo matrices are column-major
+  this -> FillPartialHarmonics(workspace,0,partial_C.memptr(),partial_S.memptr(),1,3);
 
-          ddU_dxdx += 2.0 * K0 * ( this -> Cnm(nn,mm) * K6 * b_bar_real(nn+2,mm+2) -(n+2)*(n+1) * K7*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) );
-          ddU_dydy -= 2.0 * K0 * ( this -> Cnm(nn,mm) * K6 * b_bar_real(nn+2,mm+2) +(n+2)*(n+1) * K7*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) );
-          ddU_dxdy += 2.0 * K0 * ( this -> Cnm(nn,mm) * K6 * b_bar_imag(nn+2,mm+2) );
-          ddU_dxdz += 4.0 * K0 * ( this -> Cnm(nn,mm) * K10 * b_bar_real(nn+2,mm+1) );
-          ddU_dydz += 4.0 * K0 * ( this -> Cnm(nn,mm) * K10 * b_bar_imag(nn+2,mm+1) );
-          ddU_dzdz += 4.0 * K0 * ( this -> Cnm(nn,mm) * K2  * b_bar_real(nn+2,mm) );
+}
 
-        }
-        else if (mm == 1){
 
-          ddU_dxdx += K0 * ( this -> Cnm(nn,mm) * K4 * b_bar_real(nn+2,mm+2) +this -> Snm(nn,mm) * K4 * b_bar_imag(nn+2,mm+2) -3.0 * K5*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) -  K5*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm));
-          ddU_dydy -= K0 * ( this -> Cnm(nn,mm) * K4 * b_bar_real(nn+2,mm+2) +this -> Snm(nn,mm) * K4 * b_bar_imag(nn+2,mm+2) +  K5*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) +3.0 * K5*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm));
-          ddU_dxdy -= K0 * ( this -> Snm(nn,mm) * K4 * b_bar_real(nn+2,mm+2) -this -> Cnm(nn,mm) * K4 * b_bar_imag(nn+2,mm+2) +  K5*this -> Snm(nn,mm) * b_bar_real(nn+2,mm) +  K5*this -> Cnm(nn,mm) * b_bar_imag(nn+2,mm));
-          ddU_dxdz += 2.0 * K0 * ( this -> Cnm(nn,mm) * K8 * b_bar_real(nn+2,mm+1) +this -> Snm(nn,mm) * K8 * b_bar_imag(nn+2,mm+1) -  K9*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm-1) -K9*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm-1) );
-          ddU_dydz -= 2.0 * K0 * ( this -> Snm(nn,mm) * K8 * b_bar_real(nn+2,mm+1) -this -> Cnm(nn,mm) * K8 * b_bar_imag(nn+2,mm+1) +  K9*this -> Snm(nn,mm) * b_bar_real(nn+2,mm-1) -K9*this -> Cnm(nn,mm) * b_bar_imag(nn+2,mm-1) );
-          ddU_dzdz += 4.0 * K0 * ( this -> Cnm(nn,mm) * K2 * b_bar_real(nn+2,mm)   +this -> Snm(nn,mm) * K2 * b_bar_imag(nn+2,mm));
-        }
-        else{
+void SBGATSphericalHarmo::EvaluatePartialHarmonicsBatch(const arma::mat & positions,
+  double * design_matrix,
+  const size_t row_stride) const{
 
-          ddU_dxdx += K0 * (  this -> Cnm(nn,mm) * K1 * b_bar_real(nn+2,mm+2) +this -> Snm(nn,mm) * K1 * b_bar_imag(nn+2,mm+2) -2.0 * K2*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) -2.0 * K2*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm) +K3*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm-2) +K3*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm-2));
-          ddU_dydy -= K0 * (  this -> Cnm(nn,mm) * K1 * b_bar_real(nn+2,mm+2) +this -> Snm(nn,mm) * K1 * b_bar_imag(nn+2,mm+2) +2.0 * K2*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm) +2.0 * K2*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm) +K3*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm-2) +K3*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm-2));
-          ddU_dxdy += K0 * ( -this -> Snm(nn,mm) * K1 * b_bar_real(nn+2,mm+2) +this -> Cnm(nn,mm) * K1 * b_bar_imag(nn+2,mm+2) +K3*this -> Snm(nn,mm) * b_bar_real(nn+2,mm-2) -K3*this -> Cnm(nn,mm) * b_bar_imag(nn+2,mm-2));
-          ddU_dxdz += 2.0 * K0 * ( this -> Cnm(nn,mm) * K8 * b_bar_real(nn+2,mm+1) +this -> Snm(nn,mm) * K8 * b_bar_real(nn+2,mm+1) -  K9*this -> Cnm(nn,mm) * b_bar_real(nn+2,mm-1) -K9*this -> Snm(nn,mm) * b_bar_imag(nn+2,mm-1) );
-          ddU_dydz -= 2.0 * K0 * ( this -> Snm(nn,mm) * K8 * b_bar_real(nn+2,mm+1) -this -> Cnm(nn,mm) * K8 * b_bar_imag(nn+2,mm+1) +  K9*this -> Snm(nn,mm) * b_bar_real(nn+2,mm-1) -K9*this -> Cnm(nn,mm) * b_bar_imag(nn+2,mm-1) );
-          ddU_dzdz += 4.0 * K0 * ( this -> Cnm(nn,mm) * K2 * b_bar_real(nn+2,mm)   +this -> Snm(nn,mm) * K2 * b_bar_imag(nn+2,mm));
+  if (positions.n_rows != 3){
+    throw(std::runtime_error("In SBGATSphericalHarmo::EvaluatePartialHarmonicsBatch: positions must have 3 rows, got " + std::to_string(positions.n_rows)));
+  }
 
-        }
+  size_t n_C = (this -> degree + 1) * (this -> degree + 2) / 2;
+  size_t n_S = n_C - (this -> degree + 1);
 
-      } 
+  if (row_stride < n_C + n_S){
+    throw(std::runtime_error("In SBGATSphericalHarmo::EvaluatePartialHarmonicsBatch: the row stride (" + std::to_string(row_stride) 
+      + ") is smaller than the number of partials per row (" + std::to_string(n_C + n_S) + ")"));
+  }
 
-    } 
+  const int tile_size = SBGATSphericalHarmo::tileSize;
+  int N_points = positions.n_cols;
+  int N_tiles = (N_points + tile_size - 1) / tile_size;
 
-    dAccdPos(0,0) = ddU_dxdx;
-    dAccdPos(1,1) = ddU_dydy;
-    dAccdPos(2,2) = ddU_dzdz;
+  // Each epoch writes its own rows of the design matrix
+  #pragma omp parallel for
+  for (int tile = 0; tile < N_tiles; ++tile){
 
-    dAccdPos(0,1) = ddU_dxdy;
-    dAccdPos(1,0) = ddU_dxdy;
+    thread_local EvaluationWorkspace workspace;
 
-    dAccdPos(0,2) = ddU_dxdz;
-    dAccdPos(2,0) = ddU_dxdz;
+    int p0 = tile * tile_size;
+    int n_points = std::min(tile_size,N_points - p0);
 
-    dAccdPos(1,2) = ddU_dydz;
-    dAccdPos(2,1) = ddU_dydz;
+    this -> ComputeBnm(positions.colptr(p0),n_points,workspace);
 
+    for (int p = 0; p < n_points; ++p){
+      double * rows = design_matrix + 3 * static_cast<size_t>(p0 + p) * row_stride;
+      this -> FillPartialHarmonics(workspace,p,rows,rows + n_C,row_stride,1);
+    }
 
   }
 
-  catch(std::runtime_error & error){
-    std::cout << "an std::runtime_error occured inside SBGATSphericalHarmo::GetGravityGradientMatrix. returning zero matrix\n";
-    dAccdPos = arma::zeros<arma::mat>(3,3);
-  }
+}
 
-} 
 
-void SBGATSphericalHarmo::GetPartialHarmonics(const arma::vec::fixed<3> & pos,
-  arma::mat & partial_C, 
-  arma::mat & partial_S){
+void SBGATSphericalHarmo::FillPartialHarmonics(const EvaluationWorkspace & workspace,
+  const int point,
+  double * partial_C,
+  double * partial_S,
+  const size_t component_stride,
+  const size_t coef_stride) const{
 
   int Ccounter = 0;
   int Scounter = 0;
 
-  int n_max = 50;
   double mu = this -> totalMass * arma::datum::G;
 
   double K0 = 0.5 * mu / std::pow(this -> referenceRadius,2);
-  
-  arma::mat b_bar_real = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
-  arma::mat b_bar_imag = arma::zeros<arma::mat>(n_max + 3,n_max + 3);
 
-  SHARMLib::GetBnmNormalizedExterior(this -> degree,
-    b_bar_real,
-    b_bar_imag,
-    pos,
-    this -> referenceRadius);
+  auto b_bar_real = [&](int n,int m){return workspace.b_bar_real(point,BnmIndex(n,m));};
+  auto b_bar_imag = [&](int n,int m){return workspace.b_bar_imag(point,BnmIndex(n,m));};
 
-
-  partial_C.set_size(3,static_cast<int>((this -> degree + 1) * (this -> degree + 2)/2));
-  partial_S.set_size(3,static_cast<int>((this -> degree + 1) * (this -> degree + 2)/2 - static_cast<int>(this -> degree + 1)));
+  auto C = [&](int i,int k) -> double & {return partial_C[i * component_stride + k * coef_stride];};
+  auto S = [&](int i,int k) -> double & {return partial_S[i * component_stride + k * coef_stride];};
 
   for (unsigned int nn = 0; nn <= this -> degree; nn++){
 
-    double n = (double) nn;
-
     for (unsigned int mm = 0; mm<=nn; mm++){
 
-      double m = (double) mm;
-      double delta_1_m;
-
-      if (mm == 1){
-        delta_1_m = 1.0;
-      }
-      else{
-        delta_1_m = 0.0;
-      } 
-
-      double K1 = sqrt( (n+2.0) * (n+1.0) * (2.0*n+1.0) / 2.0 / (2.0*n+3.0) );
-      double K2 = sqrt( (n+m+2.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) );
-      double K3 = sqrt( 2.0 * (n-m+2.0) * (n-m+1.0) * (2.0*n+1.0) / (2.0 - delta_1_m) / (2.0*n+3.0) );
+      double K1 = this -> accelerationFactors(nn,mm,0);
+      double K2 = this -> accelerationFactors(nn,mm,1);
+      double K3 = this -> accelerationFactors(nn,mm,2);
+      double Kz = this -> accelerationFactors(nn,mm,3);
 
       if (mm == 0){
 
-        partial_C(0,Ccounter)   = - 2.0 * K0 * ( K1 * b_bar_real(nn+1,mm+1) );
-        partial_C(1,Ccounter) = - 2.0 * K0 * ( K1 * b_bar_imag(nn+1,mm+1) );
-        partial_C(2,Ccounter) = - 2.0 * K0 * ( sqrt( (n-m+1.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) ) * b_bar_real(nn+1,mm) );
+        C(0,Ccounter) = - 2.0 * K0 * ( K1 * b_bar_real(nn+1,mm+1) );
+        C(1,Ccounter) = - 2.0 * K0 * ( K1 * b_bar_imag(nn+1,mm+1) );
+        C(2,Ccounter) = - 2.0 * K0 * ( Kz * b_bar_real(nn+1,mm) );
         Ccounter += 1;
 
       }           
       else{
 
-        partial_C(0,Ccounter)   = K0 * ( -K2 * b_bar_real(nn+1,mm+1) +K3 * b_bar_real(nn+1,mm-1) );
-        partial_C(1,Ccounter) = K0 * ( -K2 * b_bar_imag(nn+1,mm+1) -K3 * b_bar_imag(nn+1,mm-1) );
-        partial_C(2,Ccounter) = -2.0 * K0 * ( sqrt( (n-m+1.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) ) * b_bar_real(nn+1,mm) );
+        C(0,Ccounter) = K0 * ( -K2 * b_bar_real(nn+1,mm+1) +K3 * b_bar_real(nn+1,mm-1) );
+        C(1,Ccounter) = K0 * ( -K2 * b_bar_imag(nn+1,mm+1) -K3 * b_bar_imag(nn+1,mm-1) );
+        C(2,Ccounter) = -2.0 * K0 * ( Kz * b_bar_real(nn+1,mm) );
         Ccounter += 1;
         
-        partial_S(0,Scounter)   = K0 * ( -K2 * b_bar_imag(nn+1,mm+1) + K3 * b_bar_imag(nn+1,mm-1) );
-        partial_S(1,Scounter) = K0 * (  K2 * b_bar_real(nn+1,mm+1) + K3 * b_bar_real(nn+1,mm-1) );
-        partial_S(2,Scounter) = -2.0 * K0 * ( sqrt( (n-m+1.0) * (n+m+1.0) * (2.0*n+1.0) / (2.0*n+3.0) ) * b_bar_imag(nn+1,mm) );
+        S(0,Scounter) = K0 * ( -K2 * b_bar_imag(nn+1,mm+1) + K3 * b_bar_imag(nn+1,mm-1) );
+        S(1,Scounter) = K0 * (  K2 * b_bar_real(nn+1,mm+1) + K3 * b_bar_real(nn+1,mm-1) );
+        S(2,Scounter) = -2.0 * K0 * ( Kz * b_bar_imag(nn+1,mm) );
         Scounter += 1;
 
       } 
@@ -461,8 +1445,6 @@ void SBGATSphericalHarmo::GetPartialHarmonics(const arma::vec::fixed<3> & pos,
 
   }
 
-
-
 }
 
 
@@ -539,6 +1521,8 @@ void SBGATSphericalHarmo::SaveToJson(std::string path) const{
 
 void SBGATSphericalHarmo::LoadFromJson(std::string path){
 
+  this -> ReleaseCoefficientsMapping();
+
   // The JSON container is created
   nlohmann::json spherical_harmo_json;
 
@@ -559,6 +1543,7 @@ void SBGATSphericalHarmo::LoadFromJson(std::string path){
 
   this -> normalized = spherical_harmo_json.at("normalized");
   this -> degree = spherical_harmo_json.at("degree");
+  this -> ComputeEvaluationTables();
 
   this -> Cnm.clear();
   this -> Snm.clear();
@@ -594,6 +1579,169 @@ void SBGATSphericalHarmo::LoadFromJson(std::string path){
 
 }
 
+void SBGATSphericalHarmo::SaveToBinary(std::string path) const{
+
+  SphericalHarmoBinaryHeader header;
+  std::memset(&header,0,sizeof(header));
+  std::memcpy(header.magic,spherical_harmo_binary_magic,sizeof(header.magic));
+  header.version = spherical_harmo_binary_version;
+  header.normalized = this -> normalized ? 1 : 0;
+  header.degree = this -> degree;
+  header.n_facets = this -> n_facets;
+  header.n_vertices = this -> n_vertices;
+  header.referenceRadius = this -> referenceRadius;
+  header.totalMass = this -> totalMass;
+  header.density = this -> density;
+
+  if (this -> Cnm.n_rows != this -> degree + 1 || this -> Cnm.n_cols != this -> degree + 1 
+    || this -> Snm.n_rows != this -> degree + 1 || this -> Snm.n_cols != this -> degree + 1){
+    throw(std::runtime_error("In SBGATSphericalHarmo::SaveToBinary: the coefficients are inconsistent with the degree of the expansion"));
+  }
+
+  std::ofstream o(path,std::ios::binary);
+  o.write(reinterpret_cast<const char *>(&header),sizeof(header));
+  o.write(reinterpret_cast<const char *>(this -> Cnm.memptr()),this -> Cnm.n_elem * sizeof(double));
+  o.write(reinterpret_cast<const char *>(this -> Snm.memptr()),this -> Snm.n_elem * sizeof(double));
+
+  if (!o){
+    throw(std::runtime_error("In SBGATSphericalHarmo::SaveToBinary: could not write to " + path));
+  }
+
+}
+
+void SBGATSphericalHarmo::LoadFromBinary(std::string path,bool memory_map){
+
+  this -> ReleaseCoefficientsMapping();
+
+  std::ifstream i(path,std::ios::binary | std::ios::ate);
+  if (!i){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: could not open " + path));
+  }
+
+  std::streamoff end = i.tellg();
+  if (end < 0){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: could not get the size of " + path));
+  }
+
+  size_t file_size = static_cast<size_t>(end);
+  i.seekg(0);
+
+  SphericalHarmoBinaryHeader header;
+  if (file_size < sizeof(header) || !i.read(reinterpret_cast<char *>(&header),sizeof(header))){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: " + path + " is too short to hold a header"));
+  }
+
+  if (std::memcmp(header.magic,spherical_harmo_binary_magic,sizeof(header.magic)) != 0){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: " + path + " is not a spherical harmonics binary file"));
+  }
+
+  if (header.version != spherical_harmo_binary_version){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: unsupported format version " + std::to_string(header.version) 
+      + " in " + path + ". The file may also have been written on a machine of different endianness"));
+  }
+
+  // The degree is bounded before it is used to size anything, so that a corrupted 
+  // header cannot cause an overflow or a huge allocation/mapping
+  if (header.degree > spherical_harmo_binary_max_degree){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: the degree read from " + path + " (" + std::to_string(header.degree) 
+      + ") exceeds the maximum supported degree (" + std::to_string(spherical_harmo_binary_max_degree) + ")"));
+  }
+
+  uint64_t n_coefs = (header.degree + 1) * (header.degree + 1);
+
+  if (n_coefs > (std::numeric_limits<uint64_t>::max() - sizeof(header)) / (2 * sizeof(double))){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: the size of the coefficients read from " + path + " overflows"));
+  }
+
+  uint64_t expected_size = sizeof(header) + 2 * n_coefs * sizeof(double);
+
+  if (static_cast<uint64_t>(file_size) != expected_size){
+    throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: the size of " + path + " (" + std::to_string(file_size) 
+      + " bytes) is inconsistent with the degree of the expansion (" + std::to_string(header.degree) + ")"));
+  }
+
+  this -> density = header.density;
+  this -> referenceRadius = header.referenceRadius;
+  this -> totalMass = header.totalMass;
+  this -> normalized = (header.normalized == 1);
+  this -> degree = header.degree;
+  this -> n_facets = header.n_facets;
+  this -> n_vertices = header.n_vertices;
+  this -> ComputeEvaluationTables();
+
+  bool mapped = false;
+
+#ifdef SBGAT_SPHERICAL_HARMO_MMAP
+  if (memory_map){
+
+    int fd = open(path.c_str(),O_RDONLY);
+    if (fd < 0){
+      throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: could not open " + path));
+    }
+
+    // The mapping is private and writable so that the pages are shared between processes
+    // until (and unless) the coefficients get modified
+    void * mapping = mmap(nullptr,file_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+
+    if (mapping == MAP_FAILED){
+      throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: could not map " + path));
+    }
+
+    this -> coefficientsMapping = mapping;
+    this -> coefficientsMappingSize = file_size;
+
+    double * coefs = reinterpret_cast<double *>(static_cast<char *>(mapping) + sizeof(header));
+
+    // The coefficients use the mapped pages as auxiliary memory, without copy
+    this -> Cnm = arma::mat(coefs,this -> degree + 1,this -> degree + 1,false,false);
+    this -> Snm = arma::mat(coefs + n_coefs,this -> degree + 1,this -> degree + 1,false,false);
+
+    mapped = true;
+
+  }
+#endif
+
+  // Buffered reads, also used where memory mapping is not available
+  if (!mapped){
+
+    this -> Cnm.set_size(this -> degree + 1,this -> degree + 1);
+    this -> Snm.set_size(this -> degree + 1,this -> degree + 1);
+
+    i.read(reinterpret_cast<char *>(this -> Cnm.memptr()),n_coefs * sizeof(double));
+    i.read(reinterpret_cast<char *>(this -> Snm.memptr()),n_coefs * sizeof(double));
+
+    if (!i){
+      throw(std::runtime_error("In SBGATSphericalHarmo::LoadFromBinary: could not read the coefficients from " + path));
+    }
+
+  }
+
+  this -> setFromJSON = true;
+
+  // See LoadFromJson
+  vtkSmartPointer<vtkPolyData> empty_polydata = vtkSmartPointer<vtkPolyData>::New();
+  this -> SetInputData(empty_polydata);
+
+}
+
+void SBGATSphericalHarmo::ReleaseCoefficientsMapping(){
+
+  if (this -> coefficientsMapping == nullptr){
+    return;
+  }
+
+  this -> Cnm.reset();
+  this -> Snm.reset();
+
+#ifdef SBGAT_SPHERICAL_HARMO_MMAP
+  munmap(this -> coefficientsMapping,this -> coefficientsMappingSize);
+#endif
+  this -> coefficientsMapping = nullptr;
+  this -> coefficientsMappingSize = 0;
+
+}
+
 //----------------------------------------------------------------------------
 void SBGATSphericalHarmo::PrintSelf(std::ostream& os, vtkIndent indent){
 
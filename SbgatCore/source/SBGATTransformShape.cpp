@@ -8,10 +8,7 @@
 void SBGATTransformShape::ShiftShapeToBarycenter(vtkSmartPointer<vtkPolyData> & shape){
 
 	vtkSmartPointer<SBGATMassProperties> center_of_mass_filter =
-	vtkSmartPointer<SBGATMassProperties>::New();
-
-	center_of_mass_filter -> SetInputData(shape);
-	center_of_mass_filter -> Update();
+	SBGATMassProperties::GetSharedMassProperties(shape,true);
 
 	arma::vec com_translation = - center_of_mass_filter -> GetCenterOfMass();
 	SBGATTransformShape::Translate(com_translation,shape);
@@ -0,0 +1,363 @@
+/** MIT License
+
+Copyright (c) 2018 Benjamin Bercovici and Jay McMahon
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SBGATTriangleBVH.hpp"
+
+#include <vtkIdList.h>
+#include <vtkSmartPointer.h>
+#include <vtkCellType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+SBGATTriangleBVH::SBGATTriangleBVH(){
+
+}
+
+
+void SBGATTriangleBVH::Build(vtkPolyData * polydata){
+
+	this -> nodes.clear();
+	this -> blocks.clear();
+
+	int N_f = static_cast<int>(polydata -> GetNumberOfCells());
+	this -> number_of_triangles = N_f;
+
+	if (N_f == 0){
+		return;
+	}
+
+	std::vector<double> vertices(9 * N_f);
+	std::vector<double> centroids(3 * N_f);
+	std::vector<int> indices(N_f);
+
+	double lower[3] = {std::numeric_limits<double>::infinity(),std::numeric_limits<double>::infinity(),std::numeric_limits<double>::infinity()};
+	double upper[3] = {-std::numeric_limits<double>::infinity(),-std::numeric_limits<double>::infinity(),-std::numeric_limits<double>::infinity()};
+
+	vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+	ptIds -> Allocate(VTK_CELL_SIZE);
+
+	for (int f = 0; f < N_f; ++f){
+
+		if (polydata -> GetCellType(f) != VTK_TRIANGLE){
+			throw(std::runtime_error("In SBGATTriangleBVH::Build: input data type must be VTK_TRIANGLE not " + std::to_string(polydata -> GetCellType(f))));
+		}
+
+		polydata -> GetCellPoints(f,ptIds);
+
+		for (int v = 0; v < 3; ++v){
+			polydata -> GetPoint(ptIds -> GetId(v),vertices.data() + 9 * f + 3 * v);
+		}
+
+		for (int i = 0; i < 3; ++i){
+			centroids[3 * f + i] = (vertices[9 * f + i] + vertices[9 * f + 3 + i] + vertices[9 * f + 6 + i]) / 3;
+			for (int v = 0; v < 3; ++v){
+				lower[i] = std::min(lower[i],vertices[9 * f + 3 * v + i]);
+				upper[i] = std::max(upper[i],vertices[9 * f + 3 * v + i]);
+			}
+		}
+
+		indices[f] = f;
+
+	}
+
+	// The boxes are slightly inflated so that flat boxes (e.g around axis-aligned facets) remain robust
+	this -> padding = 1e-9 * std::sqrt(std::pow(upper[0] - lower[0],2) + std::pow(upper[1] - lower[1],2) + std::pow(upper[2] - lower[2],2));
+
+	this -> nodes.reserve(2 * (N_f / LeafWidth + 1));
+	this -> blocks.reserve(N_f / LeafWidth + 1);
+
+	this -> build_node(indices,0,N_f,vertices,centroids,0);
+
+}
+
+
+void SBGATTriangleBVH::build_node(std::vector<int> & indices,
+	int begin,
+	int end,
+	const std::vector<double> & vertices,
+	const std::vector<double> & centroids,
+	int depth){
+
+	if (depth >= MaxDepth){
+		throw(std::runtime_error("In SBGATTriangleBVH::build_node: maximum depth exceeded"));
+	}
+
+	// Nodes are referred to by index since the node vector grows during the build
+	int node_index = static_cast<int>(this -> nodes.size());
+	this -> nodes.push_back(Node());
+
+	double lower[3] = {std::numeric_limits<double>::infinity(),std::numeric_limits<double>::infinity(),std::numeric_limits<double>::infinity()};
+	double upper[3] = {-std::numeric_limits<double>::infinity(),-std::numeric_limits<double>::infinity(),-std::numeric_limits<double>::infinity()};
+	double centroid_lower[3] = {lower[0],lower[1],lower[2]};
+	double centroid_upper[3] = {upper[0],upper[1],upper[2]};
+
+	for (int k = begin; k < end; ++k){
+		int f = indices[k];
+		for (int i = 0; i < 3; ++i){
+			for (int v = 0; v < 3; ++v){
+				lower[i] = std::min(lower[i],vertices[9 * f + 3 * v + i]);
+				upper[i] = std::max(upper[i],vertices[9 * f + 3 * v + i]);
+			}
+			centroid_lower[i] = std::min(centroid_lower[i],centroids[3 * f + i]);
+			centroid_upper[i] = std::max(centroid_upper[i],centroids[3 * f + i]);
+		}
+	}
+
+	for (int i = 0; i < 3; ++i){
+		this -> nodes[node_index].lower[i] = lower[i] - this -> padding;
+		this -> nodes[node_index].upper[i] = upper[i] + this -> padding;
+	}
+
+	if (end - begin <= LeafWidth){
+
+		TriangleBlock block;
+		for (int lane = 0; lane < LeafWidth; ++lane){
+			for (int i = 0; i < 3; ++i){
+				if (begin + lane < end){
+					int f = indices[begin + lane];
+					block.v0[i][lane] = vertices[9 * f + i];
+					block.e1[i][lane] = vertices[9 * f + 3 + i] - vertices[9 * f + i];
+					block.e2[i][lane] = vertices[9 * f + 6 + i] - vertices[9 * f + i];
+				}
+				else{
+					block.v0[i][lane] = 0;
+					block.e1[i][lane] = 0;
+					block.e2[i][lane] = 0;
+				}
+			}
+		}
+
+		this -> nodes[node_index].offset = static_cast<int>(this -> blocks.size());
+		this -> nodes[node_index].is_leaf = 1;
+		this -> blocks.push_back(block);
+		return;
+	}
+
+	// The triangles are split at the median of their centroids along the widest axis
+	int axis = 0;
+	for (int i = 1; i < 3; ++i){
+		if (centroid_upper[i] - centroid_lower[i] > centroid_upper[axis] - centroid_lower[axis]){
+			axis = i;
+		}
+	}
+
+	int mid = (begin + end) / 2;
+	std::nth_element(indices.begin() + begin,indices.begin() + mid,indices.begin() + end,
+		[&centroids,axis](int a, int b){ return centroids[3 * a + axis] < centroids[3 * b + axis]; });
+
+	this -> build_node(indices,begin,mid,vertices,centroids,depth + 1);
+
+	this -> nodes[node_index].offset = static_cast<int>(this -> nodes.size());
+	this -> nodes[node_index].is_leaf = 0;
+
+	this -> build_node(indices,mid,end,vertices,centroids,depth + 1);
+
+}
+
+
+bool SBGATTriangleBVH::intersect_box(const double * origin, const double * inv_dir, const Node & node){
+
+	double t_lower = 0;
+	double t_upper = 1;
+
+	for (int i = 0; i < 3; ++i){
+		double t_a = (node.lower[i] - origin[i]) * inv_dir[i];
+		double t_b = (node.upper[i] - origin[i]) * inv_dir[i];
+		if (t_a > t_b){
+			std::swap(t_a,t_b);
+		}
+
+		// Written so that NaNs (ray parallel to and on a slab boundary) leave the interval unchanged
+		t_lower = t_a > t_lower ? t_a : t_lower;
+		t_upper = t_b < t_upper ? t_b : t_upper;
+	}
+
+	return t_lower <= t_upper;
+
+}
+
+
+bool SBGATTriangleBVH::intersect_block(const double * origin, const double * dir, const double t_min, const TriangleBlock & block){
+
+	int hit = 0;
+
+	// Moller-Trumbore test over all the lanes of the block.
+	// Degenerate lanes have a zero determinant and are never hit
+	#pragma omp simd reduction(|:hit)
+	for (int lane = 0; lane < LeafWidth; ++lane){
+
+		double p_x = dir[1] * block.e2[2][lane] - dir[2] * block.e2[1][lane];
+		double p_y = dir[2] * block.e2[0][lane] - dir[0] * block.e2[2][lane];
+		double p_z = dir[0] * block.e2[1][lane] - dir[1] * block.e2[0][lane];
+
+		double det = block.e1[0][lane] * p_x + block.e1[1][lane] * p_y + block.e1[2][lane] * p_z;
+		double inv_det = 1. / det;
+
+		double s_x = origin[0] - block.v0[0][lane];
+		double s_y = origin[1] - block.v0[1][lane];
+		double s_z = origin[2] - block.v0[2][lane];
+
+		double u = (s_x * p_x + s_y * p_y + s_z * p_z) * inv_det;
+
+		double q_x = s_y * block.e1[2][lane] - s_z * block.e1[1][lane];
+		double q_y = s_z * block.e1[0][lane] - s_x * block.e1[2][lane];
+		double q_z = s_x * block.e1[1][lane] - s_y * block.e1[0][lane];
+
+		double v = (dir[0] * q_x + dir[1] * q_y + dir[2] * q_z) * inv_det;
+		double t = (block.e2[0][lane] * q_x + block.e2[1][lane] * q_y + block.e2[2][lane] * q_z) * inv_det;
+
+		hit |= (det != 0) & (u >= 0) & (v >= 0) & (u + v <= 1) & (t >= t_min) & (t <= 1);
+
+	}
+
+	return hit != 0;
+
+}
+
+
+bool SBGATTriangleBVH::AnyHit(const double * start, const double * end, const double tol) const{
+
+	if (this -> nodes.empty()){
+		return false;
+	}
+
+	double dir[3];
+	double inv_dir[3];
+	for (int i = 0; i < 3; ++i){
+		dir[i] = end[i] - start[i];
+		inv_dir[i] = 1. / dir[i];
+	}
+
+	double length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+	if (length == 0){
+		return false;
+	}
+	double t_min = tol / length;
+
+	int stack[MaxDepth + 1];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0){
+
+		int node_index = stack[--top];
+		const Node & node = this -> nodes[node_index];
+
+		if (!SBGATTriangleBVH::intersect_box(start,inv_dir,node)){
+			continue;
+		}
+
+		if (node.is_leaf){
+			if (SBGATTriangleBVH::intersect_block(start,dir,t_min,this -> blocks[node.offset])){
+				return true;
+			}
+		}
+		else{
+			stack[top++] = node.offset;
+			stack[top++] = node_index + 1;
+		}
+
+	}
+
+	return false;
+
+}
+
+
+void SBGATTriangleBVH::AnyHitPacket(const double * starts, const double * ends, const int n_rays, const double tol, bool * hits) const{
+
+	if (n_rays > PacketSize){
+		throw(std::runtime_error("In SBGATTriangleBVH::AnyHitPacket: packets hold at most " + std::to_string(PacketSize) + " rays, not " + std::to_string(n_rays)));
+	}
+
+	if (this -> nodes.empty()){
+		return;
+	}
+
+	double dir[PacketSize][3];
+	double inv_dir[PacketSize][3];
+	double t_min[PacketSize];
+	bool active[PacketSize];
+	int n_active = 0;
+
+	for (int r = 0; r < n_rays; ++r){
+
+		for (int i = 0; i < 3; ++i){
+			dir[r][i] = ends[3 * r + i] - starts[3 * r + i];
+			inv_dir[r][i] = 1. / dir[r][i];
+		}
+
+		double length = std::sqrt(dir[r][0] * dir[r][0] + dir[r][1] * dir[r][1] + dir[r][2] * dir[r][2]);
+		active[r] = !hits[r] && length > 0;
+
+		if (active[r]){
+			t_min[r] = tol / length;
+			++n_active;
+		}
+
+	}
+
+	int stack[MaxDepth + 1];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0 && n_active > 0){
+
+		int node_index = stack[--top];
+		const Node & node = this -> nodes[node_index];
+
+		// The node is visited if any of the active rays crosses its box
+		bool crosses[PacketSize];
+		bool any_crosses = false;
+		for (int r = 0; r < n_rays; ++r){
+			crosses[r] = active[r] && SBGATTriangleBVH::intersect_box(starts + 3 * r,inv_dir[r],node);
+			any_crosses = any_crosses || crosses[r];
+		}
+
+		if (!any_crosses){
+			continue;
+		}
+
+		if (node.is_leaf){
+			const TriangleBlock & block = this -> blocks[node.offset];
+			for (int r = 0; r < n_rays; ++r){
+				if (crosses[r] && SBGATTriangleBVH::intersect_block(starts + 3 * r,dir[r],t_min[r],block)){
+					hits[r] = true;
+					active[r] = false;
+					--n_active;
+				}
+			}
+		}
+		else{
+			stack[top++] = node.offset;
+			stack[top++] = node_index + 1;
+		}
+
+	}
+
+}
@@ -59,7 +59,8 @@ namespace SBGAT_GUI {
 \brief SurfacePGMWindow class defining a window where a user 
 evaluate the Polyhedron Gravity Model of a shape model
 \details Enables computation of surface potential, inertial accelerations, 
-body-frame accelerations and surface slopes
+body-frame accelerations and surface slopes, and of their variances 
+arising from an uncertain shape
 */
 
 	class SurfacePGMWindow : public QDialog {
@@ -76,6 +77,7 @@ body-frame accelerations and surface slopes
 		private slots:
 		
 		void compute_surface_pgm();
+		void compute_surface_pgm_uq();
 		void load_surface_pgm();
 
 		/**
@@ -100,8 +102,12 @@ body-frame accelerations and surface slopes
 		QPushButton * open_output_file_dialog_button;
 
 		QPushButton * compute_surface_pgm_button;
+		QPushButton * compute_surface_pgm_uq_button;
 		QPushButton * load_surface_pgm_button;
 
+		QDoubleSpinBox * sigma_sbox;
+		QDoubleSpinBox * correlation_length_sbox;
+
 		ShapePropertiesWidget * primary_shape_properties_widget;
 
 		std::string output_path;
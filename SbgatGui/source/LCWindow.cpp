@@ -177,24 +177,17 @@ void LCWindow::collect_observations(){
 	SBGATObsLightcurve * lc = SBGATObsLightcurve::SafeDownCast(this -> observation_filter);
 
 
-	for (unsigned int t = 0; t < imaging_times.size(); ++t){
-
-
-
-		lc -> CollectMeasurements(
-			this -> measurements,
-			imaging_times[t],
-			this -> N_samples_sbox -> value(),
-			sun_dir,
-			observer_dir,
-			positions_vec[t],
-			velocities_vec[t], 
-			mrps_vec[t],
-			omegas_vec[t],
-			this -> penalize_incidence_box -> isChecked());
-
-
-	}
+	lc -> CollectMeasurementsSequence(
+		this -> measurements,
+		imaging_times,
+		this -> N_samples_sbox -> value(),
+		sun_dir,
+		observer_dir,
+		positions_vec,
+		velocities_vec, 
+		mrps_vec,
+		omegas_vec,
+		this -> penalize_incidence_box -> isChecked());
 
 
 	this -> open_visualizer_button -> setEnabled(1);
@@ -608,10 +608,7 @@ void Mainwindow::add_shape() {
 
             // The camera is moved to be adjusted to the new shape
         vtkSmartPointer<SBGATMassProperties> center_of_mass_filter =
-        vtkSmartPointer<SBGATMassProperties>::New();
-
-        center_of_mass_filter -> SetInputData(polygonPolyData);
-        center_of_mass_filter -> Update();
+        SBGATMassProperties::GetSharedMassProperties(polygonPolyData,true);
         
         this -> renderer -> GetActiveCamera() -> SetPosition(0, 0, 10 * std::cbrt(3./4. / arma::datum::pi * center_of_mass_filter -> GetVolume()) );
 
@@ -702,10 +699,7 @@ void Mainwindow::align_shape(){
     std::string name = this  -> prop_table -> item(selected_row_index, 0) -> text() .toStdString();
 
     vtkSmartPointer<SBGATMassProperties> center_of_mass_filter =
-    vtkSmartPointer<SBGATMassProperties>::New();
-
-    center_of_mass_filter -> SetInputData(this -> wrapped_shape_data[name] -> get_polydata());
-    center_of_mass_filter -> Update();
+    SBGATMassProperties::GetSharedMassProperties(this -> wrapped_shape_data[name] -> get_polydata(),true);
 
     double center[3];
     center_of_mass_filter -> GetCenterOfMass(center);
@@ -925,9 +919,7 @@ void Mainwindow::compute_geometric_measures(){
  std::chrono::time_point<std::chrono::system_clock> start, end;
  start = std::chrono::system_clock::now();
 
- vtkSmartPointer<SBGATMassProperties> mass_properties_filter = vtkSmartPointer<SBGATMassProperties>::New();
- mass_properties_filter -> SetInputData(this -> wrapped_shape_data[name] -> get_polydata());
- mass_properties_filter -> Update();
+ vtkSmartPointer<SBGATMassProperties> mass_properties_filter = SBGATMassProperties::GetSharedMassProperties(this -> wrapped_shape_data[name] -> get_polydata(),true);
  end = std::chrono::system_clock::now();
  std::chrono::duration<double> elapsed_seconds = end - start;
 
@@ -222,11 +222,8 @@ void ObsWindow::add_state_history(ShapePropertiesWidget * shape_properties_widge
 
 
 	auto shape_data = this -> parent -> get_wrapped_shape_data();
-	vtkSmartPointer<SBGATMassProperties> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
 	std::string primary_name = this -> primary_prop_combo_box -> currentText().toStdString();
-	mass_properties -> SetInputData(shape_data[primary_name] -> get_polydata());
-
-	mass_properties -> Update();
+	vtkSmartPointer<SBGATMassProperties> mass_properties = SBGATMassProperties::GetSharedMassProperties(shape_data[primary_name] -> get_polydata(),true);
 
 
 
@@ -181,18 +181,15 @@ void RadarWindow::collect_observations(){
 
 	SBGATObsRadar * radar = SBGATObsRadar::SafeDownCast(this -> observation_filter);
 
-	for (unsigned int t = 0; t < imaging_times.size(); ++t){
-
-		radar -> CollectMeasurements(this -> measurement_sequence,
-			imaging_times[t],
-			this -> N_samples_sbox -> value(),
-			radar_dir,
-			positions_vec[t],
-			velocities_vec[t], 
-			mrps_vec[t],
-			omegas_vec[t],
-			this -> penalize_incidence_box -> isChecked());
-	}
+	radar -> CollectMeasurementsSequence(this -> measurement_sequence,
+		imaging_times,
+		this -> N_samples_sbox -> value(),
+		radar_dir,
+		positions_vec,
+		velocities_vec, 
+		mrps_vec,
+		omegas_vec,
+		this -> penalize_incidence_box -> isChecked());
 
 	
 
@@ -30,6 +30,7 @@ SOFTWARE.
 #include <SBGATTrajectory.hpp>
 #include <OrbitConversions.hpp>
 #include <SBGATPolyhedronGravityModel.hpp>
+#include <SBGATPolyhedronGravityModelUQ.hpp>
 
 using namespace SBGAT_GUI;
 
@@ -48,6 +49,7 @@ SurfacePGMWindow::SurfacePGMWindow(Mainwindow * parent) {
 
 	this -> compute_surface_pgm_button = new QPushButton("Compute Surface PGM",this);
 	this -> load_surface_pgm_button = new QPushButton("Load Surface PGM",this);
+	this -> compute_surface_pgm_uq_button = new QPushButton("Compute Surface PGM UQ",this);
 
 	this -> primary_prop_combo_box = new QComboBox (this);
 	this -> primary_shape_properties_widget = new ShapePropertiesWidget(this ,"Shape properties");
@@ -66,8 +68,22 @@ SurfacePGMWindow::SurfacePGMWindow(Mainwindow * parent) {
 	window_layout -> addWidget(select_shape_widget);
 
 	window_layout -> addWidget(this -> primary_shape_properties_widget);
+
+	QGroupBox * uncertainty_settings_group = new QGroupBox(tr("Shape uncertainty"));
+	QGridLayout * uncertainty_settings_group_layout = new QGridLayout(uncertainty_settings_group);
+
+	this -> sigma_sbox = new QDoubleSpinBox(this);
+	this -> correlation_length_sbox = new QDoubleSpinBox(this);
+
+	uncertainty_settings_group_layout -> addWidget(new QLabel("Standard deviation (m)",this),0,0,1,1);
+	uncertainty_settings_group_layout -> addWidget(this -> sigma_sbox,0,1,1,1);
+	uncertainty_settings_group_layout -> addWidget(new QLabel("Correlation length (m)",this),1,0,1,1);
+	uncertainty_settings_group_layout -> addWidget(this -> correlation_length_sbox,1,1,1,1);
+
+	window_layout -> addWidget(uncertainty_settings_group);
 	
 	button_widget_layout -> addWidget(this -> compute_surface_pgm_button);
+	button_widget_layout -> addWidget(this -> compute_surface_pgm_uq_button);
 	button_widget_layout -> addWidget(this -> load_surface_pgm_button);
 
 	window_layout -> addWidget(this -> open_output_file_dialog_button);
@@ -78,10 +94,12 @@ SurfacePGMWindow::SurfacePGMWindow(Mainwindow * parent) {
 
 
 	this -> compute_surface_pgm_button -> setEnabled(false);
+	this -> compute_surface_pgm_uq_button -> setEnabled(false);
 
 	this -> init();
 	connect(this -> button_box, SIGNAL(accepted()), this, SLOT(accept()));
 	connect(this -> compute_surface_pgm_button, SIGNAL(clicked()), this, SLOT(compute_surface_pgm()));
+	connect(this -> compute_surface_pgm_uq_button, SIGNAL(clicked()), this, SLOT(compute_surface_pgm_uq()));
 	connect(this -> load_surface_pgm_button, SIGNAL(clicked()), this, SLOT(load_surface_pgm()));
 	connect(this -> open_output_file_dialog_button,SIGNAL(clicked()),this,
 		SLOT(open_output_file_dialog()));
@@ -94,6 +112,15 @@ SurfacePGMWindow::SurfacePGMWindow(Mainwindow * parent) {
 
 void SurfacePGMWindow::init(){
 
+	this -> sigma_sbox -> setDecimals(6);
+	this -> correlation_length_sbox -> setDecimals(6);
+
+	this -> sigma_sbox -> setRange(1e-10,1e10);
+	this -> correlation_length_sbox -> setRange(1e-10,1e10);
+
+	this -> sigma_sbox -> setValue(1);
+	this -> correlation_length_sbox -> setValue(10);
+
 	auto wrapped_shape_data = this -> parent -> get_wrapped_shape_data();	
 	
 	
@@ -162,10 +189,7 @@ void SurfacePGMWindow::compute_surface_pgm(){
 	
 
 
-	vtkSmartPointer<SBGATMassProperties> mass_properties = vtkSmartPointer<SBGATMassProperties>::New();
-
-	mass_properties -> SetInputData(selected_shape);
-	mass_properties -> Update();
+	vtkSmartPointer<SBGATMassProperties> mass_properties = SBGATMassProperties::GetSharedMassProperties(selected_shape,true);
 	double mass = mass_properties -> GetVolume() * this -> primary_shape_properties_widget -> get_density();
 
 	SBGATPolyhedronGravityModel::SaveSurfacePGM(selected_shape,
@@ -214,6 +238,100 @@ void SurfacePGMWindow::compute_surface_pgm(){
 
 
 
+}
+
+
+void SurfacePGMWindow::compute_surface_pgm_uq(){
+
+	std::string selected_shape_name = this -> primary_prop_combo_box -> currentText().toStdString();
+	vtkSmartPointer<vtkPolyData> selected_shape = this -> parent -> get_wrapped_shape_data()[selected_shape_name]-> get_polydata();
+
+	arma::vec::fixed<3> omega = this -> primary_shape_properties_widget -> get_spin();
+
+	if (this -> primary_shape_properties_widget -> get_period() == 0){
+		QMessageBox::warning(this, "Evaluate Surface PGM UQ", "The rotation period must be strictly greater than 0!");
+		return;
+	}
+
+	std::string opening_line = "### Computing surface PGM uncertainty of " + selected_shape_name  + " ###";
+	this -> parent ->log_console -> appendPlainText(QString::fromStdString(opening_line));
+
+	omega *= 2 * arma::datum::pi / this -> primary_shape_properties_widget -> get_period();
+
+	std::vector<double> slopes_variances,
+	inertial_potentials_variances,
+	body_fixed_potentials_variances,
+	inertial_acc_magnitudes_variances,
+	body_fixed_acc_magnitudes_variances;
+
+	int numCells = selected_shape -> GetNumberOfCells();
+	std::vector<unsigned int> queried_elements;
+	
+	for (unsigned int i = 0; i < static_cast<unsigned int>(numCells); ++i){
+		queried_elements.push_back(i);
+	}
+
+	auto start = std::chrono::system_clock::now();
+
+	try{
+		SBGATPolyhedronGravityModelUQ::ComputeSurfacePGMUQ(selected_shape,
+			queried_elements,
+			true,
+			this -> primary_shape_properties_widget -> get_density(),
+			omega,
+			this -> sigma_sbox -> value(),
+			this -> correlation_length_sbox -> value(),
+			slopes_variances,
+			inertial_potentials_variances,
+			body_fixed_potentials_variances,
+			inertial_acc_magnitudes_variances,
+			body_fixed_acc_magnitudes_variances);
+	}
+	catch(std::runtime_error & e){
+		QMessageBox::warning(this, "Evaluate Surface PGM UQ", e.what());
+		return;
+	}
+
+	auto end = std::chrono::system_clock::now();
+
+	std::chrono::duration<double> elapsed_seconds = end-start;
+
+	vtkSmartPointer<SBGATMassProperties> mass_properties = SBGATMassProperties::GetSharedMassProperties(selected_shape,true);
+	double mass = mass_properties -> GetVolume() * this -> primary_shape_properties_widget -> get_density();
+
+	// The uncertainty is saved next to the surface PGM
+	std::string output_path_uq = this -> output_path;
+	std::size_t extension_pos = output_path_uq.rfind(".json");
+	if (extension_pos != std::string::npos){
+		output_path_uq.erase(extension_pos);
+	}
+	output_path_uq += "_uq.json";
+
+	SBGATPolyhedronGravityModelUQ::SaveSurfacePGMUQ(selected_shape,
+		queried_elements,
+		true,
+		mass,
+		omega,
+		this -> sigma_sbox -> value(),
+		this -> correlation_length_sbox -> value(),
+		slopes_variances,
+		inertial_potentials_variances,
+		body_fixed_potentials_variances,
+		inertial_acc_magnitudes_variances,
+		body_fixed_acc_magnitudes_variances,
+		output_path_uq);
+
+	std::string displayed_line = "- Saved surface-evaluated PGM uncertainty of " + selected_shape_name + " to " + output_path_uq;
+
+	this -> parent -> log_console -> appendPlainText(QString::fromStdString("- Done computing surface PGM uncertainty in " + std::to_string(elapsed_seconds.count()) +  " seconds."));
+	this -> parent -> log_console -> appendPlainText(QString::fromStdString(displayed_line));
+
+	std::string closing_line(opening_line.length() - 1, '#');
+
+	closing_line.append("\n");
+
+	this -> parent -> log_console -> appendPlainText(QString::fromStdString(closing_line));
+
 }
 
 
@@ -236,6 +354,7 @@ void SurfacePGMWindow::open_output_file_dialog(){
 
 	if (this -> output_path.size() > 0){
 		this -> compute_surface_pgm_button -> setEnabled(true);
+		this -> compute_surface_pgm_uq_button -> setEnabled(true);
 
 	}
 }
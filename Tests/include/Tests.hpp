@@ -37,6 +37,7 @@ namespace TestsSBCore {
 
 void run();
 void test_sbgat_mass_properties();
+void test_sbgat_shared_mass_properties();
 void test_sbgat_pgm_speed();
 void test_sbgat_pgm_cube();
 void test_sbgat_pgm_sphere();
@@ -44,16 +45,38 @@ void test_sbgat_transform_shape();
 
 void test_spherical_harmonics_coefs_consistency();
 void test_spherical_harmonics_partials_consistency();
+void test_spherical_harmonics_coefs_covariance();
+void test_spherical_harmonics_evaluator();
+void test_spherical_harmonics_batch();
+void test_spherical_harmonics_fixed_degree();
+void test_spherical_harmonics_potential();
+void test_spherical_harmonics_thread_reproducibility();
+void test_spherical_harmonics_binary_io();
+void test_spherical_harmonics_extend_degree();
+void test_spherical_harmonics_partials_batch();
 void test_sbgat_shape_uq();
 
 
 void test_radar_obs();
 void test_lightcurve_obs();
+void test_lightcurve_obs_reproducibility();
+void test_obs_facet_cache();
+void test_triangle_bvh();
+void test_radar_binning();
+void test_radar_streaming_images();
+void test_obs_rasterization();
+void test_obs_sampling_convergence();
+void test_obs_horizon_maps();
+void test_obs_broad_phase();
 void test_frame_conversion();
 void test_PGM_UQ_partials();
 void test_PGM_UQ_cube();
 void test_PGM_UQ_itokawa_km();
 void test_PGM_UQ_itokawa_m();
+void test_PGM_UQ_MC();
+void test_PGM_UQ_kernel_covariance();
+void test_PGM_UQ_surface();
+void test_PGM_UQ_trajectory();
 
 
 
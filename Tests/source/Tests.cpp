@@ -35,6 +35,7 @@ SOFTWARE.
 #include <SBGATTransformShape.hpp>
 #include <SBGATObjWriter.hpp>
 #include <SBGATPolyhedronGravityModelUQ.hpp>
+#include <SBGATTriangleBVH.hpp>
 
 #include <vtkCell.h>
 #include <vtkDataObject.h>
@@ -48,10 +49,16 @@ SOFTWARE.
 #include <vtkDoubleArray.h>
 #include <vtkFloatArray.h>
 #include <vtkCellData.h>
+#include <vtkPointData.h>
+#include <vtkImageData.h>
 #include <vtkSphereSource.h>
 #include <vtkCubeSource.h>
 #include <vtkPolyData.h>
 #include <assert.h>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
 #include <vtkTriangleFilter.h>
 #include <vtkCleanPolyData.h>
 #include <vtkOBJReader.h>
@@ -59,25 +66,58 @@ SOFTWARE.
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkLinearSubdivisionFilter.h>
+#include <vtkModifiedBSPTree.h>
+#include <vtkGenericCell.h>
+#include <vtkTriangle.h>
+#include <vtkPlatonicSolidSource.h>
+#include <vtkWeakPointer.h>
 #include <boost/progress.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 void TestsSBCore::run() {	
 	TestsSBCore::test_sbgat_transform_shape();
 	TestsSBCore::test_frame_conversion();
 	TestsSBCore::test_sbgat_mass_properties();
+	TestsSBCore::test_sbgat_shared_mass_properties();
 	TestsSBCore::test_sbgat_pgm_cube();
 	TestsSBCore::test_sbgat_pgm_sphere();
 	TestsSBCore::test_sbgat_pgm_speed();
 	TestsSBCore::test_spherical_harmonics_coefs_consistency();
 	TestsSBCore::test_spherical_harmonics_partials_consistency();
+	TestsSBCore::test_spherical_harmonics_coefs_covariance();
+	TestsSBCore::test_spherical_harmonics_evaluator();
+	TestsSBCore::test_spherical_harmonics_batch();
+	TestsSBCore::test_spherical_harmonics_fixed_degree();
+	TestsSBCore::test_spherical_harmonics_potential();
+	TestsSBCore::test_spherical_harmonics_thread_reproducibility();
+	TestsSBCore::test_spherical_harmonics_binary_io();
+	TestsSBCore::test_spherical_harmonics_extend_degree();
+	TestsSBCore::test_spherical_harmonics_partials_batch();
 	TestsSBCore::test_sbgat_shape_uq();
 
 	TestsSBCore::test_PGM_UQ_partials();
 	TestsSBCore::test_PGM_UQ_cube();
 	TestsSBCore::test_PGM_UQ_itokawa_m();
 	TestsSBCore::test_PGM_UQ_itokawa_km();
-
+	TestsSBCore::test_PGM_UQ_MC();
+	TestsSBCore::test_PGM_UQ_kernel_covariance();
+	TestsSBCore::test_PGM_UQ_surface();
+	TestsSBCore::test_PGM_UQ_trajectory();
+
+
+	TestsSBCore::test_triangle_bvh();
+	TestsSBCore::test_radar_binning();
+	TestsSBCore::test_radar_streaming_images();
+	TestsSBCore::test_lightcurve_obs_reproducibility();
+	TestsSBCore::test_obs_facet_cache();
+	TestsSBCore::test_obs_rasterization();
+	TestsSBCore::test_obs_sampling_convergence();
+	TestsSBCore::test_obs_horizon_maps();
+	TestsSBCore::test_obs_broad_phase();
 
 	// TestsSBCore::test_lightcurve_obs();
 	// TestsSBCore::test_radar_obs();
@@ -177,11 +217,143 @@ void TestsSBCore::test_sbgat_mass_properties(){
 
 	assert(std::abs(volume_itokawa_m - volume_itokawa_km) / volume_itokawa_m < 1e-7);
 
+	// Skipping the projected-volume diagnostics should not change the mass properties
+	arma::vec::fixed<3> com_itokawa = mass_filter -> GetCenterOfMass();
+	arma::mat::fixed<3,3> inertia_itokawa = mass_filter -> GetUnitDensityInertiaTensor();
+	double surface_area_itokawa = mass_filter -> GetSurfaceArea();
+
+	mass_filter -> SetComputeProjectedVolumes(false);
+	mass_filter -> Update();
+
+	assert(std::abs(mass_filter -> GetVolume() - volume_itokawa_m) / volume_itokawa_m < 1e-10);
+	assert(std::abs(mass_filter -> GetSurfaceArea() - surface_area_itokawa) / surface_area_itokawa < 1e-12);
+	assert(arma::norm(mass_filter -> GetCenterOfMass() - com_itokawa) / mass_filter -> GetAverageRadius() < 1e-10);
+	assert(arma::abs(mass_filter -> GetUnitDensityInertiaTensor() - inertia_itokawa).max() / arma::abs(inertia_itokawa).max() < 1e-10);
+	assert(std::isnan(mass_filter -> GetVolumeProjected()));
+	assert(mass_filter -> CheckClosed());
+
 	std::cout << "- Done running test_sbgat_mass_properties" << std::endl;
 
 }
 
 
+/**
+This test checks that the mass properties shared between filters are computed once per shape,
+recomputed when the shape is modified, and consistent with a standalone computation
+*/
+void TestsSBCore::test_sbgat_shared_mass_properties(){
+
+	std::cout << "- Running test_sbgat_shared_mass_properties ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	vtkSmartPointer<vtkPolyData> shape = reader -> GetOutput();
+
+	SBGATMassProperties::ClearSharedMassProperties();
+
+	vtkSmartPointer<SBGATMassProperties> shared = SBGATMassProperties::GetSharedMassProperties(shape,false);
+
+	// The same shape yields the same filter, unless its unit differs
+	assert(SBGATMassProperties::GetSharedMassProperties(shape,false) == shared);
+	assert(SBGATMassProperties::GetSharedMassProperties(shape,true) != shared);
+
+	vtkSmartPointer<SBGATMassProperties> mass_filter = vtkSmartPointer<SBGATMassProperties>::New();
+	mass_filter -> SetInputData(shape);
+	mass_filter -> SetScaleKiloMeters();
+	mass_filter -> SetComputeProjectedVolumes(false);
+	mass_filter -> Update();
+
+	assert(shared -> GetVolume() == mass_filter -> GetVolume());
+	assert(arma::norm(shared -> GetCenterOfMass() - mass_filter -> GetCenterOfMass()) == 0);
+	assert(shared -> GetCleanedShape() -> GetNumberOfCells() == shape -> GetNumberOfCells());
+
+	// The facet normals and edges are computed before the entry is shared
+	assert(arma::abs(shared -> GetCleanedShapeFacetNormals() - mass_filter -> GetCleanedShapeFacetNormals()).max() == 0);
+	assert(shared -> GetCleanedShapeEdges() == mass_filter -> GetCleanedShapeEdges());
+	assert(2 * shared -> GetCleanedShapeEdges().size() == 3 * shape -> GetNumberOfCells());
+	for (auto edge : shared -> GetCleanedShapeEdges()){
+		assert(edge[2] >= 0 && edge[3] >= 0);
+	}
+
+	// The cache does not keep the shapes alive
+	vtkSmartPointer<vtkPolyData> shape_copy = vtkSmartPointer<vtkPolyData>::New();
+	shape_copy -> DeepCopy(shape);
+	vtkWeakPointer<vtkPolyData> shape_copy_weak = shape_copy.GetPointer();
+	vtkSmartPointer<SBGATMassProperties> shared_copy = SBGATMassProperties::GetSharedMassProperties(shape_copy,false);
+	shape_copy = nullptr;
+	assert(shape_copy_weak.GetPointer() == nullptr);
+	assert(shared_copy -> GetVolume() == shared -> GetVolume());
+
+	// The filters processing the shape share the same mass properties
+	double density = 2000;
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputData(shape);
+	pgm_filter -> SetDensity(density);
+	pgm_filter -> SetScaleKiloMeters();
+	pgm_filter -> Update();
+
+	assert(std::abs(pgm_filter -> GetMass() - density * shared -> GetVolume()) / pgm_filter -> GetMass() < 1e-14);
+
+#ifdef _OPENMP
+	// Concurrent queries of the same shape get the same filter, computed once,
+	// while distinct shapes are computed concurrently
+	SBGATMassProperties::ClearSharedMassProperties();
+
+	// The queried shapes fit in the cache, so that no entry is evicted while being queried
+	const int N_queries = 4;
+	std::vector<vtkSmartPointer<vtkPolyData> > shape_copies(N_queries);
+	for (int i = 0; i < N_queries; ++i){
+		shape_copies[i] = vtkSmartPointer<vtkPolyData>::New();
+		shape_copies[i] -> DeepCopy(shape);
+	}
+
+	std::vector<vtkSmartPointer<SBGATMassProperties> > shared_same(N_queries);
+	std::vector<vtkSmartPointer<SBGATMassProperties> > shared_distinct(N_queries);
+
+	#pragma omp parallel for
+	for (int i = 0; i < 2 * N_queries; ++i){
+		if (i < N_queries){
+			shared_same[i] = SBGATMassProperties::GetSharedMassProperties(shape,false);
+		}
+		else{
+			shared_distinct[i - N_queries] = SBGATMassProperties::GetSharedMassProperties(shape_copies[i - N_queries],false);
+		}
+	}
+
+	for (int i = 0; i < N_queries; ++i){
+		assert(shared_same[i] == shared_same[0]);
+		assert(shared_distinct[i] != shared_same[0]);
+		assert(shared_distinct[i] -> GetVolume() == shared -> GetVolume());
+	}
+	assert(shared_same[0] -> GetVolume() == shared -> GetVolume());
+#endif
+
+	// Modifying the shape invalidates its shared mass properties
+	vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+	transform -> Translate(1,0,0);
+	vtkSmartPointer<vtkTransformPolyDataFilter> transform_filter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+	transform_filter -> SetInputData(shape);
+	transform_filter -> SetTransform(transform);
+	transform_filter -> Update();
+
+	shape -> DeepCopy(transform_filter -> GetOutput());
+
+	vtkSmartPointer<SBGATMassProperties> shared_modified = SBGATMassProperties::GetSharedMassProperties(shape,false);
+	assert(shared_modified != shared);
+
+	// The previously shared entry is frozen and still describes the unmodified shape
+	assert(std::abs(shared_modified -> GetCenterOfMass()(0) - shared -> GetCenterOfMass()(0) - 1000) < 1e-6);
+
+	SBGATMassProperties::ClearSharedMassProperties();
+
+	std::cout << "- Done running test_sbgat_shared_mass_properties" << std::endl;
+
+}
+
+
 /**
 This test computes the surface accelerations at the center of each facet over a polydata
 of KW4 for benchmarking purposes
@@ -1337,69 +1509,1970 @@ void TestsSBCore::test_PGM_UQ_itokawa_km(){
 }
 
 
+/**
+This test checks the Monte Carlo engine of SBGATPolyhedronGravityModelUQ against
+the analytical potential variance and acceleration covariance, and checks that it is reproducible
+*/
+void TestsSBCore::test_PGM_UQ_MC(){
 
+	std::cout << "- Running test_PGM_UQ_MC ..." << std::endl;
 
+	int N = 5000;
+	unsigned int seed = 0;
 
+	arma::vec::fixed<3> pos = {200,300,400};
+	double density = 1970;
 
+	std::string filename  = "../../resources/shape_models/skewed.obj";
 
-// TODO : reimplement these tests
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName(filename.c_str());
+	reader -> Update(); 
 
-// /**
-// This test computes simulated radar images for benchmarking purposes
-// */
-// void TestsSBCore::test_radar_obs(){
+	// Cleaning
+	vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+	cleaner -> SetInputConnection (reader -> GetOutputPort());
+	cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
+	cleaner -> Update();
 
-// 	std::cout << "- Running test_radar_obs ..." << std::endl;
+	// Creating the PGM dyads
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputConnection(cleaner -> GetOutputPort());
+	pgm_filter -> SetDensity(density); 
+	pgm_filter -> SetScaleMeters();
+	pgm_filter -> Update();
 
-// 	// Loading in the shape model
-// 	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
-// 	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
-// 	reader -> Update(); 
+	arma::vec::fixed<3> nom_acc;
+	double nom_pot;
+	pgm_filter -> GetPotentialAcceleration(pos,nom_pot,nom_acc);
 
-// 	// Creating the radar object
-// 	vtkSmartPointer<SBGATObsRadar> radar = vtkSmartPointer<SBGATObsRadar>::New();
-// 	radar -> SetInputConnection(reader -> GetOutputPort());
-// 	radar -> SetScaleKiloMeters();
-// 	radar -> Update();
+	int N_C = vtkPolyData::SafeDownCast(pgm_filter -> GetInput()) -> GetNumberOfPoints();
+	arma::mat P_CC = std::pow(1e-1,2) * arma::diagmat<arma::mat>( arma::ones<arma::vec>(3 * N_C));
 
+	SBGATPolyhedronGravityModelUQ shape_uq;
+	shape_uq.SetPGM(pgm_filter);
 
-// 	// Arguments
-// 	arma::vec spin = {0,0,1};
-// 	arma::vec dir = {1,0,0};
-// 	double period = 4 * 3600; // 4 hours
-// 	int images = 48; 
-// 	int N = 100;
+	for (int i = 0; i < N_C; ++i){
+		for (int j = 0; j <= i; ++j){
+			const arma::mat::fixed<3,3> & P = P_CC.submat(3 * i,3 * j, 3 * i + 2,3 * j + 2);
+			shape_uq.SetCovarianceComponent(P,i,j);
+			shape_uq.SetCovarianceComponent(P.t(),j,i);
+		}
+	}
 
-// 	double r_bin = 7.5;//(m)
-// 	double rr_bin = 7.9e-3;//(m/s)
+	shape_uq.ComputeCovarianceSquareRoot();
+	arma::mat C_CC = shape_uq.GetCovarianceSquareRoot();
+	assert(arma::abs(P_CC - C_CC * C_CC.t()).max() < 1e-10);
 
-// 	// A sequence of images is collected
-// 	SBGATRadarObsSequence measurement_sequence;
-// 	auto start = std::chrono::system_clock::now();
+	double variance_U_analytical = shape_uq.GetVariancePotential(pos);
+	arma::mat::fixed<3,3> covariance_A_analytical = shape_uq.GetCovarianceAcceleration(pos);
 
-// 	for (int i  = 0; i < images; ++i){
-// 		double dt = 1.5 * double(i) / ((images - 1)) * period;
+	arma::mat points = pos;
+	arma::vec potential_mean,potential_var;
+	arma::mat acc_mean;
+	arma::cube acc_cov;
 
-// 		std::cout << " --- Ray tracing " +std::to_string(i + 1) + "/" +std::to_string(images) + " ...\n";
+	auto start = std::chrono::system_clock::now();
+	shape_uq.RunMonteCarlo(points,N,seed,potential_mean,potential_var,acc_mean,acc_cov);
+	auto end = std::chrono::system_clock::now();
 
-// 		radar -> CollectMeasurementsSimpleSpin(measurement_sequence,N,dt,period,dir,spin);
-// 	}
+	std::chrono::duration<double> elapsed_seconds = end-start;
+	std::cout << "\tMC of potential and acceleration computed in " << elapsed_seconds.count() << " seconds\n";
+	std::cout << "\tMC variance in potential: " << potential_var(0) << std::endl;
+	std::cout << "\tAnalytical variance in potential: " << variance_U_analytical << std::endl;
+	std::cout << "\tMC covariance in acceleration: \n" << acc_cov.slice(0) << std::endl;
+	std::cout << "\tAnalytical covariance in acceleration: \n" << covariance_A_analytical << std::endl;
 
-// 	radar -> BinObservations(measurement_sequence,r_bin,rr_bin);
-// 	std::cout << " --- Done binning ...\n";
+	assert(std::abs(potential_mean(0) - nom_pot) / std::abs(nom_pot) < 1e-3);
+	assert(arma::norm(acc_mean.col(0) - nom_acc) / arma::norm(nom_acc) < 1e-3);
+	assert(std::abs(potential_var(0) - variance_U_analytical) / variance_U_analytical < 1e-1);
+	assert(arma::norm(acc_cov.slice(0) - covariance_A_analytical) / arma::norm(covariance_A_analytical) < 1e-1);
 
-// 	radar -> SaveImages("../radar_output/");
-// 	std::cout << " --- Done saving ...\n";
+	// Same seed, same outcomes
+	arma::vec potential_mean_2,potential_var_2;
+	arma::mat acc_mean_2;
+	arma::cube acc_cov_2;
+	shape_uq.RunMonteCarlo(points,N,seed,potential_mean_2,potential_var_2,acc_mean_2,acc_cov_2);
 
+	assert(arma::all(potential_mean == potential_mean_2));
+	assert(arma::all(potential_var == potential_var_2));
+	assert(arma::all(arma::vectorise(acc_mean == acc_mean_2)));
+	assert(arma::all(arma::vectorise(acc_cov == acc_cov_2)));
 
-// 	auto end = std::chrono::system_clock::now();
+	std::cout << "- Done running test_PGM_UQ_MC ..." << std::endl;
 
-// 	std::chrono::duration<double> elapsed_seconds = end-start;
-// 	std::cout << "-- Done collecting radar images in " << elapsed_seconds.count() << " s\n";
-// 	std::cout << "-- test_radar_obs successful" << std::endl;
+}
+
+
+/**
+This test checks the covariance built by SBGATPolyhedronGravityModelUQ::SetCovarianceKernel
+*/
+void TestsSBCore::test_PGM_UQ_kernel_covariance(){
+
+	std::cout << "- Running test_PGM_UQ_kernel_covariance ..." << std::endl;
+
+	double density = 1970;
+	double sigma = 1e-1;
+	double l = 1;
+	double cutoff = 2.5;
+
+	std::string filename  = "../../resources/shape_models/skewed.obj";
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName(filename.c_str());
+	reader -> Update(); 
+
+	// Cleaning
+	vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+	cleaner -> SetInputConnection (reader -> GetOutputPort());
+	cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
+	cleaner -> Update();
+
+	// Creating the PGM dyads
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputConnection(cleaner -> GetOutputPort());
+	pgm_filter -> SetDensity(density); 
+	pgm_filter -> SetScaleMeters();
+	pgm_filter -> Update();
+
+	vtkPolyData * polydata = vtkPolyData::SafeDownCast(pgm_filter -> GetInput());
+	int N_C = polydata -> GetNumberOfPoints();
+
+	SBGATPolyhedronGravityModelUQ shape_uq;
+	shape_uq.SetPGM(pgm_filter);
+
+	for (auto isotropic : {true,false}){
+
+		shape_uq.SetCovarianceKernel(sigma,l,cutoff,true,isotropic);
+		arma::mat P_CC = shape_uq.GetCovariance();
+
+		// Symmetric and positive semi-definite
+		assert(arma::abs(P_CC - P_CC.t()).max() < 1e-12);
+		assert(arma::eig_sym(P_CC).min() > - 1e-12);
+
+		// Isotropic blocks only store their diagonal
+		arma::sp_mat P_CC_sparse = shape_uq.GetSparseCovariance();
+		assert(arma::abs(P_CC - arma::mat(P_CC_sparse)).max() == 0);
+		if (isotropic){
+			for (arma::sp_mat::const_iterator it = P_CC_sparse.begin(); it != P_CC_sparse.end(); ++it){
+				assert(it.row() % 3 == it.col() % 3);
+			}
+		}
+
+		for (int i = 0; i < N_C; ++i){
+
+			// Each vertex has a standard deviation of sigma
+			assert(std::abs(arma::trace(P_CC.submat(3 * i,3 * i,3 * i + 2,3 * i + 2)) - (isotropic ? 3 : 1) * sigma * sigma) < 1e-12);
+
+			double ri[3];
+			polydata -> GetPoint(i,ri);
+
+			for (int j = 0; j < N_C; ++j){
+
+				double rj[3];
+				polydata -> GetPoint(j,rj);
+
+				// Vertices beyond the cutoff are uncorrelated
+				if (std::sqrt(vtkMath::Distance2BetweenPoints(ri,rj)) >= cutoff){
+					assert(arma::abs(P_CC.submat(3 * i,3 * j,3 * i + 2,3 * j + 2)).max() == 0);
+				}
+			}
+		}
+
+		// The variances are consistent with a covariance filled block by block
+		arma::vec::fixed<3> pos = {200,300,400};
+		double variance_U_kernel = shape_uq.GetVariancePotential(pos);
+
+		SBGATPolyhedronGravityModelUQ shape_uq_dense;
+		shape_uq_dense.SetPGM(pgm_filter);
+
+		for (int i = 0; i < N_C; ++i){
+			for (int j = 0; j < N_C; ++j){
+				const arma::mat::fixed<3,3> & P = P_CC.submat(3 * i,3 * j, 3 * i + 2,3 * j + 2);
+				shape_uq_dense.SetCovarianceComponent(P,i,j);
+			}
+		}
+
+		assert(std::abs(shape_uq_dense.GetVariancePotential(pos) - variance_U_kernel) / variance_U_kernel < 1e-10);
+
+		// The sparse square root reproduces the covariance
+		arma::sp_mat S = shape_uq.GetSparseCovarianceSquareRoot();
+		assert(arma::abs(P_CC - arma::mat(S * S.t())).max() < 1e-8 * sigma * sigma);
+
+		// The truncated square root has the requested number of modes
+		shape_uq.ComputeCovarianceSquareRoot(10);
+		assert(shape_uq.GetCovarianceSquareRoot().n_cols == 10);
+
+	}
+
+	// An indefinite covariance is rejected by the sparse cholesky factorization
+	shape_uq.SetCovarianceKernel(sigma,l,cutoff,true,true);
+	arma::mat::fixed<3,3> P_indefinite = 10 * sigma * sigma * arma::eye<arma::mat>(3,3);
+	shape_uq.SetCovarianceComponent(P_indefinite,0,1);
+	shape_uq.SetCovarianceComponent(P_indefinite,1,0);
+
+	bool indefinite_thrown = false;
+	try{
+		shape_uq.GetSparseCovarianceSquareRoot();
+	}
+	catch(std::runtime_error & e){
+		indefinite_thrown = true;
+	}
+	assert(indefinite_thrown);
+
+	std::cout << "- Done running test_PGM_UQ_kernel_covariance ..." << std::endl;
+
+}
+
+
+/**
+This test checks the surface variances computed by SBGATPolyhedronGravityModelUQ::GetSurfacePGMVariances
+against finite differences of SBGATPolyhedronGravityModel::ComputeSurfacePGM. A rank-one shape covariance
+P_CC = dC * dC^T is used, so that the standard deviation of each quantity is the magnitude of its first-order change 
+when the shape is deformed by dC
+*/
+void TestsSBCore::test_PGM_UQ_surface(){
+
+	std::cout << "- Running test_PGM_UQ_surface ..." << std::endl;
+
+	double density = 1970;
+	arma::vec::fixed<3> omega = {0,0,2 * arma::datum::pi / (12 * 3600)};
+
+	std::string filename  = "../../resources/shape_models/skewed.obj";
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName(filename.c_str());
+	reader -> Update(); 
+
+	// Cleaning
+	vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+	cleaner -> SetInputConnection (reader -> GetOutputPort());
+	cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
+	cleaner -> Update();
+
+	vtkSmartPointer<vtkPolyData> shape = cleaner -> GetOutput();
+
+	// Creating the PGM dyads
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputData(shape);
+	pgm_filter -> SetDensity(density); 
+	pgm_filter -> SetScaleMeters();
+	pgm_filter -> Update();
+
+	vtkSmartPointer<SBGATMassProperties> mass_prop = vtkSmartPointer<SBGATMassProperties>::New();
+	mass_prop -> SetInputData(shape);
+	mass_prop -> SetScaleMeters();
+	mass_prop -> Update();
+
+	int N_C = shape -> GetNumberOfPoints();
+	int N_f = shape -> GetNumberOfCells();
+
+	arma::arma_rng::set_seed(0);
+	arma::vec dC = 1e-4 * arma::randn<arma::vec>(3 * N_C);
+
+	SBGATPolyhedronGravityModelUQ shape_uq;
+	shape_uq.SetPGM(pgm_filter);
+
+	for (int i = 0; i < N_C; ++i){
+		for (int j = 0; j < N_C; ++j){
+			arma::mat::fixed<3,3> P = dC.subvec(3 * i, 3 * i + 2) * dC.subvec(3 * j, 3 * j + 2).t();
+			shape_uq.SetCovarianceComponent(P,i,j);
+		}
+	}
+
+	std::vector<unsigned int> queried_elements = {0,static_cast<unsigned int>(N_f / 2),static_cast<unsigned int>(N_f - 1)};
+
+	std::vector<double> slopes_variances,inertial_potentials_variances,body_fixed_potentials_variances,
+	inertial_acc_magnitudes_variances,body_fixed_acc_magnitudes_variances;
+
+	shape_uq.GetSurfacePGMVariances(queried_elements,omega,mass_prop -> GetCenterOfMass(),
+		slopes_variances,
+		inertial_potentials_variances,
+		body_fixed_potentials_variances,
+		inertial_acc_magnitudes_variances,
+		body_fixed_acc_magnitudes_variances);
+
+	// Nominal and deformed surface PGM
+	std::vector<double> slopes,inertial_potentials,body_fixed_potentials,inertial_acc_magnitudes,body_fixed_acc_magnitudes;
+	SBGATPolyhedronGravityModel::ComputeSurfacePGM(shape,queried_elements,true,density,omega,
+		slopes,inertial_potentials,body_fixed_potentials,inertial_acc_magnitudes,body_fixed_acc_magnitudes);
+
+	vtkSmartPointer<vtkPolyData> deformed_shape = vtkSmartPointer<vtkPolyData>::New();
+	deformed_shape -> DeepCopy(shape);
+
+	for (int i = 0; i < N_C; ++i){
+		double p[3];
+		deformed_shape -> GetPoint(i,p);
+		for (int k = 0; k < 3; ++k){
+			p[k] += dC(3 * i + k);
+		}
+		deformed_shape -> GetPoints() -> SetPoint(i,p);
+	}
+	deformed_shape -> Modified();
+
+	std::vector<double> slopes_d,inertial_potentials_d,body_fixed_potentials_d,inertial_acc_magnitudes_d,body_fixed_acc_magnitudes_d;
+	SBGATPolyhedronGravityModel::ComputeSurfacePGM(deformed_shape,queried_elements,true,density,omega,
+		slopes_d,inertial_potentials_d,body_fixed_potentials_d,inertial_acc_magnitudes_d,body_fixed_acc_magnitudes_d);
+
+	for (int f = 0; f < N_f; ++f){
+
+		if (std::find(queried_elements.begin(),queried_elements.end(),f) == queried_elements.end()){
+			// Non-queried facets are not evaluated
+			assert(std::isnan(inertial_potentials_variances[f]));
+			continue;
+		}
+
+		assert(slopes_variances[f] >= 0);
+		assert(body_fixed_potentials_variances[f] >= 0);
+		assert(body_fixed_acc_magnitudes_variances[f] >= 0);
+
+		// The inertial quantities do not depend on the center of mass, which is 
+		// held fixed in the linear model
+		double dU = std::abs(inertial_potentials_d[f] - inertial_potentials[f]);
+		assert(std::abs(std::sqrt(inertial_potentials_variances[f]) - dU) / dU < 1e-2);
+
+	}
+
+	// The slope vanishes at the center of the facets of a non-rotating octahedron, where 
+	// its variance is zero by convention. Facets queried twice are evaluated once
+	vtkSmartPointer<vtkPlatonicSolidSource> octahedron = vtkSmartPointer<vtkPlatonicSolidSource>::New();
+	octahedron -> SetSolidTypeToOctahedron();
+	octahedron -> Update();
+
+	vtkSmartPointer<vtkPolyData> octahedron_shape = octahedron -> GetOutput();
+	std::vector<unsigned int> octahedron_queried_elements = {0,0,3};
+
+	SBGATPolyhedronGravityModelUQ::ComputeSurfacePGMUQ(octahedron_shape,octahedron_queried_elements,true,density,
+		arma::zeros<arma::vec>(3),1e-2,1,
+		slopes_variances,
+		inertial_potentials_variances,
+		body_fixed_potentials_variances,
+		inertial_acc_magnitudes_variances,
+		body_fixed_acc_magnitudes_variances,
+		0,true,true);
+
+	for (auto f : octahedron_queried_elements){
+		assert(slopes_variances[f] == 0);
+		assert(std::isfinite(inertial_potentials_variances[f]) && inertial_potentials_variances[f] > 0);
+		assert(std::isfinite(body_fixed_acc_magnitudes_variances[f]) && body_fixed_acc_magnitudes_variances[f] > 0);
+	}
+
+	std::cout << "- Done running test_PGM_UQ_surface ..." << std::endl;
+
+}
 
-// }
 
+/**
+This test checks the acceleration covariances propagated along a trajectory by 
+SBGATPolyhedronGravityModelUQ::GetCovarianceAccelerationTrajectory
+*/
+void TestsSBCore::test_PGM_UQ_trajectory(){
+
+	std::cout << "- Running test_PGM_UQ_trajectory ..." << std::endl;
+
+	double density = 1970;
+	unsigned int max_lag = 2;
+
+	std::string filename  = "../../resources/shape_models/skewed.obj";
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName(filename.c_str());
+	reader -> Update(); 
+
+	// Cleaning
+	vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+	cleaner -> SetInputConnection (reader -> GetOutputPort());
+	cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
+	cleaner -> Update();
+
+	// Creating the PGM dyads
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputConnection(cleaner -> GetOutputPort());
+	pgm_filter -> SetDensity(density); 
+	pgm_filter -> SetScaleMeters();
+	pgm_filter -> Update();
+
+	SBGATPolyhedronGravityModelUQ shape_uq;
+	shape_uq.SetPGM(pgm_filter);
+	shape_uq.SetCovarianceKernel(1e-1,1);
+
+	// The third point repeats the second one
+	arma::mat positions = {
+		{3,4,4,-2,0},
+		{1,2,2,3,-4},
+		{2,-1,-1,1,3}
+	};
+
+	arma::cube acc_cov,acc_cov_sqrt;
+	std::vector<arma::cube> acc_cross_cov,acc_cross_cov_sqrt;
+
+	shape_uq.GetCovarianceAccelerationTrajectory(positions,max_lag,acc_cov,acc_cross_cov);
+
+	assert(acc_cross_cov.size() == max_lag);
+
+	for (unsigned int t = 0; t < positions.n_cols; ++t){
+		arma::mat::fixed<3,3> P = shape_uq.GetCovarianceAcceleration(arma::vec::fixed<3>(positions.col(t)));
+		assert(arma::abs(acc_cov.slice(t) - P).max() / arma::abs(P).max() < 1e-10);
+	}
+
+	for (unsigned int k = 1; k <= max_lag; ++k){
+		assert(acc_cross_cov[k - 1].n_slices == positions.n_cols - k);
+	}
+
+	// Identical points are fully correlated
+	assert(arma::abs(acc_cross_cov[0].slice(1) - acc_cov.slice(1)).max() / arma::abs(acc_cov.slice(1)).max() < 1e-10);
+	
+	// Same blocks obtained from the covariance square root
+	shape_uq.ComputeCovarianceSquareRoot();
+	shape_uq.GetCovarianceAccelerationTrajectory(positions,max_lag,acc_cov_sqrt,acc_cross_cov_sqrt);
+
+	assert(arma::abs(acc_cov_sqrt - acc_cov).max() / arma::abs(acc_cov).max() < 1e-8);
+	for (unsigned int k = 1; k <= max_lag; ++k){
+		assert(arma::abs(acc_cross_cov_sqrt[k - 1] - acc_cross_cov[k - 1]).max() / arma::abs(acc_cross_cov[k - 1]).max() < 1e-8);
+	}
+
+	std::cout << "- Done running test_PGM_UQ_trajectory ..." << std::endl;
+
+}
+
+
+/**
+This test checks the spherical harmonics coefficients covariance against finite differences
+of the coefficients. A rank-one vertex covariance P_CC = dC * dC^T is used, so that the standard deviation
+of each coefficient is the magnitude of its first-order change when the shape is deformed by dC
+*/
+void TestsSBCore::test_spherical_harmonics_coefs_covariance(){
+
+	std::cout << "- Running test_spherical_harmonics_coefs_covariance ..." << std::endl;
+
+	int degree = 4;
+	double density = 1970;
+	double ref_radius = 2;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/skewed.obj");
+	reader -> Update(); 
+
+	// Cleaning
+	vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+	cleaner -> SetInputConnection (reader -> GetOutputPort());
+	cleaner -> SetOutputPointsPrecision ( vtkAlgorithm::DesiredOutputPrecision::DOUBLE_PRECISION );
+	cleaner -> Update();
+
+	vtkSmartPointer<vtkPolyData> shape = cleaner -> GetOutput();
+	int N_C = shape -> GetNumberOfPoints();
+
+	arma::arma_rng::set_seed(0);
+	arma::vec dC = 1e-4 * arma::randn<arma::vec>(3 * N_C);
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics -> SetInputData(shape);
+	spherical_harmonics -> SetDensity(density);
+	spherical_harmonics -> SetScaleMeters();
+	spherical_harmonics -> SetReferenceRadius(ref_radius);
+	spherical_harmonics -> IsNormalized();
+	spherical_harmonics -> SetDegree(degree);
+	spherical_harmonics -> SetVertexCovariance(arma::mat(dC * dC.t()));
+	spherical_harmonics -> Update();
+
+	arma::mat P_coefs = spherical_harmonics -> GetCoefficientsCovariance();
+	arma::mat Cnm = spherical_harmonics -> GetCnm();
+	arma::mat Snm = spherical_harmonics -> GetSnm();
+
+	assert(P_coefs.n_rows == static_cast<unsigned int>((degree + 1) * (degree + 2) / 2 + degree * (degree + 1) / 2));
+	
+	// Deformed shape
+	vtkSmartPointer<vtkPolyData> deformed_shape = vtkSmartPointer<vtkPolyData>::New();
+	deformed_shape -> DeepCopy(shape);
+
+	for (int i = 0; i < N_C; ++i){
+		double p[3];
+		deformed_shape -> GetPoint(i,p);
+		for (int k = 0; k < 3; ++k){
+			p[k] += dC(3 * i + k);
+		}
+		deformed_shape -> GetPoints() -> SetPoint(i,p);
+	}
+	deformed_shape -> Modified();
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_deformed = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics_deformed -> SetInputData(deformed_shape);
+	spherical_harmonics_deformed -> SetDensity(density);
+	spherical_harmonics_deformed -> SetScaleMeters();
+	spherical_harmonics_deformed -> SetReferenceRadius(ref_radius);
+	spherical_harmonics_deformed -> IsNormalized();
+	spherical_harmonics_deformed -> SetDegree(degree);
+	spherical_harmonics_deformed -> Update();
+
+	arma::mat dCnm = spherical_harmonics_deformed -> GetCnm() - Cnm;
+	arma::mat dSnm = spherical_harmonics_deformed -> GetSnm() - Snm;
+
+	int counter = 0;
+	for (int n = 0; n <= degree; ++n){
+		for (int m = 0; m <= n; ++m){
+			if (n > 0){
+				assert(std::abs(std::sqrt(P_coefs(counter,counter)) - std::abs(dCnm(n,m))) / std::abs(dCnm(n,m)) < 1e-2);
+			}
+			++counter;
+		}
+	}
+
+	for (int n = 1; n <= degree; ++n){
+		for (int m = 1; m <= n; ++m){
+			assert(std::abs(std::sqrt(P_coefs(counter,counter)) - std::abs(dSnm(n,m))) / std::abs(dSnm(n,m)) < 1e-2);
+			++counter;
+		}
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_coefs_covariance ..." << std::endl;
+
+}
+
+
+/**
+This test checks the const spherical harmonics evaluators against the pipeline-updating ones,
+when called concurrently, and checks the gravity gradient matrix against finite differences of the acceleration
+*/
+void TestsSBCore::test_spherical_harmonics_evaluator(){
+
+	std::cout << "- Running test_spherical_harmonics_evaluator ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	int degree = 10;
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+	spherical_harmonics -> SetDensity(density);
+	spherical_harmonics -> SetScaleKiloMeters();
+	spherical_harmonics -> SetReferenceRadius(ref_radius);
+	spherical_harmonics -> IsNormalized();
+	spherical_harmonics -> SetDegree(degree);
+	spherical_harmonics -> Update();
+
+	arma::arma_rng::set_seed(0);
+	arma::mat positions = 3e3 * arma::normalise(arma::randn<arma::mat>(3,200));
+
+	arma::mat acc_serial(3,positions.n_cols);
+	arma::mat acc_parallel(3,positions.n_cols);
+
+	for (unsigned int i = 0; i < positions.n_cols; ++i){
+		acc_serial.col(i) = spherical_harmonics -> GetAcceleration(positions.col(i));
+	}
+
+	#pragma omp parallel for
+	for (unsigned int i = 0; i < positions.n_cols; ++i){
+		acc_parallel.col(i) = spherical_harmonics -> EvaluateAcceleration(positions.col(i));
+	}
+
+	assert(arma::abs(acc_serial - acc_parallel).max() == 0);
+
+	// Gravity gradient matrix against central differences of the acceleration
+	arma::vec::fixed<3> pos = {3e3,5e3,-2e3};
+	double h = 1e-2;
+	arma::mat::fixed<3,3> dAccdPos,dAccdPos_fd;
+	spherical_harmonics -> EvaluateGravityGradientMatrix(pos,dAccdPos);
+
+	for (int k = 0; k < 3; ++k){
+		arma::vec::fixed<3> dpos = arma::zeros<arma::vec>(3);
+		dpos(k) = h;
+		dAccdPos_fd.col(k) = (spherical_harmonics -> EvaluateAcceleration(pos + dpos) 
+			- spherical_harmonics -> EvaluateAcceleration(pos - dpos)) / (2 * h);
+	}
+
+	assert(arma::abs(dAccdPos - dAccdPos_fd).max() / arma::abs(dAccdPos).max() < 1e-6);
+
+	std::cout << "- Done running test_spherical_harmonics_evaluator ..." << std::endl;
+
+}
+
+
+/**
+This test checks the batched spherical harmonics evaluation against the single-point evaluators
+and the potential against the polyhedron gravity model
+*/
+void TestsSBCore::test_spherical_harmonics_batch(){
+
+	std::cout << "- Running test_spherical_harmonics_batch ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	int degree = 10;
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	vtkSmartPointer<SBGATPolyhedronGravityModel> pgm_filter = vtkSmartPointer<SBGATPolyhedronGravityModel>::New();
+	pgm_filter -> SetInputConnection(reader -> GetOutputPort());
+	pgm_filter -> SetDensity(density);
+	pgm_filter -> SetScaleKiloMeters();
+	pgm_filter -> Update();
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+	spherical_harmonics -> SetDensity(density);
+	spherical_harmonics -> SetScaleKiloMeters();
+	spherical_harmonics -> SetReferenceRadius(ref_radius);
+	spherical_harmonics -> IsNormalized();
+	spherical_harmonics -> SetDegree(degree);
+	spherical_harmonics -> Update();
+
+	// The number of points is not a multiple of the tile size
+	arma::arma_rng::set_seed(0);
+	arma::mat positions = 5e3 * arma::normalise(arma::randn<arma::mat>(3,101));
+
+	arma::vec potentials;
+	arma::mat accelerations,accelerations_only;
+	arma::cube gravity_gradients;
+
+	spherical_harmonics -> EvaluateBatch(positions,potentials,accelerations,gravity_gradients);
+	spherical_harmonics -> EvaluateAccelerationBatch(positions,accelerations_only);
+
+	for (unsigned int i = 0; i < positions.n_cols; ++i){
+
+		arma::vec::fixed<3> pos = positions.col(i);
+
+		arma::vec::fixed<3> acc = spherical_harmonics -> EvaluateAcceleration(pos);
+		arma::mat::fixed<3,3> dAccdPos;
+		spherical_harmonics -> EvaluateGravityGradientMatrix(pos,dAccdPos);
+
+		assert(arma::norm(accelerations.col(i) - acc) / arma::norm(acc) < 1e-12);
+		assert(arma::norm(accelerations_only.col(i) - acc) / arma::norm(acc) < 1e-12);
+		assert(arma::abs(gravity_gradients.slice(i) - dAccdPos).max() / arma::abs(dAccdPos).max() < 1e-12);
+
+		double pgm_potential = pgm_filter -> GetPotential(pos);
+		assert(std::abs(potentials(i) - pgm_potential) / std::abs(pgm_potential) < 1e-4);
+
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_batch ..." << std::endl;
+
+}
+
+
+/**
+This test checks the single-point spherical harmonics kernels specialized for low degrees 
+against the generic batched kernel
+*/
+void TestsSBCore::test_spherical_harmonics_fixed_degree(){
+
+	std::cout << "- Running test_spherical_harmonics_fixed_degree ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	// Two points, so that the batch goes through the generic kernel
+	arma::mat positions = {
+		{3e3,-1e3},
+		{5e3,2e3},
+		{-2e3,4e3}
+	};
+
+	arma::vec::fixed<3> pos = positions.col(0);
+
+	for (unsigned int degree = 1; degree <= SBGATSphericalHarmo::maxFixedDegree + 1; ++degree){
+
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics -> SetDensity(density);
+		spherical_harmonics -> SetScaleKiloMeters();
+		spherical_harmonics -> SetReferenceRadius(ref_radius);
+		spherical_harmonics -> IsNormalized();
+		spherical_harmonics -> SetDegree(degree);
+		spherical_harmonics -> Update();
+
+		arma::vec potentials;
+		arma::mat accelerations;
+		arma::cube gravity_gradients;
+		spherical_harmonics -> EvaluateBatch(positions,potentials,accelerations,gravity_gradients);
+
+		arma::vec::fixed<3> acc = spherical_harmonics -> EvaluateAcceleration(pos);
+		arma::mat::fixed<3,3> dAccdPos;
+		spherical_harmonics -> EvaluateGravityGradientMatrix(pos,dAccdPos);
+
+		assert(arma::norm(accelerations.col(0) - acc) / arma::norm(acc) < 1e-12);
+		assert(arma::abs(gravity_gradients.slice(0) - dAccdPos).max() / arma::abs(dAccdPos).max() < 1e-12);
+
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_fixed_degree ..." << std::endl;
+
+}
+
+
+/**
+This test checks the spherical harmonics potential against finite differences of the acceleration 
+and the fused potential/acceleration/gravity gradient evaluation against the separate ones
+*/
+void TestsSBCore::test_spherical_harmonics_potential(){
+
+	std::cout << "- Running test_spherical_harmonics_potential ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	arma::vec::fixed<3> pos = {3e3,5e3,-2e3};
+
+	// Specialized and generic kernels
+	for (int degree : {5,12}){
+
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics -> SetDensity(density);
+		spherical_harmonics -> SetScaleKiloMeters();
+		spherical_harmonics -> SetReferenceRadius(ref_radius);
+		spherical_harmonics -> IsNormalized();
+		spherical_harmonics -> SetDegree(degree);
+		spherical_harmonics -> Update();
+
+		double potential;
+		arma::vec::fixed<3> acc;
+		arma::mat::fixed<3,3> dAccdPos,dAccdPos_separate;
+		spherical_harmonics -> GetPotentialAccelerationGravityGradient(pos,potential,acc,dAccdPos);
+		spherical_harmonics -> EvaluateGravityGradientMatrix(pos,dAccdPos_separate);
+
+		assert(std::abs(potential - spherical_harmonics -> GetPotential(pos)) / std::abs(potential) < 1e-12);
+		assert(arma::norm(acc - spherical_harmonics -> EvaluateAcceleration(pos)) / arma::norm(acc) < 1e-12);
+		assert(arma::abs(dAccdPos - dAccdPos_separate).max() / arma::abs(dAccdPos).max() < 1e-12);
+
+		// The acceleration is the gradient of the potential
+		double h = 1e-1;
+		arma::vec::fixed<3> acc_fd;
+		for (int k = 0; k < 3; ++k){
+			arma::vec::fixed<3> dpos = arma::zeros<arma::vec>(3);
+			dpos(k) = h;
+			acc_fd(k) = (spherical_harmonics -> EvaluatePotential(pos + dpos) 
+				- spherical_harmonics -> EvaluatePotential(pos - dpos)) / (2 * h);
+		}
+
+		assert(arma::norm(acc_fd - acc) / arma::norm(acc) < 1e-6);
+
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_potential ..." << std::endl;
+
+}
+
+
+/**
+This test checks that the spherical harmonics coefficients are bitwise identical 
+regardless of the number of threads used to accumulate the facets' contributions
+*/
+void TestsSBCore::test_spherical_harmonics_thread_reproducibility(){
+
+	std::cout << "- Running test_spherical_harmonics_thread_reproducibility ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	auto compute_coefficients = [&](arma::mat & Cnm,arma::mat & Snm){
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics -> SetDensity(density);
+		spherical_harmonics -> SetScaleKiloMeters();
+		spherical_harmonics -> SetReferenceRadius(ref_radius);
+		spherical_harmonics -> IsNormalized();
+		spherical_harmonics -> SetDegree(10);
+		spherical_harmonics -> Update();
+		Cnm = spherical_harmonics -> GetCnm();
+		Snm = spherical_harmonics -> GetSnm();
+	};
+
+	#ifdef _OPENMP
+	int max_threads = omp_get_max_threads();
+	omp_set_num_threads(1);
+	#endif
+
+	arma::mat Cnm_serial,Snm_serial;
+	compute_coefficients(Cnm_serial,Snm_serial);
+
+	#ifdef _OPENMP
+	for (int threads : {2,3,max_threads}){
+
+		omp_set_num_threads(threads);
+
+		arma::mat Cnm,Snm;
+		compute_coefficients(Cnm,Snm);
+
+		assert(arma::all(arma::vectorise(Cnm == Cnm_serial)));
+		assert(arma::all(arma::vectorise(Snm == Snm_serial)));
+	}
+
+	omp_set_num_threads(max_threads);
+	#endif
+
+	std::cout << "- Done running test_spherical_harmonics_thread_reproducibility ..." << std::endl;
+
+}
+
+
+/**
+This test checks that spherical harmonics saved to a binary file and loaded back, 
+with or without memory mapping, match the original ones
+*/
+void TestsSBCore::test_spherical_harmonics_binary_io(){
+
+	std::cout << "- Running test_spherical_harmonics_binary_io ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+	spherical_harmonics -> SetDensity(density);
+	spherical_harmonics -> SetScaleKiloMeters();
+	spherical_harmonics -> SetReferenceRadius(ref_radius);
+	spherical_harmonics -> IsNormalized();
+	spherical_harmonics -> SetDegree(10);
+	spherical_harmonics -> Update();
+
+	spherical_harmonics -> SaveToBinary("../output/KW4Alpha_harmo.bin");
+
+	arma::vec::fixed<3> pos = {3e3,5e3,-2e3};
+	arma::vec::fixed<3> acc = spherical_harmonics -> GetAcceleration(pos);
+
+	for (bool memory_map : {true,false}){
+
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_from_file = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics_from_file -> LoadFromBinary("../output/KW4Alpha_harmo.bin",memory_map);
+
+		// The coefficients are stored exactly
+		assert(arma::abs(spherical_harmonics_from_file -> GetCnm() - spherical_harmonics -> GetCnm()).max() == 0);
+		assert(arma::abs(spherical_harmonics_from_file -> GetSnm() - spherical_harmonics -> GetSnm()).max() == 0);
+		assert(arma::norm(spherical_harmonics_from_file -> GetAcceleration(pos) - acc) == 0);
+
+		// Reloading replaces the mapped coefficients
+		spherical_harmonics_from_file -> LoadFromJson("../output/KW4Alpha_harmo.json");
+		spherical_harmonics_from_file -> LoadFromBinary("../output/KW4Alpha_harmo.bin",memory_map);
+		assert(arma::norm(spherical_harmonics_from_file -> GetAcceleration(pos) - acc) == 0);
+
+		// The loaded expansion can be truncated, but not evaluated beyond its degree
+		spherical_harmonics_from_file -> SetDegree(5);
+		assert(spherical_harmonics_from_file -> GetAcceleration(pos).is_finite());
+
+		bool rejected = false;
+		spherical_harmonics_from_file -> SetDegree(12);
+		try{
+			spherical_harmonics_from_file -> EvaluateAcceleration(pos);
+		}
+		catch(std::runtime_error & e){
+			rejected = true;
+		}
+		assert(rejected);
+
+		spherical_harmonics_from_file -> SetDegree(10);
+		assert(arma::norm(spherical_harmonics_from_file -> GetAcceleration(pos) - acc) == 0);
+
+	}
+
+	// A header whose degree would overflow the expected file size is rejected
+	// before anything is allocated or mapped
+	std::ifstream binary_file("../output/KW4Alpha_harmo.bin",std::ios::binary);
+	std::vector<char> header(64);
+	binary_file.read(header.data(),header.size());
+	binary_file.close();
+
+	uint64_t corrupted_degree = (uint64_t(1) << 32) - 1;
+	std::memcpy(header.data() + 16,&corrupted_degree,sizeof(corrupted_degree));
+
+	std::ofstream corrupted_file("../output/KW4Alpha_harmo_corrupted.bin",std::ios::binary);
+	corrupted_file.write(header.data(),header.size());
+	corrupted_file.close();
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_corrupted = vtkSmartPointer<SBGATSphericalHarmo>::New();
+
+	for (auto memory_map : {false,true}){
+		bool rejected = false;
+		try{
+			spherical_harmonics_corrupted -> LoadFromBinary("../output/KW4Alpha_harmo_corrupted.bin",memory_map);
+		}
+		catch(std::runtime_error & e){
+			rejected = true;
+		}
+		assert(rejected);
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_binary_io ..." << std::endl;
+
+}
+
+
+/**
+This test checks that extending the degree of spherical harmonics, either computed or loaded from a file,
+matches a direct computation at the higher degree
+*/
+void TestsSBCore::test_spherical_harmonics_extend_degree(){
+
+	std::cout << "- Running test_spherical_harmonics_extend_degree ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+	arma::vec::fixed<3> pos = {3e3,5e3,-2e3};
+
+	for (bool normalized : {true,false}){
+
+		// Direct computation at the higher degree
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics -> SetDensity(density);
+		spherical_harmonics -> SetScaleKiloMeters();
+		spherical_harmonics -> SetReferenceRadius(ref_radius);
+		if (normalized){
+			spherical_harmonics -> IsNormalized();
+		}
+		else{
+			spherical_harmonics -> IsNonNormalized();
+		}
+		spherical_harmonics -> SetDegree(8);
+		spherical_harmonics -> Update();
+
+		// Extension of a lower degree computation
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_extended = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics_extended -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics_extended -> SetDensity(density);
+		spherical_harmonics_extended -> SetScaleKiloMeters();
+		spherical_harmonics_extended -> SetReferenceRadius(ref_radius);
+		if (normalized){
+			spherical_harmonics_extended -> IsNormalized();
+		}
+		else{
+			spherical_harmonics_extended -> IsNonNormalized();
+		}
+		spherical_harmonics_extended -> SetDegree(4);
+		spherical_harmonics_extended -> Update();
+		spherical_harmonics_extended -> SaveToJson("../output/KW4Alpha_harmo_degree_4.json");
+		spherical_harmonics_extended -> SaveToBinary("../output/KW4Alpha_harmo_degree_4.bin");
+
+		arma::mat Cnm_4 = spherical_harmonics_extended -> GetCnm();
+
+		spherical_harmonics_extended -> ExtendDegree(8);
+
+		// Extension of spherical harmonics loaded from a file
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_from_json = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics_from_json -> LoadFromJson("../output/KW4Alpha_harmo_degree_4.json");
+		spherical_harmonics_from_json -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics_from_json -> SetScaleKiloMeters();
+		spherical_harmonics_from_json -> ExtendDegree(8);
+
+		vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics_from_binary = vtkSmartPointer<SBGATSphericalHarmo>::New();
+		spherical_harmonics_from_binary -> LoadFromBinary("../output/KW4Alpha_harmo_degree_4.bin",true);
+		spherical_harmonics_from_binary -> SetInputConnection(reader -> GetOutputPort());
+		spherical_harmonics_from_binary -> SetScaleKiloMeters();
+		spherical_harmonics_from_binary -> ExtendDegree(8);
+
+		arma::mat Cnm = spherical_harmonics -> GetCnm();
+		arma::mat Snm = spherical_harmonics -> GetSnm();
+		arma::vec::fixed<3> acc = spherical_harmonics -> GetAcceleration(pos);
+
+		for (auto extended : {spherical_harmonics_extended,spherical_harmonics_from_json,spherical_harmonics_from_binary}){
+
+			assert(extended -> GetCnm().n_rows == 9);
+
+			// The existing rows are left untouched
+			assert(arma::abs(extended -> GetCnm().submat(0,0,4,4) - Cnm_4).max() == 0);
+
+			assert(arma::abs(extended -> GetCnm() - Cnm).max() / arma::abs(Cnm).max() < 1e-10);
+			assert(arma::abs(extended -> GetSnm() - Snm).max() / arma::abs(Cnm).max() < 1e-10);
+			assert(arma::norm(extended -> GetAcceleration(pos) - acc) / arma::norm(acc) < 1e-10);
+
+		}
+
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_extend_degree ..." << std::endl;
+
+}
+
+
+/**
+This test checks that the batched partials of the spherical harmonics acceleration, 
+written in a strided row-major design matrix, match the single-position ones
+*/
+void TestsSBCore::test_spherical_harmonics_partials_batch(){
+
+	std::cout << "- Running test_spherical_harmonics_partials_batch ..." << std::endl;
+
+	// Reading
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	double density = 2000.0;
+	double ref_radius = 1.317/2 * 1000;
+	int degree = 10;
+
+	vtkSmartPointer<SBGATSphericalHarmo> spherical_harmonics = vtkSmartPointer<SBGATSphericalHarmo>::New();
+	spherical_harmonics -> SetInputConnection(reader -> GetOutputPort());
+	spherical_harmonics -> SetDensity(density);
+	spherical_harmonics -> SetScaleKiloMeters();
+	spherical_harmonics -> SetReferenceRadius(ref_radius);
+	spherical_harmonics -> IsNormalized();
+	spherical_harmonics -> SetDegree(degree);
+	spherical_harmonics -> Update();
+
+	// More positions than one tile, so that the last tile is partial
+	int N_points = 100;
+	arma::mat positions = 2e3 * arma::randn<arma::mat>(3,N_points);
+	for (int k = 0; k < N_points; ++k){
+		positions.col(k) += 4e3 * arma::normalise(positions.col(k));
+	}
+
+	// The partials go in the middle of a wider design matrix
+	int n_coefs = (degree + 1) * (degree + 1);
+	int column_offset = 2;
+	int row_stride = n_coefs + 5;
+	arma::mat design_matrix_t = arma::zeros<arma::mat>(row_stride,3 * N_points);
+
+	spherical_harmonics -> EvaluatePartialHarmonicsBatch(positions,design_matrix_t.memptr() + column_offset,row_stride);
+
+	// The transpose of a column-major matrix is a row-major matrix
+	arma::mat design_matrix = design_matrix_t.t();
+
+	assert(arma::abs(design_matrix.cols(0,column_offset - 1)).max() == 0);
+	assert(arma::abs(design_matrix.cols(column_offset + n_coefs,row_stride - 1)).max() == 0);
+
+	for (int k = 0; k < N_points; ++k){
+
+		arma::mat partial_C,partial_S;
+		spherical_harmonics -> GetPartialHarmonics(positions.col(k),partial_C,partial_S);
+
+		arma::mat partials = arma::join_rows(partial_C,partial_S);
+		arma::mat partials_batch = design_matrix.submat(3 * k,column_offset,3 * k + 2,column_offset + n_coefs - 1);
+
+		assert(arma::abs(partials_batch - partials).max() / arma::abs(partials).max() < 1e-12);
+
+	}
+
+	std::cout << "- Done running test_spherical_harmonics_partials_batch ..." << std::endl;
+
+}
+
+
+
+
+
+
+
+// TODO : reimplement these tests
+
+// /**
+// This test computes simulated radar images for benchmarking purposes
+// */
+// void TestsSBCore::test_radar_obs(){
+
+// 	std::cout << "- Running test_radar_obs ..." << std::endl;
+
+// 	// Loading in the shape model
+// 	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+// 	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+// 	reader -> Update(); 
+
+// 	// Creating the radar object
+// 	vtkSmartPointer<SBGATObsRadar> radar = vtkSmartPointer<SBGATObsRadar>::New();
+// 	radar -> SetInputConnection(reader -> GetOutputPort());
+// 	radar -> SetScaleKiloMeters();
+// 	radar -> Update();
+
+
+// 	// Arguments
+// 	arma::vec spin = {0,0,1};
+// 	arma::vec dir = {1,0,0};
+// 	double period = 4 * 3600; // 4 hours
+// 	int images = 48; 
+// 	int N = 100;
+
+// 	double r_bin = 7.5;//(m)
+// 	double rr_bin = 7.9e-3;//(m/s)
+
+// 	// A sequence of images is collected
+// 	SBGATRadarObsSequence measurement_sequence;
+// 	auto start = std::chrono::system_clock::now();
+
+// 	for (int i  = 0; i < images; ++i){
+// 		double dt = 1.5 * double(i) / ((images - 1)) * period;
+
+// 		std::cout << " --- Ray tracing " +std::to_string(i + 1) + "/" +std::to_string(images) + " ...\n";
+
+// 		radar -> CollectMeasurementsSimpleSpin(measurement_sequence,N,dt,period,dir,spin);
+// 	}
+
+// 	radar -> BinObservations(measurement_sequence,r_bin,rr_bin);
+// 	std::cout << " --- Done binning ...\n";
+
+// 	radar -> SaveImages("../radar_output/");
+// 	std::cout << " --- Done saving ...\n";
+
+
+// 	auto end = std::chrono::system_clock::now();
+
+// 	std::chrono::duration<double> elapsed_seconds = end-start;
+// 	std::cout << "-- Done collecting radar images in " << elapsed_seconds.count() << " s\n";
+// 	std::cout << "-- test_radar_obs successful" << std::endl;
+
+// }
+
+
+/**
+This test bins a synthetic sequence of radar measurements and checks that every 
+return ends up in the images
+*/
+void TestsSBCore::test_radar_binning(){
+
+	std::cout << "- Running test_radar_binning ..." << std::endl;
+
+	arma::arma_rng::set_seed(0);
+
+	// Three images, the last one large enough to be split in several private histograms
+	SBGATRadarObsSequence measurements_sequence(3);
+	std::vector<double> total_weights(3,0);
+	std::vector<int> N_mes = {10,1000,200000};
+
+	for (int i = 0; i < 3; ++i){
+		arma::mat data = arma::randu<arma::mat>(3,N_mes[i]);
+		for (int mes = 0; mes < N_mes[i]; ++mes){
+			std::array<double, 3> measurement = {{1e4 + 100 * data(0,mes),data(1,mes) - 0.5,data(2,mes)}};
+			measurements_sequence[i].push_back(measurement);
+			total_weights[i] += data(2,mes);
+		}
+	}
+
+	vtkSmartPointer<SBGATObsRadar> radar = vtkSmartPointer<SBGATObsRadar>::New();
+	radar -> SetScaleMeters();
+	radar -> BinObservations(measurements_sequence,2,0.01);
+
+	std::vector<vtkSmartPointer<vtkImageData>> images = radar -> GetImages();
+	assert(images.size() == 3);
+
+	for (int i = 0; i < 3; ++i){
+
+		vtkDataArray * scalars = images[i] -> GetPointData() -> GetScalars();
+		double sum = 0;
+		for (vtkIdType tupleIdx = 0; tupleIdx < scalars -> GetNumberOfTuples(); ++tupleIdx){
+			sum += scalars -> GetTuple1(tupleIdx);
+		}
+
+		assert(std::abs(sum - total_weights[i]) / total_weights[i] < 1e-10);
+	}
+
+	// Binning the largest image alone yields the exact same histogram
+	SBGATRadarObsSequence single_sequence = {measurements_sequence[2]};
+	radar -> BinObservations(single_sequence,2,0.01);
+
+	vtkDataArray * single_scalars = radar -> GetImages()[0] -> GetPointData() -> GetScalars();
+	vtkDataArray * scalars = images[2] -> GetPointData() -> GetScalars();
+
+	assert(single_scalars -> GetNumberOfTuples() == scalars -> GetNumberOfTuples());
+	for (vtkIdType tupleIdx = 0; tupleIdx < scalars -> GetNumberOfTuples(); ++tupleIdx){
+		assert(single_scalars -> GetTuple1(tupleIdx) == scalars -> GetTuple1(tupleIdx));
+	}
+
+	std::cout << "- Done running test_radar_binning" << std::endl;
+
+}
+
+/**
+This test checks that the radar images accumulated while ray-tracing hold 
+the same returns as the measurements collected over the same epochs
+*/
+void TestsSBCore::test_radar_streaming_images(){
+
+	std::cout << "- Running test_radar_streaming_images ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/itokawa_8.obj");
+	reader -> Update(); 
+
+	double length = reader -> GetOutput() -> GetLength();
+
+	std::vector<double> times = {0,60};
+	std::vector<std::vector<arma::vec> > positions_vecs = {{arma::zeros<arma::vec>(3)},{arma::zeros<arma::vec>(3)}};
+	std::vector<std::vector<arma::vec> > velocities_vecs = {{arma::zeros<arma::vec>(3)},{arma::zeros<arma::vec>(3)}};
+	std::vector<std::vector<arma::vec> > mrps_vecs = {{arma::vec({0,0,0.1})},{arma::vec({0,0,0.2})}};
+	std::vector<std::vector<arma::vec> > omegas_vecs = {{arma::vec({0,0,1e-3})},{arma::vec({0,0,1e-3})}};
+	arma::vec radar_dir = arma::normalise(arma::vec({1,0.3,0.2}));
+
+	for (int raster_resolution : {0,128}){
+
+		vtkSmartPointer<SBGATObsRadar> radar_measurements = vtkSmartPointer<SBGATObsRadar>::New();
+		radar_measurements -> SetInputConnection(reader -> GetOutputPort());
+		radar_measurements -> SetScaleMeters();
+		radar_measurements -> SetRasterResolution(raster_resolution);
+		radar_measurements -> Update();
+
+		vtkSmartPointer<SBGATObsRadar> radar_images = vtkSmartPointer<SBGATObsRadar>::New();
+		radar_images -> SetInputConnection(reader -> GetOutputPort());
+		radar_images -> SetScaleMeters();
+		radar_images -> SetRasterResolution(raster_resolution);
+		radar_images -> Update();
+
+		SBGATRadarObsSequence measurements_sequence;
+		radar_measurements -> CollectMeasurementsSequence(measurements_sequence,times,8,radar_dir,
+			positions_vecs,velocities_vecs,mrps_vecs,omegas_vecs,true);
+
+		// The images span twice the extent of the returns in range and range-rate
+		radar_images -> CollectImages(times,8,radar_dir,
+			positions_vecs,velocities_vecs,mrps_vecs,omegas_vecs,true,
+			length / 50,1e-3 * length / 25,200,100);
+
+		std::vector<vtkSmartPointer<vtkImageData>> images = radar_images -> GetImages();
+		assert(images.size() == times.size());
+
+		for (unsigned int i = 0; i < times.size(); ++i){
+
+			double total_weight = 0;
+			for (const auto & measurement : measurements_sequence[i]){
+				total_weight += measurement[2];
+			}
+
+			vtkDataArray * scalars = images[i] -> GetPointData() -> GetScalars();
+			assert(scalars -> GetNumberOfTuples() == 200 * 100);
+
+			double sum = 0;
+			for (vtkIdType tupleIdx = 0; tupleIdx < scalars -> GetNumberOfTuples(); ++tupleIdx){
+				sum += scalars -> GetTuple1(tupleIdx);
+			}
+
+			std::cout << "-- " << measurements_sequence[i].size() << " returns accumulated in " << scalars -> GetNumberOfTuples() << " bins\n";
+
+			assert(std::abs(sum - total_weight) / total_weight < 1e-10);
+		}
+
+	}
+
+	std::cout << "- Done running test_radar_streaming_images" << std::endl;
+
+}
+
+/**
+This test checks the occlusion queries of SBGATTriangleBVH against those of vtkModifiedBSPTree
+on KW4 and Itokawa, and benchmarks both
+*/
+void TestsSBCore::test_triangle_bvh(){
+
+	std::cout << "- Running test_triangle_bvh ..." << std::endl;
+
+	std::vector<std::string> filenames = {"../../resources/shape_models/KW4Alpha.obj","../../resources/shape_models/itokawa_8.obj"};
+
+	arma::arma_rng::set_seed(0);
+
+	for (auto filename : filenames){
+
+		vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+		reader -> SetFileName(filename.c_str());
+		reader -> Update(); 
+
+		vtkSmartPointer<vtkPolyData> polydata = reader -> GetOutput();
+		double length = polydata -> GetLength();
+		double tol = length / 1e6;
+
+		auto start = std::chrono::system_clock::now();
+		vtkSmartPointer<vtkModifiedBSPTree> tree = vtkSmartPointer<vtkModifiedBSPTree>::New();
+		tree -> SetDataSet(polydata);
+		tree -> BuildLocator();
+		auto end = std::chrono::system_clock::now();
+		std::chrono::duration<double> bsp_build = end - start;
+
+		start = std::chrono::system_clock::now();
+		SBGATTriangleBVH bvh;
+		bvh.Build(polydata);
+		end = std::chrono::system_clock::now();
+		std::chrono::duration<double> bvh_build = end - start;
+
+		assert(bvh.GetNumberOfTriangles() == polydata -> GetNumberOfCells());
+
+		// Shadow rays are cast from points just above random facets toward a distant point,
+		// similarly to what is done when collecting lightcurves
+		int N_rays = 200000;
+		arma::vec::fixed<3> sun_dir = arma::normalise(arma::randn<arma::vec>(3));
+		arma::vec::fixed<3> sun_pos = 1e6 * length * sun_dir;
+
+		arma::mat starts(3,N_rays);
+		arma::mat ends(3,N_rays);
+		vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+
+		for (int i = 0; i < N_rays; ++i){
+
+			int f = arma::as_scalar(arma::randi<arma::ivec>(1,arma::distr_param(0,polydata -> GetNumberOfCells() - 1)));
+			polydata -> GetCellPoints(f,ptIds);
+
+			arma::vec::fixed<3> P0,P1,P2;
+			polydata -> GetPoint(ptIds -> GetId(0),P0.memptr());
+			polydata -> GetPoint(ptIds -> GetId(1),P1.memptr());
+			polydata -> GetPoint(ptIds -> GetId(2),P2.memptr());
+
+			arma::vec::fixed<3> n = arma::normalise(arma::cross(P1 - P0,P2 - P0));
+			arma::vec uv = arma::randu<arma::vec>(2);
+
+			starts.col(i) = (1 - std::sqrt(uv(0))) * P0 + std::sqrt(uv(0)) * (1 - uv(1)) * P1 + std::sqrt(uv(0)) * uv(1) * P2 + 3 * tol * n;
+			ends.col(i) = sun_pos;
+		}
+
+		std::vector<int> bsp_hits(N_rays);
+		std::vector<int> bvh_hits(N_rays);
+		std::vector<int> packet_hits(N_rays);
+
+		start = std::chrono::system_clock::now();
+		vtkSmartPointer<vtkGenericCell> cell = vtkSmartPointer<vtkGenericCell>::New();
+		for (int i = 0; i < N_rays; ++i){
+			double t;
+			double x[3];
+			double pcoords[3];
+			int subId;
+			vtkIdType cellId;
+			bsp_hits[i] = tree -> IntersectWithLine(starts.colptr(i),ends.colptr(i),tol,t,x,pcoords,subId,cellId,cell);
+		}
+		end = std::chrono::system_clock::now();
+		std::chrono::duration<double> bsp_trace = end - start;
+
+		start = std::chrono::system_clock::now();
+		for (int i = 0; i < N_rays; ++i){
+			bvh_hits[i] = bvh.AnyHit(starts.colptr(i),ends.colptr(i),tol);
+		}
+		end = std::chrono::system_clock::now();
+		std::chrono::duration<double> bvh_trace = end - start;
+
+		start = std::chrono::system_clock::now();
+		for (int i = 0; i < N_rays; i += SBGATTriangleBVH::PacketSize){
+			int n_rays = std::min(N_rays - i,static_cast<int>(SBGATTriangleBVH::PacketSize));
+			bool hits[SBGATTriangleBVH::PacketSize] = {};
+			bvh.AnyHitPacket(starts.colptr(i),ends.colptr(i),n_rays,tol,hits);
+			for (int r = 0; r < n_rays; ++r){
+				packet_hits[i + r] = hits[r];
+			}
+		}
+		end = std::chrono::system_clock::now();
+		std::chrono::duration<double> packet_trace = end - start;
+
+		int mismatches = 0;
+		for (int i = 0; i < N_rays; ++i){
+			assert(bvh_hits[i] == packet_hits[i]);
+			mismatches += (bvh_hits[i] != bsp_hits[i]);
+		}
+
+		std::cout << "-- " << filename << " (" << polydata -> GetNumberOfCells() << " facets), " << N_rays << " shadow rays\n";
+		std::cout << "--- vtkModifiedBSPTree: built in " << bsp_build.count() << " s, traced in " << bsp_trace.count() << " s\n";
+		std::cout << "--- SBGATTriangleBVH: built in " << bvh_build.count() << " s, traced in " << bvh_trace.count() << " s (single rays), " << packet_trace.count() << " s (packets)\n";
+		std::cout << "--- Mismatching rays: " << mismatches << std::endl;
+
+		// Only rays grazing an edge may be classified differently by the two tolerance models
+		assert(mismatches < 1e-3 * N_rays);
+
+	}
+
+	std::cout << "- Done running test_triangle_bvh" << std::endl;
+
+}
+
+/**
+This test cross-validates the self-shadowing given by horizon maps against the ray-traced one, 
+and checks that the horizon maps are restored exactly from a binary file
+*/
+void TestsSBCore::test_obs_horizon_maps(){
+
+	std::cout << "- Running test_obs_horizon_maps ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/itokawa_8.obj");
+	reader -> Update(); 
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve -> SetInputConnection(reader -> GetOutputPort());
+	lightcurve -> SetScaleKiloMeters();
+	lightcurve -> SetSamplingMethod(SBGATObs::CentroidQuadrature);
+	lightcurve -> Update();
+
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::vec({0,0,1e-4})};
+
+	// Grazing geometries, where the self-shadowing matters most
+	std::vector<arma::vec> sun_dirs = {arma::normalise(arma::vec({1,0.2,0.1})),arma::normalise(arma::vec({0.1,1,0.8}))};
+	std::vector<arma::vec> observer_dirs = {arma::normalise(arma::vec({1,1,0.3})),arma::normalise(arma::vec({-0.5,1,0.2}))};
+
+	std::vector<std::array<double, 2> > measurements_ray_traced;
+	for (unsigned int i = 0; i < sun_dirs.size(); ++i){
+		lightcurve -> CollectMeasurements(measurements_ray_traced,i,1,sun_dirs[i],observer_dirs[i],
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	}
+
+	auto start = std::chrono::system_clock::now();
+	lightcurve -> ComputeHorizonMaps(64);
+	auto end = std::chrono::system_clock::now();
+	std::chrono::duration<double> elapsed_seconds = end - start;
+	std::cout << "-- Computed horizon maps in " << elapsed_seconds.count() << " s\n";
+
+	assert(lightcurve -> HasHorizonMaps());
+
+	std::vector<std::array<double, 2> > measurements_horizon_maps;
+	for (unsigned int i = 0; i < sun_dirs.size(); ++i){
+		lightcurve -> CollectMeasurements(measurements_horizon_maps,i,1,sun_dirs[i],observer_dirs[i],
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	}
+
+	// The horizon maps only approximate the horizon of each facet's centroid
+	for (unsigned int i = 0; i < sun_dirs.size(); ++i){
+		double relative_error = std::abs(measurements_horizon_maps[i][1] - measurements_ray_traced[i][1]) / measurements_ray_traced[i][1];
+		std::cout << "-- Relative lightcurve error from horizon maps: " << relative_error << std::endl;
+		assert(relative_error < 1e-2);
+	}
+
+	// The maps are stored exactly
+	lightcurve -> SaveHorizonMaps("../output/itokawa_8_horizon_maps.bin");
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve_from_file = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve_from_file -> SetInputConnection(reader -> GetOutputPort());
+	lightcurve_from_file -> SetScaleKiloMeters();
+	lightcurve_from_file -> SetSamplingMethod(SBGATObs::CentroidQuadrature);
+	lightcurve_from_file -> Update();
+	lightcurve_from_file -> LoadHorizonMaps("../output/itokawa_8_horizon_maps.bin");
+
+	std::vector<std::array<double, 2> > measurements_from_file;
+	for (unsigned int i = 0; i < sun_dirs.size(); ++i){
+		lightcurve_from_file -> CollectMeasurements(measurements_from_file,i,1,sun_dirs[i],observer_dirs[i],
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+		assert(measurements_from_file[i][1] == measurements_horizon_maps[i][1]);
+	}
+
+	// Maps computed for another shape are rejected
+	vtkSmartPointer<vtkOBJReader> other_reader = vtkSmartPointer<vtkOBJReader>::New();
+	other_reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	other_reader -> Update(); 
+
+	vtkSmartPointer<SBGATObsLightcurve> other_lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	other_lightcurve -> SetInputConnection(other_reader -> GetOutputPort());
+	other_lightcurve -> Update();
+
+	bool thrown = false;
+	try{
+		other_lightcurve -> LoadHorizonMaps("../output/itokawa_8_horizon_maps.bin");
+	}
+	catch(std::runtime_error & e){
+		thrown = true;
+	}
+	assert(thrown);
+	assert(!other_lightcurve -> HasHorizonMaps());
+
+	// Files with no azimuth bins or whose elevation tables do not match their header are rejected
+	std::ifstream maps_file("../output/itokawa_8_horizon_maps.bin",std::ios::binary);
+	std::vector<char> maps_bytes((std::istreambuf_iterator<char>(maps_file)),std::istreambuf_iterator<char>());
+	maps_file.close();
+
+	std::vector<char> no_azimuth_bytes = maps_bytes;
+	uint32_t no_azimuth = 0;
+	std::memcpy(no_azimuth_bytes.data() + 12,&no_azimuth,sizeof(no_azimuth));
+
+	std::vector<char> truncated_bytes(maps_bytes.begin(),maps_bytes.end() - sizeof(double));
+
+	std::vector<char> padded_bytes = maps_bytes;
+	padded_bytes.resize(maps_bytes.size() + sizeof(double),0);
+
+	for (auto corrupted_bytes : {no_azimuth_bytes,truncated_bytes,padded_bytes}){
+
+		std::ofstream corrupted_file("../output/itokawa_8_horizon_maps_corrupted.bin",std::ios::binary);
+		corrupted_file.write(corrupted_bytes.data(),corrupted_bytes.size());
+		corrupted_file.close();
+
+		thrown = false;
+		try{
+			lightcurve_from_file -> LoadHorizonMaps("../output/itokawa_8_horizon_maps_corrupted.bin");
+		}
+		catch(std::runtime_error & e){
+			thrown = true;
+		}
+		assert(thrown);
+
+	}
+
+	std::cout << "- Done running test_obs_horizon_maps" << std::endl;
+
+}
+
+/**
+This test checks the broad phase of the mutual occlusion queries in a binary scene, 
+where the secondary either does not occlude the primary or eclipses it from the sun
+*/
+void TestsSBCore::test_obs_broad_phase(){
+
+	std::cout << "- Running test_obs_broad_phase ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader_primary = vtkSmartPointer<vtkOBJReader>::New();
+	reader_primary -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader_primary -> Update(); 
+
+	vtkSmartPointer<vtkOBJReader> reader_secondary = vtkSmartPointer<vtkOBJReader>::New();
+	reader_secondary -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader_secondary -> Update(); 
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve_single = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve_single -> SetInputConnection(reader_primary -> GetOutputPort());
+	lightcurve_single -> SetSamplingMethod(SBGATObs::CentroidQuadrature);
+	lightcurve_single -> Update();
+
+	// The secondary is a copy of the primary
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve_binary = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve_binary -> AddInputConnection(0,reader_primary -> GetOutputPort());
+	lightcurve_binary -> AddInputConnection(0,reader_secondary -> GetOutputPort());
+	lightcurve_binary -> SetSamplingMethod(SBGATObs::CentroidQuadrature);
+	lightcurve_binary -> Update();
+
+	double separation = 20 * reader_primary -> GetOutput() -> GetLength();
+
+	arma::vec sun_dir = {1,0,0};
+	arma::vec observer_dir = arma::normalise(arma::vec({1,1,0}));
+
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+
+	std::vector<std::array<double, 2> > measurements_single;
+	lightcurve_single -> CollectMeasurements(measurements_single,0,4,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	mrps_vec.push_back(mrps_vec[0]);
+	omegas_vec.push_back(omegas_vec[0]);
+	velocities_vec.push_back(velocities_vec[0]);
+
+	// The secondary lies out of the way of the sun and of the observer: 
+	// the rays from either body skip the other one's hierarchy and both bodies are fully lit
+	positions_vec.push_back(arma::vec({0,0,separation}));
+
+	std::vector<std::array<double, 2> > measurements_binary;
+
+	auto start = std::chrono::system_clock::now();
+	lightcurve_binary -> CollectMeasurements(measurements_binary,0,4,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	auto end = std::chrono::system_clock::now();
+	std::chrono::duration<double> elapsed_seconds = end - start;
+	std::cout << "-- Collected binary lightcurve point in " << elapsed_seconds.count() << " s\n";
+
+	assert(std::abs(measurements_binary[0][1] - 2 * measurements_single[0][1]) / measurements_single[0][1] < 1e-3);
+
+	// The secondary now lies between the primary and the sun, which it eclipses
+	positions_vec[1] = separation * sun_dir;
+
+	lightcurve_binary -> CollectMeasurements(measurements_binary,1,4,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	assert(std::abs(measurements_binary[1][1] - measurements_single[0][1]) / measurements_single[0][1] < 1e-1);
+
+	std::cout << "- Done running test_obs_broad_phase" << std::endl;
+
+}
+
+/**
+This test benchmarks the convergence of the facet sampling methods, comparing the 
+error of the lightcurve luminosities they yield at increasing sample counts to a 
+high-sample reference
+*/
+void TestsSBCore::test_obs_sampling_convergence(){
+
+	std::cout << "- Running test_obs_sampling_convergence ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve -> SetInputConnection(reader -> GetOutputPort());
+	lightcurve -> SetScaleKiloMeters();
+	lightcurve -> Update();
+
+	arma::vec sun_dir = arma::normalise(arma::vec({1,0.2,0.1}));
+	arma::vec observer_dir = arma::normalise(arma::vec({1,1,0.3}));
+
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::vec({0,0,1e-4})};
+
+	auto collect_luminosity = [&](int N, int seed){
+		std::vector<std::array<double, 2> > measurements;
+		lightcurve -> SetSeed(seed);
+		lightcurve -> CollectMeasurements(measurements,0,N,sun_dir,observer_dir,
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+		return measurements[0][1];
+	};
+
+	// The reference luminosity is obtained from a large number of quasi-random samples
+	int N_ref = 1024;
+	lightcurve -> SetSamplingMethod(SBGATObs::SobolSampling);
+	double reference_luminosity = collect_luminosity(N_ref,0);
+
+	std::vector<SBGATObs::SamplingMethod> methods = {SBGATObs::RandomSampling,SBGATObs::StratifiedSampling,SBGATObs::SobolSampling};
+	std::vector<std::string> names = {"random","stratified","sobol"};
+	std::vector<int> N_vec = {4,16,64};
+	int N_seeds = 8;
+
+	// Root-mean-square relative error of each method (row) at each sample count (column)
+	arma::mat errors(methods.size(),N_vec.size());
+
+	for (unsigned int method = 0; method < methods.size(); ++method){
+
+		lightcurve -> SetSamplingMethod(methods[method]);
+
+		for (unsigned int k = 0; k < N_vec.size(); ++k){
+
+			arma::vec relative_errors(N_seeds);
+			auto start = std::chrono::system_clock::now();
+
+			for (int seed = 0; seed < N_seeds; ++seed){
+				relative_errors(seed) = (collect_luminosity(N_vec[k],seed + 1) - reference_luminosity) / reference_luminosity;
+			}
+
+			auto end = std::chrono::system_clock::now();
+			std::chrono::duration<double> elapsed_seconds = end - start;
+
+			errors(method,k) = std::sqrt(arma::mean(arma::square(relative_errors)));
+
+			std::cout << "-- N = " << N_vec[k] << ", " << names[method] << " sampling: relative error " << errors(method,k) 
+			<< " in " << elapsed_seconds.count() / N_seeds << " s per lightcurve point\n";
+		}
+
+		// The error decreases as the number of samples increases
+		for (unsigned int k = 1; k < N_vec.size(); ++k){
+			assert(errors(method,k) < errors(method,k - 1));
+		}
+
+	}
+
+	// The quasi-random methods are more accurate than independent samples
+	for (unsigned int k = 0; k < N_vec.size(); ++k){
+		assert(errors(1,k) < errors(0,k));
+		assert(errors(2,k) < errors(0,k));
+	}
+
+	// A single ray per facet is traced by the centroid quadrature, which is deterministic
+	lightcurve -> SetSamplingMethod(SBGATObs::CentroidQuadrature);
+	std::vector<std::array<double, 2> > measurements;
+	lightcurve -> SetSeed(0);
+	lightcurve -> CollectMeasurements(measurements,0,16,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	lightcurve -> SetSeed(1);
+	lightcurve -> CollectMeasurements(measurements,0,16,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	assert(measurements[0][1] == measurements[1][1]);
+
+	std::cout << "- Done running test_obs_sampling_convergence" << std::endl;
+
+}
+
+/**
+This test cross-validates the rasterized visibility against the ray-traced one, 
+comparing the lightcurves and the total radar returns they yield
+*/
+void TestsSBCore::test_obs_rasterization(){
+
+	std::cout << "- Running test_obs_rasterization ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	arma::vec sun_dir = arma::normalise(arma::vec({1,0.2,0.1}));
+	arma::vec observer_dir = arma::normalise(arma::vec({1,1,0.3}));
+
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::vec({0,0,1e-4})};
+
+	int N = 50;
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve -> SetInputConnection(reader -> GetOutputPort());
+	lightcurve -> SetScaleKiloMeters();
+	lightcurve -> Update();
+
+	std::vector<std::array<double, 2> > measurements;
+
+	auto start = std::chrono::system_clock::now();
+	lightcurve -> CollectMeasurements(measurements,0,N,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	auto end = std::chrono::system_clock::now();
+	std::chrono::duration<double> ray_traced = end - start;
+
+	lightcurve -> SetRasterResolution(1024);
+
+	start = std::chrono::system_clock::now();
+	lightcurve -> CollectMeasurements(measurements,0,N,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	end = std::chrono::system_clock::now();
+	std::chrono::duration<double> rasterized = end - start;
+
+	std::cout << "-- Lightcurve: ray-traced " << measurements[0][1] << " in " << ray_traced.count() << " s, rasterized " << measurements[1][1] << " in " << rasterized.count() << " s\n";
+	assert(std::abs(measurements[1][1] - measurements[0][1]) / measurements[0][1] < 5e-2);
+
+	vtkSmartPointer<SBGATObsRadar> radar = vtkSmartPointer<SBGATObsRadar>::New();
+	radar -> SetInputConnection(reader -> GetOutputPort());
+	radar -> SetScaleKiloMeters();
+	radar -> Update();
+
+	SBGATRadarObsSequence measurements_sequence;
+	radar -> CollectMeasurements(measurements_sequence,0,N,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	radar -> SetRasterResolution(1024);
+	radar -> CollectMeasurements(measurements_sequence,0,N,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	std::vector<double> total_returns(2,0);
+	for (int i = 0; i < 2; ++i){
+		for (const auto & measurement : measurements_sequence[i]){
+			total_returns[i] += measurement[2];
+		}
+	}
+
+	std::cout << "-- Radar: ray-traced " << total_returns[0] << ", rasterized " << total_returns[1] << std::endl;
+	assert(std::abs(total_returns[1] - total_returns[0]) / total_returns[0] < 5e-2);
+
+	std::cout << "- Done running test_obs_rasterization" << std::endl;
+
+}
+
+/**
+This test verifies that the lightcurve reverse ray-tracing is reproducible
+for a given seed, regardless of the number of threads it runs on and of 
+whether the epochs are collected one at a time or as a sequence
+*/
+void TestsSBCore::test_lightcurve_obs_reproducibility(){
+
+	std::cout << "- Running test_lightcurve_obs_reproducibility ..." << std::endl;
+
+	// Loading in the shape model
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve -> SetInputConnection(reader -> GetOutputPort());
+	lightcurve -> SetScaleKiloMeters();
+	lightcurve -> Update();
+
+	arma::vec sun_dir = {1,0,0};
+	arma::vec observer_dir = arma::normalise(arma::vec({1,1,0}));
+
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::vec({0,0,1e-4})};
+
+	std::vector<std::array<double, 2> > measurements;
+
+	// The reference luminosities are collected on a single thread
+	#ifdef _OPENMP
+	int max_threads = omp_get_max_threads();
+	omp_set_num_threads(1);
+	#endif
+
+	lightcurve -> SetSeed(42);
+	lightcurve -> CollectMeasurements(measurements,0,10,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	lightcurve -> CollectMeasurements(measurements,1,10,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	#ifdef _OPENMP
+	omp_set_num_threads(max_threads);
+	#endif
+
+	// Re-seeding replays the same sequence of samples
+	lightcurve -> SetSeed(42);
+	lightcurve -> CollectMeasurements(measurements,0,10,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	lightcurve -> CollectMeasurements(measurements,1,10,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	assert(measurements[0][1] > 0);
+	assert(measurements[0][1] == measurements[2][1]);
+	assert(measurements[1][1] == measurements[3][1]);
+
+	// Successive collections draw from distinct streams
+	assert(measurements[0][1] != measurements[1][1]);
+
+	// A different seed yields different samples
+	lightcurve -> SetSeed(43);
+	lightcurve -> CollectMeasurements(measurements,0,10,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+	assert(measurements[4][1] != measurements[0][1]);
+
+	// Collecting both epochs at once, in parallel, yields the same luminosities
+	std::vector<std::array<double, 2> > measurements_sequence;
+	lightcurve -> SetSeed(42);
+	lightcurve -> CollectMeasurementsSequence(measurements_sequence,{0,1},10,sun_dir,observer_dir,
+		{positions_vec,positions_vec},{velocities_vec,velocities_vec},{mrps_vec,mrps_vec},{omegas_vec,omegas_vec},true);
+
+	assert(measurements_sequence.size() == 2);
+	assert(measurements_sequence[0][0] == 0 && measurements_sequence[1][0] == 1);
+	assert(measurements_sequence[0][1] == measurements[0][1]);
+	assert(measurements_sequence[1][1] == measurements[1][1]);
+
+	// The luminosities do not depend on the number of threads
+	#ifdef _OPENMP
+	for (int threads : {2,3,max_threads}){
+
+		omp_set_num_threads(threads);
+
+		std::vector<std::array<double, 2> > measurements_threads;
+		lightcurve -> SetSeed(42);
+		lightcurve -> CollectMeasurements(measurements_threads,0,10,sun_dir,observer_dir,
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+		lightcurve -> CollectMeasurements(measurements_threads,1,10,sun_dir,observer_dir,
+			positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+		assert(measurements_threads[0][1] == measurements[0][1]);
+		assert(measurements_threads[1][1] == measurements[1][1]);
+
+		std::vector<std::array<double, 2> > measurements_sequence_threads;
+		lightcurve -> SetSeed(42);
+		lightcurve -> CollectMeasurementsSequence(measurements_sequence_threads,{0,1},10,sun_dir,observer_dir,
+			{positions_vec,positions_vec},{velocities_vec,velocities_vec},{mrps_vec,mrps_vec},{omegas_vec,omegas_vec},true);
+
+		assert(measurements_sequence_threads[0][1] == measurements[0][1]);
+		assert(measurements_sequence_threads[1][1] == measurements[1][1]);
+	}
+
+	omp_set_num_threads(max_threads);
+	#endif
+
+	std::cout << "- Done running test_lightcurve_obs_reproducibility" << std::endl;
+
+}
+
+/**
+This test checks that the facet normals, areas and centers of mass cached by the observation filters match 
+freshly computed ones, and that they are refreshed once the shape changes
+*/
+void TestsSBCore::test_obs_facet_cache(){
+
+	std::cout << "- Running test_obs_facet_cache ..." << std::endl;
+
+	vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+	reader -> SetFileName("../../resources/shape_models/KW4Alpha.obj");
+	reader -> Update(); 
+
+	vtkSmartPointer<vtkPolyData> shape = vtkSmartPointer<vtkPolyData>::New();
+	shape -> DeepCopy(reader -> GetOutput());
+
+	vtkSmartPointer<SBGATObsLightcurve> lightcurve = vtkSmartPointer<SBGATObsLightcurve>::New();
+	lightcurve -> SetInputData(shape);
+	lightcurve -> SetScaleKiloMeters();
+	lightcurve -> Update();
+
+	auto check_facet_cache = [&](){
+
+		const arma::mat & normals = lightcurve -> get_facet_normals(0);
+		const arma::vec & areas = lightcurve -> get_facet_areas(0);
+
+		assert(normals.n_cols == shape -> GetNumberOfCells());
+		assert(areas.n_elem == shape -> GetNumberOfCells());
+
+		vtkSmartPointer<vtkIdList> ptIds = vtkSmartPointer<vtkIdList>::New();
+
+		for (vtkIdType i = 0; i < shape -> GetNumberOfCells(); ++i){
+			shape -> GetCellPoints(i,ptIds);
+
+			double p0[3],p1[3],p2[3],n[3];
+			shape -> GetPoint(ptIds -> GetId(0),p0);
+			shape -> GetPoint(ptIds -> GetId(1),p1);
+			shape -> GetPoint(ptIds -> GetId(2),p2);
+			vtkTriangle::ComputeNormal(p0,p1,p2,n);
+			double area = vtkTriangle::TriangleArea(p0,p1,p2);
+
+			assert(std::abs(areas(i) - area) / area < 1e-10);
+			assert(arma::norm(normals.col(i) - arma::vec({n[0],n[1],n[2]})) < 1e-10);
+		}
+	};
+
+	arma::vec sun_dir = {1,0,0};
+	arma::vec observer_dir = arma::normalise(arma::vec({1,1,0}));
+
+	std::vector<arma::vec> positions_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> velocities_vec = {arma::zeros<arma::vec>(3)};
+	std::vector<arma::vec> mrps_vec = {arma::vec({0,0,0.1})};
+	std::vector<arma::vec> omegas_vec = {arma::vec({0,0,1e-4})};
+
+	std::vector<std::array<double, 2> > measurements;
+
+	check_facet_cache();
+	lightcurve -> CollectMeasurements(measurements,0,16,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	// Subdividing the shape changes its facets but not its geometry
+	vtkSmartPointer<vtkLinearSubdivisionFilter> subdivisionFilter = vtkSmartPointer<vtkLinearSubdivisionFilter>::New();
+	subdivisionFilter -> SetInputData(reader -> GetOutput());
+	subdivisionFilter -> SetNumberOfSubdivisions(1);
+	subdivisionFilter -> Update();
+
+	shape -> DeepCopy(subdivisionFilter -> GetOutput());
+	lightcurve -> Update();
+
+	assert(lightcurve -> get_facet_normals(0).n_cols == 4 * reader -> GetOutput() -> GetNumberOfCells());
+	check_facet_cache();
+
+	// The facets in view are found among the new facets
+	lightcurve -> CollectMeasurements(measurements,1,16,sun_dir,observer_dir,
+		positions_vec,velocities_vec,mrps_vec,omegas_vec,true);
+
+	assert(std::abs(measurements[1][1] - measurements[0][1]) / measurements[0][1] < 5e-2);
+
+	// Moving the shape refreshes its center of mass, expressed in the units of the shape
+	arma::vec center_of_mass = lightcurve -> get_center_of_mass(0);
+
+	vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+	transform -> Translate(1,0,0);
+	vtkSmartPointer<vtkTransformPolyDataFilter> transform_filter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+	transform_filter -> SetInputData(subdivisionFilter -> GetOutput());
+	transform_filter -> SetTransform(transform);
+	transform_filter -> Update();
+
+	shape -> DeepCopy(transform_filter -> GetOutput());
+	lightcurve -> Update();
+
+	check_facet_cache();
+	assert(std::abs(lightcurve -> get_center_of_mass(0)(0) - center_of_mass(0) - 1) < 1e-6);
+	assert(std::abs(lightcurve -> get_center_of_mass(0)(1) - center_of_mass(1)) < 1e-6);
+	assert(std::abs(lightcurve -> get_center_of_mass(0)(2) - center_of_mass(2)) < 1e-6);
+
+	std::cout << "- Done running test_obs_facet_cache" << std::endl;
+
+}
 
 // *
 // This test computes simulated lightcurves for benchmarking purposes